@@ -0,0 +1,249 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    bqfft
+
+    A small library wrapping various FFT implementations for some
+    common audio processing use cases.
+
+    Copyright 2007-2021 Particular Programs Ltd.
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of Chris Cannam and
+    Particular Programs Ltd shall not be used in advertising or
+    otherwise to promote the sale, use or other dealings in this
+    Software without prior written authorization.
+*/
+
+
+#ifndef BQFFT_CONVOLVER_H
+#define BQFFT_CONVOLVER_H
+
+#include "FFT.h"
+
+#include <vector>
+
+namespace breakfastquay {
+
+/**
+ * Convolution of a signal with a fixed impulse response (FIR
+ * filtering) by uniformly partitioned overlap-save, processing
+ * blockSize samples at a time with no latency beyond the block
+ * itself.
+ *
+ * The impulse response is split into partitions of blockSize
+ * samples, each transformed once, at construction, with an FFT of
+ * size 2 * blockSize. Each block of input is transformed once and
+ * kept in a frequency-domain delay line. The output spectrum is the
+ * sum over all partitions of the partition's spectrum times the
+ * spectrum of the input from that many blocks ago, and a single
+ * inverse transform per block gives the output.
+ *
+ * process does not allocate memory. Construct with
+ * FFT::RealTimeMode for the FFT to preallocate too, making it safe
+ * for a real-time thread.
+ *
+ * T may be float or double. Like FFT, this class is not thread safe.
+ */
+template <typename T>
+class Convolver
+{
+public:
+    /**
+     * Convolve with the length samples of impulseResponse, which is
+     * copied (in transformed form), in blocks of blockSize samples.
+     *
+     * Throws FFT::InvalidSize if blockSize or length is less than 1.
+     */
+    Convolver(int blockSize, const T *impulseResponse, int length,
+              FFT::Mode mode = FFT::DefaultMode);
+    ~Convolver();
+
+    int getBlockSize() const { return m_blockSize; }
+    int getImpulseResponseLength() const { return m_length; }
+    int getPartitionCount() const { return m_partitions; }
+
+    /**
+     * Filter the next blockSize samples of in into out. The output
+     * includes the tails of the responses to all earlier blocks.
+     */
+    void process(const T *BQ_R__ in, T *BQ_R__ out);
+
+    /**
+     * Forget all previous input, as if newly constructed.
+     */
+    void reset();
+
+    FFT &getFFT() { return m_fft; }
+
+private:
+    const int m_blockSize;
+    const int m_length;
+    const int m_partitions;
+    const int m_bins;   // blockSize + 1
+    T *m_irReal;        // m_partitions spectra of m_bins, pre-scaled
+    T *m_irImag;
+    T *m_fdlReal;       // m_partitions input spectra of m_bins
+    T *m_fdlImag;
+    int m_fdlHead;      // index in the delay line of the newest spectrum
+    T *m_accReal;       // m_bins
+    T *m_accImag;
+    T *m_input;         // previous and current blocks
+    FFT m_fft;
+
+    Convolver(const Convolver &); // not provided
+    Convolver &operator=(const Convolver &); // not provided
+};
+
+/**
+ * Convolution with a long impulse response using partitions of
+ * increasing size, for low latency at modest CPU cost.
+ *
+ * The head of the impulse response, the first 6 * blockSize samples,
+ * is convolved directly in process() by a Convolver with the caller's
+ * block size, so there is no latency beyond the block itself, as for
+ * Convolver. The rest is split into stages whose block size doubles
+ * from 2 * blockSize up to maxBlockSize: the stage with block size B
+ * covers the impulse response from 3B to 6B (the last stage covers
+ * everything from 3B to the end). Each stage is a Convolver of its
+ * own size, run once per B samples of input, so the tail costs a few
+ * large transforms rather than many small ones.
+ *
+ * Because each stage starts 3B samples into the impulse response,
+ * its output for a block of input is not needed until 2B samples
+ * after that block has arrived. With a background thread, process()
+ * queues each completed stage block for the thread, which runs
+ * queued blocks earliest deadline first, and picks up the result 2B
+ * samples later. The thread so has two of a stage's blocks in which
+ * to finish each of them, and a stage can have a block queued while
+ * the thread is still running the one before. If the thread has not
+ * started a block when it is due, process() runs it itself. If the
+ * thread is still running it, process() does not wait for it, since
+ * on a busy or single core the thread might not get to run until
+ * process() returns: the stage contributes silence for that block
+ * instead, but the thread still finishes it, so that the stage's
+ * later output is unaffected. Either case counts as late
+ * (getLateCount()), and the second is also counted as skipped
+ * (getSkipCount()). Only if the thread falls a further block behind
+ * is there nowhere to queue a stage's next block, which is then
+ * lost, leaving that stage's part of the output wrong until its
+ * span of the impulse response has passed. Without a background
+ * thread, or if built with NO_THREADING, process() runs each stage
+ * as soon as its block is complete, so the cost arrives in bursts.
+ *
+ * process() does not allocate memory and takes no locks: blocks are
+ * handed to and from the background thread through atomic state
+ * flags, and the thread is woken by posting a semaphore. Construct
+ * with FFT::RealTimeMode for the FFTs to preallocate too. The
+ * background thread runs at the default priority, so give it room:
+ * a caller with a real-time priority should leave the thread enough
+ * CPU time to finish each stage block within two of that stage's
+ * blocks.
+ *
+ * T may be float or double. Like FFT, this class is not thread safe:
+ * the background thread is internal to it.
+ */
+template <typename T>
+class NonUniformConvolver
+{
+public:
+    /**
+     * Convolve with the length samples of impulseResponse, which is
+     * copied, in blocks of blockSize samples. The largest stage
+     * block size is the greatest blockSize * 2^k not exceeding
+     * maxBlockSize; 0 means 4096, or blockSize if that is larger. If
+     * useThread is false, or threading is not available, all stages
+     * run in process().
+     *
+     * Throws FFT::InvalidSize if blockSize or length is less than 1,
+     * or maxBlockSize is nonzero but less than blockSize.
+     */
+    NonUniformConvolver(int blockSize, const T *impulseResponse, int length,
+                        int maxBlockSize = 0, bool useThread = true,
+                        FFT::Mode mode = FFT::DefaultMode);
+    ~NonUniformConvolver();
+
+    int getBlockSize() const { return m_blockSize; }
+    int getImpulseResponseLength() const { return m_length; }
+
+    /**
+     * Return the number of stages after the head, i.e. the number
+     * of distinct larger block sizes in use.
+     */
+    int getStageCount() const { return int(m_stages.size()); }
+
+    /**
+     * Return the block size of the given stage, 0 <= stage <
+     * getStageCount().
+     */
+    int getStageBlockSize(int stage) const;
+
+    /**
+     * Filter the next blockSize samples of in into out.
+     */
+    void process(const T *BQ_R__ in, T *BQ_R__ out);
+
+    /**
+     * Return the number of stage blocks whose processing had not
+     * finished on the background thread when process() needed them,
+     * whether process() then ran them itself or had to leave their
+     * output out.
+     */
+    int getLateCount() const { return m_lateCount; }
+
+    /**
+     * Return the number of stage blocks whose output was left out
+     * because the background thread was still running them when
+     * process() needed them, plus any blocks of input lost because
+     * the thread was too far behind to queue them, as described
+     * above. Other late blocks were only expensive.
+     */
+    int getSkipCount() const { return m_skipCount; }
+
+    /**
+     * Forget all previous input, as if newly constructed. Waits for
+     * the background thread to finish any stage it is running, so
+     * unlike process() this may block.
+     */
+    void reset();
+
+private:
+    struct Stage;
+    struct Worker;
+
+    const int m_blockSize;
+    const int m_length;
+    Convolver<T> *m_head;
+    std::vector<Stage *> m_stages;
+    Worker *m_worker;    // null if stages run in process()
+    int m_lateCount;
+    int m_skipCount;
+
+    void collect(Stage *stage);
+    void issue(Stage *stage);
+
+    NonUniformConvolver(const NonUniformConvolver &); // not provided
+    NonUniformConvolver &operator=(const NonUniformConvolver &); // not provided
+};
+
+}
+
+#endif
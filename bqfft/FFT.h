@@ -40,6 +40,12 @@
 
 #include <string>
 #include <set>
+#include <vector>
+#include <cstddef>
+
+#ifdef FFT_STATISTICS
+#include <stdint.h>
+#endif
 
 namespace breakfastquay {
 
@@ -63,6 +69,12 @@ class FFTImpl;
  *
  * Neither forward nor inverse transform is scaled.
  *
+ * Unless a default implementation has been set explicitly, a single
+ * FFT object may use more than one implementation underneath: float
+ * and double calls each go to an implementation that is native in
+ * that precision where one is compiled in, and individual methods go
+ * to whichever implementation calibrate() found fastest for them.
+ *
  * This class is reentrant but not thread safe: use a separate
  * instance per thread, or use a mutex.
  */
@@ -73,10 +85,29 @@ public:
         NullArgument, InvalidSize, InvalidImplementation, InternalError
     };
 
-    FFT(int size, int debugLevel = 0); // may throw InvalidSize
+    /**
+     * In RealTimeMode, the constructor initialises the chosen
+     * implementation(s) for both precisions up front, so that no
+     * subsequent transform call allocates memory or takes a lock and
+     * every call is safe to make from a real-time thread. In
+     * DefaultMode, each precision is initialised on first use unless
+     * initFloat or initDouble is called first.
+     */
+    enum Mode {
+        DefaultMode, RealTimeMode
+    };
+    
+    FFT(int size, int debugLevel = 0, Mode mode = DefaultMode); // may throw InvalidSize
     ~FFT();
 
     int getSize() const;
+
+    /**
+     * Return the name of the implementation this object uses, as
+     * listed by getImplementations(). If its methods are routed to
+     * more than one implementation, the names are joined with "+".
+     */
+    std::string getImplementation() const;
     
     void forward(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut);
     void forwardInterleaved(const double *BQ_R__ realIn, double *BQ_R__ complexOut);
@@ -98,6 +129,226 @@ public:
     void inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut);
     void inverseCepstral(const float *BQ_R__ magIn, float *BQ_R__ cepOut);
 
+    /**
+     * Forward transforms of a windowed and rotated frame, as used
+     * for STFT analysis. The transform sees realIn multiplied by
+     * window (if window is non-null; it must have size samples) and
+     * then rotated left by rotation samples, i.e. the windowed
+     * sample j appears at index (j - rotation) mod size. A rotation
+     * of size/2 gives zero-phase analysis. The implementation does
+     * this while loading the input into its own buffers, so it costs
+     * no separate pass over the frame. realIn is not modified.
+     */
+    void forwardWindowed(const double *BQ_R__ realIn, const double *BQ_R__ window, int rotation, double *BQ_R__ realOut, double *BQ_R__ imagOut);
+    void forwardWindowedInterleaved(const double *BQ_R__ realIn, const double *BQ_R__ window, int rotation, double *BQ_R__ complexOut);
+    void forwardWindowedPolar(const double *BQ_R__ realIn, const double *BQ_R__ window, int rotation, double *BQ_R__ magOut, double *BQ_R__ phaseOut);
+    void forwardWindowedMagnitude(const double *BQ_R__ realIn, const double *BQ_R__ window, int rotation, double *BQ_R__ magOut);
+
+    void forwardWindowed(const float *BQ_R__ realIn, const float *BQ_R__ window, int rotation, float *BQ_R__ realOut, float *BQ_R__ imagOut);
+    void forwardWindowedInterleaved(const float *BQ_R__ realIn, const float *BQ_R__ window, int rotation, float *BQ_R__ complexOut);
+    void forwardWindowedPolar(const float *BQ_R__ realIn, const float *BQ_R__ window, int rotation, float *BQ_R__ magOut, float *BQ_R__ phaseOut);
+    void forwardWindowedMagnitude(const float *BQ_R__ realIn, const float *BQ_R__ window, int rotation, float *BQ_R__ magOut);
+
+    /**
+     * Forward transforms of a frame of inputLength samples
+     * zero-padded to size, e.g. 1500 samples analysed at a size of
+     * 4096. Only the first inputLength samples of realIn are read,
+     * so it need not have room for the padding, and the padding is
+     * never copied in. The built-in implementation also skips the
+     * butterflies that would only combine the input with zeros, so
+     * the transform costs closer to size log(inputLength) than size
+     * log(size). inputLength must be between 0 and size inclusive,
+     * or InvalidSize is thrown.
+     */
+    void forwardPadded(const double *BQ_R__ realIn, int inputLength, double *BQ_R__ realOut, double *BQ_R__ imagOut);
+    void forwardPaddedInterleaved(const double *BQ_R__ realIn, int inputLength, double *BQ_R__ complexOut);
+    void forwardPaddedPolar(const double *BQ_R__ realIn, int inputLength, double *BQ_R__ magOut, double *BQ_R__ phaseOut);
+    void forwardPaddedMagnitude(const double *BQ_R__ realIn, int inputLength, double *BQ_R__ magOut);
+
+    void forwardPadded(const float *BQ_R__ realIn, int inputLength, float *BQ_R__ realOut, float *BQ_R__ imagOut);
+    void forwardPaddedInterleaved(const float *BQ_R__ realIn, int inputLength, float *BQ_R__ complexOut);
+    void forwardPaddedPolar(const float *BQ_R__ realIn, int inputLength, float *BQ_R__ magOut, float *BQ_R__ phaseOut);
+    void forwardPaddedMagnitude(const float *BQ_R__ realIn, int inputLength, float *BQ_R__ magOut);
+
+    /**
+     * Forward transforms returning only bins firstBin to lastBin - 1,
+     * written from the start of the output arrays, which need room
+     * for lastBin - firstBin values. The range must lie within the
+     * size/2+1 bins, or InvalidSize is thrown.
+     *
+     * A narrow range is computed by Goertzel's algorithm directly
+     * from the input, at a cost of about size per bin; a wider one
+     * by a full transform of which only the range is copied out,
+     * whichever a simple cost model expects to be cheaper: at size
+     * 4096, Goertzel is used for up to 8 bins. Its rounding error
+     * grows with the size faster than a transform's does, reaching
+     * around 1e-12 of the spectrum's scale at size 4096 in double
+     * precision (it always computes in double).
+     */
+    void forwardBins(const double *BQ_R__ realIn, int firstBin, int lastBin, double *BQ_R__ realOut, double *BQ_R__ imagOut);
+    void forwardBinsMagnitude(const double *BQ_R__ realIn, int firstBin, int lastBin, double *BQ_R__ magOut);
+
+    void forwardBins(const float *BQ_R__ realIn, int firstBin, int lastBin, float *BQ_R__ realOut, float *BQ_R__ imagOut);
+    void forwardBinsMagnitude(const float *BQ_R__ realIn, int firstBin, int lastBin, float *BQ_R__ magOut);
+
+    /**
+     * Inverse transforms returning only samples firstSample to
+     * lastSample - 1 of the plain inverse result, written from the
+     * start of realOut, which needs room for lastSample - firstSample
+     * values. The range must lie within the size samples, or
+     * InvalidSize is thrown. This suits overlap-save processing,
+     * which keeps only the end of each inverse.
+     *
+     * The samples outside the range are not stored, and the built-in
+     * and DFT implementations do not produce them at all; the
+     * transform itself is still done in full.
+     */
+    void inverseSamples(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, int firstSample, int lastSample, double *BQ_R__ realOut);
+    void inverseInterleavedSamples(const double *BQ_R__ complexIn, int firstSample, int lastSample, double *BQ_R__ realOut);
+
+    void inverseSamples(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, int firstSample, int lastSample, float *BQ_R__ realOut);
+    void inverseInterleavedSamples(const float *BQ_R__ complexIn, int firstSample, int lastSample, float *BQ_R__ realOut);
+
+    /**
+     * Inverse transforms followed by a rotation and synthesis
+     * window: sample j of realOut is window[j] (or 1 if window is
+     * null) times sample (j - rotation) mod size of the plain inverse
+     * result. Passing the rotation given to forwardWindowed undoes
+     * it. This is done while storing the output, as for
+     * forwardWindowed.
+     */
+    void inverseWindowed(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, const double *BQ_R__ window, int rotation, double *BQ_R__ realOut);
+    void inverseWindowedInterleaved(const double *BQ_R__ complexIn, const double *BQ_R__ window, int rotation, double *BQ_R__ realOut);
+    void inverseWindowedPolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, const double *BQ_R__ window, int rotation, double *BQ_R__ realOut);
+
+    void inverseWindowed(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, const float *BQ_R__ window, int rotation, float *BQ_R__ realOut);
+    void inverseWindowedInterleaved(const float *BQ_R__ complexIn, const float *BQ_R__ window, int rotation, float *BQ_R__ realOut);
+    void inverseWindowedPolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, const float *BQ_R__ window, int rotation, float *BQ_R__ realOut);
+
+    /**
+     * As inverseWindowed, but for overlap-add synthesis: sample j
+     * of the rotated and windowed inverse result is multiplied by
+     * gain and added to out[j], instead of being stored there. The
+     * scaling, windowing and accumulation all happen in the pass in
+     * which the implementation stores its output, so out may be the
+     * overlap-add buffer itself with no temporary frame in between.
+     */
+    void inverseAccumulate(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, const double *BQ_R__ window, int rotation, double gain, double *BQ_R__ out);
+    void inverseAccumulateInterleaved(const double *BQ_R__ complexIn, const double *BQ_R__ window, int rotation, double gain, double *BQ_R__ out);
+    void inverseAccumulatePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, const double *BQ_R__ window, int rotation, double gain, double *BQ_R__ out);
+
+    void inverseAccumulate(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, const float *BQ_R__ window, int rotation, float gain, float *BQ_R__ out);
+    void inverseAccumulateInterleaved(const float *BQ_R__ complexIn, const float *BQ_R__ window, int rotation, float gain, float *BQ_R__ out);
+    void inverseAccumulatePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, const float *BQ_R__ window, int rotation, float gain, float *BQ_R__ out);
+
+    /**
+     * Squared magnitude (power) spectrum, of size/2+1 bins: the
+     * square of what forwardMagnitude returns, but computed directly
+     * from the implementation's own transform output with no square
+     * root taken. inversePower is the inverse of a spectrum with
+     * these real parts and zero imaginary parts; given the output of
+     * forwardPower, it returns size times the circular
+     * autocorrelation of the original input (see autocorrelate).
+     */
+    void forwardPower(const double *BQ_R__ realIn, double *BQ_R__ powerOut);
+    void inversePower(const double *BQ_R__ powerIn, double *BQ_R__ realOut);
+
+    void forwardPower(const float *BQ_R__ realIn, float *BQ_R__ powerOut);
+    void inversePower(const float *BQ_R__ powerIn, float *BQ_R__ realOut);
+
+    /**
+     * Log magnitude spectra, of size/2+1 bins. forwardLogMagnitude
+     * returns the natural log ln(max(|X|, floor)) of each bin X, and
+     * forwardDecibels returns 20 log10(max(|X|, 10^(floorDb/20))),
+     * so that floorDb is the least value it writes. The floor must
+     * be positive; zero gives the log of the smallest normal number.
+     *
+     * Both are computed from the power spectrum with no square root,
+     * using a polynomial approximation to the log that the compiler
+     * can vectorise, in the same pass in which the implementation
+     * unpacks its transform output. Beyond the rounding error of
+     * the transform itself, this adds an absolute error to each bin
+     * of forwardLogMagnitude within 1e-7 + 4e-7 |out| for float and
+     * 5e-15 + 2e-15 |out| for double, i.e. a few units in the last
+     * place. For forwardDecibels the constant term is 4.3 times
+     * larger: 5e-7 + 4e-7 |out| for float and 2.5e-14 + 2e-15 |out|
+     * for double. inverseCepstral uses the same approximation for
+     * the log of its input magnitudes.
+     *
+     * A power too large to represent (a magnitude above about 1.8e19
+     * for an implementation that works in float, or 1.3e154 in
+     * double) is taken as the largest finite value, so the result is
+     * finite but too small.
+     */
+    void forwardLogMagnitude(const double *BQ_R__ realIn, double *BQ_R__ logMagOut, double floor);
+    void forwardDecibels(const double *BQ_R__ realIn, double *BQ_R__ dbOut, double floorDb);
+
+    void forwardLogMagnitude(const float *BQ_R__ realIn, float *BQ_R__ logMagOut, float floor);
+    void forwardDecibels(const float *BQ_R__ realIn, float *BQ_R__ dbOut, float floorDb);
+
+    enum Normalisation {
+        NoNormalisation,         // plain sums of products
+        BiasedNormalisation,     // sums divided by size
+        CoefficientNormalisation // divided by sqrt(sum a^2 * sum b^2)
+    };
+
+    /**
+     * Circular cross-correlation of a with b, both of size samples:
+     * lag k of the result is the sum over j of a[j + k] * b[j], with
+     * indices taken mod size. For a linear (non-circular) result,
+     * zero-pad the inputs to at least the sum of their lengths less
+     * one. The conjugate product of the two spectra is formed inside
+     * the implementation's own buffers between its forward and
+     * inverse transforms, so no spectrum is copied out or back in.
+     *
+     * The three-argument form writes all size lags to out, lag k at
+     * out[k] (so negative lag -k is at out[size - k]), unnormalised.
+     * The other writes only lags minLag to maxLag inclusive, lag k at
+     * out[k - minLag], so out needs maxLag - minLag + 1 samples;
+     * both lags must lie strictly between -size and size and span no
+     * more than size lags, or InvalidSize is thrown. The chosen
+     * normalisation is folded into the spectral product, and the
+     * coefficient one gives 1 at lag 0 when a and b are equal.
+     */
+    void correlate(const double *BQ_R__ a, const double *BQ_R__ b, double *BQ_R__ out);
+    void correlate(const double *BQ_R__ a, const double *BQ_R__ b, double *BQ_R__ out, int minLag, int maxLag, Normalisation normalisation = NoNormalisation);
+
+    void correlate(const float *BQ_R__ a, const float *BQ_R__ b, float *BQ_R__ out);
+    void correlate(const float *BQ_R__ a, const float *BQ_R__ b, float *BQ_R__ out, int minLag, int maxLag, Normalisation normalisation = NoNormalisation);
+
+    /**
+     * Circular autocorrelation of in, as correlate(in, in, ...) but
+     * transforming the input only once and taking its power spectrum,
+     * which has no imaginary part, in place of the cross product. As
+     * the result is symmetric, the range form returns lags 0 to
+     * maxLag only, in maxLag + 1 samples.
+     */
+    void autocorrelate(const double *BQ_R__ in, double *BQ_R__ out);
+    void autocorrelate(const double *BQ_R__ in, double *BQ_R__ out, int maxLag, Normalisation normalisation = NoNormalisation);
+
+    void autocorrelate(const float *BQ_R__ in, float *BQ_R__ out);
+    void autocorrelate(const float *BQ_R__ in, float *BQ_R__ out, int maxLag, Normalisation normalisation = NoNormalisation);
+
+    /**
+     * Spectral envelope of frame by cepstral smoothing, of size/2+1
+     * bins: the real cepstrum of frame (as inverseCepstral of its
+     * forwardMagnitude output, divided by size) is liftered to keep
+     * only quefrencies up to lifterCutoff either side of zero, and
+     * the exponential of its forward transform returned. A cutoff
+     * of size/2 or more returns the magnitude spectrum plus the
+     * 1e-6 that inverseCepstral adds before the log; a negative one
+     * throws InvalidSize.
+     *
+     * The whole pipeline runs within the implementation's own
+     * buffers in a single call. Only real parts are carried from
+     * the log spectrum onwards, as the imaginary parts are zero,
+     * and the quefrencies removed by the lifter are not computed
+     * where the implementation allows (or otherwise are zeroed
+     * rather than read).
+     */
+    void cepstralEnvelope(const double *BQ_R__ frame, int lifterCutoff, double *BQ_R__ envOut);
+    void cepstralEnvelope(const float *BQ_R__ frame, int lifterCutoff, float *BQ_R__ envOut);
+
     // Calling one or both of these is optional -- if neither is
     // called, the first call to a forward or inverse method will call
     // init().  You only need call these if you don't want to risk
@@ -123,11 +374,255 @@ public:
      */
     Precisions getSupportedPrecisions() const;
 
+    /**
+     * Return the alignment, in bytes, that input and output buffers
+     * should have in order for the implementation to be able to use
+     * them directly, rather than copying through internal buffers. A
+     * power of two, at least sizeof(double). Buffers returned by
+     * allocateBuffer() always have at least this alignment.
+     */
+    int getPreferredAlignment() const;
+
+    enum BufferType {
+        TimeDomainBuffer,          // size samples
+        SplitSpectrumBuffer,       // size/2+1 bins (real, imag, mag or phase)
+        InterleavedSpectrumBuffer  // size/2+1 complex pairs, i.e. size+2
+    };
+
+    /**
+     * Return the number of elements in a buffer of the given type for
+     * this FFT size.
+     */
+    int getBufferLength(BufferType type) const;
+
+    /**
+     * Allocate a zero-filled buffer of the given type, aligned to
+     * getPreferredAlignment() and padded to a multiple of it. Free it
+     * with deallocateBuffer() rather than free() or delete.
+     */
+    template <typename T>
+    T *allocateBuffer(BufferType type) const {
+        return static_cast<T *>
+            (allocateAligned(getBufferLength(type) * sizeof(T)));
+    }
+
+    static void deallocateBuffer(void *buffer);
+
+    /**
+     * Return the number of calls so far that could not use the
+     * implementation's direct (aligned) path and had to copy through
+     * internal buffers instead. Intended for debugging buffer
+     * alignment in calling code; always zero for implementations that
+     * have no such path.
+     */
+    int getSlowPathCount() const;
+
+    enum PolarAccuracy {
+        ExactPolar, // library atan2, sin and cos
+        FastPolar   // vectorisable polynomial approximations
+    };
+
+    /**
+     * Choose how forwardPolar and inversePolar (and their windowed
+     * and accumulating forms) convert between the implementation's
+     * complex spectrum and magnitude and phase. The default is
+     * ExactPolar. With FastPolar, the phase is taken with a
+     * polynomial atan2 and rebuilt with a polynomial sin and cos,
+     * branch-free so that the compiler vectorises them, in the pass
+     * in which the implementation unpacks or packs its own buffers;
+     * at the sizes typical of phase vocoders this can take more
+     * time than the transform when done exactly.
+     *
+     * Beyond the error of the transform, forward phases are then
+     * within 2e-8 radians of exact for double and 4e-7 for float,
+     * and inverse inputs mag * (cos, sin) within (2e-9 + 2e-16 |phase|)
+     * * mag for double and (2e-7 + 2e-16 |phase|) * mag for float.
+     * Any finite phase is accepted, but accuracy is lost as phases
+     * grow, so accumulated phases are best kept wrapped. Magnitudes
+     * are unaffected. The slow DFT used for
+     * unsupported sizes always converts exactly.
+     */
+    void setPolarAccuracy(PolarAccuracy accuracy);
+    PolarAccuracy getPolarAccuracy() const;
+
     static std::set<std::string> getImplementations();
     static std::string getDefaultImplementation();
     static void setDefaultImplementation(std::string);
 
+    /**
+     * Measure every compiled-in implementation, for every transform
+     * method, at each of the given sizes, and record the results in
+     * the tuning file (merging with any results already there for
+     * other sizes). Subsequently constructed FFT objects of a
+     * calibrated size use the implementation that was fastest
+     * overall, unless a default implementation has been set
+     * explicitly with setDefaultImplementation.
+     *
+     * This takes a few tens of milliseconds per implementation per
+     * size, and is intended to be called once at install or first
+     * run rather than routinely.
+     */
+    static void calibrate(const std::vector<int> &sizes);
+
+    /**
+     * Return the tuning file that calibrate() writes to and that is
+     * consulted when picking an implementation. The default is
+     * $HOME/.bqfft.tuning. Results in the file are used only on the
+     * CPU model they were measured on.
+     */
+    static std::string getTuningFile();
+
+    /**
+     * Set the tuning file. It is read lazily when the next FFT
+     * object is constructed. Pass an empty string to disable tuning
+     * entirely (in which case calibrate() measures without saving).
+     */
+    static void setTuningFile(std::string filename);
+
+#ifdef FFT_STATISTICS
+    /**
+     * Counters for one method in one precision. Times are in
+     * nanoseconds. Bytes are those read from the inputs plus those
+     * written to the outputs. Slow-path events are calls that copied
+     * through internal buffers because of argument alignment (see
+     * getSlowPathCount); lazy inits are calls that were the first in
+     * their precision without a prior initFloat or initDouble, and so
+     * included the implementation's setup.
+     */
+    struct MethodStatistics {
+        uint64_t calls;
+        double totalNs;
+        double minNs;
+        double maxNs;
+        uint64_t bytes;
+        uint64_t slowPathEvents;
+        uint64_t lazyInits;
+    };
+
+    /**
+     * Counters for all methods, indexed in the order forward,
+     * forwardInterleaved, forwardPolar, forwardMagnitude (double,
+     * then float), then inverse, inverseInterleaved, inversePolar,
+     * inverseCepstral (double, then float). See getMethodName.
+     * Other methods that transform are counted under the one of
+     * these whose implementation they use: forwardBins under
+     * forward, correlate and autocorrelate under forwardInterleaved,
+     * forwardBinsMagnitude, forwardPower, forwardLogMagnitude and
+     * forwardDecibels under forwardMagnitude, and inversePower and
+     * cepstralEnvelope under inverseCepstral. This is so even when
+     * forwardBins uses Goertzel's algorithm, though that never
+     * counts as a lazy initialisation.
+     */
+    struct Statistics {
+        enum { MethodCount = 16 };
+        MethodStatistics methods[MethodCount];
+    };
+
+    /**
+     * Return the name of a method index in Statistics, for example
+     * "forwardPolarDouble".
+     */
+    static const char *getMethodName(int method);
+
+    /**
+     * Return the counters recorded for this object since it was
+     * constructed or last reset.
+     */
+    Statistics getStatistics() const;
+    void resetStatistics();
+
+    /**
+     * Return the counters for all FFT objects in the process,
+     * including ones already destroyed. Counters belonging to objects
+     * in use on other threads may be slightly out of date.
+     */
+    static Statistics getProcessStatistics();
+    static void resetProcessStatistics();
+
+    /**
+     * Switch recording on or off for all objects. Recording is off
+     * by default. The statistics functions are only available if the
+     * library is built with FFT_STATISTICS defined (which must also
+     * be defined when this header is included); without it, there is
+     * no instrumentation overhead at all.
+     */
+    static void setStatisticsEnabled(bool enabled);
+    static bool isStatisticsEnabled();
+
+    /**
+     * Histogram of the durations of all transforms on one FFT
+     * object, for watching worst-case latency (e.g. against an audio
+     * deadline) rather than the mean. Bucket i counts durations of
+     * at least 2^i and less than 2^(i+1) ns (bucket 0 also counts
+     * anything shorter, and the last bucket anything longer).
+     */
+    struct LatencyHistogram {
+        enum { BucketCount = 40 };
+        uint64_t buckets[BucketCount];
+        uint64_t count;
+        double maxNs;
+
+        /**
+         * Return an upper bound in ns for the given percentile
+         * (e.g. 99.9), namely the upper edge of the bucket it falls
+         * in, or the maximum if that is lower.
+         */
+        double getPercentile(double percentile) const;
+    };
+
+    /**
+     * Return a snapshot of this object's latency histogram. This may
+     * be called from any thread. The thread calling the transforms
+     * records without locking or waiting, and a snapshot taken from
+     * another thread is always consistent (its buckets sum to its
+     * count) but may lag slightly behind. resetLatencyHistogram must
+     * be called from the thread calling the transforms, or while no
+     * transform is running.
+     */
+    LatencyHistogram getLatencyHistogram() const;
+    void resetLatencyHistogram();
+
+    /**
+     * Return a one-line summary of the latency histogram, giving
+     * count, p50, p99, p99.9 and maximum.
+     */
+    std::string getLatencySummary() const;
+
+    /**
+     * Switch latency recording on or off for all objects,
+     * independently of the other statistics. Off by default.
+     */
+    static void setLatencyHistogramEnabled(bool enabled);
+#endif
+
 #ifdef FFT_MEASUREMENT
+    enum TuneFormat {
+        TuneText, TuneJSON, TuneCSV
+    };
+
+    /**
+     * Time every compiled-in implementation, for all sixteen
+     * transform methods, at each of the given sizes (which need not
+     * be powers of two; implementations that cannot handle a size
+     * are skipped for it). Each measurement is summarised as the
+     * median time per transform, an MFLOPS estimate based on 2.5 N
+     * log2 N, and the spread across batches. Text is written to
+     * std::cerr, JSON and CSV to std::cout, unless
+     * FFT_MEASUREMENT_RETURN_RESULT_TEXT is defined in which case the
+     * output is returned instead.
+     */
+    static
+#ifdef FFT_MEASUREMENT_RETURN_RESULT_TEXT
+    std::string
+#else
+    void
+#endif
+    tune(TuneFormat format, const std::vector<int> &sizes);
+
+    /**
+     * Time as above, for the sizes 512, 1024, 2048 and 4096, with
+     * text output.
+     */
     static
 #ifdef FFT_MEASUREMENT_RETURN_RESULT_TEXT
     std::string
@@ -139,8 +634,12 @@ public:
 
 protected:
     FFTImpl *d;
+    int m_size;
+    std::string m_implementation;
 
 private:
+    void *allocateAligned(size_t bytes) const;
+
     FFT(const FFT &); // not provided
     FFT &operator=(const FFT &); // not provided
 };
@@ -0,0 +1,290 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    bqfft
+
+    A small library wrapping various FFT implementations for some
+    common audio processing use cases.
+
+    Copyright 2007-2021 Particular Programs Ltd.
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of Chris Cannam and
+    Particular Programs Ltd shall not be used in advertising or
+    otherwise to promote the sale, use or other dealings in this
+    Software without prior written authorization.
+*/
+
+#ifndef BQFFT_STFT_H
+#define BQFFT_STFT_H
+
+#include "FFT.h"
+
+namespace breakfastquay {
+
+/**
+ * Streaming short-time Fourier transform analysis on top of FFT.
+ *
+ * Samples are pushed in blocks of any length and buffered in a ring
+ * buffer; a spectrum becomes available for every hop samples once
+ * the first frameSize samples have arrived. Each frame is windowed
+ * (and optionally rotated for zero-phase analysis) as the FFT loads
+ * it, straight from the ring buffer, which is laid out so that every
+ * frame is contiguous in memory. Pulling several pending frames at
+ * once transforms them back to back with the same FFT instance.
+ *
+ * Neither push nor pull allocates memory. Construct with
+ * FFT::RealTimeMode for the FFT to preallocate too, making both safe
+ * for a real-time thread.
+ *
+ * T may be float or double. Like FFT, this class is not thread safe.
+ */
+template <typename T>
+class STFTAnalyser
+{
+public:
+    enum Format {
+        Cartesian, // real and imaginary parts
+        Polar,     // magnitude and phase
+        Magnitude  // magnitude only
+    };
+
+    /**
+     * Analyse frames of frameSize samples, one every hop samples,
+     * with 0 < hop <= frameSize. window, if non-null, holds frameSize
+     * values, and is copied. If zeroPhase is true, each windowed
+     * frame is rotated by frameSize/2 before transforming. capacity
+     * is the number of samples that may be buffered awaiting
+     * analysis, at least frameSize; 0 means 4 * frameSize.
+     *
+     * Throws FFT::InvalidSize if the sizes are invalid.
+     */
+    STFTAnalyser(int frameSize, int hop, Format format,
+                 const T *window = 0, bool zeroPhase = false,
+                 int capacity = 0, FFT::Mode mode = FFT::DefaultMode);
+    ~STFTAnalyser();
+
+    int getFrameSize() const { return m_frameSize; }
+    int getHop() const { return m_hop; }
+    Format getFormat() const { return m_format; }
+
+    /**
+     * Return the number of values in each output spectrum array,
+     * i.e. frameSize/2 + 1.
+     */
+    int getBinCount() const { return m_frameSize/2 + 1; }
+
+    /**
+     * Return the number of samples that can be pushed before some
+     * frames must be pulled.
+     */
+    int getWriteSpace() const { return m_capacity - m_fill; }
+
+    /**
+     * Buffer up to count samples for analysis, and return the number
+     * actually accepted, which is less than count only if it exceeds
+     * getWriteSpace().
+     */
+    int push(const T *BQ_R__ samples, int count);
+
+    /**
+     * Return the number of frames that can be pulled now.
+     */
+    int getAvailableFrames() const;
+
+    /**
+     * Analyse the next frame, writing getBinCount() values to each
+     * of a (real part or magnitude) and b (imaginary part or phase;
+     * unused, and may be null, for Magnitude format). Return false,
+     * without writing anything, if no frame is available.
+     */
+    bool pull(T *BQ_R__ a, T *BQ_R__ b);
+
+    /**
+     * Analyse up to n available frames into a[0..n-1] and b[0..n-1]
+     * (b may be null for Magnitude format), and return the number
+     * analysed.
+     */
+    int pull(T *const *a, T *const *b, int n);
+
+    /**
+     * Discard all buffered samples.
+     */
+    void reset();
+
+    FFT &getFFT() { return m_fft; }
+
+private:
+    const int m_frameSize;
+    const int m_hop;
+    const Format m_format;
+    const int m_rotation;
+    const int m_capacity;
+    T *m_window;
+    T *m_buffer;    // m_capacity + m_frameSize - 1 samples
+    int m_readPos;  // start of the next frame
+    int m_fill;     // samples buffered from m_readPos
+    FFT m_fft;
+
+    void write(const T *BQ_R__ samples, int pos, int count);
+    void analyse(T *BQ_R__ a, T *BQ_R__ b);
+
+    STFTAnalyser(const STFTAnalyser &); // not provided
+    STFTAnalyser &operator=(const STFTAnalyser &); // not provided
+};
+
+/**
+ * Streaming inverse short-time Fourier transform by overlap-add, the
+ * counterpart of STFTAnalyser.
+ *
+ * Each spectrum pushed is inverse transformed with
+ * FFT::inverseAccumulate straight into an overlap-add buffer, the
+ * scaling, rotation, synthesis window and addition all happening as
+ * the FFT stores its output, with no intermediate frame. Output
+ * samples become available hop at a time, as soon as no further
+ * frame can overlap them.
+ *
+ * Neither push nor pull allocates memory. Construct with
+ * FFT::RealTimeMode for the FFT to preallocate too, making both safe
+ * for a real-time thread.
+ *
+ * T may be float or double. Like FFT, this class is not thread safe.
+ */
+template <typename T>
+class ISTFTSynthesiser
+{
+public:
+    enum Format {
+        Cartesian, // real and imaginary parts
+        Polar      // magnitude and phase
+    };
+
+    /**
+     * Synthesise frames of frameSize samples, one every hop
+     * samples, with 0 < hop <= frameSize. window, if non-null, holds
+     * frameSize values to be used as the synthesis window, and is
+     * copied. If zeroPhase is true, each inverse transformed frame
+     * is rotated by frameSize/2 before windowing, undoing the
+     * rotation of a zero-phase STFTAnalyser. capacity is the number
+     * of output samples that may be buffered awaiting pull, at least
+     * frameSize; 0 means 4 * frameSize.
+     *
+     * The output is scaled so that analysing with an STFTAnalyser
+     * using the same frame size, hop, window and zeroPhase, and
+     * resynthesising here, gives back the input. This is exact where
+     * the square of the window overlap-adds to a constant at this
+     * hop (e.g. a periodic Hann window with hop frameSize/4) and
+     * frames overlap fully, i.e. apart from the first and last
+     * frameSize - hop samples.
+     *
+     * Throws FFT::InvalidSize if the sizes are invalid.
+     */
+    ISTFTSynthesiser(int frameSize, int hop, Format format,
+                     const T *window = 0, bool zeroPhase = false,
+                     int capacity = 0, FFT::Mode mode = FFT::DefaultMode);
+    ~ISTFTSynthesiser();
+
+    int getFrameSize() const { return m_frameSize; }
+    int getHop() const { return m_hop; }
+    Format getFormat() const { return m_format; }
+
+    /**
+     * Return the number of values expected in each input spectrum
+     * array, i.e. frameSize/2 + 1.
+     */
+    int getBinCount() const { return m_frameSize/2 + 1; }
+
+    /**
+     * Return the gain applied to each inverse transformed frame,
+     * which includes the 1/frameSize normalisation of the inverse
+     * transform.
+     */
+    T getGain() const { return m_gain; }
+
+    /**
+     * Return the number of frames that can be pushed before some
+     * output must be pulled.
+     */
+    int getWriteSpace() const;
+
+    /**
+     * Inverse transform the spectrum in a (real part or magnitude)
+     * and b (imaginary part or phase), each of getBinCount() values,
+     * and add it to the output one hop after the previous frame.
+     * Return false, without doing anything, if getWriteSpace() is 0.
+     */
+    bool push(const T *BQ_R__ a, const T *BQ_R__ b);
+
+    /**
+     * Push up to n frames from a[0..n-1] and b[0..n-1], and return
+     * the number pushed.
+     */
+    int push(const T *const *a, const T *const *b, int n);
+
+    /**
+     * Return the number of output samples that are complete and can
+     * be pulled now.
+     */
+    int getAvailableSamples() const { return m_writePos - m_readPos; }
+
+    /**
+     * Write up to count complete output samples and return the
+     * number written.
+     */
+    int pull(T *BQ_R__ samples, int count);
+
+    /**
+     * Make the remaining samples of the frames pushed so far
+     * available to pull, as at the end of a stream. Any frame pushed
+     * afterwards starts after them.
+     */
+    void flush();
+
+    /**
+     * Discard all buffered output.
+     */
+    void reset();
+
+    FFT &getFFT() { return m_fft; }
+
+private:
+    const int m_frameSize;
+    const int m_hop;
+    const Format m_format;
+    const int m_rotation;
+    const int m_capacity;
+    T m_gain;
+    T *m_window;
+    T *m_buffer;    // m_capacity + m_frameSize samples
+    int m_readPos;  // next sample to pull
+    int m_writePos; // start of the next frame; samples before it are complete
+    int m_endPos;   // end of the last frame; samples from here on are zero
+    FFT m_fft;
+
+    void compact();
+
+    ISTFTSynthesiser(const ISTFTSynthesiser &); // not provided
+    ISTFTSynthesiser &operator=(const ISTFTSynthesiser &); // not provided
+};
+
+}
+
+#endif
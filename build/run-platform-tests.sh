@@ -100,6 +100,11 @@ for mf in Makefile build/Makefile.$platformtag build/Makefile.$platformtag.* ; d
 
     if [ "$have_valgrind" = "yes" ]; then
 	for t in test-* ; do
+	    # test-realtime interposes malloc itself, which valgrind
+	    # also needs to do
+	    if [ "$t" = "test-realtime" ]; then
+		continue
+	    fi
 	    if [ -f "$t" -a -x "$t" ]; then
 		run "0 errors from 0 contexts" valgrind --leak-check=full ./"$t"
 	    fi
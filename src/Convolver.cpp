@@ -0,0 +1,686 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    bqfft
+
+    A small library wrapping various FFT implementations for some
+    common audio processing use cases.
+
+    Copyright 2007-2021 Particular Programs Ltd.
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of Chris Cannam and
+    Particular Programs Ltd shall not be used in advertising or
+    otherwise to promote the sale, use or other dealings in this
+    Software without prior written authorization.
+*/
+
+
+#include "bqfft/Convolver.h"
+
+#include <bqvec/Allocators.h>
+#include <bqvec/VectorOps.h>
+
+#include <iostream>
+#include <climits>
+#include <cstdlib>
+
+#ifndef NO_THREADING
+#ifdef _WIN32
+#include <windows.h>
+#else
+#ifdef __APPLE__
+#include <dispatch/dispatch.h>
+#else
+#include <semaphore.h>
+#endif
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#endif
+
+namespace breakfastquay {
+
+static int
+checkConvolverSizes(int blockSize, int length)
+{
+    if (blockSize < 1 || length < 1) {
+        std::cerr << "Convolver: ERROR: Invalid block size " << blockSize
+                  << " or impulse response length " << length << std::endl;
+#ifndef NO_EXCEPTIONS
+        throw FFT::InvalidSize;
+#else
+        abort();
+#endif
+    }
+    return blockSize;
+}
+
+// acc = x * h, over split complex arrays of n values. Written as
+// plain loops over restrict-qualified pointers so that the compiler
+// can vectorise them.
+template <typename T>
+static void
+complexMultiply(T *BQ_R__ accReal, T *BQ_R__ accImag,
+                const T *BQ_R__ xReal, const T *BQ_R__ xImag,
+                const T *BQ_R__ hReal, const T *BQ_R__ hImag,
+                int n)
+{
+    for (int i = 0; i < n; ++i) {
+        accReal[i] = xReal[i] * hReal[i] - xImag[i] * hImag[i];
+        accImag[i] = xReal[i] * hImag[i] + xImag[i] * hReal[i];
+    }
+}
+
+// acc += x * h, as above
+template <typename T>
+static void
+complexMultiplyAdd(T *BQ_R__ accReal, T *BQ_R__ accImag,
+                   const T *BQ_R__ xReal, const T *BQ_R__ xImag,
+                   const T *BQ_R__ hReal, const T *BQ_R__ hImag,
+                   int n)
+{
+    for (int i = 0; i < n; ++i) {
+        accReal[i] += xReal[i] * hReal[i] - xImag[i] * hImag[i];
+        accImag[i] += xReal[i] * hImag[i] + xImag[i] * hReal[i];
+    }
+}
+
+template <typename T>
+Convolver<T>::Convolver(int blockSize, const T *impulseResponse, int length,
+                        FFT::Mode mode) :
+    m_blockSize(checkConvolverSizes(blockSize, length)),
+    m_length(length),
+    m_partitions((length + blockSize - 1) / blockSize),
+    m_bins(blockSize + 1),
+    m_fdlHead(0),
+    m_fft(blockSize * 2, 0, mode)
+{
+    const int total = m_partitions * m_bins;
+    m_irReal = allocate<T>(total);
+    m_irImag = allocate<T>(total);
+    m_fdlReal = allocate_and_zero<T>(total);
+    m_fdlImag = allocate_and_zero<T>(total);
+    m_accReal = allocate<T>(m_bins);
+    m_accImag = allocate<T>(m_bins);
+    m_input = allocate_and_zero<T>(m_blockSize * 2);
+
+    // Transform each partition, zero-padded to the FFT size, with
+    // the 1/N scaling of the inverse transform folded in
+    const T scale = T(1.0 / (m_blockSize * 2));
+    T *partition = allocate<T>(m_blockSize);
+    for (int p = 0; p < m_partitions; ++p) {
+        int start = p * m_blockSize;
+        int n = m_length - start;
+        if (n > m_blockSize) n = m_blockSize;
+        for (int i = 0; i < n; ++i) {
+            partition[i] = impulseResponse[start + i] * scale;
+        }
+        m_fft.forwardPadded(partition, n, m_irReal + p * m_bins, m_irImag + p * m_bins);
+    }
+    deallocate(partition);
+}
+
+template <typename T>
+Convolver<T>::~Convolver()
+{
+    deallocate(m_irReal);
+    deallocate(m_irImag);
+    deallocate(m_fdlReal);
+    deallocate(m_fdlImag);
+    deallocate(m_accReal);
+    deallocate(m_accImag);
+    deallocate(m_input);
+}
+
+template <typename T>
+void
+Convolver<T>::process(const T *BQ_R__ in, T *BQ_R__ out)
+{
+    const int b = m_blockSize;
+    const int n = m_bins;
+
+    // Overlap-save: transform the previous block and this one
+    // together, and keep only the second half of the result, whose
+    // circular convolution does not wrap
+    v_move(m_input, m_input + b, b);
+    v_copy(m_input + b, in, b);
+
+    // The delay line runs backwards, so that the spectrum of the
+    // input from p blocks ago is at m_fdlHead + p, modulo the
+    // number of partitions
+    if (--m_fdlHead < 0) m_fdlHead = m_partitions - 1;
+    m_fft.forward(m_input, m_fdlReal + m_fdlHead * n, m_fdlImag + m_fdlHead * n);
+
+    // The delay line is contiguous from m_fdlHead to its end, and
+    // then from its start, so the partitions can be walked in two
+    // linear runs with no per-partition modulo
+    complexMultiply(m_accReal, m_accImag,
+                    m_fdlReal + m_fdlHead * n, m_fdlImag + m_fdlHead * n,
+                    m_irReal, m_irImag, n);
+    const int firstRun = m_partitions - m_fdlHead;
+    for (int p = 1; p < firstRun; ++p) {
+        const int slot = (m_fdlHead + p) * n;
+        complexMultiplyAdd(m_accReal, m_accImag,
+                           m_fdlReal + slot, m_fdlImag + slot,
+                           m_irReal + p * n, m_irImag + p * n, n);
+    }
+    for (int p = firstRun; p < m_partitions; ++p) {
+        const int slot = (p - firstRun) * n;
+        complexMultiplyAdd(m_accReal, m_accImag,
+                           m_fdlReal + slot, m_fdlImag + slot,
+                           m_irReal + p * n, m_irImag + p * n, n);
+    }
+
+    m_fft.inverseSamples(m_accReal, m_accImag, b, b * 2, out);
+}
+
+template <typename T>
+void
+Convolver<T>::reset()
+{
+    v_zero(m_fdlReal, m_partitions * m_bins);
+    v_zero(m_fdlImag, m_partitions * m_bins);
+    v_zero(m_input, m_blockSize * 2);
+    m_fdlHead = 0;
+}
+
+static int
+checkNonUniformSizes(int blockSize, int length, int maxBlockSize)
+{
+    checkConvolverSizes(blockSize, length);
+    if (maxBlockSize != 0 && maxBlockSize < blockSize) {
+        std::cerr << "NonUniformConvolver: ERROR: Invalid maximum block size "
+                  << maxBlockSize << " for block size " << blockSize
+                  << std::endl;
+#ifndef NO_EXCEPTIONS
+        throw FFT::InvalidSize;
+#else
+        abort();
+#endif
+    }
+    return blockSize;
+}
+
+// A stage's state is a word changed only by atomic compare-and-swap
+// (or, where nothing else can be changing it, an atomic store), so
+// that process() and the background thread can hand stages between
+// them without a lock
+
+#if defined(NO_THREADING)
+typedef int StateWord;
+static bool compareAndSwap(volatile StateWord *w, StateWord from, StateWord to) {
+    if (*w != from) return false;
+    *w = to;
+    return true;
+}
+static void store(volatile StateWord *w, StateWord to) { *w = to; }
+#elif defined(_WIN32)
+typedef LONG StateWord;
+static bool compareAndSwap(volatile StateWord *w, StateWord from, StateWord to) {
+    return InterlockedCompareExchange(w, to, from) == from;
+}
+static void store(volatile StateWord *w, StateWord to) {
+    InterlockedExchange(w, to);
+}
+#else
+typedef int StateWord;
+static bool compareAndSwap(volatile StateWord *w, StateWord from, StateWord to) {
+    return __sync_bool_compare_and_swap(w, from, to);
+}
+static void store(volatile StateWord *w, StateWord to) {
+    __sync_synchronize();
+    *w = to;
+    __sync_synchronize();
+}
+#endif
+
+template <typename T>
+struct NonUniformConvolver<T>::Stage
+{
+    enum State {
+        Free,    // no block queued, or result collected
+        Pending, // block queued, not yet started
+        Running, // being processed, by the worker or by process()
+        Done     // result ready in output
+    };
+
+    // A queued block of input and its result. A block is collected
+    // two stage blocks after it was queued, and its job is reused
+    // one stage block after that, so three jobs are enough for the
+    // worker to be running one while another waits behind it.
+    struct Job
+    {
+        volatile StateWord state;
+        volatile unsigned int seq; // number of the block, in order of queueing
+        T *input;
+        T *output;
+
+        // Move from one state to another, if the job is in the
+        // first; passing the same state twice just tests for it
+        bool transition(State from, State to) {
+            return compareAndSwap(&state, from, to);
+        }
+
+        void setState(State to) {
+            store(&state, to);
+        }
+    };
+
+    enum { JobCount = 3 };
+
+    Stage(int b, const T *ir, int n, FFT::Mode mode) :
+        blockSize(b), conv(b, ir, n, mode), fill(0), readPos(0),
+        issued(0), nextJob(0) {
+        input = allocate_and_zero<T>(b);
+        output = allocate_and_zero<T>(b);
+        for (int i = 0; i < JobCount; ++i) {
+            jobs[i].state = Free;
+            jobs[i].seq = 0;
+            jobs[i].input = allocate_and_zero<T>(b);
+            jobs[i].output = allocate_and_zero<T>(b);
+        }
+    }
+
+    ~Stage() {
+        deallocate(input);
+        deallocate(output);
+        for (int i = 0; i < JobCount; ++i) {
+            deallocate(jobs[i].input);
+            deallocate(jobs[i].output);
+        }
+    }
+
+    void run(Job *job) {
+        conv.process(job->input, job->output);
+    }
+
+    // The job for the block queued two stage blocks ago, due now
+    Job *due() {
+        return &jobs[(nextJob + 1) % JobCount];
+    }
+
+    // The job to queue the next block in, last used three stage
+    // blocks ago
+    Job *next() {
+        return &jobs[nextJob];
+    }
+
+    // The job for the earliest block not yet processed, or null if
+    // there is none. The convolver must see its blocks in order, so
+    // this is the only job of the stage that may be started.
+    Job *oldestUnfinished() {
+        Job *oldest = 0;
+        for (int i = 0; i < JobCount; ++i) {
+            Job *job = &jobs[i];
+            if (job->transition(Pending, Pending) ||
+                job->transition(Running, Running)) {
+                if (!oldest || int(job->seq - oldest->seq) < 0) {
+                    oldest = job;
+                }
+            }
+        }
+        return oldest;
+    }
+
+    void reset() {
+        conv.reset();
+        v_zero(input, blockSize);
+        v_zero(output, blockSize);
+        for (int i = 0; i < JobCount; ++i) {
+            jobs[i].setState(Free);
+        }
+        fill = 0;
+        readPos = 0;
+        issued = 0;
+        nextJob = 0;
+    }
+
+    const int blockSize;
+    Convolver<T> conv;
+    Job jobs[JobCount];
+    T *input;        // filling from process()
+    T *output;       // being read by process()
+    int fill;        // samples in input
+    int readPos;     // next sample of output to read
+    unsigned int issued; // number of blocks queued since reset
+    int nextJob;     // index in jobs of next()
+};
+
+#ifndef NO_THREADING
+
+// The background thread. It sleeps on a semaphore that process()
+// posts after queueing a block, and on waking runs queued blocks
+// until there are none left. Posting a semaphore takes no lock, and
+// a post made while the worker is busy is kept until it next waits,
+// so no wakeup is lost.
+
+template <typename T>
+struct NonUniformConvolver<T>::Worker
+{
+    Worker(std::vector<Stage *> &s) : stages(s), exiting(false) {
+#ifdef _WIN32
+        semaphore = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+        thread = 0;
+#else
+#ifdef __APPLE__
+        semaphore = dispatch_semaphore_create(0);
+#else
+        sem_init(&semaphore, 0, 0);
+#endif
+        started = false;
+#endif
+    }
+
+    ~Worker() {
+        exiting = true;
+        wake();
+#ifdef _WIN32
+        if (thread) {
+            WaitForSingleObject(thread, INFINITE);
+            CloseHandle(thread);
+        }
+        CloseHandle(semaphore);
+#else
+        if (started) {
+            pthread_join(thread, 0);
+        }
+#ifdef __APPLE__
+        dispatch_release(semaphore);
+#else
+        sem_destroy(&semaphore);
+#endif
+#endif
+    }
+
+    bool start() {
+#ifdef _WIN32
+        thread = CreateThread(NULL, 0, entry, this, 0, NULL);
+        return thread != 0;
+#else
+        started = (pthread_create(&thread, 0, entry, this) == 0);
+        return started;
+#endif
+    }
+
+#ifdef _WIN32
+    void wake() { ReleaseSemaphore(semaphore, 1, NULL); }
+    void wait() { WaitForSingleObject(semaphore, INFINITE); }
+    static void pause() { Sleep(1); }
+    static DWORD WINAPI entry(LPVOID arg) {
+        static_cast<Worker *>(arg)->run();
+        return 0;
+    }
+#else
+#ifdef __APPLE__
+    void wake() { dispatch_semaphore_signal(semaphore); }
+    void wait() { dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER); }
+#else
+    void wake() { sem_post(&semaphore); }
+    void wait() { while (sem_wait(&semaphore) != 0 && errno == EINTR) ; }
+#endif
+    static void pause() { usleep(1000); }
+    static void *entry(void *arg) {
+        static_cast<Worker *>(arg)->run();
+        return 0;
+    }
+#endif
+
+    // Earliest deadline first. A block is due two of its stage's
+    // blocks after it was queued, and stages are in order of
+    // increasing block size, each a multiple of the last, so the
+    // first stage with a block ready to start has the one due
+    // soonest.
+    bool runNext() {
+        for (int i = 0; i < int(stages.size()); ++i) {
+            Stage *stage = stages[i];
+            typename Stage::Job *job = stage->oldestUnfinished();
+            if (job && job->transition(Stage::Pending, Stage::Running)) {
+                stage->run(job);
+                job->setState(Stage::Done);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run() {
+        while (true) {
+            wait();
+            if (exiting) break;
+            while (runNext()) ;
+        }
+    }
+
+    std::vector<Stage *> &stages;
+    volatile bool exiting;
+#ifdef _WIN32
+    HANDLE semaphore;
+    HANDLE thread;
+#else
+#ifdef __APPLE__
+    dispatch_semaphore_t semaphore;
+#else
+    sem_t semaphore;
+#endif
+    pthread_t thread;
+    bool started;
+#endif
+};
+
+#endif
+
+template <typename T>
+NonUniformConvolver<T>::NonUniformConvolver(int blockSize,
+                                            const T *impulseResponse,
+                                            int length,
+                                            int maxBlockSize,
+                                            bool useThread,
+                                            FFT::Mode mode) :
+    m_blockSize(checkNonUniformSizes(blockSize, length, maxBlockSize)),
+    m_length(length),
+    m_head(0),
+    m_worker(0),
+    m_lateCount(0),
+    m_skipCount(0)
+{
+    if (maxBlockSize == 0) {
+        maxBlockSize = (blockSize > 4096 ? blockSize : 4096);
+    }
+    int maxBlock = blockSize;
+    while (maxBlock * 2 <= maxBlockSize) maxBlock *= 2;
+
+    // The head covers up to where the first stage starts, at three
+    // times its block size, or everything if there are no stages
+    int headLength = length;
+    if (maxBlock > blockSize && headLength > blockSize * 6) {
+        headLength = blockSize * 6;
+    }
+    m_head = new Convolver<T>(blockSize, impulseResponse, headLength, mode);
+
+    for (int b = blockSize * 2; b <= maxBlock && b * 3 < length; b *= 2) {
+        int start = b * 3;
+        int end = b * 6;
+        if (b == maxBlock || end > length) end = length;
+        m_stages.push_back(new Stage(b, impulseResponse + start,
+                                     end - start, mode));
+    }
+
+#ifndef NO_THREADING
+    if (useThread && !m_stages.empty()) {
+        m_worker = new Worker(m_stages);
+        if (!m_worker->start()) {
+            std::cerr << "NonUniformConvolver: WARNING: Failed to start "
+                      << "background thread, processing all stages in "
+                      << "process()" << std::endl;
+            delete m_worker;
+            m_worker = 0;
+        }
+    }
+#else
+    (void)useThread;
+#endif
+}
+
+template <typename T>
+NonUniformConvolver<T>::~NonUniformConvolver()
+{
+#ifndef NO_THREADING
+    delete m_worker;
+#endif
+    for (int i = 0; i < int(m_stages.size()); ++i) {
+        delete m_stages[i];
+    }
+    delete m_head;
+}
+
+template <typename T>
+int
+NonUniformConvolver<T>::getStageBlockSize(int stage) const
+{
+    if (stage < 0 || stage >= int(m_stages.size())) return 0;
+    return m_stages[stage]->blockSize;
+}
+
+template <typename T>
+void
+NonUniformConvolver<T>::collect(Stage *stage)
+{
+    // The result of the block queued two stage blocks ago is due
+    // now. If the worker has not started it, and is not still busy
+    // with an earlier block of the same stage, run it here. If it
+    // is busy with it, do not wait: the worker may be unable to run
+    // until this thread gives up the CPU, so waiting here could
+    // never end. The stage contributes silence for this block
+    // instead, and the worker goes on to finish it, so that the
+    // stage's convolver still sees every block of input.
+    typename Stage::Job *job = stage->due();
+#ifndef NO_THREADING
+    if (m_worker) {
+        if (stage->oldestUnfinished() == job &&
+            job->transition(Stage::Pending, Stage::Running)) {
+            stage->run(job);
+            job->setState(Stage::Done);
+            ++m_lateCount;
+        }
+    }
+#endif
+    stage->readPos = 0;
+    if (job->seq == stage->issued - 2 &&
+        job->transition(Stage::Done, Stage::Free)) {
+        T *tmp = stage->output;
+        stage->output = job->output;
+        job->output = tmp;
+        return;
+    }
+    v_zero(stage->output, stage->blockSize);
+    if (!job->transition(Stage::Free, Stage::Free)) {
+        // Not just the start, before anything was queued
+        ++m_lateCount;
+        ++m_skipCount;
+    }
+}
+
+template <typename T>
+void
+NonUniformConvolver<T>::issue(Stage *stage)
+{
+    typename Stage::Job *job = stage->next();
+    const unsigned int seq = stage->issued++;
+    stage->nextJob = (stage->nextJob + 1) % Stage::JobCount;
+    stage->fill = 0;
+    if (!job->transition(Stage::Free, Stage::Free) &&
+        !job->transition(Stage::Done, Stage::Free)) {
+        // The worker has still not finished the block this job was
+        // last used for, three stage blocks ago, so there is nowhere
+        // to queue this one and it is lost
+        ++m_skipCount;
+        return;
+    }
+    T *tmp = stage->input;
+    stage->input = job->input;
+    job->input = tmp;
+    job->seq = seq;
+#ifndef NO_THREADING
+    if (m_worker) {
+        job->setState(Stage::Pending);
+        m_worker->wake();
+        return;
+    }
+#endif
+    stage->run(job);
+    job->setState(Stage::Done);
+}
+
+template <typename T>
+void
+NonUniformConvolver<T>::process(const T *BQ_R__ in, T *BQ_R__ out)
+{
+    const int b = m_blockSize;
+    m_head->process(in, out);
+    for (int i = 0; i < int(m_stages.size()); ++i) {
+        Stage *stage = m_stages[i];
+        v_add(out, stage->output + stage->readPos, b);
+        stage->readPos += b;
+        v_copy(stage->input + stage->fill, in, b);
+        stage->fill += b;
+        if (stage->fill == stage->blockSize) {
+            collect(stage);
+            issue(stage);
+        }
+    }
+}
+
+template <typename T>
+void
+NonUniformConvolver<T>::reset()
+{
+    for (int i = 0; i < int(m_stages.size()); ++i) {
+        Stage *stage = m_stages[i];
+#ifndef NO_THREADING
+        if (m_worker) {
+            // Withdraw anything queued, and wait (sleeping, so that
+            // the worker can run) for anything it is running
+            for (int j = 0; j < Stage::JobCount; ++j) {
+                stage->jobs[j].transition(Stage::Pending, Stage::Free);
+            }
+            for (int j = 0; j < Stage::JobCount; ++j) {
+                while (stage->jobs[j].transition(Stage::Running,
+                                                 Stage::Running)) {
+                    Worker::pause();
+                }
+            }
+        }
+#endif
+        stage->reset();
+    }
+    m_head->reset();
+    m_lateCount = 0;
+    m_skipCount = 0;
+}
+
+template class Convolver<float>;
+template class Convolver<double>;
+template class NonUniformConvolver<float>;
+template class NonUniformConvolver<double>;
+
+}
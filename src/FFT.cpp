@@ -50,8 +50,48 @@
 // is included as well.
 //#define FFT_MEASUREMENT 1
 
-#ifdef FFT_MEASUREMENT
-#include <sstream>
+// Define FFT_STATISTICS to record per-method call counts and timings
+// for each FFT object, readable via FFT::getStatistics() once enabled
+// with FFT::setStatisticsEnabled(). Must be defined when the header
+// is included as well.
+//#define FFT_STATISTICS 1
+
+// Define HAVE_SYS_SDT_H to compile in static (USDT) probes for perf,
+// bpftrace, SystemTap etc, with provider name "bqfft". Until a tracer
+// attaches, each probe is a nop. The probes are
+//   select(size, implementation)
+//   plan__create(size, precision, implementation)
+//   transform__entry(size, method, precision, implementation)
+//   transform__return(size, method, precision, implementation)
+// where precision is 32 or 64 and method and implementation are
+// strings, e.g. "forwardPolarFloat" and "fftw". Each probe has a
+// semaphore, which the tracer increments while it is attached, and
+// the transform probes compute their arguments only when it is
+// nonzero, so that they cost a load and a branch until then.
+//#define HAVE_SYS_SDT_H 1
+
+#ifdef HAVE_SYS_SDT_H
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#define FFT_PROBE_SEMAPHORE(name) \
+    __extension__ unsigned short bqfft_##name##_semaphore \
+    __attribute__((unused)) __attribute__((section(".probes"))) \
+    __attribute__((visibility("hidden")))
+extern "C" {
+FFT_PROBE_SEMAPHORE(select);
+FFT_PROBE_SEMAPHORE(plan__create);
+FFT_PROBE_SEMAPHORE(transform__entry);
+FFT_PROBE_SEMAPHORE(transform__return);
+}
+#define FFT_PROBE_ENABLED(name) __builtin_expect(bqfft_##name##_semaphore, 0)
+#define FFT_PROBE2(name, a1, a2) DTRACE_PROBE2(bqfft, name, a1, a2)
+#define FFT_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(bqfft, name, a1, a2, a3)
+#define FFT_PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(bqfft, name, a1, a2, a3, a4)
+#else
+#define FFT_PROBE_ENABLED(name) 0
+#define FFT_PROBE2(name, a1, a2)
+#define FFT_PROBE3(name, a1, a2, a3)
+#define FFT_PROBE4(name, a1, a2, a3, a4)
 #endif
 
 #ifdef HAVE_IPP
@@ -76,6 +116,7 @@ extern "C" {
 
 #ifdef HAVE_KISSFFT
 #include "kiss_fftr.h"
+#include "kiss_fft_double.h"
 #endif
 
 #ifndef HAVE_IPP
@@ -92,13 +133,33 @@ extern "C" {
 #endif
 #endif
 
+#include <algorithm>
+#include <cfloat>
 #include <cmath>
 #include <iostream>
 #include <map>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <sstream>
 #include <vector>
 
+#include <stdint.h>
+#include <time.h>
+
+#ifndef NO_THREADING
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+#endif
+
+#ifdef __APPLE__
+#include <sys/types.h>
+#include <sys/sysctl.h>
+#endif
+
 #ifdef FFT_MEASUREMENT
 #ifndef _WIN32
 #include <unistd.h>
@@ -119,6 +180,12 @@ public:
     virtual FFT::Precisions getSupportedPrecisions() const = 0;
 
     virtual int getSize() const = 0;
+
+    virtual int getPreferredAlignment() const = 0;
+
+    // Number of calls that had to copy through internal buffers
+    // because the caller's buffers were not suitably aligned
+    virtual int getSlowPathCount() const { return 0; }
     
     virtual void initFloat() = 0;
     virtual void initDouble() = 0;
@@ -142,6 +209,528 @@ public:
     virtual void inverseInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ realOut) = 0;
     virtual void inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut) = 0;
     virtual void inverseCepstral(const float *BQ_R__ magIn, float *BQ_R__ cepOut) = 0;
+
+    virtual void forwardPower(const double *BQ_R__ realIn, double *BQ_R__ powerOut) = 0;
+    virtual void inversePower(const double *BQ_R__ powerIn, double *BQ_R__ realOut) = 0;
+
+    virtual void forwardPower(const float *BQ_R__ realIn, float *BQ_R__ powerOut) = 0;
+    virtual void inversePower(const float *BQ_R__ powerIn, float *BQ_R__ realOut) = 0;
+
+    // scale * log(max(|X|^2, floor)) for each bin of the forward
+    // transform X, which is FFT::forwardLogMagnitude with scale 0.5
+    // and FFT::forwardDecibels with scale 10/ln(10)
+    virtual void forwardLogPower(const double *BQ_R__ realIn, double *BQ_R__ logOut, double floor, double scale) = 0;
+    virtual void forwardLogPower(const float *BQ_R__ realIn, float *BQ_R__ logOut, float floor, float scale) = 0;
+
+    // Spectral envelope by cepstral smoothing, as described at
+    // FFT::cepstralEnvelope. cutoff is non-negative.
+    virtual void cepstralEnvelope(const double *BQ_R__ frame, int cutoff, double *BQ_R__ envOut) = 0;
+    virtual void cepstralEnvelope(const float *BQ_R__ frame, int cutoff, float *BQ_R__ envOut) = 0;
+
+    // Bins first to last - 1 of the forward transform, as separate
+    // real and imaginary parts or as magnitudes, taken from a full
+    // transform with only that range copied out. FFT::forwardBins
+    // calls these only when the range is too wide for Goertzel.
+    virtual void forwardBins(const double *BQ_R__ realIn, int first, int last, double *BQ_R__ realOut, double *BQ_R__ imagOut) = 0;
+    virtual void forwardBinsMagnitude(const double *BQ_R__ realIn, int first, int last, double *BQ_R__ magOut) = 0;
+
+    virtual void forwardBins(const float *BQ_R__ realIn, int first, int last, float *BQ_R__ realOut, float *BQ_R__ imagOut) = 0;
+    virtual void forwardBinsMagnitude(const float *BQ_R__ realIn, int first, int last, float *BQ_R__ magOut) = 0;
+
+    // The same range by Goertzel's algorithm, without using the
+    // implementation's transform, for ranges narrow enough that
+    // this is cheaper. Either imagOut or magOut is null.
+    virtual void forwardBinsGoertzel(const double *BQ_R__ realIn, int first, int last, double *BQ_R__ realOut, double *BQ_R__ imagOut, double *BQ_R__ magOut);
+    virtual void forwardBinsGoertzel(const float *BQ_R__ realIn, int first, int last, float *BQ_R__ realOut, float *BQ_R__ imagOut, float *BQ_R__ magOut);
+
+    // Circular cross-correlation of a and b, and autocorrelation of
+    // in, each written as scale times the unnormalised inverse of
+    // A.conj(B) or |X|^2. Output shaping applies (as it does for
+    // the lag range of FFT::correlate) but input shaping does not.
+    virtual void correlate(const double *BQ_R__ a, const double *BQ_R__ b, double *BQ_R__ out, double scale) = 0;
+    virtual void autocorrelate(const double *BQ_R__ in, double *BQ_R__ out, double scale) = 0;
+
+    virtual void correlate(const float *BQ_R__ a, const float *BQ_R__ b, float *BQ_R__ out, float scale) = 0;
+    virtual void autocorrelate(const float *BQ_R__ in, float *BQ_R__ out, float scale) = 0;
+
+    // Window (may be null) and rotation to apply to the time-domain
+    // input of forward transforms and output of inverse ones until
+    // clearShaping is called, as described at FFT::forwardWindowed.
+    // If accumulate is true, inverse output is also multiplied by
+    // gain and added to the output buffer rather than replacing it,
+    // as described at FFT::inverseAccumulate. Every implementation
+    // applies these in the pass in which it copies or converts its
+    // input or output anyway, using the helpers below.
+    virtual void setShaping(const double *window, int rotation,
+                            bool accumulate, double gain) {
+        m_dwindow = window;
+        m_fwindow = 0;
+        setShapingParameters(window != 0, rotation, accumulate, gain);
+    }
+    virtual void setShaping(const float *window, int rotation,
+                            bool accumulate, double gain) {
+        m_dwindow = 0;
+        m_fwindow = window;
+        setShapingParameters(window != 0, rotation, accumulate, gain);
+    }
+
+    // Rotation to apply to the time-domain output of inverse
+    // transforms only, writing no more than count samples, until
+    // clearShaping is called. Forward transforms are unaffected.
+    // This is how the lag range of FFT::correlate is extracted.
+    virtual void setOutputShaping(int rotation, int count) {
+        m_dwindow = 0;
+        m_fwindow = 0;
+        m_rotation = rotation;
+        m_accumulate = false;
+        m_gain = 1.0;
+        m_count = count;
+        m_length = getSize();
+        m_shapeInput = false;
+        m_shapeOutput = true;
+    }
+
+    // Length of the time-domain input of forward transforms, the
+    // samples beyond it being taken as zero without being read,
+    // until clearShaping is called. Inverse transforms are
+    // unaffected. This is how FFT::forwardPadded is done; there is
+    // never a window or rotation with it.
+    virtual void setInputShaping(int length) {
+        m_dwindow = 0;
+        m_fwindow = 0;
+        m_rotation = 0;
+        m_accumulate = false;
+        m_gain = 1.0;
+        m_count = 0;
+        m_length = length;
+        m_shapeInput = true;
+        m_shapeOutput = false;
+    }
+    
+    // Whether forwardPolar and inversePolar use the fastAtan2 and
+    // fastSinCos helpers below in place of exact conversions, as set
+    // by FFT::setPolarAccuracy. Unlike shaping, this persists.
+    virtual void setFastPolar(bool fast) {
+        m_fastPolar = fast;
+    }
+
+    bool isFastPolar() const {
+        return m_fastPolar;
+    }
+
+    virtual void clearShaping() {
+        m_dwindow = 0;
+        m_fwindow = 0;
+        m_rotation = 0;
+        m_accumulate = false;
+        m_gain = 1.0;
+        m_count = 0;
+        m_length = 0;
+        m_shapeInput = false;
+        m_shapeOutput = false;
+    }
+
+protected:
+    FFTImpl() :
+        m_dwindow(0), m_fwindow(0), m_rotation(0),
+        m_accumulate(false), m_gain(1.0), m_count(0), m_length(0),
+        m_shapeInput(false), m_shapeOutput(false),
+        m_fastPolar(false) { }
+
+    void setShapingParameters(bool windowed, int rotation,
+                              bool accumulate, double gain) {
+        m_rotation = rotation;
+        m_accumulate = accumulate;
+        m_gain = gain;
+        m_count = getSize();
+        m_length = getSize();
+        m_shapeInput = windowed || rotation;
+        m_shapeOutput = windowed || rotation || accumulate;
+    }
+    
+    bool isShapingInput() const {
+        return m_shapeInput;
+    }
+
+    bool isShapingOutput() const {
+        return m_shapeOutput;
+    }
+
+    // True if input shaping is only the zero padding set by
+    // setInputShaping, of which the length is then m_length
+    bool isPaddingInput() const {
+        return m_shapeInput && m_length < getSize();
+    }
+
+    const double *shapingWindow(const double *) const { return m_dwindow; }
+    const float *shapingWindow(const float *) const { return m_fwindow; }
+
+    // out[i] = window[j] * in[j] where j = (i + rotation) mod n; or,
+    // when padding, out[i] = in[i] for i below the input length and
+    // zero above it
+    template <typename S, typename T>
+    void shapeInput(T *BQ_R__ out, const S *BQ_R__ in, int n) const {
+        if (isPaddingInput()) {
+            const int len = m_length;
+            for (int i = 0; i < len; ++i) out[i] = T(in[i]);
+            for (int i = len; i < n; ++i) out[i] = T(0);
+            return;
+        }
+        const S *const BQ_R__ w = shapingWindow(in);
+        const int r = m_rotation;
+        const int k = n - r;
+        if (w) {
+            for (int i = 0; i < k; ++i) out[i] = T(in[i + r] * w[i + r]);
+            for (int i = 0; i < r; ++i) out[i + k] = T(in[i] * w[i]);
+        } else {
+            for (int i = 0; i < k; ++i) out[i] = T(in[i + r]);
+            for (int i = 0; i < r; ++i) out[i + k] = T(in[i]);
+        }
+    }
+
+    // out[j] = window[j] * in[i] where i = (j - rotation) mod n,
+    // reversing the rotation applied by shapeInput, for j below the
+    // output count; or, when accumulating, out[j] += gain *
+    // window[j] * in[i]
+    template <typename S, typename T>
+    void shapeOutput(T *BQ_R__ out, const S *BQ_R__ in, int n) const {
+        const T *const BQ_R__ w = shapingWindow(out);
+        const int c = m_count;
+        const int r = (m_rotation < c ? m_rotation : c);
+        const int k = n - m_rotation;
+        if (m_accumulate) {
+            const T g = T(m_gain);
+            if (w) {
+                for (int j = 0; j < r; ++j) out[j] += T(in[j + k]) * w[j] * g;
+                for (int j = r; j < c; ++j) out[j] += T(in[j - r]) * w[j] * g;
+            } else {
+                for (int j = 0; j < r; ++j) out[j] += T(in[j + k]) * g;
+                for (int j = r; j < c; ++j) out[j] += T(in[j - r]) * g;
+            }
+            return;
+        }
+        if (w) {
+            for (int j = 0; j < r; ++j) out[j] = T(in[j + k]) * w[j];
+            for (int j = r; j < c; ++j) out[j] = T(in[j - r]) * w[j];
+        } else {
+            for (int j = 0; j < r; ++j) out[j] = T(in[j + k]);
+            for (int j = r; j < c; ++j) out[j] = T(in[j - r]);
+        }
+    }
+
+    // The number of output samples written by shapeOutput, and the
+    // index of the input sample it reads for output sample j below
+    // that count, for implementations that would rather produce only
+    // the samples it reads
+    int shapedOutputCount() const {
+        return m_count;
+    }
+
+    int shapedOutputSource(int j) const {
+        const int i = j - m_rotation;
+        return (i < 0 ? i + getSize() : i);
+    }
+
+    // Conjugate product of two interleaved spectra of the given
+    // number of bins, in place: a[i] = scale * a[i] * conj(b[i]).
+    // This is the whole frequency-domain part of FFT::correlate.
+    template <typename T>
+    static void conjugateMultiply(T *BQ_R__ a, const T *BQ_R__ b,
+                                  int bins, T scale) {
+        for (int i = 0; i < bins; ++i) {
+            const T ar = a[i*2], ai = a[i*2+1];
+            const T br = b[i*2], bi = b[i*2+1];
+            a[i*2] = (ar * br + ai * bi) * scale;
+            a[i*2+1] = (ai * br - ar * bi) * scale;
+        }
+    }
+
+    // out[i] = |in[i]|^2 for an interleaved spectrum of the given
+    // number of bins
+    template <typename S, typename T>
+    static void interleavedToPower(T *BQ_R__ out, const S *BQ_R__ in,
+                                   int bins) {
+        for (int i = 0; i < bins; ++i) {
+            const S re = in[i*2], im = in[i*2+1];
+            out[i] = T(re * re + im * im);
+        }
+    }
+
+    // Bins first to last - 1 of an interleaved spectrum, to the
+    // start of separate real and imaginary arrays
+    template <typename S, typename T>
+    static void interleavedBinsToSplit(T *BQ_R__ re, T *BQ_R__ im,
+                                       const S *BQ_R__ in,
+                                       int first, int last) {
+        for (int i = first; i < last; ++i) {
+            re[i - first] = T(in[i*2]);
+            im[i - first] = T(in[i*2+1]);
+        }
+    }
+
+    // As interleavedBinsToSplit, to magnitudes
+    template <typename S, typename T>
+    static void interleavedBinsToMagnitudes(T *BQ_R__ mag,
+                                            const S *BQ_R__ in,
+                                            int first, int last) {
+        for (int i = first; i < last; ++i) {
+            const S re = in[i*2], im = in[i*2+1];
+            mag[i - first] = T(std::sqrt(re * re + im * im));
+        }
+    }
+
+    // Scaled power of an interleaved spectrum, in place, with zero
+    // imaginary part: a[i] = scale * |a[i]|^2
+    template <typename T>
+    static void conjugateSquare(T *BQ_R__ a, int bins, T scale) {
+        for (int i = 0; i < bins; ++i) {
+            const T re = a[i*2], im = a[i*2+1];
+            a[i*2] = (re * re + im * im) * scale;
+            a[i*2+1] = T(0);
+        }
+    }
+
+    // Natural logarithm of a positive normal x: the exponent is
+    // taken from the bits of x and the log of its mantissa m,
+    // reduced to [sqrt(1/2), sqrt(2)), from the odd series in
+    // (m-1)/(m+1). There are no branches or library calls, so loops
+    // over these vectorise. The absolute error is within 1e-7 + 4e-7
+    // |log x| for float and 5e-15 + 2e-15 |log x| for double, as
+    // documented for FFT::forwardLogMagnitude and checked by its
+    // tests. Infinity, NaN, zero and denormals give wrong results,
+    // so callers clamp their arguments (see clampPower).
+    static float fastLog(float x) {
+        union { float f; uint32_t i; } u;
+        u.f = x;
+        const int e = int(u.i >> 23) - 127;
+        u.i = (u.i & 0x007fffffu) | 0x3f800000u;
+        const float high = (u.f > 1.41421356f ? 1.f : 0.f);
+        const float m = u.f * (1.f - 0.5f * high);
+        const float t = (m - 1.f) / (m + 1.f);
+        const float t2 = t * t;
+        const float s = t * (2.f + t2 * (2.f/3.f + t2 * (2.f/5.f +
+                                                         t2 * (2.f/7.f))));
+        return (float(e) + high) * 0.693147181f + s;
+    }
+    static double fastLog(double x) {
+        union { double f; uint64_t i; } u;
+        u.f = x;
+        const int e = int(u.i >> 52) - 1023;
+        u.i = (u.i & ((uint64_t(0x000fffffu) << 32) | 0xffffffffu)) |
+            (uint64_t(0x3ff00000u) << 32);
+        const double high = (u.f > 1.4142135623730951 ? 1.0 : 0.0);
+        const double m = u.f * (1.0 - 0.5 * high);
+        const double t = (m - 1.0) / (m + 1.0);
+        const double t2 = t * t;
+        const double s = t * (2.0 + t2 * (2.0/3 + t2 * (2.0/5 +
+                         t2 * (2.0/7 + t2 * (2.0/9 + t2 * (2.0/11 +
+                         t2 * (2.0/13 + t2 * (2.0/15 + t2 * (2.0/17)))))))));
+        return (double(e) + high) * 0.69314718055994531 + s;
+    }
+
+    // A power limited to [floor, the largest finite value], for
+    // fastLog. A float power overflows to infinity for magnitudes
+    // above about 1.8e19 (a double one above about 1.3e154); that
+    // is taken as the largest finite value, giving a log just short
+    // of the true one rather than garbage.
+    static float clampPower(float p, float floor) {
+        return p < floor ? floor : (p < FLT_MAX ? p : FLT_MAX);
+    }
+    static double clampPower(double p, double floor) {
+        return p < floor ? floor : (p < DBL_MAX ? p : DBL_MAX);
+    }
+
+    // out[i] = scale * log(max(|in[i]|^2, floor)) for an interleaved
+    // spectrum of the given number of bins. This is the whole of
+    // FFT::forwardLogMagnitude and FFT::forwardDecibels after the
+    // transform; floor must be positive and normal.
+    template <typename S, typename T>
+    static void interleavedToLogPower(T *BQ_R__ out, const S *BQ_R__ in,
+                                      int bins, T floor, T scale) {
+        for (int i = 0; i < bins; ++i) {
+            const T re = T(in[i*2]), im = T(in[i*2+1]);
+            const T p = re * re + im * im;
+            out[i] = fastLog(clampPower(p, floor)) * scale;
+        }
+    }
+
+    // As interleavedToLogPower, for a power spectrum already
+    // calculated, in place
+    template <typename T>
+    static void powerToLogPower(T *BQ_R__ a, int bins, T floor, T scale) {
+        for (int i = 0; i < bins; ++i) {
+            const T p = a[i];
+            a[i] = fastLog(clampPower(p, floor)) * scale;
+        }
+    }
+
+    // Log magnitudes for inverseCepstral, with zero imaginary parts,
+    // into an interleaved spectrum: out[i] = log(mag[i] + 0.000001)
+    template <typename S, typename T>
+    static void magnitudeToLogInterleaved(T *BQ_R__ out,
+                                          const S *BQ_R__ mag, int bins) {
+        for (int i = 0; i < bins; ++i) {
+            out[i*2] = T(fastLog(mag[i] + S(0.000001)));
+            out[i*2+1] = T(0);
+        }
+    }
+
+    // As magnitudeToLogInterleaved, into a real array alone
+    template <typename S, typename T>
+    static void magnitudeToLog(T *BQ_R__ out, const S *BQ_R__ mag, int bins) {
+        for (int i = 0; i < bins; ++i) {
+            out[i] = T(fastLog(mag[i] + S(0.000001)));
+        }
+    }
+
+    // atan2(y, x) from a polynomial in min(|x|,|y|) / max(|x|,|y|)
+    // (Abramowitz and Stegun 4.4.49) folded into the right octant
+    // by selects rather than branches. The absolute error is within
+    // 2e-8 for double and 4e-7 (a couple of float ulps of pi) for
+    // float. atan2(0, 0) is 0.
+    template <typename T>
+    static T fastAtan2(T y, T x) {
+        const T ax = std::fabs(x), ay = std::fabs(y);
+        const T mx = (ax > ay ? ax : ay), mn = (ax > ay ? ay : ax);
+        const T a = mn / (mx > T(0) ? mx : T(1));
+        const T a2 = a * a;
+        T r = a * (T(1) + a2 * (T(-0.3333314528) + a2 * (T(0.1999355085) +
+              a2 * (T(-0.1420889944) + a2 * (T(0.1065626393) +
+              a2 * (T(-0.0752896400) + a2 * (T(0.0429096138) +
+              a2 * (T(-0.0161657367) + a2 * T(0.0028662257)))))))));
+        r = (ay > ax ? T(M_PI / 2.0) - r : r);
+        r = (x < T(0) ? T(M_PI) - r : r);
+        return (y < T(0) ? -r : r);
+    }
+
+    // sin and cos of x from Taylor polynomials on [-pi/4, pi/4],
+    // after reducing x by the nearest multiple of pi/2 and selecting
+    // the quadrant without branches. The reduction is in double
+    // precision, so that it holds under -ffast-math, and keeps the
+    // multiple in a double, so that no phase can overflow an int.
+    // Rounding in the reduction grows with |x|: the absolute error
+    // is within 2e-9 + 2e-16 |x| for double and 2e-7 + 2e-16 |x| for
+    // float. Beyond about 1e15 the result is meaningless, but the
+    // reduced argument is clamped so that it stays within [-1, 1].
+    template <typename T>
+    static void fastSinCos(T x, T &sinOut, T &cosOut) {
+        const double j = std::floor(double(x) * (2.0 / M_PI) + 0.5);
+        double rd = double(x) - j * (M_PI / 2.0);
+        rd = (rd < -M_PI / 4.0 ? -M_PI / 4.0 :
+              (rd > M_PI / 4.0 ? M_PI / 4.0 : rd));
+        const T r = T(rd);
+        const T r2 = r * r;
+        const T sr = r * (T(1) + r2 * (T(-1.0/6) + r2 * (T(1.0/120) +
+                     r2 * (T(-1.0/5040) + r2 * T(1.0/362880)))));
+        const T cr = T(1) + r2 * (T(-1.0/2) + r2 * (T(1.0/24) +
+                     r2 * (T(-1.0/720) + r2 * (T(1.0/40320) +
+                     r2 * T(-1.0/3628800)))));
+        const int q = int(j - 4.0 * std::floor(j * 0.25));
+        const T s = ((q & 1) ? cr : sr), c = ((q & 1) ? sr : cr);
+        sinOut = ((q & 2) ? -s : s);
+        cosOut = (((q + 1) & 2) ? -c : c);
+    }
+
+    // Magnitude and phase of an interleaved spectrum of the given
+    // number of bins, using fastAtan2: the polar unpack for
+    // forwardPolar when isFastPolar()
+    template <typename S, typename T>
+    static void interleavedToPolarFast(T *BQ_R__ mag, T *BQ_R__ phase,
+                                       const S *BQ_R__ in, int bins) {
+        for (int i = 0; i < bins; ++i) {
+            const T re = T(in[i*2]), im = T(in[i*2+1]);
+            mag[i] = std::sqrt(re * re + im * im);
+            phase[i] = fastAtan2(im, re);
+        }
+    }
+
+    // As interleavedToPolarFast, from separate real and imaginary
+    // arrays, with the magnitudes multiplied by scale
+    template <typename S, typename T>
+    static void cartesianToPolarFast(T *BQ_R__ mag, T *BQ_R__ phase,
+                                     const S *BQ_R__ re, const S *BQ_R__ im,
+                                     int bins, T scale) {
+        for (int i = 0; i < bins; ++i) {
+            const T r = T(re[i]), m = T(im[i]);
+            mag[i] = std::sqrt(r * r + m * m) * scale;
+            phase[i] = fastAtan2(m, r);
+        }
+    }
+
+    // Interleaved spectrum from magnitude and phase, using
+    // fastSinCos: the polar pack for inversePolar when isFastPolar()
+    template <typename S, typename T>
+    static void polarToInterleavedFast(T *BQ_R__ out, const S *BQ_R__ mag,
+                                       const S *BQ_R__ phase, int bins) {
+        for (int i = 0; i < bins; ++i) {
+            S s, c;
+            fastSinCos(phase[i], s, c);
+            out[i*2] = T(mag[i] * c);
+            out[i*2+1] = T(mag[i] * s);
+        }
+    }
+
+    // As polarToInterleavedFast, to separate real and imaginary arrays
+    template <typename S, typename T>
+    static void polarToCartesianFast(T *BQ_R__ re, T *BQ_R__ im,
+                                     const S *BQ_R__ mag,
+                                     const S *BQ_R__ phase, int bins) {
+        for (int i = 0; i < bins; ++i) {
+            S s, c;
+            fastSinCos(phase[i], s, c);
+            re[i] = T(mag[i] * c);
+            im[i] = T(mag[i] * s);
+        }
+    }
+
+    // The three steps of cepstralEnvelope that fall between its
+    // transforms. First the log magnitudes of an interleaved
+    // spectrum, in place, with zero imaginary parts, taken as
+    // inverseCepstral takes them: a[i] = log(|a[i]| + 0.000001)
+    template <typename T>
+    static void logMagnitudeInPlace(T *BQ_R__ a, int bins) {
+        for (int i = 0; i < bins; ++i) {
+            const T re = a[i*2], im = a[i*2+1];
+            a[i*2] = fastLog(std::sqrt(re * re + im * im) + T(0.000001));
+            a[i*2+1] = T(0);
+        }
+    }
+
+    // Then the lifter, on the unnormalised real cepstrum c of n
+    // samples from the inverse: quefrencies up to cutoff either
+    // side of zero are scaled by 1/n and the rest zeroed, without
+    // being read
+    template <typename T>
+    static void lifter(T *BQ_R__ c, int n, int cutoff) {
+        const int k = (cutoff < n/2 ? cutoff : n/2);
+        const int upper = (n - k > k + 1 ? n - k : k + 1);
+        const T scale = T(1.0 / n);
+        for (int i = 0; i <= k; ++i) c[i] *= scale;
+        for (int i = k + 1; i < upper; ++i) c[i] = T(0);
+        for (int i = upper; i < n; ++i) c[i] *= scale;
+    }
+
+    // And the exponential of the real parts of the interleaved
+    // spectrum of the liftered cepstrum, whose imaginary parts are
+    // zero as it is even, and so are not read
+    template <typename S, typename T>
+    static void interleavedRealToExp(T *BQ_R__ out, const S *BQ_R__ in,
+                                     int bins) {
+        for (int i = 0; i < bins; ++i) {
+            out[i] = T(std::exp(in[i*2]));
+        }
+    }
+
+    const double *m_dwindow;
+    const float *m_fwindow;
+    int m_rotation;
+    bool m_accumulate;
+    double m_gain;
+    int m_count;
+    int m_length;
+    bool m_shapeInput;
+    bool m_shapeOutput;
+    bool m_fastPolar;
 };    
 
 namespace FFTs {
@@ -172,6 +761,7 @@ public:
             ippsFree(m_fbuf);
             ippsFree(m_fpacked);
             ippsFree(m_fspare);
+            ippsFree(m_fcorr);
         }
         if (m_dspec) {
 #if (IPP_VERSION_MAJOR >= 9)
@@ -182,6 +772,7 @@ public:
             ippsFree(m_dbuf);
             ippsFree(m_dpacked);
             ippsFree(m_dspare);
+            ippsFree(m_dcorr);
         }
     }
 
@@ -194,10 +785,15 @@ public:
         return FFT::SinglePrecision | FFT::DoublePrecision;
     }
 
+    int getPreferredAlignment() const {
+        return 64; // as returned by ippsMalloc
+    }
+
     //!!! rv check
 
     void initFloat() {
         if (m_fspec) return;
+        FFT_PROBE3(plan__create, m_size, 32, "ipp");
 #if (IPP_VERSION_MAJOR >= 9)
         int specSize, specBufferSize, bufferSize;
         ippsFFTGetSize_R_32f(m_order, IPP_FFT_NODIV_BY_ANY, ippAlgHintFast,
@@ -207,6 +803,7 @@ public:
         m_fbuf = ippsMalloc_8u(bufferSize);
         m_fpacked = ippsMalloc_32f(m_size + 2);
         m_fspare = ippsMalloc_32f(m_size / 2 + 1);
+        m_fcorr = ippsMalloc_32f(m_size + 2);
         ippsFFTInit_R_32f(&m_fspec,
                           m_order, IPP_FFT_NODIV_BY_ANY, ippAlgHintFast,
                           m_fspecbuf, tmp);
@@ -218,6 +815,7 @@ public:
         m_fbuf = ippsMalloc_8u(bufferSize);
         m_fpacked = ippsMalloc_32f(m_size + 2);
         m_fspare = ippsMalloc_32f(m_size / 2 + 1);
+        m_fcorr = ippsMalloc_32f(m_size + 2);
         ippsFFTInitAlloc_R_32f(&m_fspec, m_order, IPP_FFT_NODIV_BY_ANY, 
                                ippAlgHintFast);
 #endif
@@ -225,6 +823,7 @@ public:
 
     void initDouble() {
         if (m_dspec) return;
+        FFT_PROBE3(plan__create, m_size, 64, "ipp");
 #if (IPP_VERSION_MAJOR >= 9)
         int specSize, specBufferSize, bufferSize;
         ippsFFTGetSize_R_64f(m_order, IPP_FFT_NODIV_BY_ANY, ippAlgHintFast,
@@ -234,6 +833,7 @@ public:
         m_dbuf = ippsMalloc_8u(bufferSize);
         m_dpacked = ippsMalloc_64f(m_size + 2);
         m_dspare = ippsMalloc_64f(m_size / 2 + 1);
+        m_dcorr = ippsMalloc_64f(m_size + 2);
         ippsFFTInit_R_64f(&m_dspec,
                           m_order, IPP_FFT_NODIV_BY_ANY, ippAlgHintFast,
                           m_dspecbuf, tmp);
@@ -245,6 +845,7 @@ public:
         m_dbuf = ippsMalloc_8u(bufferSize);
         m_dpacked = ippsMalloc_64f(m_size + 2);
         m_dspare = ippsMalloc_64f(m_size / 2 + 1);
+        m_dcorr = ippsMalloc_64f(m_size + 2);
         ippsFFTInitAlloc_R_64f(&m_dspec, m_order, IPP_FFT_NODIV_BY_ANY, 
                                ippAlgHintFast);
 #endif
@@ -324,52 +925,106 @@ public:
         }
     }        
 
+    // The transforms run out of place from and to the caller's
+    // buffers, except when shaping, where the input is shaped into
+    // the packed buffer or the output shaped out of it and the
+    // transform runs in place there
+    void executeForward(const double *BQ_R__ realIn, double *BQ_R__ packed) {
+        if (isShapingInput()) {
+            shapeInput(packed, realIn, m_size);
+            ippsFFTFwd_RToCCS_64f_I(packed, m_dspec, m_dbuf);
+        } else {
+            ippsFFTFwd_RToCCS_64f(realIn, packed, m_dspec, m_dbuf);
+        }
+    }
+
+    void executeInverse(const double *packed, double *BQ_R__ realOut) {
+        if (isShapingOutput()) {
+            if (packed != m_dpacked) {
+                ippsCopy_64f(packed, m_dpacked, m_size + 2);
+            }
+            ippsFFTInv_CCSToR_64f_I(m_dpacked, m_dspec, m_dbuf);
+            shapeOutput(realOut, m_dpacked, m_size);
+        } else {
+            ippsFFTInv_CCSToR_64f(packed, realOut, m_dspec, m_dbuf);
+        }
+    }
+
+    void executeForward(const float *BQ_R__ realIn, float *BQ_R__ packed) {
+        if (isShapingInput()) {
+            shapeInput(packed, realIn, m_size);
+            ippsFFTFwd_RToCCS_32f_I(packed, m_fspec, m_fbuf);
+        } else {
+            ippsFFTFwd_RToCCS_32f(realIn, packed, m_fspec, m_fbuf);
+        }
+    }
+
+    void executeInverse(const float *packed, float *BQ_R__ realOut) {
+        if (isShapingOutput()) {
+            if (packed != m_fpacked) {
+                ippsCopy_32f(packed, m_fpacked, m_size + 2);
+            }
+            ippsFFTInv_CCSToR_32f_I(m_fpacked, m_fspec, m_fbuf);
+            shapeOutput(realOut, m_fpacked, m_size);
+        } else {
+            ippsFFTInv_CCSToR_32f(packed, realOut, m_fspec, m_fbuf);
+        }
+    }
+
     void forward(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
         if (!m_dspec) initDouble();
-        ippsFFTFwd_RToCCS_64f(realIn, m_dpacked, m_dspec, m_dbuf);
+        executeForward(realIn, m_dpacked);
         unpackDouble(realOut, imagOut);
     }
 
     void forwardInterleaved(const double *BQ_R__ realIn, double *BQ_R__ complexOut) {
         if (!m_dspec) initDouble();
-        ippsFFTFwd_RToCCS_64f(realIn, complexOut, m_dspec, m_dbuf);
+        executeForward(realIn, complexOut);
     }
 
     void forwardPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut) {
         if (!m_dspec) initDouble();
-        ippsFFTFwd_RToCCS_64f(realIn, m_dpacked, m_dspec, m_dbuf);
+        executeForward(realIn, m_dpacked);
+        if (isFastPolar()) {
+            interleavedToPolarFast(magOut, phaseOut, m_dpacked, m_size/2+1);
+            return;
+        }
         unpackDouble(m_dpacked, m_dspare);
         ippsCartToPolar_64f(m_dpacked, m_dspare, magOut, phaseOut, m_size/2+1);
     }
 
     void forwardMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut) {
         if (!m_dspec) initDouble();
-        ippsFFTFwd_RToCCS_64f(realIn, m_dpacked, m_dspec, m_dbuf);
+        executeForward(realIn, m_dpacked);
         unpackDouble(m_dpacked, m_dspare);
         ippsMagnitude_64f(m_dpacked, m_dspare, magOut, m_size/2+1);
     }
 
     void forward(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
         if (!m_fspec) initFloat();
-        ippsFFTFwd_RToCCS_32f(realIn, m_fpacked, m_fspec, m_fbuf);
+        executeForward(realIn, m_fpacked);
         unpackFloat(realOut, imagOut);
     }
 
     void forwardInterleaved(const float *BQ_R__ realIn, float *BQ_R__ complexOut) {
         if (!m_fspec) initFloat();
-        ippsFFTFwd_RToCCS_32f(realIn, complexOut, m_fspec, m_fbuf);
+        executeForward(realIn, complexOut);
     }
 
     void forwardPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut) {
         if (!m_fspec) initFloat();
-        ippsFFTFwd_RToCCS_32f(realIn, m_fpacked, m_fspec, m_fbuf);
+        executeForward(realIn, m_fpacked);
+        if (isFastPolar()) {
+            interleavedToPolarFast(magOut, phaseOut, m_fpacked, m_size/2+1);
+            return;
+        }
         unpackFloat(m_fpacked, m_fspare);
         ippsCartToPolar_32f(m_fpacked, m_fspare, magOut, phaseOut, m_size/2+1);
     }
 
     void forwardMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut) {
         if (!m_fspec) initFloat();
-        ippsFFTFwd_RToCCS_32f(realIn, m_fpacked, m_fspec, m_fbuf);
+        executeForward(realIn, m_fpacked);
         unpackFloat(m_fpacked, m_fspare);
         ippsMagnitude_32f(m_fpacked, m_fspare, magOut, m_size/2+1);
     }
@@ -377,59 +1032,173 @@ public:
     void inverse(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut) {
         if (!m_dspec) initDouble();
         packDouble(realIn, imagIn);
-        ippsFFTInv_CCSToR_64f(m_dpacked, realOut, m_dspec, m_dbuf);
+        executeInverse(m_dpacked, realOut);
     }
 
     void inverseInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ realOut) {
         if (!m_dspec) initDouble();
-        ippsFFTInv_CCSToR_64f(complexIn, realOut, m_dspec, m_dbuf);
+        executeInverse(complexIn, realOut);
     }
 
     void inversePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, double *BQ_R__ realOut) {
         if (!m_dspec) initDouble();
-        ippsPolarToCart_64f(magIn, phaseIn, realOut, m_dspare, m_size/2+1);
-        packDouble(realOut, m_dspare); // to m_dpacked
-        ippsFFTInv_CCSToR_64f(m_dpacked, realOut, m_dspec, m_dbuf);
+        if (isFastPolar()) {
+            polarToInterleavedFast(m_dpacked, magIn, phaseIn, m_size/2+1);
+        } else {
+            ippsPolarToCart_64f(magIn, phaseIn, realOut, m_dspare, m_size/2+1);
+            packDouble(realOut, m_dspare); // to m_dpacked
+        }
+        executeInverse(m_dpacked, realOut);
     }
 
     void inverseCepstral(const double *BQ_R__ magIn, double *BQ_R__ cepOut) {
         if (!m_dspec) initDouble();
-        const int hs1 = m_size/2 + 1;
-        ippsCopy_64f(magIn, m_dspare, hs1);
-        ippsAddC_64f_I(0.000001, m_dspare, hs1);
-        ippsLn_64f_I(m_dspare, hs1);
-        packDouble(m_dspare, 0);
+        magnitudeToLogInterleaved(m_dpacked, magIn, m_size/2 + 1);
         ippsFFTInv_CCSToR_64f(m_dpacked, cepOut, m_dspec, m_dbuf);
     }
     
     void inverse(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut) {
         if (!m_fspec) initFloat();
         packFloat(realIn, imagIn);
-        ippsFFTInv_CCSToR_32f(m_fpacked, realOut, m_fspec, m_fbuf);
+        executeInverse(m_fpacked, realOut);
     }
 
     void inverseInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ realOut) {
         if (!m_fspec) initFloat();
-        ippsFFTInv_CCSToR_32f(complexIn, realOut, m_fspec, m_fbuf);
+        executeInverse(complexIn, realOut);
     }
 
     void inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut) {
         if (!m_fspec) initFloat();
-        ippsPolarToCart_32f(magIn, phaseIn, realOut, m_fspare, m_size/2+1);
-        packFloat(realOut, m_fspare); // to m_fpacked
-        ippsFFTInv_CCSToR_32f(m_fpacked, realOut, m_fspec, m_fbuf);
+        if (isFastPolar()) {
+            polarToInterleavedFast(m_fpacked, magIn, phaseIn, m_size/2+1);
+        } else {
+            ippsPolarToCart_32f(magIn, phaseIn, realOut, m_fspare, m_size/2+1);
+            packFloat(realOut, m_fspare); // to m_fpacked
+        }
+        executeInverse(m_fpacked, realOut);
     }
 
     void inverseCepstral(const float *BQ_R__ magIn, float *BQ_R__ cepOut) {
         if (!m_fspec) initFloat();
-        const int hs1 = m_size/2 + 1;
-        ippsCopy_32f(magIn, m_fspare, hs1);
-        ippsAddC_32f_I(0.000001f, m_fspare, hs1);
-        ippsLn_32f_I(m_fspare, hs1);
-        packFloat(m_fspare, 0);
+        magnitudeToLogInterleaved(m_fpacked, magIn, m_size/2 + 1);
         ippsFFTInv_CCSToR_32f(m_fpacked, cepOut, m_fspec, m_fbuf);
     }
 
+    void forwardPower(const double *BQ_R__ realIn, double *BQ_R__ powerOut) {
+        if (!m_dspec) initDouble();
+        executeForward(realIn, m_dpacked);
+        ippsPowerSpectr_64fc((const Ipp64fc *)m_dpacked, powerOut, m_size/2+1);
+    }
+
+    void inversePower(const double *BQ_R__ powerIn, double *BQ_R__ realOut) {
+        if (!m_dspec) initDouble();
+        packDouble(powerIn, 0);
+        executeInverse(m_dpacked, realOut);
+    }
+
+    void forwardPower(const float *BQ_R__ realIn, float *BQ_R__ powerOut) {
+        if (!m_fspec) initFloat();
+        executeForward(realIn, m_fpacked);
+        ippsPowerSpectr_32fc((const Ipp32fc *)m_fpacked, powerOut, m_size/2+1);
+    }
+
+    void inversePower(const float *BQ_R__ powerIn, float *BQ_R__ realOut) {
+        if (!m_fspec) initFloat();
+        packFloat(powerIn, 0);
+        executeInverse(m_fpacked, realOut);
+    }
+
+    void forwardLogPower(const double *BQ_R__ realIn, double *BQ_R__ logOut, double floor, double scale) {
+        if (!m_dspec) initDouble();
+        executeForward(realIn, m_dpacked);
+        interleavedToLogPower(logOut, m_dpacked, m_size/2+1, floor, scale);
+    }
+
+    void forwardLogPower(const float *BQ_R__ realIn, float *BQ_R__ logOut, float floor, float scale) {
+        if (!m_fspec) initFloat();
+        executeForward(realIn, m_fpacked);
+        interleavedToLogPower(logOut, m_fpacked, m_size/2+1, floor, scale);
+    }
+
+    // The whole pipeline runs in place in the packed buffer
+    void cepstralEnvelope(const double *BQ_R__ frame, int cutoff, double *BQ_R__ envOut) {
+        if (!m_dspec) initDouble();
+        executeForward(frame, m_dpacked);
+        logMagnitudeInPlace(m_dpacked, m_size/2+1);
+        ippsFFTInv_CCSToR_64f_I(m_dpacked, m_dspec, m_dbuf);
+        lifter(m_dpacked, m_size, cutoff);
+        ippsFFTFwd_RToCCS_64f_I(m_dpacked, m_dspec, m_dbuf);
+        interleavedRealToExp(envOut, m_dpacked, m_size/2+1);
+    }
+
+    void cepstralEnvelope(const float *BQ_R__ frame, int cutoff, float *BQ_R__ envOut) {
+        if (!m_fspec) initFloat();
+        executeForward(frame, m_fpacked);
+        logMagnitudeInPlace(m_fpacked, m_size/2+1);
+        ippsFFTInv_CCSToR_32f_I(m_fpacked, m_fspec, m_fbuf);
+        lifter(m_fpacked, m_size, cutoff);
+        ippsFFTFwd_RToCCS_32f_I(m_fpacked, m_fspec, m_fbuf);
+        interleavedRealToExp(envOut, m_fpacked, m_size/2+1);
+    }
+
+    void forwardBins(const double *BQ_R__ realIn, int first, int last, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        if (!m_dspec) initDouble();
+        executeForward(realIn, m_dpacked);
+        interleavedBinsToSplit(realOut, imagOut, m_dpacked, first, last);
+    }
+
+    void forwardBinsMagnitude(const double *BQ_R__ realIn, int first, int last, double *BQ_R__ magOut) {
+        if (!m_dspec) initDouble();
+        executeForward(realIn, m_dpacked);
+        interleavedBinsToMagnitudes(magOut, m_dpacked, first, last);
+    }
+
+    void forwardBins(const float *BQ_R__ realIn, int first, int last, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        if (!m_fspec) initFloat();
+        executeForward(realIn, m_fpacked);
+        interleavedBinsToSplit(realOut, imagOut, m_fpacked, first, last);
+    }
+
+    void forwardBinsMagnitude(const float *BQ_R__ realIn, int first, int last, float *BQ_R__ magOut) {
+        if (!m_fspec) initFloat();
+        executeForward(realIn, m_fpacked);
+        interleavedBinsToMagnitudes(magOut, m_fpacked, first, last);
+    }
+
+    // CCS is already interleaved complex, so the products are taken
+    // in place in the packed buffers between the transforms
+
+    void correlate(const double *BQ_R__ a, const double *BQ_R__ b, double *BQ_R__ out, double scale) {
+        if (!m_dspec) initDouble();
+        executeForward(b, m_dcorr);
+        executeForward(a, m_dpacked);
+        conjugateMultiply(m_dpacked, m_dcorr, m_size/2 + 1, scale);
+        executeInverse(m_dpacked, out);
+    }
+
+    void autocorrelate(const double *BQ_R__ in, double *BQ_R__ out, double scale) {
+        if (!m_dspec) initDouble();
+        executeForward(in, m_dpacked);
+        conjugateSquare(m_dpacked, m_size/2 + 1, scale);
+        executeInverse(m_dpacked, out);
+    }
+
+    void correlate(const float *BQ_R__ a, const float *BQ_R__ b, float *BQ_R__ out, float scale) {
+        if (!m_fspec) initFloat();
+        executeForward(b, m_fcorr);
+        executeForward(a, m_fpacked);
+        conjugateMultiply(m_fpacked, m_fcorr, m_size/2 + 1, scale);
+        executeInverse(m_fpacked, out);
+    }
+
+    void autocorrelate(const float *BQ_R__ in, float *BQ_R__ out, float scale) {
+        if (!m_fspec) initFloat();
+        executeForward(in, m_fpacked);
+        conjugateSquare(m_fpacked, m_size/2 + 1, scale);
+        executeInverse(m_fpacked, out);
+    }
+
 private:
     const int m_size;
     int m_order;
@@ -441,8 +1210,10 @@ private:
     Ipp8u *m_dbuf;
     float *m_fpacked;
     float *m_fspare;
+    float *m_fcorr;
     double *m_dpacked;
     double *m_dspare;
+    double *m_dcorr;
 };
 
 #endif /* HAVE_IPP */
@@ -499,10 +1270,15 @@ public:
         return FFT::SinglePrecision | FFT::DoublePrecision;
     }
 
+    int getPreferredAlignment() const {
+        return 16;
+    }
+
     //!!! rv check
 
     void initFloat() {
         if (m_fspec) return;
+        FFT_PROBE3(plan__create, m_size, 32, "vdsp");
         m_fspec = vDSP_create_fftsetup(m_order, FFT_RADIX2);
         m_fbuf = new DSPSplitComplex;
         //!!! "If possible, tempBuffer->realp and tempBuffer->imagp should be 32-byte aligned for best performance."
@@ -517,6 +1293,7 @@ public:
 
     void initDouble() {
         if (m_dspec) return;
+        FFT_PROBE3(plan__create, m_size, 64, "vdsp");
         m_dspec = vDSP_create_fftsetupD(m_order, FFT_RADIX2);
         m_dbuf = new DSPDoubleSplitComplex;
         //!!! "If possible, tempBuffer->realp and tempBuffer->imagp should be 32-byte aligned for best performance."
@@ -531,6 +1308,11 @@ public:
 
     void packReal(const float *BQ_R__ const re) {
         // Pack input for forward transform 
+        if (isShapingInput()) {
+            shapeInput(m_fspare, re, m_size);
+            vDSP_ctoz((DSPComplex *)m_fspare, 2, m_fpacked, 1, m_size/2);
+            return;
+        }
         vDSP_ctoz((DSPComplex *)re, 2, m_fpacked, 1, m_size/2);
     }
     void packComplex(const float *BQ_R__ const re, const float *BQ_R__ const im) {
@@ -544,6 +1326,11 @@ public:
 
     void unpackReal(float *BQ_R__ const re) {
         // Unpack output for inverse transform
+        if (isShapingOutput()) {
+            vDSP_ztoc(m_fpacked, 1, (DSPComplex *)m_fspare, 2, m_size/2);
+            shapeOutput(re, m_fspare, m_size);
+            return;
+        }
         vDSP_ztoc(m_fpacked, 1, (DSPComplex *)re, 2, m_size/2);
     }
     void unpackComplex(float *BQ_R__ const re, float *BQ_R__ const im) {
@@ -565,6 +1352,11 @@ public:
 
     void packReal(const double *BQ_R__ const re) {
         // Pack input for forward transform
+        if (isShapingInput()) {
+            shapeInput(m_dspare, re, m_size);
+            vDSP_ctozD((DSPDoubleComplex *)m_dspare, 2, m_dpacked, 1, m_size/2);
+            return;
+        }
         vDSP_ctozD((DSPDoubleComplex *)re, 2, m_dpacked, 1, m_size/2);
     }
     void packComplex(const double *BQ_R__ const re, const double *BQ_R__ const im) {
@@ -578,6 +1370,11 @@ public:
 
     void unpackReal(double *BQ_R__ const re) {
         // Unpack output for inverse transform
+        if (isShapingOutput()) {
+            vDSP_ztocD(m_dpacked, 1, (DSPDoubleComplex *)m_dspare, 2, m_size/2);
+            shapeOutput(re, m_dspare, m_size);
+            return;
+        }
         vDSP_ztocD(m_dpacked, 1, (DSPDoubleComplex *)re, 2, m_size/2);
     }
     void unpackComplex(double *BQ_R__ const re, double *BQ_R__ const im) {
@@ -650,6 +1447,11 @@ public:
         vDSP_fft_zriptD(m_dspec, m_dpacked, 1, m_dbuf, m_order, FFT_FORWARD);
         ddenyq();
         // vDSP forward FFTs are scaled 2x (for some reason)
+        if (isFastPolar()) {
+            cartesianToPolarFast(magOut, phaseOut, m_dpacked->realp,
+                                 m_dpacked->imagp, hs1, 0.5);
+            return;
+        }
         for (int i = 0; i < hs1; ++i) m_dpacked->realp[i] *= 0.5;
         for (int i = 0; i < hs1; ++i) m_dpacked->imagp[i] *= 0.5;
         v_cartesian_to_polar(magOut, phaseOut,
@@ -692,6 +1494,11 @@ public:
         vDSP_fft_zript(m_fspec, m_fpacked, 1, m_fbuf, m_order, FFT_FORWARD);
         fdenyq();
         // vDSP forward FFTs are scaled 2x (for some reason)
+        if (isFastPolar()) {
+            cartesianToPolarFast(magOut, phaseOut, m_fpacked->realp,
+                                 m_fpacked->imagp, hs1, 0.5f);
+            return;
+        }
         for (int i = 0; i < hs1; ++i) m_fpacked->realp[i] *= 0.5f;
         for (int i = 0; i < hs1; ++i) m_fpacked->imagp[i] *= 0.5f;
         v_cartesian_to_polar(magOut, phaseOut,
@@ -730,11 +1537,16 @@ public:
     void inversePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, double *BQ_R__ realOut) {
         if (!m_dspec) initDouble();
         const int hs1 = m_size/2+1;
-        vvsincos(m_dpacked->imagp, m_dpacked->realp, phaseIn, &hs1);
-        double *const rp = m_dpacked->realp;
-        double *const ip = m_dpacked->imagp;
-        for (int i = 0; i < hs1; ++i) rp[i] *= magIn[i];
-        for (int i = 0; i < hs1; ++i) ip[i] *= magIn[i];
+        if (isFastPolar()) {
+            polarToCartesianFast(m_dpacked->realp, m_dpacked->imagp,
+                                 magIn, phaseIn, hs1);
+        } else {
+            vvsincos(m_dpacked->imagp, m_dpacked->realp, phaseIn, &hs1);
+            double *const rp = m_dpacked->realp;
+            double *const ip = m_dpacked->imagp;
+            for (int i = 0; i < hs1; ++i) rp[i] *= magIn[i];
+            for (int i = 0; i < hs1; ++i) ip[i] *= magIn[i];
+        }
         dnyq();
         vDSP_fft_zriptD(m_dspec, m_dpacked, 1, m_dbuf, m_order, FFT_INVERSE);
         unpackReal(realOut);
@@ -743,10 +1555,11 @@ public:
     void inverseCepstral(const double *BQ_R__ magIn, double *BQ_R__ cepOut) {
         if (!m_dspec) initDouble();
         const int hs1 = m_size/2 + 1;
-        v_copy(m_dspare, magIn, hs1);
-        for (int i = 0; i < hs1; ++i) m_dspare[i] += 0.000001;
-        vvlog(m_dspare2, m_dspare, &hs1);
-        inverse(m_dspare2, 0, cepOut);
+        magnitudeToLog(m_dpacked->realp, magIn, hs1);
+        v_zero(m_dpacked->imagp, hs1);
+        dnyq();
+        vDSP_fft_zriptD(m_dspec, m_dpacked, 1, m_dbuf, m_order, FFT_INVERSE);
+        unpackReal(cepOut);
     }
     
     void inverse(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut) {
@@ -769,11 +1582,16 @@ public:
         if (!m_fspec) initFloat();
 
         const int hs1 = m_size/2+1;
-        vvsincosf(m_fpacked->imagp, m_fpacked->realp, phaseIn, &hs1);
-        float *const rp = m_fpacked->realp;
-        float *const ip = m_fpacked->imagp;
-        for (int i = 0; i < hs1; ++i) rp[i] *= magIn[i];
-        for (int i = 0; i < hs1; ++i) ip[i] *= magIn[i];
+        if (isFastPolar()) {
+            polarToCartesianFast(m_fpacked->realp, m_fpacked->imagp,
+                                 magIn, phaseIn, hs1);
+        } else {
+            vvsincosf(m_fpacked->imagp, m_fpacked->realp, phaseIn, &hs1);
+            float *const rp = m_fpacked->realp;
+            float *const ip = m_fpacked->imagp;
+            for (int i = 0; i < hs1; ++i) rp[i] *= magIn[i];
+            for (int i = 0; i < hs1; ++i) ip[i] *= magIn[i];
+        }
         fnyq();
         vDSP_fft_zript(m_fspec, m_fpacked, 1, m_fbuf, m_order, FFT_INVERSE);
         unpackReal(realOut);
@@ -782,54 +1600,323 @@ public:
     void inverseCepstral(const float *BQ_R__ magIn, float *BQ_R__ cepOut) {
         if (!m_fspec) initFloat();
         const int hs1 = m_size/2 + 1;
-        v_copy(m_fspare, magIn, hs1);
-        for (int i = 0; i < hs1; ++i) m_fspare[i] += 0.000001f;
-        vvlogf(m_fspare2, m_fspare, &hs1);
-        inverse(m_fspare2, 0, cepOut);
+        magnitudeToLog(m_fpacked->realp, magIn, hs1);
+        v_zero(m_fpacked->imagp, hs1);
+        fnyq();
+        vDSP_fft_zript(m_fspec, m_fpacked, 1, m_fbuf, m_order, FFT_INVERSE);
+        unpackReal(cepOut);
     }
 
-private:
-    const int m_size;
-    int m_order;
-    FFTSetup m_fspec;
-    FFTSetupD m_dspec;
-    DSPSplitComplex *m_fbuf;
-    DSPDoubleSplitComplex *m_dbuf;
-    DSPSplitComplex *m_fpacked;
-    float *m_fspare;
-    float *m_fspare2;
-    DSPDoubleSplitComplex *m_dpacked;
-    double *m_dspare;
-    double *m_dspare2;
-};
+    void forwardPower(const double *BQ_R__ realIn, double *BQ_R__ powerOut) {
+        if (!m_dspec) initDouble();
+        packReal(realIn);
+        vDSP_fft_zriptD(m_dspec, m_dpacked, 1, m_dbuf, m_order, FFT_FORWARD);
+        ddenyq();
+        const int hs1 = m_size/2+1;
+        vDSP_zvmagsD(m_dpacked, 1, powerOut, 1, hs1);
+        // vDSP forward FFTs are scaled 2x (for some reason)
+        double quarter = 0.25;
+        vDSP_vsmulD(powerOut, 1, &quarter, powerOut, 1, hs1);
+    }
 
-#endif /* HAVE_VDSP */
+    void inversePower(const double *BQ_R__ powerIn, double *BQ_R__ realOut) {
+        inverse(powerIn, 0, realOut);
+    }
 
-#ifdef HAVE_FFTW3
+    void forwardPower(const float *BQ_R__ realIn, float *BQ_R__ powerOut) {
+        if (!m_fspec) initFloat();
+        packReal(realIn);
+        vDSP_fft_zript(m_fspec, m_fpacked, 1, m_fbuf, m_order, FFT_FORWARD);
+        fdenyq();
+        const int hs1 = m_size/2+1;
+        vDSP_zvmags(m_fpacked, 1, powerOut, 1, hs1);
+        // vDSP forward FFTs are scaled 2x (for some reason)
+        float quarter = 0.25f;
+        vDSP_vsmul(powerOut, 1, &quarter, powerOut, 1, hs1);
+    }
 
-/*
- Define FFTW_DOUBLE_ONLY to make all uses of FFTW functions be
- double-precision (so "float" FFTs are calculated by casting to
- doubles and using the double-precision FFTW function).
+    void inversePower(const float *BQ_R__ powerIn, float *BQ_R__ realOut) {
+        inverse(powerIn, 0, realOut);
+    }
 
- Define FFTW_SINGLE_ONLY to make all uses of FFTW functions be
- single-precision (so "double" FFTs are calculated by casting to
- floats and using the single-precision FFTW function).
+    // vDSP forward FFTs are scaled 2x, so the power is scaled 4x
 
- Neither of these flags is desirable for either performance or
- precision. The main reason to define either flag is to avoid linking
- against both fftw3 and fftw3f libraries.
-*/
+    void forwardLogPower(const double *BQ_R__ realIn, double *BQ_R__ logOut, double floor, double scale) {
+        if (!m_dspec) initDouble();
+        packReal(realIn);
+        vDSP_fft_zriptD(m_dspec, m_dpacked, 1, m_dbuf, m_order, FFT_FORWARD);
+        ddenyq();
+        const int hs1 = m_size/2+1;
+        const double *const rp = m_dpacked->realp;
+        const double *const ip = m_dpacked->imagp;
+        for (int i = 0; i < hs1; ++i) {
+            const double p = (rp[i] * rp[i] + ip[i] * ip[i]) * 0.25;
+            logOut[i] = fastLog(clampPower(p, floor)) * scale;
+        }
+    }
 
-//#define FFTW_DOUBLE_ONLY 1
-//#define FFTW_SINGLE_ONLY 1
+    void forwardLogPower(const float *BQ_R__ realIn, float *BQ_R__ logOut, float floor, float scale) {
+        if (!m_fspec) initFloat();
+        packReal(realIn);
+        vDSP_fft_zript(m_fspec, m_fpacked, 1, m_fbuf, m_order, FFT_FORWARD);
+        fdenyq();
+        const int hs1 = m_size/2+1;
+        const float *const rp = m_fpacked->realp;
+        const float *const ip = m_fpacked->imagp;
+        for (int i = 0; i < hs1; ++i) {
+            const float p = (rp[i] * rp[i] + ip[i] * ip[i]) * 0.25f;
+            logOut[i] = fastLog(clampPower(p, floor)) * scale;
+        }
+    }
 
-#if defined(FFTW_DOUBLE_ONLY) && defined(FFTW_SINGLE_ONLY)
-// Can't meaningfully define both
-#error Can only define one of FFTW_DOUBLE_ONLY and FFTW_SINGLE_ONLY
-#endif
+    // Everything stays in vDSP's packed format, as for the products
+    // below: the log magnitude spectrum is real, so its imaginary
+    // parts are zero except for bin 0, whose imaginary part is the
+    // Nyquist value. Both forward transforms are scaled 2x.
 
-#if defined(FFTW_FLOAT_ONLY)
+    void cepstralEnvelope(const double *BQ_R__ frame, int cutoff, double *BQ_R__ envOut) {
+        if (!m_dspec) initDouble();
+        const int hs = m_size/2;
+        packReal(frame);
+        vDSP_fft_zriptD(m_dspec, m_dpacked, 1, m_dbuf, m_order, FFT_FORWARD);
+        double *const BQ_R__ rp = m_dpacked->realp;
+        double *const BQ_R__ ip = m_dpacked->imagp;
+        rp[0] = fastLog(std::fabs(rp[0]) * 0.5 + 0.000001);
+        ip[0] = fastLog(std::fabs(ip[0]) * 0.5 + 0.000001);
+        for (int i = 1; i < hs; ++i) {
+            const double mag = std::sqrt(rp[i] * rp[i] + ip[i] * ip[i]) * 0.5;
+            rp[i] = fastLog(mag + 0.000001);
+            ip[i] = 0.0;
+        }
+        vDSP_fft_zriptD(m_dspec, m_dpacked, 1, m_dbuf, m_order, FFT_INVERSE);
+        // The cepstrum is split, even quefrencies in realp and odd
+        // in imagp
+        const int k = (cutoff < hs ? cutoff : hs);
+        const double scale = 1.0 / m_size;
+        for (int i = 0; i < hs; ++i) {
+            const int e = i * 2, o = i * 2 + 1;
+            rp[i] = (e <= k || e >= m_size - k) ? rp[i] * scale : 0.0;
+            ip[i] = (o <= k || o >= m_size - k) ? ip[i] * scale : 0.0;
+        }
+        vDSP_fft_zriptD(m_dspec, m_dpacked, 1, m_dbuf, m_order, FFT_FORWARD);
+        for (int i = 0; i < hs; ++i) envOut[i] = std::exp(rp[i] * 0.5);
+        envOut[hs] = std::exp(ip[0] * 0.5);
+    }
+
+    void cepstralEnvelope(const float *BQ_R__ frame, int cutoff, float *BQ_R__ envOut) {
+        if (!m_fspec) initFloat();
+        const int hs = m_size/2;
+        packReal(frame);
+        vDSP_fft_zript(m_fspec, m_fpacked, 1, m_fbuf, m_order, FFT_FORWARD);
+        float *const BQ_R__ rp = m_fpacked->realp;
+        float *const BQ_R__ ip = m_fpacked->imagp;
+        rp[0] = fastLog(std::fabs(rp[0]) * 0.5f + 0.000001f);
+        ip[0] = fastLog(std::fabs(ip[0]) * 0.5f + 0.000001f);
+        for (int i = 1; i < hs; ++i) {
+            const float mag = std::sqrt(rp[i] * rp[i] + ip[i] * ip[i]) * 0.5f;
+            rp[i] = fastLog(mag + 0.000001f);
+            ip[i] = 0.f;
+        }
+        vDSP_fft_zript(m_fspec, m_fpacked, 1, m_fbuf, m_order, FFT_INVERSE);
+        // The cepstrum is split, even quefrencies in realp and odd
+        // in imagp
+        const int k = (cutoff < hs ? cutoff : hs);
+        const float scale = float(1.0 / m_size);
+        for (int i = 0; i < hs; ++i) {
+            const int e = i * 2, o = i * 2 + 1;
+            rp[i] = (e <= k || e >= m_size - k) ? rp[i] * scale : 0.f;
+            ip[i] = (o <= k || o >= m_size - k) ? ip[i] * scale : 0.f;
+        }
+        vDSP_fft_zript(m_fspec, m_fpacked, 1, m_fbuf, m_order, FFT_FORWARD);
+        for (int i = 0; i < hs; ++i) envOut[i] = std::exp(rp[i] * 0.5f);
+        envOut[hs] = std::exp(ip[0] * 0.5f);
+    }
+
+    // vDSP forward FFTs are scaled 2x, hence the 0.5
+
+    void forwardBins(const double *BQ_R__ realIn, int first, int last, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        if (!m_dspec) initDouble();
+        packReal(realIn);
+        vDSP_fft_zriptD(m_dspec, m_dpacked, 1, m_dbuf, m_order, FFT_FORWARD);
+        ddenyq();
+        const double *const rp = m_dpacked->realp;
+        const double *const ip = m_dpacked->imagp;
+        for (int i = first; i < last; ++i) {
+            realOut[i - first] = rp[i] * 0.5;
+            imagOut[i - first] = ip[i] * 0.5;
+        }
+    }
+
+    void forwardBinsMagnitude(const double *BQ_R__ realIn, int first, int last, double *BQ_R__ magOut) {
+        if (!m_dspec) initDouble();
+        packReal(realIn);
+        vDSP_fft_zriptD(m_dspec, m_dpacked, 1, m_dbuf, m_order, FFT_FORWARD);
+        ddenyq();
+        const double *const rp = m_dpacked->realp;
+        const double *const ip = m_dpacked->imagp;
+        for (int i = first; i < last; ++i) {
+            magOut[i - first] = std::sqrt(rp[i] * rp[i] + ip[i] * ip[i]) * 0.5;
+        }
+    }
+
+    void forwardBins(const float *BQ_R__ realIn, int first, int last, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        if (!m_fspec) initFloat();
+        packReal(realIn);
+        vDSP_fft_zript(m_fspec, m_fpacked, 1, m_fbuf, m_order, FFT_FORWARD);
+        fdenyq();
+        const float *const rp = m_fpacked->realp;
+        const float *const ip = m_fpacked->imagp;
+        for (int i = first; i < last; ++i) {
+            realOut[i - first] = rp[i] * 0.5f;
+            imagOut[i - first] = ip[i] * 0.5f;
+        }
+    }
+
+    void forwardBinsMagnitude(const float *BQ_R__ realIn, int first, int last, float *BQ_R__ magOut) {
+        if (!m_fspec) initFloat();
+        packReal(realIn);
+        vDSP_fft_zript(m_fspec, m_fpacked, 1, m_fbuf, m_order, FFT_FORWARD);
+        fdenyq();
+        const float *const rp = m_fpacked->realp;
+        const float *const ip = m_fpacked->imagp;
+        for (int i = first; i < last; ++i) {
+            magOut[i - first] = std::sqrt(rp[i] * rp[i] + ip[i] * ip[i]) * 0.5f;
+        }
+    }
+
+    // The products are taken directly in vDSP's packed format, in
+    // which bin 0 holds the DC and Nyquist values as its real and
+    // imaginary parts, so no unpacking is needed in between. Both
+    // forward transforms are scaled 2x, hence the 0.25.
+
+    void correlate(const double *BQ_R__ a, const double *BQ_R__ b, double *BQ_R__ out, double scale) {
+        if (!m_dspec) initDouble();
+        const int hs = m_size/2;
+        packReal(b);
+        vDSP_fft_zriptD(m_dspec, m_dpacked, 1, m_dbuf, m_order, FFT_FORWARD);
+        v_copy(m_dspare, m_dpacked->realp, hs);
+        v_copy(m_dspare2, m_dpacked->imagp, hs);
+        packReal(a);
+        vDSP_fft_zriptD(m_dspec, m_dpacked, 1, m_dbuf, m_order, FFT_FORWARD);
+        double *const BQ_R__ rp = m_dpacked->realp;
+        double *const BQ_R__ ip = m_dpacked->imagp;
+        const double *const BQ_R__ br = m_dspare;
+        const double *const BQ_R__ bi = m_dspare2;
+        const double s = scale * 0.25;
+        rp[0] = rp[0] * br[0] * s;
+        ip[0] = ip[0] * bi[0] * s;
+        for (int i = 1; i < hs; ++i) {
+            const double re = rp[i], im = ip[i];
+            rp[i] = (re * br[i] + im * bi[i]) * s;
+            ip[i] = (im * br[i] - re * bi[i]) * s;
+        }
+        vDSP_fft_zriptD(m_dspec, m_dpacked, 1, m_dbuf, m_order, FFT_INVERSE);
+        unpackReal(out);
+    }
+
+    void autocorrelate(const double *BQ_R__ in, double *BQ_R__ out, double scale) {
+        if (!m_dspec) initDouble();
+        const int hs = m_size/2;
+        packReal(in);
+        vDSP_fft_zriptD(m_dspec, m_dpacked, 1, m_dbuf, m_order, FFT_FORWARD);
+        double *const BQ_R__ rp = m_dpacked->realp;
+        double *const BQ_R__ ip = m_dpacked->imagp;
+        const double s = scale * 0.25;
+        rp[0] = rp[0] * rp[0] * s;
+        ip[0] = ip[0] * ip[0] * s;
+        for (int i = 1; i < hs; ++i) {
+            rp[i] = (rp[i] * rp[i] + ip[i] * ip[i]) * s;
+        }
+        v_zero(ip + 1, hs - 1);
+        vDSP_fft_zriptD(m_dspec, m_dpacked, 1, m_dbuf, m_order, FFT_INVERSE);
+        unpackReal(out);
+    }
+
+    void correlate(const float *BQ_R__ a, const float *BQ_R__ b, float *BQ_R__ out, float scale) {
+        if (!m_fspec) initFloat();
+        const int hs = m_size/2;
+        packReal(b);
+        vDSP_fft_zript(m_fspec, m_fpacked, 1, m_fbuf, m_order, FFT_FORWARD);
+        v_copy(m_fspare, m_fpacked->realp, hs);
+        v_copy(m_fspare2, m_fpacked->imagp, hs);
+        packReal(a);
+        vDSP_fft_zript(m_fspec, m_fpacked, 1, m_fbuf, m_order, FFT_FORWARD);
+        float *const BQ_R__ rp = m_fpacked->realp;
+        float *const BQ_R__ ip = m_fpacked->imagp;
+        const float *const BQ_R__ br = m_fspare;
+        const float *const BQ_R__ bi = m_fspare2;
+        const float s = scale * 0.25f;
+        rp[0] = rp[0] * br[0] * s;
+        ip[0] = ip[0] * bi[0] * s;
+        for (int i = 1; i < hs; ++i) {
+            const float re = rp[i], im = ip[i];
+            rp[i] = (re * br[i] + im * bi[i]) * s;
+            ip[i] = (im * br[i] - re * bi[i]) * s;
+        }
+        vDSP_fft_zript(m_fspec, m_fpacked, 1, m_fbuf, m_order, FFT_INVERSE);
+        unpackReal(out);
+    }
+
+    void autocorrelate(const float *BQ_R__ in, float *BQ_R__ out, float scale) {
+        if (!m_fspec) initFloat();
+        const int hs = m_size/2;
+        packReal(in);
+        vDSP_fft_zript(m_fspec, m_fpacked, 1, m_fbuf, m_order, FFT_FORWARD);
+        float *const BQ_R__ rp = m_fpacked->realp;
+        float *const BQ_R__ ip = m_fpacked->imagp;
+        const float s = scale * 0.25f;
+        rp[0] = rp[0] * rp[0] * s;
+        ip[0] = ip[0] * ip[0] * s;
+        for (int i = 1; i < hs; ++i) {
+            rp[i] = (rp[i] * rp[i] + ip[i] * ip[i]) * s;
+        }
+        v_zero(ip + 1, hs - 1);
+        vDSP_fft_zript(m_fspec, m_fpacked, 1, m_fbuf, m_order, FFT_INVERSE);
+        unpackReal(out);
+    }
+
+private:
+    const int m_size;
+    int m_order;
+    FFTSetup m_fspec;
+    FFTSetupD m_dspec;
+    DSPSplitComplex *m_fbuf;
+    DSPDoubleSplitComplex *m_dbuf;
+    DSPSplitComplex *m_fpacked;
+    float *m_fspare;
+    float *m_fspare2;
+    DSPDoubleSplitComplex *m_dpacked;
+    double *m_dspare;
+    double *m_dspare2;
+};
+
+#endif /* HAVE_VDSP */
+
+#ifdef HAVE_FFTW3
+
+/*
+ Define FFTW_DOUBLE_ONLY to make all uses of FFTW functions be
+ double-precision (so "float" FFTs are calculated by casting to
+ doubles and using the double-precision FFTW function).
+
+ Define FFTW_SINGLE_ONLY to make all uses of FFTW functions be
+ single-precision (so "double" FFTs are calculated by casting to
+ floats and using the single-precision FFTW function).
+
+ Neither of these flags is desirable for either performance or
+ precision. The main reason to define either flag is to avoid linking
+ against both fftw3 and fftw3f libraries.
+*/
+
+//#define FFTW_DOUBLE_ONLY 1
+//#define FFTW_SINGLE_ONLY 1
+
+#if defined(FFTW_DOUBLE_ONLY) && defined(FFTW_SINGLE_ONLY)
+// Can't meaningfully define both
+#error Can only define one of FFTW_DOUBLE_ONLY and FFTW_SINGLE_ONLY
+#endif
+
+#if defined(FFTW_FLOAT_ONLY)
 #warning FFTW_FLOAT_ONLY is deprecated, use FFTW_SINGLE_ONLY instead
 #define FFTW_SINGLE_ONLY 1
 #endif
@@ -874,7 +1961,7 @@ class D_FFTW : public FFTImpl
 {
 public:
     D_FFTW(int size) :
-        m_fplanf(0), m_dplanf(0), m_size(size)
+        m_fplanf(0), m_dplanf(0), m_size(size), m_slowPathCount(0)
     {
     }
 
@@ -893,6 +1980,7 @@ public:
             fftwf_destroy_plan(m_fplani);
             fftwf_free(m_fbuf);
             fftwf_free(m_fpacked);
+            fftwf_free(m_fcorr);
             unlock();
         }
         if (m_dplanf) {
@@ -909,6 +1997,7 @@ public:
             fftw_destroy_plan(m_dplani);
             fftw_free(m_dbuf);
             fftw_free(m_dpacked);
+            fftw_free(m_dcorr);
             unlock();
         }
         lock();
@@ -940,8 +2029,20 @@ public:
 #endif
     }
 
+    int getPreferredAlignment() const {
+        // Anything at least as aligned as fftw_malloc's allocations
+        // (up to AVX-512 width) lets us use the new-array execute
+        // functions directly on the caller's buffers
+        return 64;
+    }
+
+    int getSlowPathCount() const {
+        return m_slowPathCount;
+    }
+
     void initFloat() {
         if (m_fplanf) return;
+        FFT_PROBE3(plan__create, m_size, 32, "fftw");
         bool load = false;
         lock();
         if (m_extantf++ == 0) load = true;
@@ -956,6 +2057,8 @@ public:
         m_fbuf = (fft_float_type *)fftw_malloc(m_size * sizeof(fft_float_type));
         m_fpacked = (fftwf_complex *)fftw_malloc
             ((m_size/2 + 1) * sizeof(fftwf_complex));
+        m_fcorr = (fftwf_complex *)fftw_malloc
+            ((m_size/2 + 1) * sizeof(fftwf_complex));
 #ifdef USE_FFTW_WISDOM
         m_fplanf = fftwf_plan_dft_r2c_1d
             (m_size, m_fbuf, m_fpacked, FFTW_MEASURE);
@@ -972,6 +2075,7 @@ public:
 
     void initDouble() {
         if (m_dplanf) return;
+        FFT_PROBE3(plan__create, m_size, 64, "fftw");
         bool load = false;
         lock();
         if (m_extantd++ == 0) load = true;
@@ -986,6 +2090,8 @@ public:
         m_dbuf = (fft_double_type *)fftw_malloc(m_size * sizeof(fft_double_type));
         m_dpacked = (fftw_complex *)fftw_malloc
             ((m_size/2 + 1) * sizeof(fftw_complex));
+        m_dcorr = (fftw_complex *)fftw_malloc
+            ((m_size/2 + 1) * sizeof(fftw_complex));
 #ifdef USE_FFTW_WISDOM
         m_dplanf = fftw_plan_dft_r2c_1d
             (m_size, m_dbuf, m_dpacked, FFTW_MEASURE);
@@ -1116,118 +2222,179 @@ public:
         }
     }        
 
-    void forward(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
-        if (!m_dplanf) initDouble();
-        const int sz = m_size;
+    // Run the forward plan on realIn, leaving the result in
+    // m_dpacked. The caller's buffer is used directly if it is
+    // suitably aligned and needs no shaping, otherwise it is copied
+    // (and shaped) into m_dbuf first.
+    void executeForward(const double *BQ_R__ realIn) {
         fft_double_type *const BQ_R__ dbuf = m_dbuf;
+        if (isShapingInput()) {
+            shapeInput(dbuf, realIn, m_size);
+            fftw_execute(m_dplanf);
+            return;
+        }
 #ifndef FFTW_SINGLE_ONLY
-        if (realIn != dbuf) 
+        if (realIn == dbuf) {
+            fftw_execute(m_dplanf);
+            return;
+        }
+        // r2c plans preserve their input, so this is safe for const data
+        double *in = const_cast<double *>(realIn);
+        if (fftw_alignment_of(in) == 0) {
+            fftw_execute_dft_r2c(m_dplanf, in, m_dpacked);
+            return;
+        }
+        ++m_slowPathCount;
 #endif
-            for (int i = 0; i < sz; ++i) {
-                dbuf[i] = realIn[i];
-            }
+        const int sz = m_size;
+        for (int i = 0; i < sz; ++i) {
+            dbuf[i] = realIn[i];
+        }
         fftw_execute(m_dplanf);
-        unpackDouble(realOut, imagOut);
     }
 
-    void forwardInterleaved(const double *BQ_R__ realIn, double *BQ_R__ complexOut) {
-        if (!m_dplanf) initDouble();
-        const int sz = m_size;
+    // Run the inverse plan from m_dpacked (which is destroyed) into
+    // realOut, writing to it directly if it is suitably aligned and
+    // needs no shaping, otherwise copying (and shaping) out from
+    // m_dbuf.
+    void executeInverse(double *BQ_R__ realOut) {
         fft_double_type *const BQ_R__ dbuf = m_dbuf;
+        if (isShapingOutput()) {
+            fftw_execute(m_dplani);
+            shapeOutput(realOut, dbuf, m_size);
+            return;
+        }
 #ifndef FFTW_SINGLE_ONLY
-        if (realIn != dbuf) 
+        if (realOut == dbuf) {
+            fftw_execute(m_dplani);
+            return;
+        }
+        if (fftw_alignment_of(realOut) == 0) {
+            fftw_execute_dft_c2r(m_dplani, m_dpacked, realOut);
+            return;
+        }
+        ++m_slowPathCount;
 #endif
-            for (int i = 0; i < sz; ++i) {
-                dbuf[i] = realIn[i];
-            }
-        fftw_execute(m_dplanf);
-        v_convert(complexOut, (const fft_double_type *)m_dpacked, sz + 2);
+        fftw_execute(m_dplani);
+        const int sz = m_size;
+        for (int i = 0; i < sz; ++i) {
+            realOut[i] = dbuf[i];
+        }
     }
 
-    void forwardPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut) {
-        if (!m_dplanf) initDouble();
-        fft_double_type *const BQ_R__ dbuf = m_dbuf;
+    void executeForward(const float *BQ_R__ realIn) {
+        fft_float_type *const BQ_R__ fbuf = m_fbuf;
+        if (isShapingInput()) {
+            shapeInput(fbuf, realIn, m_size);
+            fftwf_execute(m_fplanf);
+            return;
+        }
+#ifndef FFTW_DOUBLE_ONLY
+        if (realIn == fbuf) {
+            fftwf_execute(m_fplanf);
+            return;
+        }
+        float *in = const_cast<float *>(realIn);
+        if (fftwf_alignment_of(in) == 0) {
+            fftwf_execute_dft_r2c(m_fplanf, in, m_fpacked);
+            return;
+        }
+        ++m_slowPathCount;
+#endif
         const int sz = m_size;
-#ifndef FFTW_SINGLE_ONLY
-        if (realIn != dbuf)
+        for (int i = 0; i < sz; ++i) {
+            fbuf[i] = realIn[i];
+        }
+        fftwf_execute(m_fplanf);
+    }
+
+    void executeInverse(float *BQ_R__ realOut) {
+        fft_float_type *const BQ_R__ fbuf = m_fbuf;
+        if (isShapingOutput()) {
+            fftwf_execute(m_fplani);
+            shapeOutput(realOut, fbuf, m_size);
+            return;
+        }
+#ifndef FFTW_DOUBLE_ONLY
+        if (realOut == fbuf) {
+            fftwf_execute(m_fplani);
+            return;
+        }
+        if (fftwf_alignment_of(realOut) == 0) {
+            fftwf_execute_dft_c2r(m_fplani, m_fpacked, realOut);
+            return;
+        }
+        ++m_slowPathCount;
 #endif
-            for (int i = 0; i < sz; ++i) {
-                dbuf[i] = realIn[i];
-            }
-        fftw_execute(m_dplanf);
-        v_cartesian_interleaved_to_polar
-            (magOut, phaseOut, (const fft_double_type *)m_dpacked, m_size/2+1);
+        fftwf_execute(m_fplani);
+        const int sz = m_size;
+        for (int i = 0; i < sz; ++i) {
+            realOut[i] = fbuf[i];
+        }
+    }
+
+    void forward(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        if (!m_dplanf) initDouble();
+        executeForward(realIn);
+        unpackDouble(realOut, imagOut);
+    }
+
+    void forwardInterleaved(const double *BQ_R__ realIn, double *BQ_R__ complexOut) {
+        if (!m_dplanf) initDouble();
+        executeForward(realIn);
+        v_convert(complexOut, (const fft_double_type *)m_dpacked, m_size + 2);
+    }
+
+    void forwardPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut) {
+        if (!m_dplanf) initDouble();
+        executeForward(realIn);
+        if (isFastPolar()) {
+            interleavedToPolarFast
+                (magOut, phaseOut, (const fft_double_type *)m_dpacked,
+                 m_size/2+1);
+        } else {
+            v_cartesian_interleaved_to_polar
+                (magOut, phaseOut, (const fft_double_type *)m_dpacked,
+                 m_size/2+1);
+        }
     }
 
     void forwardMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut) {
         if (!m_dplanf) initDouble();
-        fft_double_type *const BQ_R__ dbuf = m_dbuf;
-        const int sz = m_size;
-#ifndef FFTW_SINGLE_ONLY
-        if (realIn != m_dbuf)
-#endif
-            for (int i = 0; i < sz; ++i) {
-                dbuf[i] = realIn[i];
-            }
-        fftw_execute(m_dplanf);
+        executeForward(realIn);
         v_cartesian_interleaved_to_magnitudes
             (magOut, (const fft_double_type *)m_dpacked, m_size/2+1);
     }
 
     void forward(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
         if (!m_fplanf) initFloat();
-        fft_float_type *const BQ_R__ fbuf = m_fbuf;
-        const int sz = m_size;
-#ifndef FFTW_DOUBLE_ONLY
-        if (realIn != fbuf)
-#endif
-            for (int i = 0; i < sz; ++i) {
-                fbuf[i] = realIn[i];
-            }
-        fftwf_execute(m_fplanf);
+        executeForward(realIn);
         unpackFloat(realOut, imagOut);
     }
 
     void forwardInterleaved(const float *BQ_R__ realIn, float *BQ_R__ complexOut) {
         if (!m_fplanf) initFloat();
-        fft_float_type *const BQ_R__ fbuf = m_fbuf;
-        const int sz = m_size;
-#ifndef FFTW_DOUBLE_ONLY
-        if (realIn != fbuf)
-#endif
-            for (int i = 0; i < sz; ++i) {
-                fbuf[i] = realIn[i];
-            }
-        fftwf_execute(m_fplanf);
-        v_convert(complexOut, (const fft_float_type *)m_fpacked, sz + 2);
+        executeForward(realIn);
+        v_convert(complexOut, (const fft_float_type *)m_fpacked, m_size + 2);
     }
 
     void forwardPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut) {
         if (!m_fplanf) initFloat();
-        fft_float_type *const BQ_R__ fbuf = m_fbuf;
-        const int sz = m_size;
-#ifndef FFTW_DOUBLE_ONLY
-        if (realIn != fbuf) 
-#endif
-            for (int i = 0; i < sz; ++i) {
-                fbuf[i] = realIn[i];
-            }
-        fftwf_execute(m_fplanf);
-        v_cartesian_interleaved_to_polar
-            (magOut, phaseOut, (const fft_float_type *)m_fpacked, m_size/2+1);
+        executeForward(realIn);
+        if (isFastPolar()) {
+            interleavedToPolarFast
+                (magOut, phaseOut, (const fft_float_type *)m_fpacked,
+                 m_size/2+1);
+        } else {
+            v_cartesian_interleaved_to_polar
+                (magOut, phaseOut, (const fft_float_type *)m_fpacked,
+                 m_size/2+1);
+        }
     }
 
     void forwardMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut) {
         if (!m_fplanf) initFloat();
-        fft_float_type *const BQ_R__ fbuf = m_fbuf;
-        const int sz = m_size;
-#ifndef FFTW_DOUBLE_ONLY
-        if (realIn != fbuf)
-#endif
-            for (int i = 0; i < sz; ++i) {
-                fbuf[i] = realIn[i];
-            }
-        fftwf_execute(m_fplanf);
+        executeForward(realIn);
         v_cartesian_interleaved_to_magnitudes
             (magOut, (const fft_float_type *)m_fpacked, m_size/2+1);
     }
@@ -1235,129 +2402,220 @@ public:
     void inverse(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut) {
         if (!m_dplanf) initDouble();
         packDouble(realIn, imagIn);
-        fftw_execute(m_dplani);
-        const int sz = m_size;
-        fft_double_type *const BQ_R__ dbuf = m_dbuf;
-#ifndef FFTW_SINGLE_ONLY
-        if (realOut != dbuf) 
-#endif
-            for (int i = 0; i < sz; ++i) {
-                realOut[i] = dbuf[i];
-            }
+        executeInverse(realOut);
     }
 
     void inverseInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ realOut) {
         if (!m_dplanf) initDouble();
         v_convert((fft_double_type *)m_dpacked, complexIn, m_size + 2);
-        fftw_execute(m_dplani);
-        const int sz = m_size;
-        fft_double_type *const BQ_R__ dbuf = m_dbuf;
-#ifndef FFTW_SINGLE_ONLY
-        if (realOut != dbuf) 
-#endif
-            for (int i = 0; i < sz; ++i) {
-                realOut[i] = dbuf[i];
-            }
+        executeInverse(realOut);
     }
 
     void inversePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, double *BQ_R__ realOut) {
         if (!m_dplanf) initDouble();
-        v_polar_to_cartesian_interleaved
-            ((fft_double_type *)m_dpacked, magIn, phaseIn, m_size/2+1);
-        fftw_execute(m_dplani);
-        const int sz = m_size;
-        fft_double_type *const BQ_R__ dbuf = m_dbuf;
-#ifndef FFTW_SINGLE_ONLY
-        if (realOut != dbuf)
-#endif
-            for (int i = 0; i < sz; ++i) {
-                realOut[i] = dbuf[i];
-            }
+        if (isFastPolar()) {
+            polarToInterleavedFast
+                ((fft_double_type *)m_dpacked, magIn, phaseIn, m_size/2+1);
+        } else {
+            v_polar_to_cartesian_interleaved
+                ((fft_double_type *)m_dpacked, magIn, phaseIn, m_size/2+1);
+        }
+        executeInverse(realOut);
     }
 
     void inverseCepstral(const double *BQ_R__ magIn, double *BQ_R__ cepOut) {
         if (!m_dplanf) initDouble();
-        fft_double_type *const BQ_R__ dbuf = m_dbuf;
-        fftw_complex *const BQ_R__ dpacked = m_dpacked;
-        const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) {
-            dpacked[i][0] = log(magIn[i] + 0.000001);
-        }
-        for (int i = 0; i <= hs; ++i) {
-            dpacked[i][1] = 0.0;
-        }
-        fftw_execute(m_dplani);
-        const int sz = m_size;
-#ifndef FFTW_SINGLE_ONLY
-        if (cepOut != dbuf)
-#endif
-            for (int i = 0; i < sz; ++i) {
-                cepOut[i] = dbuf[i];
-            }
+        magnitudeToLogInterleaved((fft_double_type *)m_dpacked, magIn,
+                                  m_size/2+1);
+        executeInverse(cepOut);
     }
 
     void inverse(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut) {
         if (!m_fplanf) initFloat();
         packFloat(realIn, imagIn);
-        fftwf_execute(m_fplani);
-        const int sz = m_size;
-        fft_float_type *const BQ_R__ fbuf = m_fbuf;
-#ifndef FFTW_DOUBLE_ONLY
-        if (realOut != fbuf)
-#endif
-            for (int i = 0; i < sz; ++i) {
-                realOut[i] = fbuf[i];
-            }
+        executeInverse(realOut);
     }
 
     void inverseInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ realOut) {
         if (!m_fplanf) initFloat();
         v_convert((fft_float_type *)m_fpacked, complexIn, m_size + 2);
-        fftwf_execute(m_fplani);
-        const int sz = m_size;
-        fft_float_type *const BQ_R__ fbuf = m_fbuf;
-#ifndef FFTW_DOUBLE_ONLY
-        if (realOut != fbuf)
-#endif
-            for (int i = 0; i < sz; ++i) {
-                realOut[i] = fbuf[i];
-            }
+        executeInverse(realOut);
     }
 
     void inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut) {
         if (!m_fplanf) initFloat();
-        v_polar_to_cartesian_interleaved
-            ((fft_float_type *)m_fpacked, magIn, phaseIn, m_size/2+1);
-        fftwf_execute(m_fplani);
-        const int sz = m_size;
-        fft_float_type *const BQ_R__ fbuf = m_fbuf;
-#ifndef FFTW_DOUBLE_ONLY
-        if (realOut != fbuf)
-#endif
-            for (int i = 0; i < sz; ++i) {
-                realOut[i] = fbuf[i];
-            }
+        if (isFastPolar()) {
+            polarToInterleavedFast
+                ((fft_float_type *)m_fpacked, magIn, phaseIn, m_size/2+1);
+        } else {
+            v_polar_to_cartesian_interleaved
+                ((fft_float_type *)m_fpacked, magIn, phaseIn, m_size/2+1);
+        }
+        executeInverse(realOut);
     }
 
     void inverseCepstral(const float *BQ_R__ magIn, float *BQ_R__ cepOut) {
+        if (!m_fplanf) initFloat();
+        magnitudeToLogInterleaved((fft_float_type *)m_fpacked, magIn,
+                                  m_size/2+1);
+        executeInverse(cepOut);
+    }
+
+    void forwardPower(const double *BQ_R__ realIn, double *BQ_R__ powerOut) {
+        if (!m_dplanf) initDouble();
+        executeForward(realIn);
+        interleavedToPower(powerOut, (const fft_double_type *)m_dpacked,
+                           m_size/2+1);
+    }
+
+    void inversePower(const double *BQ_R__ powerIn, double *BQ_R__ realOut) {
+        if (!m_dplanf) initDouble();
+        const int hs = m_size/2;
+        fftw_complex *const BQ_R__ dpacked = m_dpacked;
+        for (int i = 0; i <= hs; ++i) {
+            dpacked[i][0] = powerIn[i];
+        }
+        for (int i = 0; i <= hs; ++i) {
+            dpacked[i][1] = 0.0;
+        }
+        executeInverse(realOut);
+    }
+
+    void forwardPower(const float *BQ_R__ realIn, float *BQ_R__ powerOut) {
+        if (!m_fplanf) initFloat();
+        executeForward(realIn);
+        interleavedToPower(powerOut, (const fft_float_type *)m_fpacked,
+                           m_size/2+1);
+    }
+
+    void inversePower(const float *BQ_R__ powerIn, float *BQ_R__ realOut) {
         if (!m_fplanf) initFloat();
         const int hs = m_size/2;
         fftwf_complex *const BQ_R__ fpacked = m_fpacked;
         for (int i = 0; i <= hs; ++i) {
-            fpacked[i][0] = logf(magIn[i] + 0.000001f);
+            fpacked[i][0] = powerIn[i];
         }
         for (int i = 0; i <= hs; ++i) {
             fpacked[i][1] = 0.f;
         }
+        executeInverse(realOut);
+    }
+
+    void forwardLogPower(const double *BQ_R__ realIn, double *BQ_R__ logOut, double floor, double scale) {
+        if (!m_dplanf) initDouble();
+        executeForward(realIn);
+        interleavedToLogPower(logOut, (const fft_double_type *)m_dpacked,
+                              m_size/2+1, floor, scale);
+    }
+
+    void forwardLogPower(const float *BQ_R__ realIn, float *BQ_R__ logOut, float floor, float scale) {
+        if (!m_fplanf) initFloat();
+        executeForward(realIn);
+        interleavedToLogPower(logOut, (const fft_float_type *)m_fpacked,
+                              m_size/2+1, floor, scale);
+    }
+
+    // The cepstrum passes through m_dbuf or m_fbuf between the
+    // inverse and second forward plans, without leaving the object
+
+    void cepstralEnvelope(const double *BQ_R__ frame, int cutoff, double *BQ_R__ envOut) {
+        if (!m_dplanf) initDouble();
+        executeForward(frame);
+        logMagnitudeInPlace((fft_double_type *)m_dpacked, m_size/2+1);
+        fftw_execute(m_dplani);
+        lifter(m_dbuf, m_size, cutoff);
+        fftw_execute(m_dplanf);
+        interleavedRealToExp(envOut, (const fft_double_type *)m_dpacked,
+                             m_size/2+1);
+    }
+
+    void cepstralEnvelope(const float *BQ_R__ frame, int cutoff, float *BQ_R__ envOut) {
+        if (!m_fplanf) initFloat();
+        executeForward(frame);
+        logMagnitudeInPlace((fft_float_type *)m_fpacked, m_size/2+1);
         fftwf_execute(m_fplani);
-        const int sz = m_size;
-        fft_float_type *const BQ_R__ fbuf = m_fbuf;
-#ifndef FFTW_DOUBLE_ONLY
-        if (cepOut != fbuf)
-#endif
-            for (int i = 0; i < sz; ++i) {
-                cepOut[i] = fbuf[i];
-            }
+        lifter(m_fbuf, m_size, cutoff);
+        fftwf_execute(m_fplanf);
+        interleavedRealToExp(envOut, (const fft_float_type *)m_fpacked,
+                             m_size/2+1);
+    }
+
+    void forwardBins(const double *BQ_R__ realIn, int first, int last, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        if (!m_dplanf) initDouble();
+        executeForward(realIn);
+        interleavedBinsToSplit(realOut, imagOut,
+                               (const fft_double_type *)m_dpacked,
+                               first, last);
+    }
+
+    void forwardBinsMagnitude(const double *BQ_R__ realIn, int first, int last, double *BQ_R__ magOut) {
+        if (!m_dplanf) initDouble();
+        executeForward(realIn);
+        interleavedBinsToMagnitudes(magOut,
+                                    (const fft_double_type *)m_dpacked,
+                                    first, last);
+    }
+
+    void forwardBins(const float *BQ_R__ realIn, int first, int last, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        if (!m_fplanf) initFloat();
+        executeForward(realIn);
+        interleavedBinsToSplit(realOut, imagOut,
+                               (const fft_float_type *)m_fpacked,
+                               first, last);
+    }
+
+    void forwardBinsMagnitude(const float *BQ_R__ realIn, int first, int last, float *BQ_R__ magOut) {
+        if (!m_fplanf) initFloat();
+        executeForward(realIn);
+        interleavedBinsToMagnitudes(magOut,
+                                    (const fft_float_type *)m_fpacked,
+                                    first, last);
+    }
+
+    // The products are taken in place in m_dpacked or m_fpacked
+    // between the forward and inverse plans, with the spectrum of b
+    // set aside in m_dcorr or m_fcorr
+
+    void correlate(const double *BQ_R__ a, const double *BQ_R__ b, double *BQ_R__ out, double scale) {
+        if (!m_dplanf) initDouble();
+        const int hs1 = m_size/2 + 1;
+        executeForward(b);
+        v_copy((fft_double_type *)m_dcorr,
+               (const fft_double_type *)m_dpacked, hs1 * 2);
+        executeForward(a);
+        conjugateMultiply((fft_double_type *)m_dpacked,
+                          (const fft_double_type *)m_dcorr, hs1,
+                          fft_double_type(scale));
+        executeInverse(out);
+    }
+
+    void autocorrelate(const double *BQ_R__ in, double *BQ_R__ out, double scale) {
+        if (!m_dplanf) initDouble();
+        executeForward(in);
+        conjugateSquare((fft_double_type *)m_dpacked, m_size/2 + 1,
+                        fft_double_type(scale));
+        executeInverse(out);
+    }
+
+    void correlate(const float *BQ_R__ a, const float *BQ_R__ b, float *BQ_R__ out, float scale) {
+        if (!m_fplanf) initFloat();
+        const int hs1 = m_size/2 + 1;
+        executeForward(b);
+        v_copy((fft_float_type *)m_fcorr,
+               (const fft_float_type *)m_fpacked, hs1 * 2);
+        executeForward(a);
+        conjugateMultiply((fft_float_type *)m_fpacked,
+                          (const fft_float_type *)m_fcorr, hs1,
+                          fft_float_type(scale));
+        executeInverse(out);
+    }
+
+    void autocorrelate(const float *BQ_R__ in, float *BQ_R__ out, float scale) {
+        if (!m_fplanf) initFloat();
+        executeForward(in);
+        conjugateSquare((fft_float_type *)m_fpacked, m_size/2 + 1,
+                        fft_float_type(scale));
+        executeInverse(out);
     }
 
 private:
@@ -1369,6 +2627,7 @@ private:
     float *m_fbuf;
 #endif
     fftwf_complex *m_fpacked;
+    fftwf_complex *m_fcorr;
     fftw_plan m_dplanf;
     fftw_plan m_dplani;
 #ifdef FFTW_SINGLE_ONLY
@@ -1377,7 +2636,9 @@ private:
     double *m_dbuf;
 #endif
     fftw_complex *m_dpacked;
+    fftw_complex *m_dcorr;
     const int m_size;
+    int m_slowPathCount;
     static int m_extantf;
     static int m_extantd;
 #ifdef NO_THREADING
@@ -1456,9 +2717,9 @@ class D_SLEEF : public FFTImpl
     
 public:
     D_SLEEF(int size) :
-        m_fplanf(0), m_fplani(0), m_fbuf(0), m_fpacked(0),
-        m_dplanf(0), m_dplani(0), m_dbuf(0), m_dpacked(0),
-        m_size(size)
+        m_fplanf(0), m_fplani(0), m_fbuf(0), m_fpacked(0), m_fcorr(0),
+        m_dplanf(0), m_dplani(0), m_dbuf(0), m_dpacked(0), m_dcorr(0),
+        m_size(size), m_slowPathCount(0)
     {
     }
 
@@ -1468,12 +2729,14 @@ public:
             SleefDFT_dispose(m_fplani);
             Sleef_free(m_fbuf);
             Sleef_free(m_fpacked);
+            Sleef_free(m_fcorr);
         }
         if (m_dplanf) {
             SleefDFT_dispose(m_dplanf);
             SleefDFT_dispose(m_dplani);
             Sleef_free(m_dbuf);
             Sleef_free(m_dpacked);
+            Sleef_free(m_dcorr);
         }
     }
 
@@ -1486,13 +2749,24 @@ public:
         return FFT::SinglePrecision | FFT::DoublePrecision;
     }
 
+    int getPreferredAlignment() const {
+        return 64; // see isAligned
+    }
+
+    int getSlowPathCount() const {
+        return m_slowPathCount;
+    }
+
     void initFloat() {
         if (m_fplanf) return;
+        FFT_PROBE3(plan__create, m_size, 32, "sleef");
 
         m_fbuf = static_cast<float *>
             (Sleef_malloc(m_size * sizeof(float)));
         m_fpacked = static_cast<float *>
             (Sleef_malloc((m_size + 2) * sizeof(float)));
+        m_fcorr = static_cast<float *>
+            (Sleef_malloc((m_size + 2) * sizeof(float)));
 
         m_fplanf = SleefDFT_float_init1d
             (m_size, m_fbuf, m_fpacked,
@@ -1505,11 +2779,14 @@ public:
 
     void initDouble() {
         if (m_dplanf) return;
+        FFT_PROBE3(plan__create, m_size, 64, "sleef");
 
         m_dbuf = static_cast<double *>
             (Sleef_malloc(m_size * sizeof(double)));
         m_dpacked = static_cast<double *>
             (Sleef_malloc((m_size + 2) * sizeof(double)));
+        m_dcorr = static_cast<double *>
+            (Sleef_malloc((m_size + 2) * sizeof(double)));
 
         m_dplanf = SleefDFT_double_init1d
             (m_size, m_dbuf, m_dpacked,
@@ -1540,12 +2817,75 @@ public:
         v_deinterleave(dst, m_dpacked, 2, m_size/2 + 1);
     }        
 
+    // Copy the caller's input into our aligned buffer, applying any
+    // shaping; without shaping, this is only needed for misaligned
+    // input
+    template <typename T>
+    void load(T *BQ_R__ buf, const T *BQ_R__ realIn) {
+        if (isShapingInput()) {
+            shapeInput(buf, realIn, m_size);
+        } else {
+            ++m_slowPathCount;
+            v_copy(buf, realIn, m_size);
+        }
+    }
+
+    template <typename T>
+    void store(T *BQ_R__ realOut, const T *BQ_R__ buf) {
+        if (isShapingOutput()) {
+            shapeOutput(realOut, buf, m_size);
+        } else {
+            ++m_slowPathCount;
+            v_copy(realOut, buf, m_size);
+        }
+    }
+
+    // Forward transform into the given packed buffer, and inverse
+    // from the usual one, as used by correlate and autocorrelate
+    // which take their products between the two
+
+    void executeForward(const double *BQ_R__ realIn, double *BQ_R__ packed) {
+        if (!isShapingInput() && isAligned(realIn)) {
+            SleefDFT_double_execute(m_dplanf, realIn, packed);
+        } else {
+            load(m_dbuf, realIn);
+            SleefDFT_double_execute(m_dplanf, 0, packed);
+        }
+    }
+
+    void executeInverse(double *BQ_R__ realOut) {
+        if (!isShapingOutput() && isAligned(realOut)) {
+            SleefDFT_double_execute(m_dplani, 0, realOut);
+        } else {
+            SleefDFT_double_execute(m_dplani, 0, 0);
+            store(realOut, m_dbuf);
+        }
+    }
+
+    void executeForward(const float *BQ_R__ realIn, float *BQ_R__ packed) {
+        if (!isShapingInput() && isAligned(realIn)) {
+            SleefDFT_float_execute(m_fplanf, realIn, packed);
+        } else {
+            load(m_fbuf, realIn);
+            SleefDFT_float_execute(m_fplanf, 0, packed);
+        }
+    }
+
+    void executeInverse(float *BQ_R__ realOut) {
+        if (!isShapingOutput() && isAligned(realOut)) {
+            SleefDFT_float_execute(m_fplani, 0, realOut);
+        } else {
+            SleefDFT_float_execute(m_fplani, 0, 0);
+            store(realOut, m_fbuf);
+        }
+    }
+
     void forward(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
         if (!m_dplanf) initDouble();
-        if (isAligned(realIn)) {
+        if (!isShapingInput() && isAligned(realIn)) {
             SleefDFT_double_execute(m_dplanf, realIn, 0);
         } else {
-            v_copy(m_dbuf, realIn, m_size);
+            load(m_dbuf, realIn);
             SleefDFT_double_execute(m_dplanf, 0, 0);
         }
         unpackDouble(realOut, imagOut);
@@ -1553,10 +2893,10 @@ public:
 
     void forwardInterleaved(const double *BQ_R__ realIn, double *BQ_R__ complexOut) {
         if (!m_dplanf) initDouble();
-        if (isAligned(realIn) && isAligned(complexOut)) {
+        if (!isShapingInput() && isAligned(realIn) && isAligned(complexOut)) {
             SleefDFT_double_execute(m_dplanf, realIn, complexOut);
         } else {
-            v_copy(m_dbuf, realIn, m_size);
+            load(m_dbuf, realIn);
             SleefDFT_double_execute(m_dplanf, 0, 0);
             v_copy(complexOut, m_dpacked, m_size + 2);
         }
@@ -1564,21 +2904,26 @@ public:
 
     void forwardPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut) {
         if (!m_dplanf) initDouble();
-        if (isAligned(realIn)) {
+        if (!isShapingInput() && isAligned(realIn)) {
             SleefDFT_double_execute(m_dplanf, realIn, 0);
         } else {
-            v_copy(m_dbuf, realIn, m_size);
+            load(m_dbuf, realIn);
             SleefDFT_double_execute(m_dplanf, 0, 0);
         }
-        v_cartesian_interleaved_to_polar(magOut, phaseOut, m_dpacked, m_size/2+1);
+        if (isFastPolar()) {
+            interleavedToPolarFast(magOut, phaseOut, m_dpacked, m_size/2+1);
+        } else {
+            v_cartesian_interleaved_to_polar
+                (magOut, phaseOut, m_dpacked, m_size/2+1);
+        }
     }
 
     void forwardMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut) {
         if (!m_dplanf) initDouble();
-        if (isAligned(realIn)) {
+        if (!isShapingInput() && isAligned(realIn)) {
             SleefDFT_double_execute(m_dplanf, realIn, 0);
         } else {
-            v_copy(m_dbuf, realIn, m_size);
+            load(m_dbuf, realIn);
             SleefDFT_double_execute(m_dplanf, 0, 0);
         }
         v_cartesian_interleaved_to_magnitudes(magOut, m_dpacked, m_size/2+1);
@@ -1586,10 +2931,10 @@ public:
 
     void forward(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
         if (!m_fplanf) initFloat();
-        if (isAligned(realIn)) {
+        if (!isShapingInput() && isAligned(realIn)) {
             SleefDFT_float_execute(m_fplanf, realIn, 0);
         } else {
-            v_copy(m_fbuf, realIn, m_size);
+            load(m_fbuf, realIn);
             SleefDFT_float_execute(m_fplanf, 0, 0);
         }
         unpackFloat(realOut, imagOut);
@@ -1597,10 +2942,10 @@ public:
 
     void forwardInterleaved(const float *BQ_R__ realIn, float *BQ_R__ complexOut) {
         if (!m_fplanf) initFloat();
-        if (isAligned(realIn) && isAligned(complexOut)) {
+        if (!isShapingInput() && isAligned(realIn) && isAligned(complexOut)) {
             SleefDFT_float_execute(m_fplanf, realIn, complexOut);
         } else {
-            v_copy(m_fbuf, realIn, m_size);
+            load(m_fbuf, realIn);
             SleefDFT_float_execute(m_fplanf, 0, 0);
             v_copy(complexOut, m_fpacked, m_size + 2);
         }
@@ -1608,21 +2953,26 @@ public:
 
     void forwardPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut) {
         if (!m_fplanf) initFloat();
-        if (isAligned(realIn)) {
+        if (!isShapingInput() && isAligned(realIn)) {
             SleefDFT_float_execute(m_fplanf, realIn, 0);
         } else {
-            v_copy(m_fbuf, realIn, m_size);
+            load(m_fbuf, realIn);
             SleefDFT_float_execute(m_fplanf, 0, 0);
         }
-        v_cartesian_interleaved_to_polar(magOut, phaseOut, m_fpacked, m_size/2+1);
+        if (isFastPolar()) {
+            interleavedToPolarFast(magOut, phaseOut, m_fpacked, m_size/2+1);
+        } else {
+            v_cartesian_interleaved_to_polar
+                (magOut, phaseOut, m_fpacked, m_size/2+1);
+        }
     }
 
     void forwardMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut) {
         if (!m_fplanf) initFloat();
-        if (isAligned(realIn)) {
+        if (!isShapingInput() && isAligned(realIn)) {
             SleefDFT_float_execute(m_fplanf, realIn, 0);
         } else {
-            v_copy(m_fbuf, realIn, m_size);
+            load(m_fbuf, realIn);
             SleefDFT_float_execute(m_fplanf, 0, 0);
         }
         v_cartesian_interleaved_to_magnitudes(magOut, m_fpacked, m_size/2+1);
@@ -1631,46 +2981,53 @@ public:
     void inverse(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut) {
         if (!m_dplanf) initDouble();
         packDouble(realIn, imagIn);
-        if (isAligned(realOut)) {
+        if (!isShapingOutput() && isAligned(realOut)) {
             SleefDFT_double_execute(m_dplani, 0, realOut);
         } else {
             SleefDFT_double_execute(m_dplani, 0, 0);
-            v_copy(realOut, m_dbuf, m_size);
+            store(realOut, m_dbuf);
         }
     }
 
     void inverseInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ realOut) {
         if (!m_dplanf) initDouble();
-        if (isAligned(complexIn) && isAligned(realOut)) {
+        if (!isShapingOutput() && isAligned(complexIn) && isAligned(realOut)) {
             SleefDFT_double_execute(m_dplani, complexIn, realOut);
-        } else {            
-            v_copy(m_dpacked, complexIn, m_size + 2);
-            SleefDFT_double_execute(m_dplani, 0, 0);
-            v_copy(realOut, m_dbuf, m_size);
+        } else {
+            if (isAligned(complexIn) && isAligned(realOut)) {
+                SleefDFT_double_execute(m_dplani, complexIn, 0);
+            } else {
+                ++m_slowPathCount;
+                v_copy(m_dpacked, complexIn, m_size + 2);
+                SleefDFT_double_execute(m_dplani, 0, 0);
+            }
+            store(realOut, m_dbuf);
         }
     }
 
     void inversePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, double *BQ_R__ realOut) {
         if (!m_dplanf) initDouble();
-        v_polar_to_cartesian_interleaved(m_dpacked, magIn, phaseIn, m_size/2+1);
-        if (isAligned(realOut)) {
+        if (isFastPolar()) {
+            polarToInterleavedFast(m_dpacked, magIn, phaseIn, m_size/2+1);
+        } else {
+            v_polar_to_cartesian_interleaved
+                (m_dpacked, magIn, phaseIn, m_size/2+1);
+        }
+        if (!isShapingOutput() && isAligned(realOut)) {
             SleefDFT_double_execute(m_dplani, 0, realOut);
         } else {
             SleefDFT_double_execute(m_dplani, 0, 0);
-            v_copy(realOut, m_dbuf, m_size);
+            store(realOut, m_dbuf);
         }
     }
 
     void inverseCepstral(const double *BQ_R__ magIn, double *BQ_R__ cepOut) {
         if (!m_dplanf) initDouble();
-        const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) {
-            m_dpacked[i*2] = log(magIn[i] + 0.000001);
-            m_dpacked[i*2+1] = 0.0;
-        }
+        magnitudeToLogInterleaved(m_dpacked, magIn, m_size/2+1);
         if (isAligned(cepOut)) {
             SleefDFT_double_execute(m_dplani, 0, cepOut);
         } else {
+            ++m_slowPathCount;
             SleefDFT_double_execute(m_dplani, 0, 0);
             v_copy(cepOut, m_dbuf, m_size);
         }
@@ -1679,99 +3036,303 @@ public:
     void inverse(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut) {
         if (!m_fplanf) initFloat();
         packFloat(realIn, imagIn);
-        if (isAligned(realOut)) {
-            SleefDFT_float_execute(m_dplani, 0, realOut);
+        if (!isShapingOutput() && isAligned(realOut)) {
+            SleefDFT_float_execute(m_fplani, 0, realOut);
         } else {
             SleefDFT_float_execute(m_fplani, 0, 0);
-            v_copy(realOut, m_fbuf, m_size);
+            store(realOut, m_fbuf);
         }
     }
 
     void inverseInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ realOut) {
         if (!m_fplanf) initFloat();
-        if (isAligned(complexIn) && isAligned(realOut)) {
+        if (!isShapingOutput() && isAligned(complexIn) && isAligned(realOut)) {
             SleefDFT_float_execute(m_fplani, complexIn, realOut);
         } else {
-            v_copy(m_fpacked, complexIn, m_size + 2);
-            SleefDFT_float_execute(m_fplani, 0, 0);
-            v_copy(realOut, m_fbuf, m_size);
+            if (isAligned(complexIn) && isAligned(realOut)) {
+                SleefDFT_float_execute(m_fplani, complexIn, 0);
+            } else {
+                ++m_slowPathCount;
+                v_copy(m_fpacked, complexIn, m_size + 2);
+                SleefDFT_float_execute(m_fplani, 0, 0);
+            }
+            store(realOut, m_fbuf);
         }
     }
 
     void inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut) {
         if (!m_fplanf) initFloat();
-        v_polar_to_cartesian_interleaved(m_fpacked, magIn, phaseIn, m_size/2+1);
-        if (isAligned(realOut)) {
+        if (isFastPolar()) {
+            polarToInterleavedFast(m_fpacked, magIn, phaseIn, m_size/2+1);
+        } else {
+            v_polar_to_cartesian_interleaved
+                (m_fpacked, magIn, phaseIn, m_size/2+1);
+        }
+        if (!isShapingOutput() && isAligned(realOut)) {
             SleefDFT_float_execute(m_fplani, 0, realOut);
         } else {
             SleefDFT_float_execute(m_fplani, 0, 0);
-            v_copy(realOut, m_fbuf, m_size);
+            store(realOut, m_fbuf);
         }
     }
 
     void inverseCepstral(const float *BQ_R__ magIn, float *BQ_R__ cepOut) {
         if (!m_fplanf) initFloat();
-        const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) {
-            m_fpacked[i*2] = logf(magIn[i] + 0.000001f);
-            m_fpacked[i*2+1] = 0.0;
-        }
+        magnitudeToLogInterleaved(m_fpacked, magIn, m_size/2+1);
         if (isAligned(cepOut)) {
             SleefDFT_float_execute(m_fplani, 0, cepOut);
         } else {
+            ++m_slowPathCount;
             SleefDFT_float_execute(m_fplani, 0, 0);
             v_copy(cepOut, m_fbuf, m_size);
         }
     }
 
+    void forwardPower(const double *BQ_R__ realIn, double *BQ_R__ powerOut) {
+        if (!m_dplanf) initDouble();
+        executeForward(realIn, m_dpacked);
+        interleavedToPower(powerOut, m_dpacked, m_size/2+1);
+    }
+
+    void inversePower(const double *BQ_R__ powerIn, double *BQ_R__ realOut) {
+        if (!m_dplanf) initDouble();
+        const int hs = m_size/2;
+        for (int i = 0; i <= hs; ++i) {
+            m_dpacked[i*2] = powerIn[i];
+            m_dpacked[i*2+1] = 0.0;
+        }
+        executeInverse(realOut);
+    }
+
+    void forwardPower(const float *BQ_R__ realIn, float *BQ_R__ powerOut) {
+        if (!m_fplanf) initFloat();
+        executeForward(realIn, m_fpacked);
+        interleavedToPower(powerOut, m_fpacked, m_size/2+1);
+    }
+
+    void inversePower(const float *BQ_R__ powerIn, float *BQ_R__ realOut) {
+        if (!m_fplanf) initFloat();
+        const int hs = m_size/2;
+        for (int i = 0; i <= hs; ++i) {
+            m_fpacked[i*2] = powerIn[i];
+            m_fpacked[i*2+1] = 0.f;
+        }
+        executeInverse(realOut);
+    }
+
+    void forwardLogPower(const double *BQ_R__ realIn, double *BQ_R__ logOut, double floor, double scale) {
+        if (!m_dplanf) initDouble();
+        executeForward(realIn, m_dpacked);
+        interleavedToLogPower(logOut, m_dpacked, m_size/2+1, floor, scale);
+    }
+
+    void forwardLogPower(const float *BQ_R__ realIn, float *BQ_R__ logOut, float floor, float scale) {
+        if (!m_fplanf) initFloat();
+        executeForward(realIn, m_fpacked);
+        interleavedToLogPower(logOut, m_fpacked, m_size/2+1, floor, scale);
+    }
+
+    void cepstralEnvelope(const double *BQ_R__ frame, int cutoff, double *BQ_R__ envOut) {
+        if (!m_dplanf) initDouble();
+        executeForward(frame, m_dpacked);
+        logMagnitudeInPlace(m_dpacked, m_size/2+1);
+        SleefDFT_double_execute(m_dplani, 0, 0);
+        lifter(m_dbuf, m_size, cutoff);
+        SleefDFT_double_execute(m_dplanf, 0, 0);
+        interleavedRealToExp(envOut, m_dpacked, m_size/2+1);
+    }
+
+    void cepstralEnvelope(const float *BQ_R__ frame, int cutoff, float *BQ_R__ envOut) {
+        if (!m_fplanf) initFloat();
+        executeForward(frame, m_fpacked);
+        logMagnitudeInPlace(m_fpacked, m_size/2+1);
+        SleefDFT_float_execute(m_fplani, 0, 0);
+        lifter(m_fbuf, m_size, cutoff);
+        SleefDFT_float_execute(m_fplanf, 0, 0);
+        interleavedRealToExp(envOut, m_fpacked, m_size/2+1);
+    }
+
+    void forwardBins(const double *BQ_R__ realIn, int first, int last, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        if (!m_dplanf) initDouble();
+        executeForward(realIn, m_dpacked);
+        interleavedBinsToSplit(realOut, imagOut, m_dpacked, first, last);
+    }
+
+    void forwardBinsMagnitude(const double *BQ_R__ realIn, int first, int last, double *BQ_R__ magOut) {
+        if (!m_dplanf) initDouble();
+        executeForward(realIn, m_dpacked);
+        interleavedBinsToMagnitudes(magOut, m_dpacked, first, last);
+    }
+
+    void forwardBins(const float *BQ_R__ realIn, int first, int last, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        if (!m_fplanf) initFloat();
+        executeForward(realIn, m_fpacked);
+        interleavedBinsToSplit(realOut, imagOut, m_fpacked, first, last);
+    }
+
+    void forwardBinsMagnitude(const float *BQ_R__ realIn, int first, int last, float *BQ_R__ magOut) {
+        if (!m_fplanf) initFloat();
+        executeForward(realIn, m_fpacked);
+        interleavedBinsToMagnitudes(magOut, m_fpacked, first, last);
+    }
+
+    void correlate(const double *BQ_R__ a, const double *BQ_R__ b, double *BQ_R__ out, double scale) {
+        if (!m_dplanf) initDouble();
+        executeForward(b, m_dcorr);
+        executeForward(a, m_dpacked);
+        conjugateMultiply(m_dpacked, m_dcorr, m_size/2 + 1, scale);
+        executeInverse(out);
+    }
+
+    void autocorrelate(const double *BQ_R__ in, double *BQ_R__ out, double scale) {
+        if (!m_dplanf) initDouble();
+        executeForward(in, m_dpacked);
+        conjugateSquare(m_dpacked, m_size/2 + 1, scale);
+        executeInverse(out);
+    }
+
+    void correlate(const float *BQ_R__ a, const float *BQ_R__ b, float *BQ_R__ out, float scale) {
+        if (!m_fplanf) initFloat();
+        executeForward(b, m_fcorr);
+        executeForward(a, m_fpacked);
+        conjugateMultiply(m_fpacked, m_fcorr, m_size/2 + 1, scale);
+        executeInverse(out);
+    }
+
+    void autocorrelate(const float *BQ_R__ in, float *BQ_R__ out, float scale) {
+        if (!m_fplanf) initFloat();
+        executeForward(in, m_fpacked);
+        conjugateSquare(m_fpacked, m_size/2 + 1, scale);
+        executeInverse(out);
+    }
+
 private:
     SleefDFT *m_fplanf;
     SleefDFT *m_fplani;
 
     float *m_fbuf;
     float *m_fpacked;
+    float *m_fcorr;
     
     SleefDFT *m_dplanf;
     SleefDFT *m_dplani;
 
     double *m_dbuf;
     double *m_dpacked;
+    double *m_dcorr;
     
     const int m_size;
+    int m_slowPathCount;
 };
 
 #endif /* HAVE_SLEEF */
 
 #ifdef HAVE_KISSFFT
 
-class D_KISSFFT : public FFTImpl
-{
-public:
-    D_KISSFFT(int size) :
-        m_size(size),
-        m_fplanf(0),  
-        m_fplani(0)
-    {
+/*
+ KissFFT is built into the library twice, as normally with float as
+ its scalar type and again with double under renamed symbols (see
+ kiss_fft_double.h), so that each precision is computed natively.
+ KissFFT's complex type has the same layout as our interleaved
+ format, so interleaved data are read and written in place.
+*/
+
 #ifdef FIXED_POINT
-#error KISSFFT is not configured for float values
+#error KISSFFT is not configured for floating-point values
 #endif
-        if (sizeof(kiss_fft_scalar) != sizeof(float)) {
-            std::cerr << "ERROR: KISSFFT is not configured for float values"
-                      << std::endl;
-        }
 
-        m_fbuf = new kiss_fft_scalar[m_size + 2];
-        m_fpacked = new kiss_fft_cpx[m_size + 2];
-        m_fplanf = kiss_fftr_alloc(m_size, 0, NULL, NULL);
-        m_fplani = kiss_fftr_alloc(m_size, 1, NULL, NULL);
+// The float build must really be float, as the double one is separate
+typedef char kissfft_scalar_check
+[sizeof(kiss_fft_scalar) == sizeof(float) ? 1 : -1];
+
+typedef char kissfft_cpx_layout_check
+[sizeof(kiss_fft_cpx) == 2 * sizeof(float) &&
+ sizeof(kiss_fft_d_cpx) == 2 * sizeof(double) ? 1 : -1];
+
+// The calls into each build of KissFFT, by scalar type
+
+template <typename T> struct KissFFT { };
+
+template <> struct KissFFT<float>
+{
+    typedef kiss_fftr_cfg Config;
+    typedef kiss_fft_cpx Complex;
+    static Config alloc(int size, int inverse) {
+        return kiss_fftr_alloc(size, inverse, NULL, NULL);
+    }
+    static void dispose(Config cfg) {
+        kiss_fftr_free(cfg);
+    }
+    static void forward(Config cfg, const float *in, Complex *out) {
+        kiss_fftr(cfg, in, out);
+    }
+    static void inverse(Config cfg, const Complex *in, float *out) {
+        kiss_fftri(cfg, in, out);
+    }
+};
+
+template <> struct KissFFT<double>
+{
+    typedef kiss_fftr_d_cfg Config;
+    typedef kiss_fft_d_cpx Complex;
+    static Config alloc(int size, int inverse) {
+        return kiss_fftr_d_alloc(size, inverse, NULL, NULL);
+    }
+    static void dispose(Config cfg) {
+        kiss_fftr_d_free(cfg);
+    }
+    static void forward(Config cfg, const double *in, Complex *out) {
+        kiss_fftr_d(cfg, in, out);
+    }
+    static void inverse(Config cfg, const Complex *in, double *out) {
+        kiss_fftri_d(cfg, in, out);
     }
+};
 
-    ~D_KISSFFT() {
-        kiss_fftr_free(m_fplanf);
-        kiss_fftr_free(m_fplani);
+class D_KISSFFT : public FFTImpl
+{
+    // Plans and buffers for one precision, allocated by initFloat or
+    // initDouble or on first use
+    template <typename T>
+    struct Plans {
+        typedef KissFFT<T> Kiss;
+        typedef typename Kiss::Complex Complex;
+        typename Kiss::Config planf;
+        typename Kiss::Config plani;
+        T *buf;
+        Complex *packed;
+        Complex *corr;
+        Plans() : planf(0), plani(0), buf(0), packed(0), corr(0) { }
+        void init(int size) {
+            buf = new T[size + 2];
+            packed = new Complex[size + 2];
+            corr = new Complex[size/2 + 1];
+            planf = Kiss::alloc(size, 0);
+            plani = Kiss::alloc(size, 1);
+        }
+        ~Plans() {
+            if (!planf) return;
+            Kiss::dispose(planf);
+            Kiss::dispose(plani);
+            delete[] buf;
+            delete[] packed;
+            delete[] corr;
+        }
+        void forward(const T *in, Complex *out) {
+            Kiss::forward(planf, in, out);
+        }
+        void inverse(const Complex *in, T *out) {
+            Kiss::inverse(plani, in, out);
+        }
+        T *spectrum() {
+            return reinterpret_cast<T *>(packed);
+        }
+    };
 
-        delete[] m_fbuf;
-        delete[] m_fpacked;
+public:
+    D_KISSFFT(int size) :
+        m_size(size)
+    {
     }
 
     int getSize() const {
@@ -1780,175 +3341,382 @@ public:
 
     FFT::Precisions
     getSupportedPrecisions() const {
-        return FFT::SinglePrecision;
+        return FFT::SinglePrecision | FFT::DoublePrecision;
     }
 
-    void initFloat() { }
-    void initDouble() { }
+    int getPreferredAlignment() const {
+        return 16;
+    }
 
-    void packFloat(const float *BQ_R__ re, const float *BQ_R__ im) {
+    void initFloat() {
+        if (m_float.planf) return;
+        FFT_PROBE3(plan__create, m_size, 32, "kissfft");
+        m_float.init(m_size);
+    }
+
+    void initDouble() {
+        if (m_double.planf) return;
+        FFT_PROBE3(plan__create, m_size, 64, "kissfft");
+        m_double.init(m_size);
+    }
+
+    // The plans for the precision of the data pointed to, initialised
+    // if not yet used
+
+    Plans<float> &plans(const float *) {
+        if (!m_float.planf) initFloat();
+        return m_float;
+    }
+
+    Plans<double> &plans(const double *) {
+        if (!m_double.planf) initDouble();
+        return m_double;
+    }
+
+    template <typename T>
+    void pack(Plans<T> &p, const T *BQ_R__ re, const T *BQ_R__ im) {
         const int hs = m_size/2;
         for (int i = 0; i <= hs; ++i) {
-            m_fpacked[i].r = re[i];
+            p.packed[i].r = re[i];
         }
         if (im) {
             for (int i = 0; i <= hs; ++i) {
-                m_fpacked[i].i = im[i];
+                p.packed[i].i = im[i];
             }
         } else {
             for (int i = 0; i <= hs; ++i) {
-                m_fpacked[i].i = 0.f;
+                p.packed[i].i = T(0);
             }
         }
     }
 
-    void unpackFloat(float *BQ_R__ re, float *BQ_R__ im) {
+    template <typename T>
+    void unpack(Plans<T> &p, T *BQ_R__ re, T *BQ_R__ im) {
         const int hs = m_size/2;
         for (int i = 0; i <= hs; ++i) {
-            re[i] = m_fpacked[i].r;
+            re[i] = p.packed[i].r;
         }
         if (im) {
             for (int i = 0; i <= hs; ++i) {
-                im[i] = m_fpacked[i].i;
+                im[i] = p.packed[i].i;
             }
         }
     }        
 
-    void packDouble(const double *BQ_R__ re, const double *BQ_R__ im) {
-        const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) {
-            m_fpacked[i].r = float(re[i]);
+    // Time-domain input and output: used directly unless shaped, in
+    // which case they pass through the plans' buffer
+
+    template <typename T>
+    const T *timeIn(Plans<T> &p, const T *in) {
+        if (isShapingInput()) {
+            shapeInput(p.buf, in, m_size);
+            return p.buf;
         }
-        if (im) {
-            for (int i = 0; i <= hs; ++i) {
-                m_fpacked[i].i = float(im[i]);
-            }
-        } else {
-            for (int i = 0; i <= hs; ++i) {
-                m_fpacked[i].i = 0.f;
-            }
+        return in;
+    }
+
+    template <typename T>
+    T *timeOut(Plans<T> &p, T *out) {
+        if (isShapingOutput()) {
+            return p.buf;
         }
+        return out;
     }
 
-    void unpackDouble(double *BQ_R__ re, double *BQ_R__ im) {
-        const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) {
-            re[i] = double(m_fpacked[i].r);
+    template <typename T>
+    void finishTimeOut(Plans<T> &p, T *out) {
+        if (isShapingOutput()) {
+            shapeOutput(out, p.buf, m_size);
         }
-        if (im) {
-            for (int i = 0; i <= hs; ++i) {
-                im[i] = double(m_fpacked[i].i);
-            }
+    }
+
+    template <typename T>
+    static const typename KissFFT<T>::Complex *complexIn(const T *in) {
+        return reinterpret_cast<const typename KissFFT<T>::Complex *>(in);
+    }
+
+    template <typename T>
+    static typename KissFFT<T>::Complex *complexOut(T *out) {
+        return reinterpret_cast<typename KissFFT<T>::Complex *>(out);
+    }
+
+    template <typename T>
+    void forwardT(const T *BQ_R__ realIn, T *BQ_R__ realOut, T *BQ_R__ imagOut) {
+        Plans<T> &p = plans(realIn);
+        p.forward(timeIn(p, realIn), p.packed);
+        unpack(p, realOut, imagOut);
+    }
+
+    template <typename T>
+    void forwardInterleavedT(const T *BQ_R__ realIn, T *BQ_R__ complexOutput) {
+        Plans<T> &p = plans(realIn);
+        p.forward(timeIn(p, realIn), complexOut(complexOutput));
+    }
+
+    template <typename T>
+    void forwardPolarT(const T *BQ_R__ realIn, T *BQ_R__ magOut, T *BQ_R__ phaseOut) {
+        Plans<T> &p = plans(realIn);
+        p.forward(timeIn(p, realIn), p.packed);
+        if (isFastPolar()) {
+            interleavedToPolarFast
+                (magOut, phaseOut, p.spectrum(), m_size/2+1);
+        } else {
+            v_cartesian_interleaved_to_polar
+                (magOut, phaseOut, p.spectrum(), m_size/2+1);
         }
-    }        
+    }
+
+    template <typename T>
+    void forwardMagnitudeT(const T *BQ_R__ realIn, T *BQ_R__ magOut) {
+        Plans<T> &p = plans(realIn);
+        p.forward(timeIn(p, realIn), p.packed);
+        v_cartesian_interleaved_to_magnitudes
+            (magOut, p.spectrum(), m_size/2+1);
+    }
+
+    template <typename T>
+    void inverseT(const T *BQ_R__ realIn, const T *BQ_R__ imagIn, T *BQ_R__ realOut) {
+        Plans<T> &p = plans(realIn);
+        pack(p, realIn, imagIn);
+        p.inverse(p.packed, timeOut(p, realOut));
+        finishTimeOut(p, realOut);
+    }
+
+    template <typename T>
+    void inverseInterleavedT(const T *BQ_R__ complexInput, T *BQ_R__ realOut) {
+        Plans<T> &p = plans(complexInput);
+        p.inverse(complexIn(complexInput), timeOut(p, realOut));
+        finishTimeOut(p, realOut);
+    }
+
+    template <typename T>
+    void inversePolarT(const T *BQ_R__ magIn, const T *BQ_R__ phaseIn, T *BQ_R__ realOut) {
+        Plans<T> &p = plans(magIn);
+        if (isFastPolar()) {
+            polarToInterleavedFast(p.spectrum(), magIn, phaseIn, m_size/2+1);
+        } else {
+            v_polar_to_cartesian_interleaved
+                (p.spectrum(), magIn, phaseIn, m_size/2+1);
+        }
+        p.inverse(p.packed, timeOut(p, realOut));
+        finishTimeOut(p, realOut);
+    }
+
+    template <typename T>
+    void forwardPowerT(const T *BQ_R__ realIn, T *BQ_R__ powerOut) {
+        Plans<T> &p = plans(realIn);
+        p.forward(timeIn(p, realIn), p.packed);
+        interleavedToPower(powerOut, p.spectrum(), m_size/2+1);
+    }
+
+    template <typename T>
+    void inverseCepstralT(const T *BQ_R__ magIn, T *BQ_R__ cepOut) {
+        Plans<T> &p = plans(magIn);
+        magnitudeToLogInterleaved(p.spectrum(), magIn, m_size/2+1);
+        p.inverse(p.packed, timeOut(p, cepOut));
+        finishTimeOut(p, cepOut);
+    }
+
+    template <typename T>
+    void inversePowerT(const T *BQ_R__ powerIn, T *BQ_R__ realOut) {
+        Plans<T> &p = plans(powerIn);
+        pack(p, powerIn, (const T *)0);
+        p.inverse(p.packed, timeOut(p, realOut));
+        finishTimeOut(p, realOut);
+    }
+
+    template <typename T>
+    void forwardLogPowerT(const T *BQ_R__ realIn, T *BQ_R__ logOut, T floor, T scale) {
+        Plans<T> &p = plans(realIn);
+        p.forward(timeIn(p, realIn), p.packed);
+        interleavedToLogPower
+            (logOut, p.spectrum(), m_size/2+1, floor, scale);
+    }
+
+    // The cepstrum passes through the plans' buffer, which timeIn may
+    // also have used for the frame but is finished with by then
+    template <typename T>
+    void cepstralEnvelopeT(const T *BQ_R__ frame, int cutoff, T *BQ_R__ envOut) {
+        Plans<T> &p = plans(frame);
+        p.forward(timeIn(p, frame), p.packed);
+        logMagnitudeInPlace(p.spectrum(), m_size/2+1);
+        p.inverse(p.packed, p.buf);
+        lifter(p.buf, m_size, cutoff);
+        p.forward(p.buf, p.packed);
+        interleavedRealToExp(envOut, p.spectrum(), m_size/2+1);
+    }
+
+    template <typename T>
+    void forwardBinsT(const T *BQ_R__ realIn, int first, int last, T *BQ_R__ realOut, T *BQ_R__ imagOut) {
+        Plans<T> &p = plans(realIn);
+        p.forward(timeIn(p, realIn), p.packed);
+        interleavedBinsToSplit
+            (realOut, imagOut, p.spectrum(), first, last);
+    }
+
+    template <typename T>
+    void forwardBinsMagnitudeT(const T *BQ_R__ realIn, int first, int last, T *BQ_R__ magOut) {
+        Plans<T> &p = plans(realIn);
+        p.forward(timeIn(p, realIn), p.packed);
+        interleavedBinsToMagnitudes(magOut, p.spectrum(), first, last);
+    }
+
+    // The spectrum of b goes to the plans' corr buffer, and the
+    // products are taken in place in packed before it is passed to
+    // the inverse
+    
+    template <typename T>
+    void correlateT(const T *BQ_R__ a, const T *BQ_R__ b, T *BQ_R__ out, T scale) {
+        Plans<T> &p = plans(a);
+        p.forward(timeIn(p, b), p.corr);
+        p.forward(timeIn(p, a), p.packed);
+        conjugateMultiply(p.spectrum(), reinterpret_cast<const T *>(p.corr),
+                          m_size/2 + 1, scale);
+        p.inverse(p.packed, timeOut(p, out));
+        finishTimeOut(p, out);
+    }
+
+    template <typename T>
+    void autocorrelateT(const T *BQ_R__ in, T *BQ_R__ out, T scale) {
+        Plans<T> &p = plans(in);
+        p.forward(timeIn(p, in), p.packed);
+        conjugateSquare(p.spectrum(), m_size/2 + 1, scale);
+        p.inverse(p.packed, timeOut(p, out));
+        finishTimeOut(p, out);
+    }
 
     void forward(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
-        v_convert(m_fbuf, realIn, m_size);
-        kiss_fftr(m_fplanf, m_fbuf, m_fpacked);
-        unpackDouble(realOut, imagOut);
+        forwardT(realIn, realOut, imagOut);
     }
 
     void forwardInterleaved(const double *BQ_R__ realIn, double *BQ_R__ complexOut) {
-        v_convert(m_fbuf, realIn, m_size);
-        kiss_fftr(m_fplanf, m_fbuf, m_fpacked);
-        v_convert(complexOut, (float *)m_fpacked, m_size + 2);
+        forwardInterleavedT(realIn, complexOut);
     }
 
     void forwardPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut) {
-        v_convert(m_fbuf, realIn, m_size);
-        kiss_fftr(m_fplanf, m_fbuf, m_fpacked);
-        v_cartesian_interleaved_to_polar
-            (magOut, phaseOut, (float *)m_fpacked, m_size/2+1);
+        forwardPolarT(realIn, magOut, phaseOut);
     }
 
     void forwardMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut) {
-        v_convert(m_fbuf, realIn, m_size);
-        kiss_fftr(m_fplanf, m_fbuf, m_fpacked);
-        v_cartesian_interleaved_to_magnitudes
-            (magOut, (float *)m_fpacked, m_size/2+1);
+        forwardMagnitudeT(realIn, magOut);
     }
 
     void forward(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
-        kiss_fftr(m_fplanf, realIn, m_fpacked);
-        unpackFloat(realOut, imagOut);
+        forwardT(realIn, realOut, imagOut);
     }
 
     void forwardInterleaved(const float *BQ_R__ realIn, float *BQ_R__ complexOut) {
-        kiss_fftr(m_fplanf, realIn, (kiss_fft_cpx *)complexOut);
+        forwardInterleavedT(realIn, complexOut);
     }
 
     void forwardPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut) {
-        kiss_fftr(m_fplanf, realIn, m_fpacked);
-        v_cartesian_interleaved_to_polar
-            (magOut, phaseOut, (float *)m_fpacked, m_size/2+1);
+        forwardPolarT(realIn, magOut, phaseOut);
     }
 
     void forwardMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut) {
-        kiss_fftr(m_fplanf, realIn, m_fpacked);
-        v_cartesian_interleaved_to_magnitudes
-            (magOut, (float *)m_fpacked, m_size/2+1);
+        forwardMagnitudeT(realIn, magOut);
     }
 
     void inverse(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut) {
-        packDouble(realIn, imagIn);
-        kiss_fftri(m_fplani, m_fpacked, m_fbuf);
-        v_convert(realOut, m_fbuf, m_size);
+        inverseT(realIn, imagIn, realOut);
     }
 
     void inverseInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ realOut) {
-        v_convert((float *)m_fpacked, complexIn, m_size + 2);
-        kiss_fftri(m_fplani, m_fpacked, m_fbuf);
-        v_convert(realOut, m_fbuf, m_size);
+        inverseInterleavedT(complexIn, realOut);
     }
 
     void inversePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, double *BQ_R__ realOut) {
-        v_polar_to_cartesian_interleaved
-            ((float *)m_fpacked, magIn, phaseIn, m_size/2+1);
-        kiss_fftri(m_fplani, m_fpacked, m_fbuf);
-        v_convert(realOut, m_fbuf, m_size);
+        inversePolarT(magIn, phaseIn, realOut);
     }
 
     void inverseCepstral(const double *BQ_R__ magIn, double *BQ_R__ cepOut) {
-        const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) {
-            m_fpacked[i].r = float(log(magIn[i] + 0.000001));
-            m_fpacked[i].i = 0.0f;
-        }
-        kiss_fftri(m_fplani, m_fpacked, m_fbuf);
-        v_convert(cepOut, m_fbuf, m_size);
+        inverseCepstralT(magIn, cepOut);
     }
     
     void inverse(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut) {
-        packFloat(realIn, imagIn);
-        kiss_fftri(m_fplani, m_fpacked, realOut);
+        inverseT(realIn, imagIn, realOut);
     }
 
     void inverseInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ realOut) {
-        v_copy((float *)m_fpacked, complexIn, m_size + 2);
-        kiss_fftri(m_fplani, m_fpacked, realOut);
+        inverseInterleavedT(complexIn, realOut);
     }
 
     void inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut) {
-        v_polar_to_cartesian_interleaved
-            ((float *)m_fpacked, magIn, phaseIn, m_size/2+1);
-        kiss_fftri(m_fplani, m_fpacked, realOut);
+        inversePolarT(magIn, phaseIn, realOut);
     }
 
     void inverseCepstral(const float *BQ_R__ magIn, float *BQ_R__ cepOut) {
-        const int hs = m_size/2;
-        for (int i = 0; i <= hs; ++i) {
-            m_fpacked[i].r = logf(magIn[i] + 0.000001f);
-            m_fpacked[i].i = 0.0f;
-        }
-        kiss_fftri(m_fplani, m_fpacked, cepOut);
+        inverseCepstralT(magIn, cepOut);
+    }
+
+    void forwardPower(const double *BQ_R__ realIn, double *BQ_R__ powerOut) {
+        forwardPowerT(realIn, powerOut);
+    }
+
+    void inversePower(const double *BQ_R__ powerIn, double *BQ_R__ realOut) {
+        inversePowerT(powerIn, realOut);
+    }
+
+    void forwardPower(const float *BQ_R__ realIn, float *BQ_R__ powerOut) {
+        forwardPowerT(realIn, powerOut);
+    }
+
+    void inversePower(const float *BQ_R__ powerIn, float *BQ_R__ realOut) {
+        inversePowerT(powerIn, realOut);
+    }
+
+    void forwardLogPower(const double *BQ_R__ realIn, double *BQ_R__ logOut, double floor, double scale) {
+        forwardLogPowerT(realIn, logOut, floor, scale);
+    }
+
+    void forwardLogPower(const float *BQ_R__ realIn, float *BQ_R__ logOut, float floor, float scale) {
+        forwardLogPowerT(realIn, logOut, floor, scale);
+    }
+
+    void cepstralEnvelope(const double *BQ_R__ frame, int cutoff, double *BQ_R__ envOut) {
+        cepstralEnvelopeT(frame, cutoff, envOut);
+    }
+
+    void cepstralEnvelope(const float *BQ_R__ frame, int cutoff, float *BQ_R__ envOut) {
+        cepstralEnvelopeT(frame, cutoff, envOut);
+    }
+
+    void forwardBins(const double *BQ_R__ realIn, int first, int last, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        forwardBinsT(realIn, first, last, realOut, imagOut);
+    }
+
+    void forwardBinsMagnitude(const double *BQ_R__ realIn, int first, int last, double *BQ_R__ magOut) {
+        forwardBinsMagnitudeT(realIn, first, last, magOut);
+    }
+
+    void forwardBins(const float *BQ_R__ realIn, int first, int last, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        forwardBinsT(realIn, first, last, realOut, imagOut);
+    }
+
+    void forwardBinsMagnitude(const float *BQ_R__ realIn, int first, int last, float *BQ_R__ magOut) {
+        forwardBinsMagnitudeT(realIn, first, last, magOut);
+    }
+
+    void correlate(const double *BQ_R__ a, const double *BQ_R__ b, double *BQ_R__ out, double scale) {
+        correlateT(a, b, out, scale);
+    }
+
+    void autocorrelate(const double *BQ_R__ in, double *BQ_R__ out, double scale) {
+        autocorrelateT(in, out, scale);
+    }
+
+    void correlate(const float *BQ_R__ a, const float *BQ_R__ b, float *BQ_R__ out, float scale) {
+        correlateT(a, b, out, scale);
+    }
+
+    void autocorrelate(const float *BQ_R__ in, float *BQ_R__ out, float scale) {
+        autocorrelateT(in, out, scale);
     }
 
 private:
     const int m_size;
-    kiss_fftr_cfg m_fplanf;
-    kiss_fftr_cfg m_fplani;
-    kiss_fft_scalar *m_fbuf;
-    kiss_fft_cpx *m_fpacked;
+    Plans<float> m_float;
+    Plans<double> m_double;
 };
 
 #endif /* HAVE_KISSFFT */
@@ -1964,6 +3732,7 @@ public:
         m_blockTableSize(16),
         m_maxTabledBlock(1 << m_blockTableSize)
     {
+        FFT_PROBE3(plan__create, m_size, 64, "builtin");
         m_table = allocate_and_zero<int>(m_half);
         m_sincos = allocate_and_zero<double>(m_blockTableSize * 4);
         m_sincos_r = allocate_and_zero<double>(m_half);
@@ -1973,6 +3742,8 @@ public:
         m_b = allocate_and_zero<double>(m_half + 1);
         m_c = allocate_and_zero<double>(m_half + 1);
         m_d = allocate_and_zero<double>(m_half + 1);
+        m_e = allocate_and_zero<double>(m_half + 1);
+        m_f = allocate_and_zero<double>(m_half + 1);
         m_a_and_b[0] = m_a;
         m_a_and_b[1] = m_b;
         m_c_and_d[0] = m_c;
@@ -1990,6 +3761,8 @@ public:
         deallocate(m_b);
         deallocate(m_c);
         deallocate(m_d);
+        deallocate(m_e);
+        deallocate(m_f);
     }
 
     int getSize() const {
@@ -2001,6 +3774,10 @@ public:
         return FFT::DoublePrecision;
     }
 
+    int getPreferredAlignment() const {
+        return 16;
+    }
+
     void initFloat() { }
     void initDouble() { }
 
@@ -2018,7 +3795,12 @@ public:
     void forwardPolar(const double *BQ_R__ realIn,
                       double *BQ_R__ magOut, double *BQ_R__ phaseOut) {
         transformF(realIn, m_c, m_d);
-        v_cartesian_to_polar(magOut, phaseOut, m_c, m_d, m_half + 1);
+        if (isFastPolar()) {
+            cartesianToPolarFast(magOut, phaseOut, m_c, m_d, m_half + 1,
+                                 1.0);
+        } else {
+            v_cartesian_to_polar(magOut, phaseOut, m_c, m_d, m_half + 1);
+        }
     }
 
     void forwardMagnitude(const double *BQ_R__ realIn,
@@ -2044,7 +3826,12 @@ public:
     void forwardPolar(const float *BQ_R__ realIn,
                       float *BQ_R__ magOut, float *BQ_R__ phaseOut) {
         transformF(realIn, m_c, m_d);
-        v_cartesian_to_polar(magOut, phaseOut, m_c, m_d, m_half + 1);
+        if (isFastPolar()) {
+            cartesianToPolarFast(magOut, phaseOut, m_c, m_d, m_half + 1,
+                                 1.f);
+        } else {
+            v_cartesian_to_polar(magOut, phaseOut, m_c, m_d, m_half + 1);
+        }
     }
 
     void forwardMagnitude(const float *BQ_R__ realIn,
@@ -2066,17 +3853,18 @@ public:
 
     void inversePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn,
                       double *BQ_R__ realOut) {
-        v_polar_to_cartesian(m_a, m_b, magIn, phaseIn, m_half + 1);
+        if (isFastPolar()) {
+            polarToCartesianFast(m_a, m_b, magIn, phaseIn, m_half + 1);
+        } else {
+            v_polar_to_cartesian(m_a, m_b, magIn, phaseIn, m_half + 1);
+        }
         transformI(m_a, m_b, realOut);
     }
 
     void inverseCepstral(const double *BQ_R__ magIn,
                          double *BQ_R__ cepOut) {
-        for (int i = 0; i <= m_half; ++i) {
-            double real = log(magIn[i] + 0.000001);
-            m_a[i] = real;
-            m_b[i] = 0.0;
-        }
+        magnitudeToLog(m_a, magIn, m_half + 1);
+        v_zero(m_b, m_half + 1);
         transformI(m_a, m_b, cepOut);
     }
 
@@ -2096,18 +3884,108 @@ public:
 
     void inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn,
                       float *BQ_R__ realOut) {
-        v_polar_to_cartesian(m_a, m_b, magIn, phaseIn, m_half + 1);
+        if (isFastPolar()) {
+            polarToCartesianFast(m_a, m_b, magIn, phaseIn, m_half + 1);
+        } else {
+            v_polar_to_cartesian(m_a, m_b, magIn, phaseIn, m_half + 1);
+        }
         transformI(m_a, m_b, realOut);
     }
 
     void inverseCepstral(const float *BQ_R__ magIn,
                          float *BQ_R__ cepOut) {
+        magnitudeToLog(m_a, magIn, m_half + 1);
+        v_zero(m_b, m_half + 1);
+        transformI(m_a, m_b, cepOut);
+    }
+
+    void forwardPower(const double *BQ_R__ realIn,
+                      double *BQ_R__ powerOut) {
+        transformF(realIn, m_c, m_d);
         for (int i = 0; i <= m_half; ++i) {
-            float real = logf(magIn[i] + 0.000001);
-            m_a[i] = real;
-            m_b[i] = 0.0;
+            powerOut[i] = m_c[i] * m_c[i] + m_d[i] * m_d[i];
         }
-        transformI(m_a, m_b, cepOut);
+    }
+
+    void inversePower(const double *BQ_R__ powerIn,
+                      double *BQ_R__ realOut) {
+        v_zero(m_b, m_half + 1);
+        transformI(powerIn, m_b, realOut);
+    }
+
+    void forwardPower(const float *BQ_R__ realIn,
+                      float *BQ_R__ powerOut) {
+        transformF(realIn, m_c, m_d);
+        for (int i = 0; i <= m_half; ++i) {
+            powerOut[i] = float(m_c[i] * m_c[i] + m_d[i] * m_d[i]);
+        }
+    }
+
+    void inversePower(const float *BQ_R__ powerIn,
+                      float *BQ_R__ realOut) {
+        v_convert(m_a, powerIn, m_half + 1);
+        v_zero(m_b, m_half + 1);
+        transformI(m_a, m_b, realOut);
+    }
+
+    void forwardLogPower(const double *BQ_R__ realIn, double *BQ_R__ logOut,
+                         double floor, double scale) {
+        forwardLogPowerT(realIn, logOut, floor, scale);
+    }
+
+    void forwardLogPower(const float *BQ_R__ realIn, float *BQ_R__ logOut,
+                         float floor, float scale) {
+        forwardLogPowerT(realIn, logOut, floor, scale);
+    }
+
+    void cepstralEnvelope(const double *BQ_R__ frame, int cutoff,
+                          double *BQ_R__ envOut) {
+        cepstralEnvelopeT(frame, cutoff, envOut);
+    }
+
+    void cepstralEnvelope(const float *BQ_R__ frame, int cutoff,
+                          float *BQ_R__ envOut) {
+        cepstralEnvelopeT(frame, cutoff, envOut);
+    }
+
+    void forwardBins(const double *BQ_R__ realIn, int first, int last,
+                     double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        forwardBinsT(realIn, first, last, realOut, imagOut);
+    }
+
+    void forwardBinsMagnitude(const double *BQ_R__ realIn, int first, int last,
+                              double *BQ_R__ magOut) {
+        forwardBinsMagnitudeT(realIn, first, last, magOut);
+    }
+
+    void forwardBins(const float *BQ_R__ realIn, int first, int last,
+                     float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        forwardBinsT(realIn, first, last, realOut, imagOut);
+    }
+
+    void forwardBinsMagnitude(const float *BQ_R__ realIn, int first, int last,
+                              float *BQ_R__ magOut) {
+        forwardBinsMagnitudeT(realIn, first, last, magOut);
+    }
+
+    void correlate(const double *BQ_R__ a, const double *BQ_R__ b,
+                   double *BQ_R__ out, double scale) {
+        correlateT(a, b, out, scale);
+    }
+
+    void autocorrelate(const double *BQ_R__ in,
+                       double *BQ_R__ out, double scale) {
+        autocorrelateT(in, out, scale);
+    }
+
+    void correlate(const float *BQ_R__ a, const float *BQ_R__ b,
+                   float *BQ_R__ out, float scale) {
+        correlateT(a, b, out, scale);
+    }
+
+    void autocorrelate(const float *BQ_R__ in,
+                       float *BQ_R__ out, float scale) {
+        autocorrelateT(in, out, scale);
     }
 
 private:
@@ -2124,6 +4002,8 @@ private:
     double *m_b;
     double *m_c;
     double *m_d;
+    double *m_e;
+    double *m_f;
     double *m_a_and_b[2];
     double *m_c_and_d[2];
 
@@ -2172,17 +4052,125 @@ private:
         }
     }        
 
-    // Uses m_a and m_b internally; does not touch m_c or m_d
+    // The spectrum of b goes to m_e and m_f and that of a to m_c and
+    // m_d, and the products are taken straight into m_a and m_b as
+    // the inverse input
+    template <typename T>
+    void correlateT(const T *BQ_R__ a, const T *BQ_R__ b,
+                    T *BQ_R__ out, double scale) {
+        transformF(b, m_e, m_f);
+        transformF(a, m_c, m_d);
+        for (int i = 0; i <= m_half; ++i) {
+            m_a[i] = (m_c[i] * m_e[i] + m_d[i] * m_f[i]) * scale;
+            m_b[i] = (m_d[i] * m_e[i] - m_c[i] * m_f[i]) * scale;
+        }
+        transformI(m_a, m_b, out);
+    }
+
+    template <typename T>
+    void autocorrelateT(const T *BQ_R__ in, T *BQ_R__ out, double scale) {
+        transformF(in, m_c, m_d);
+        for (int i = 0; i <= m_half; ++i) {
+            m_a[i] = (m_c[i] * m_c[i] + m_d[i] * m_d[i]) * scale;
+        }
+        v_zero(m_b, m_half + 1);
+        transformI(m_a, m_b, out);
+    }
+
+    template <typename T>
+    void forwardLogPowerT(const T *BQ_R__ realIn, T *BQ_R__ logOut,
+                          double floor, double scale) {
+        transformF(realIn, m_c, m_d);
+        for (int i = 0; i <= m_half; ++i) {
+            const double p = m_c[i] * m_c[i] + m_d[i] * m_d[i];
+            logOut[i] = T(fastLog(clampPower(p, floor)) * scale);
+        }
+    }
+
+    // The log spectrum goes to m_e and m_f, and the cepstrum, left
+    // split into even and odd quefrencies in m_c and m_d, is
+    // liftered straight into m_a and m_b as the second forward
+    // input, so it is never interleaved
+    template <typename T>
+    void cepstralEnvelopeT(const T *BQ_R__ frame, int cutoff,
+                           T *BQ_R__ envOut) {
+        transformF(frame, m_e, m_f);
+        for (int i = 0; i <= m_half; ++i) {
+            const double mag = sqrt(m_e[i] * m_e[i] + m_f[i] * m_f[i]);
+            m_e[i] = fastLog(mag + 0.000001);
+        }
+        v_zero(m_f, m_half + 1);
+        transformSplitI(m_e, m_f);
+        const int k = (cutoff < m_half ? cutoff : m_half);
+        const double scale = 1.0 / m_size;
+        for (int i = 0; i < m_half; ++i) {
+            const int e = i * 2, o = i * 2 + 1;
+            m_a[i] = (e <= k || e >= m_size - k) ? m_c[i] * scale : 0.0;
+            m_b[i] = (o <= k || o >= m_size - k) ? m_d[i] * scale : 0.0;
+        }
+        transformSplitF(m_c, m_d, m_half);
+        for (int i = 0; i <= m_half; ++i) {
+            envOut[i] = T(exp(m_c[i]));
+        }
+    }
+
+    template <typename T>
+    void forwardBinsT(const T *BQ_R__ realIn, int first, int last,
+                      T *BQ_R__ realOut, T *BQ_R__ imagOut) {
+        transformF(realIn, m_c, m_d);
+        for (int i = first; i < last; ++i) {
+            realOut[i - first] = T(m_c[i]);
+            imagOut[i - first] = T(m_d[i]);
+        }
+    }
+
+    template <typename T>
+    void forwardBinsMagnitudeT(const T *BQ_R__ realIn, int first, int last,
+                               T *BQ_R__ magOut) {
+        transformF(realIn, m_c, m_d);
+        for (int i = first; i < last; ++i) {
+            magOut[i - first] = T(sqrt(m_c[i] * m_c[i] + m_d[i] * m_d[i]));
+        }
+    }
+
+    // Uses m_a and m_b internally; does not touch m_c or m_d. Input
+    // zero-padded from m_length is loaded only up to there, and the
+    // complex transform told how much of it there is.
     template <typename T>
     void transformF(const T *BQ_R__ ri,
                     double *BQ_R__ ro, double *BQ_R__ io) {
 
-        int halfhalf = m_half / 2;
-        for (int i = 0; i < m_half; ++i) {
-            m_a[i] = ri[i * 2];
-            m_b[i] = ri[i * 2 + 1];
+        if (isPaddingInput()) {
+            const int len = m_length;
+            for (int i = 0; i < len / 2; ++i) {
+                m_a[i] = ri[i * 2];
+                m_b[i] = ri[i * 2 + 1];
+            }
+            if (len % 2) {
+                m_a[len / 2] = ri[len - 1];
+                m_b[len / 2] = 0.0;
+            }
+            transformSplitF(ro, io, (len + 1) / 2);
+            return;
         }
-        transformComplex(m_a, m_b, m_vr, m_vi, false);
+        if (isShapingInput()) {
+            deinterleaveShaped(ri);
+        } else {
+            for (int i = 0; i < m_half; ++i) {
+                m_a[i] = ri[i * 2];
+                m_b[i] = ri[i * 2 + 1];
+            }
+        }
+        transformSplitF(ro, io, m_half);
+    }
+
+    // As transformF, but from input already split into m_a (even
+    // samples) and m_b (odd samples), of which the first count are
+    // read
+    void transformSplitF(double *BQ_R__ ro, double *BQ_R__ io, int count) {
+
+        int halfhalf = m_half / 2;
+        transformComplex(m_a, m_b, m_vr, m_vi, false, count);
         ro[0] = m_vr[0] + m_vi[0];
         ro[m_half] = m_vr[0] - m_vi[0];
         io[0] = io[m_half] = 0.0;
@@ -2208,6 +4196,21 @@ private:
     template <typename T>
     void transformI(const double *BQ_R__ ri, const double *BQ_R__ ii,
                     T *BQ_R__ ro) {
+
+        transformSplitI(ri, ii);
+        if (isShapingOutput()) {
+            interleaveShaped(ro);
+        } else {
+            for (int i = 0; i < m_half; ++i) {
+                ro[i*2] = m_c[i];
+                ro[i*2+1] = m_d[i];
+            }
+        }
+    }
+
+    // As transformI, but leaving the output split into m_c (even
+    // samples) and m_d (odd samples)
+    void transformSplitI(const double *BQ_R__ ri, const double *BQ_R__ ii) {
         
         int halfhalf = m_half / 2;
         m_vr[0] = ri[0] + ri[m_half];
@@ -2228,16 +4231,56 @@ private:
             m_vi[k] = (i0 + i1 + tw_i);
             m_vi[m_half - k] = (tw_i - i0 - i1);
         }
-        transformComplex(m_vr, m_vi, m_c, m_d, true);
+        transformComplex(m_vr, m_vi, m_c, m_d, true, m_half);
+    }
+
+    // As the plain loops in transformF and transformI, but reading
+    // the input through shapeInput and writing the output through
+    // shapeOutput. Sample j of the (shaped) real sequence is m_a or
+    // m_b (m_c or m_d on output) [j/2] depending on whether j is
+    // even or odd.
+    template <typename T>
+    void deinterleaveShaped(const T *BQ_R__ ri) {
+        const T *const BQ_R__ w = shapingWindow(ri);
+        int j = m_rotation;
         for (int i = 0; i < m_half; ++i) {
-            ro[i*2] = m_c[i];
-            ro[i*2+1] = m_d[i];
+            double a = ri[j], b;
+            if (w) a *= w[j];
+            if (++j == m_size) j = 0;
+            b = ri[j];
+            if (w) b *= w[j];
+            if (++j == m_size) j = 0;
+            m_a[i] = a;
+            m_b[i] = b;
+        }
+    }
+
+    // This walks the output rather than the input, so that when the
+    // output count is short (as for FFT::inverseSamples) only the
+    // samples written are visited
+    template <typename T>
+    void interleaveShaped(T *BQ_R__ ro) {
+        const T *const BQ_R__ w = shapingWindow(ro);
+        const T g = T(m_gain);
+        const int count = shapedOutputCount();
+        int i = shapedOutputSource(0);
+        for (int j = 0; j < count; ++j) {
+            T x = T((i % 2) ? m_d[i / 2] : m_c[i / 2]);
+            if (w) x *= w[j];
+            if (m_accumulate) ro[j] += x * g;
+            else ro[j] = x;
+            if (++i == m_size) i = 0;
         }
     }
     
+    // Only the first count inputs are read, the rest being taken as
+    // zero. When count is no more than n / 2^p, the first p stages
+    // would only combine each input with zeros, leaving every block
+    // of 2^p outputs of the bit reversal equal to a single input, so
+    // those blocks are filled directly and the stages skipped.
     void transformComplex(const double *BQ_R__ ri, const double *BQ_R__ ii,
                           double *BQ_R__ ro, double *BQ_R__ io,
-                          bool inverse) {
+                          bool inverse, int count) {
 
         // Following Don Cross's 1998 implementation, described by its
         // author as public domain.
@@ -2245,17 +4288,35 @@ private:
         // Because we are at heart a real-complex fft only, and we know that:
         const int n = m_half;
 
-        for (int i = 0; i < n; ++i) {
-            int j = m_table[i];
-            ro[j] = ri[i];
-            io[j] = ii[i];
-        }
-        
         int ix = 0;
         int blockEnd = 1;
+
+        if (count < n) {
+            while (blockEnd * 2 <= n && count <= n / (blockEnd * 2)) {
+                if (blockEnd * 2 <= m_maxTabledBlock) ix += 4;
+                blockEnd <<= 1;
+            }
+            const int inputs = n / blockEnd;
+            for (int i = 0; i < inputs; ++i) {
+                const int j = m_table[i];
+                const double r = (i < count ? ri[i] : 0.0);
+                const double im = (i < count ? ii[i] : 0.0);
+                for (int m = 0; m < blockEnd; ++m) {
+                    ro[j + m] = r;
+                    io[j + m] = im;
+                }
+            }
+        } else {
+            for (int i = 0; i < n; ++i) {
+                int j = m_table[i];
+                ro[j] = ri[i];
+                io[j] = ii[i];
+            }
+        }
+        
         double ifactor = (inverse ? -1.0 : 1.0);
         
-        for (int blockSize = 2; blockSize <= n; blockSize <<= 1) {
+        for (int blockSize = blockEnd * 2; blockSize <= n; blockSize <<= 1) {
 
             double sm1, sm2, cm1, cm2;
 
@@ -2319,49 +4380,46 @@ private:
 class D_DFT : public FFTImpl
 {
 private:
+    // The twiddle tables hold one period of cos and sin, of length
+    // m_size, shared between precisions. Bin k at sample j uses
+    // entry (k * j) mod m_size. Each transform gathers the entries
+    // for one output into a contiguous row and then takes a plain
+    // dot product with it, which the compiler can vectorise.
+    
     template <typename T>
     class DFT
     {
     public:
-        DFT(int size) : m_size(size), m_bins(size/2 + 1) {
-            
-            m_sin = allocate_channels<double>(m_size, m_size);
-            m_cos = allocate_channels<double>(m_size, m_size);
-
-            for (int i = 0; i < m_size; ++i) {
-                for (int j = 0; j < m_size; ++j) {
-                    double arg = (double(i) * double(j) * M_PI * 2.0) / m_size;
-                    m_sin[i][j] = sin(arg);
-                    m_cos[i][j] = cos(arg);
-                }
-            }
-
-            m_tmp = allocate_channels<double>(2, m_size);
-        }
+        DFT(const D_DFT *owner, int size, const double *cos, const double *sin) :
+            m_owner(owner),
+            m_size(size), m_bins(size/2 + 1), m_cos(cos), m_sin(sin),
+            m_loaded(size) {
+            m_tmp = allocate_channels<double>(5, m_size);
+            m_complex = allocate_and_zero<T>(m_bins * 2);
+        }
 
         ~DFT() {
-            deallocate_channels(m_tmp, 2);
-            deallocate_channels(m_sin, m_size);
-            deallocate_channels(m_cos, m_size);
+            deallocate(m_complex);
+            deallocate_channels(m_tmp, 5);
         }
 
         void forward(const T *BQ_R__ realIn, T *BQ_R__ realOut, T *BQ_R__ imagOut) {
+            loadTime(realIn);
             for (int i = 0; i < m_bins; ++i) {
-                double re = 0.0, im = 0.0;
-                for (int j = 0; j < m_size; ++j) re += realIn[j] * m_cos[i][j];
-                for (int j = 0; j < m_size; ++j) im -= realIn[j] * m_sin[i][j];
+                double re, im;
+                dot(i, m_loaded, m_tmp[2], m_tmp[2], re, im);
                 realOut[i] = T(re);
-                imagOut[i] = T(im);
+                imagOut[i] = T(-im);
             }
         }
 
         void forwardInterleaved(const T *BQ_R__ realIn, T *BQ_R__ complexOut) {
+            loadTime(realIn);
             for (int i = 0; i < m_bins; ++i) {
-                double re = 0.0, im = 0.0;
-                for (int j = 0; j < m_size; ++j) re += realIn[j] * m_cos[i][j];
-                for (int j = 0; j < m_size; ++j) im -= realIn[j] * m_sin[i][j];
+                double re, im;
+                dot(i, m_loaded, m_tmp[2], m_tmp[2], re, im);
                 complexOut[i*2] = T(re);
-                complexOut[i*2 + 1] = T(im);
+                complexOut[i*2 + 1] = T(-im);
             }
         }
 
@@ -2374,82 +4432,254 @@ private:
         }
 
         void forwardMagnitude(const T *BQ_R__ realIn, T *BQ_R__ magOut) {
+            loadTime(realIn);
             for (int i = 0; i < m_bins; ++i) {
-                double re = 0.0, im = 0.0;
-                for (int j = 0; j < m_size; ++j) re += realIn[j] * m_cos[i][j];
-                for (int j = 0; j < m_size; ++j) im -= realIn[j] * m_sin[i][j];
+                double re, im;
+                dot(i, m_loaded, m_tmp[2], m_tmp[2], re, im);
                 magOut[i] = T(sqrt(re * re + im * im));
             }
         }
 
         void inverse(const T *BQ_R__ realIn, const T *BQ_R__ imagIn, T *BQ_R__ realOut) {
             for (int i = 0; i < m_bins; ++i) {
-                m_tmp[0][i] = realIn[i];
-                m_tmp[1][i] = imagIn[i];
+                m_tmp[2][i] = realIn[i];
+                m_tmp[3][i] = imagIn[i];
             }
-            for (int i = m_bins; i < m_size; ++i) {
-                m_tmp[0][i] = realIn[m_size - i];
-                m_tmp[1][i] = -imagIn[m_size - i];
+            synthesise(realOut);
+        }
+
+        void inverseInterleaved(const T *BQ_R__ complexIn, T *BQ_R__ realOut) {
+            for (int i = 0; i < m_bins; ++i) {
+                m_tmp[2][i] = complexIn[i*2];
+                m_tmp[3][i] = complexIn[i*2+1];
             }
-            for (int i = 0; i < m_size; ++i) {
-                double re = 0.0;
-                const double *const cos = m_cos[i];
-                const double *const sin = m_sin[i];
-                for (int j = 0; j < m_size; ++j) re += m_tmp[0][j] * cos[j];
-                for (int j = 0; j < m_size; ++j) re -= m_tmp[1][j] * sin[j];
-                realOut[i] = T(re);
+            synthesise(realOut);
+        }
+
+        void inversePolar(const T *BQ_R__ magIn, const T *BQ_R__ phaseIn, T *BQ_R__ realOut) {
+            v_polar_to_cartesian_interleaved(m_complex, magIn, phaseIn, m_bins);
+            inverseInterleaved(m_complex, realOut);
+        }
+
+        void inverseCepstral(const T *BQ_R__ magIn, T *BQ_R__ cepOut) {
+            magnitudeToLog(m_tmp[2], magIn, m_bins);
+            v_zero(m_tmp[3], m_bins);
+            synthesise(cepOut);
+        }
+
+        void forwardPower(const T *BQ_R__ realIn, T *BQ_R__ powerOut) {
+            loadTime(realIn);
+            for (int i = 0; i < m_bins; ++i) {
+                double re, im;
+                dot(i, m_loaded, m_tmp[2], m_tmp[2], re, im);
+                powerOut[i] = T(re * re + im * im);
             }
         }
 
-        void inverseInterleaved(const T *BQ_R__ complexIn, T *BQ_R__ realOut) {
+        void inversePower(const T *BQ_R__ powerIn, T *BQ_R__ realOut) {
             for (int i = 0; i < m_bins; ++i) {
-                m_tmp[0][i] = complexIn[i*2];
-                m_tmp[1][i] = complexIn[i*2+1];
+                m_tmp[2][i] = powerIn[i];
+                m_tmp[3][i] = 0.0;
             }
-            for (int i = m_bins; i < m_size; ++i) {
-                m_tmp[0][i] = complexIn[(m_size - i) * 2];
-                m_tmp[1][i] = -complexIn[(m_size - i) * 2 + 1];
+            synthesise(realOut);
+        }
+
+        void forwardLogPower(const T *BQ_R__ realIn, T *BQ_R__ logOut, T floor, T scale) {
+            loadTime(realIn);
+            for (int i = 0; i < m_bins; ++i) {
+                double re, im;
+                dot(i, m_loaded, m_tmp[2], m_tmp[2], re, im);
+                const double p = re * re + im * im;
+                logOut[i] = T(fastLog(clampPower(p, double(floor))) * scale);
             }
-            for (int i = 0; i < m_size; ++i) {
-                double re = 0.0;
-                const double *const cos = m_cos[i];
-                const double *const sin = m_sin[i];
-                for (int j = 0; j < m_size; ++j) re += m_tmp[0][j] * cos[j];
-                for (int j = 0; j < m_size; ++j) re -= m_tmp[1][j] * sin[j];
-                realOut[i] = T(re);
+        }
+
+        // The spectrum of b is held in m_tmp[3] and m_tmp[4] while
+        // that of a is taken, each bin of the product replacing it
+        // there; it is then moved down to m_tmp[2] and m_tmp[3] for
+        // synthesise
+        void correlate(const T *BQ_R__ a, const T *BQ_R__ b, T *BQ_R__ out, T scale) {
+            loadTime(b);
+            for (int i = 0; i < m_bins; ++i) {
+                double re, im;
+                dot(i, m_loaded, m_tmp[2], m_tmp[2], re, im);
+                m_tmp[3][i] = re;
+                m_tmp[4][i] = -im;
             }
+            loadTime(a);
+            for (int i = 0; i < m_bins; ++i) {
+                double re, im;
+                dot(i, m_loaded, m_tmp[2], m_tmp[2], re, im);
+                im = -im;
+                const double br = m_tmp[3][i], bi = m_tmp[4][i];
+                m_tmp[3][i] = (re * br + im * bi) * scale;
+                m_tmp[4][i] = (im * br - re * bi) * scale;
+            }
+            v_copy(m_tmp[2], m_tmp[3], m_bins);
+            v_copy(m_tmp[3], m_tmp[4], m_bins);
+            synthesise(out);
         }
 
-        void inversePolar(const T *BQ_R__ magIn, const T *BQ_R__ phaseIn, T *BQ_R__ realOut) {
-            T *complexIn = allocate<T>(m_bins * 2);
-            v_polar_to_cartesian_interleaved(complexIn, magIn, phaseIn, m_bins);
-            inverseInterleaved(complexIn, realOut);
-            deallocate(complexIn);
+        void autocorrelate(const T *BQ_R__ in, T *BQ_R__ out, T scale) {
+            loadTime(in);
+            for (int i = 0; i < m_bins; ++i) {
+                double re, im;
+                dot(i, m_loaded, m_tmp[2], m_tmp[2], re, im);
+                m_tmp[3][i] = (re * re + im * im) * scale;
+            }
+            v_copy(m_tmp[2], m_tmp[3], m_bins);
+            v_zero(m_tmp[3], m_bins);
+            synthesise(out);
         }
 
-        void inverseCepstral(const T *BQ_R__ magIn, T *BQ_R__ cepOut) {
-            T *complexIn = allocate_and_zero<T>(m_bins * 2);
+        // Only the bins asked for are summed
+        void forwardBins(const T *BQ_R__ realIn, int first, int last, T *BQ_R__ realOut, T *BQ_R__ imagOut) {
+            loadTime(realIn);
+            for (int i = first; i < last; ++i) {
+                double re, im;
+                dot(i, m_loaded, m_tmp[2], m_tmp[2], re, im);
+                realOut[i - first] = T(re);
+                imagOut[i - first] = T(-im);
+            }
+        }
+
+        void forwardBinsMagnitude(const T *BQ_R__ realIn, int first, int last, T *BQ_R__ magOut) {
+            loadTime(realIn);
+            for (int i = first; i < last; ++i) {
+                double re, im;
+                dot(i, m_loaded, m_tmp[2], m_tmp[2], re, im);
+                magOut[i - first] = T(sqrt(re * re + im * im));
+            }
+        }
+
+        // The log spectrum is real and even, and so is its cepstrum,
+        // so neither transform after the first needs its sine sums.
+        // Only the quefrencies kept by the lifter are synthesised
+        // (into m_tmp[4]), and the final transform sums only those,
+        // each weighted by two for its mirror as in synthesise.
+        void cepstralEnvelope(const T *BQ_R__ frame, int cutoff, T *BQ_R__ envOut) {
+            loadTime(frame);
+            double *const BQ_R__ logMag = m_tmp[3];
             for (int i = 0; i < m_bins; ++i) {
-                complexIn[i*2] = T(log(magIn[i] + 0.000001));
+                double re, im;
+                dot(i, m_loaded, m_tmp[2], m_tmp[2], re, im);
+                logMag[i] = fastLog(sqrt(re * re + im * im) + 0.000001);
+            }
+            int last = (m_size % 2 == 0) ? m_bins - 1 : m_bins;
+            for (int i = 1; i < last; ++i) logMag[i] *= 2.0;
+            const int k = (cutoff < m_size/2 ? cutoff : m_size/2);
+            double *const BQ_R__ cep = m_tmp[4];
+            for (int i = 0; i <= k; ++i) {
+                cep[i] = dotCos(i, m_bins, logMag) / m_size;
+                if (i > 0 && i * 2 != m_size) cep[i] *= 2.0;
+            }
+            for (int i = 0; i < m_bins; ++i) {
+                envOut[i] = T(exp(dotCos(i, k + 1, cep)));
             }
-            inverseInterleaved(complexIn, cepOut);
-            deallocate(complexIn);
         }
 
     private:
+        const D_DFT *const m_owner; // for input and output shaping
         const int m_size;
         const int m_bins;
-        double **m_sin;
-        double **m_cos;
+        const double *const m_cos;
+        const double *const m_sin;
         double **m_tmp;
+        T *m_complex;
+        int m_loaded;
+
+        // Zero padding is not loaded, and m_loaded is set to the
+        // number of samples that were, for the forward sums to stop
+        // at
+        void loadTime(const T *BQ_R__ realIn) {
+            double *const in = m_tmp[2];
+            if (m_owner->isPaddingInput()) {
+                m_loaded = m_owner->m_length;
+                for (int j = 0; j < m_loaded; ++j) in[j] = realIn[j];
+                return;
+            }
+            m_loaded = m_size;
+            if (m_owner->isShapingInput()) {
+                m_owner->shapeInput(in, realIn, m_size);
+                return;
+            }
+            for (int j = 0; j < m_size; ++j) in[j] = realIn[j];
+        }
+
+        // Sum of x[j] cos(2 pi k j / size) and y[j] sin(2 pi k j /
+        // size) for j in 0..n-1
+        void dot(int k, int n, const double *BQ_R__ x, const double *BQ_R__ y,
+                 double &xc, double &ys) {
+            double *const BQ_R__ c = m_tmp[0];
+            double *const BQ_R__ s = m_tmp[1];
+            int ix = 0;
+            for (int j = 0; j < n; ++j) {
+                c[j] = m_cos[ix];
+                s[j] = m_sin[ix];
+                ix += k;
+                if (ix >= m_size) ix -= m_size;
+            }
+            xc = 0.0;
+            ys = 0.0;
+            for (int j = 0; j < n; ++j) xc += x[j] * c[j];
+            for (int j = 0; j < n; ++j) ys += y[j] * s[j];
+        }
+
+        // Sum of x[j] cos(2 pi k j / size) for j in 0..n-1
+        double dotCos(int k, int n, const double *BQ_R__ x) {
+            double *const BQ_R__ c = m_tmp[0];
+            int ix = 0;
+            for (int j = 0; j < n; ++j) {
+                c[j] = m_cos[ix];
+                ix += k;
+                if (ix >= m_size) ix -= m_size;
+            }
+            double xc = 0.0;
+            for (int j = 0; j < n; ++j) xc += x[j] * c[j];
+            return xc;
+        }
+
+        // The spectrum is Hermitian, so bins above m_bins contribute
+        // the same real output as their mirrors below it: weight
+        // every bin other than DC (and Nyquist, for even sizes) by
+        // two and sum only the first m_bins
+        void synthesise(T *BQ_R__ realOut) {
+            int last = (m_size % 2 == 0) ? m_bins - 1 : m_bins;
+            for (int i = 1; i < last; ++i) {
+                m_tmp[2][i] *= 2.0;
+                m_tmp[3][i] *= 2.0;
+            }
+            double *const out = m_tmp[4];
+            if (m_owner->isShapingOutput()) {
+                // Only the samples that shapeOutput reads are summed
+                const int count = m_owner->shapedOutputCount();
+                for (int j = 0; j < count; ++j) {
+                    const int i = m_owner->shapedOutputSource(j);
+                    double re, im;
+                    dot(i, m_bins, m_tmp[2], m_tmp[3], re, im);
+                    out[i] = re - im;
+                }
+                m_owner->shapeOutput(realOut, out, m_size);
+                return;
+            }
+            for (int i = 0; i < m_size; ++i) {
+                double re, im;
+                dot(i, m_bins, m_tmp[2], m_tmp[3], re, im);
+                out[i] = re - im;
+            }
+            for (int i = 0; i < m_size; ++i) realOut[i] = T(out[i]);
+        }
     };
     
 public:
-    D_DFT(int size) : m_size(size), m_double(0), m_float(0) { }
+    D_DFT(int size) :
+        m_size(size), m_cos(0), m_sin(0), m_double(0), m_float(0) { }
 
     ~D_DFT() {
         delete m_double;
         delete m_float;
+        deallocate(m_cos);
+        deallocate(m_sin);
     }
 
     int getSize() const {
@@ -2461,15 +4691,23 @@ public:
         return FFT::DoublePrecision;
     }
 
+    int getPreferredAlignment() const {
+        return 16;
+    }
+
     void initFloat() {
         if (!m_float) {
-            m_float = new DFT<float>(m_size);
+            FFT_PROBE3(plan__create, m_size, 32, "dft");
+            initTables();
+            m_float = new DFT<float>(this, m_size, m_cos, m_sin);
         }
     }
         
     void initDouble() {
         if (!m_double) {
-            m_double = new DFT<double>(m_size);
+            FFT_PROBE3(plan__create, m_size, 64, "dft");
+            initTables();
+            m_double = new DFT<double>(this, m_size, m_cos, m_sin);
         }
     }
 
@@ -2553,10 +4791,103 @@ public:
         m_float->inverseCepstral(magIn, cepOut);
     }
 
+    void forwardPower(const double *BQ_R__ realIn, double *BQ_R__ powerOut) {
+        initDouble();
+        m_double->forwardPower(realIn, powerOut);
+    }
+
+    void inversePower(const double *BQ_R__ powerIn, double *BQ_R__ realOut) {
+        initDouble();
+        m_double->inversePower(powerIn, realOut);
+    }
+
+    void forwardPower(const float *BQ_R__ realIn, float *BQ_R__ powerOut) {
+        initFloat();
+        m_float->forwardPower(realIn, powerOut);
+    }
+
+    void inversePower(const float *BQ_R__ powerIn, float *BQ_R__ realOut) {
+        initFloat();
+        m_float->inversePower(powerIn, realOut);
+    }
+
+    void forwardLogPower(const double *BQ_R__ realIn, double *BQ_R__ logOut, double floor, double scale) {
+        initDouble();
+        m_double->forwardLogPower(realIn, logOut, floor, scale);
+    }
+
+    void forwardLogPower(const float *BQ_R__ realIn, float *BQ_R__ logOut, float floor, float scale) {
+        initFloat();
+        m_float->forwardLogPower(realIn, logOut, floor, scale);
+    }
+
+    void cepstralEnvelope(const double *BQ_R__ frame, int cutoff, double *BQ_R__ envOut) {
+        initDouble();
+        m_double->cepstralEnvelope(frame, cutoff, envOut);
+    }
+
+    void cepstralEnvelope(const float *BQ_R__ frame, int cutoff, float *BQ_R__ envOut) {
+        initFloat();
+        m_float->cepstralEnvelope(frame, cutoff, envOut);
+    }
+
+    void forwardBins(const double *BQ_R__ realIn, int first, int last, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        initDouble();
+        m_double->forwardBins(realIn, first, last, realOut, imagOut);
+    }
+
+    void forwardBinsMagnitude(const double *BQ_R__ realIn, int first, int last, double *BQ_R__ magOut) {
+        initDouble();
+        m_double->forwardBinsMagnitude(realIn, first, last, magOut);
+    }
+
+    void forwardBins(const float *BQ_R__ realIn, int first, int last, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        initFloat();
+        m_float->forwardBins(realIn, first, last, realOut, imagOut);
+    }
+
+    void forwardBinsMagnitude(const float *BQ_R__ realIn, int first, int last, float *BQ_R__ magOut) {
+        initFloat();
+        m_float->forwardBinsMagnitude(realIn, first, last, magOut);
+    }
+
+    void correlate(const double *BQ_R__ a, const double *BQ_R__ b, double *BQ_R__ out, double scale) {
+        initDouble();
+        m_double->correlate(a, b, out, scale);
+    }
+
+    void autocorrelate(const double *BQ_R__ in, double *BQ_R__ out, double scale) {
+        initDouble();
+        m_double->autocorrelate(in, out, scale);
+    }
+
+    void correlate(const float *BQ_R__ a, const float *BQ_R__ b, float *BQ_R__ out, float scale) {
+        initFloat();
+        m_float->correlate(a, b, out, scale);
+    }
+
+    void autocorrelate(const float *BQ_R__ in, float *BQ_R__ out, float scale) {
+        initFloat();
+        m_float->autocorrelate(in, out, scale);
+    }
+
 private:
     int m_size;
+    double *m_cos;
+    double *m_sin;
     DFT<double> *m_double;
     DFT<float> *m_float;
+
+    void initTables() {
+        if (m_cos) return;
+        m_cos = allocate<double>(m_size);
+        m_sin = allocate<double>(m_size);
+        for (int i = 0; i < m_size; ++i) {
+            double arg = (double(i) * M_PI * 2.0) / m_size;
+            m_cos[i] = cos(arg);
+            m_sin[i] = sin(arg);
+        }
+    }
 };
 
 } /* end namespace FFTs */
@@ -2601,108 +4932,64 @@ getImplementationDetails()
     return impls;
 }
 
-static std::string
-pickImplementation(int size)
-{
-    ImplMap impls = getImplementationDetails();
-
-    bool isPowerOfTwo = !(size & (size-1));
-    bool isEven = !(size & 1);
-
-    if (defaultImplementation != "") {
-        ImplMap::const_iterator itr = impls.find(defaultImplementation);
-        if (itr != impls.end()) {
-            if (((itr->second & SizeConstraintPowerOfTwo) && !isPowerOfTwo) ||
-                ((itr->second & SizeConstraintEven) && !isEven)) {
-//                std::cerr << "NOTE: bqfft: Explicitly-set default "
-//                          << "implementation \"" << defaultImplementation
-//                          << "\" does not support size " << size
-//                          << ", trying other compiled-in implementations"
-//                          << std::endl;
-            } else {
-                return defaultImplementation;
-            }
-        } else {
-            std::cerr << "WARNING: bqfft: Default implementation \""
-                      << defaultImplementation << "\" is not compiled in"
-                      << std::endl;
-        }
-    } 
-    
-    std::string preference[] = {
-        "ipp", "vdsp", "sleef", "fftw", "builtin", "kissfft"
-    };
-
-    for (int i = 0; i < int(sizeof(preference)/sizeof(preference[0])); ++i) {
-        ImplMap::const_iterator itr = impls.find(preference[i]);
-        if (itr != impls.end()) {
-            if ((itr->second & SizeConstraintPowerOfTwo) &&
-                // out of an abundance of caution we don't attempt to
-                // use power-of-two implementations with size 2
-                // either, as they may involve a half-half
-                // complex-complex underneath (which would end up with
-                // size 0)
-                (!isPowerOfTwo || size < 4)) {
-                continue;
-            }
-            if ((itr->second & SizeConstraintEven) && !isEven) {
-                continue;
-            }
-            return preference[i];
-        }
-    }
+// Preference order for picking an implementation when neither an
+// explicit default nor a tuning result applies. The DFT is not listed
+// as it is only ever a fallback.
+static const char *const implementationPreference[] = {
+    "ipp", "vdsp", "sleef", "fftw", "builtin", "kissfft"
+};
 
-    std::cerr << "WARNING: bqfft: No compiled-in implementation supports size "
-              << size << ", falling back to slow DFT" << std::endl;
-    
-    return "dft";
-}
+static const int implementationPreferenceCount =
+    int(sizeof(implementationPreference) / sizeof(implementationPreference[0]));
 
-std::set<std::string>
-FFT::getImplementations()
+// The precisions each implementation computes in natively (without
+// converting through the other), as reported by its
+// getSupportedPrecisions but known without constructing it
+static FFT::Precisions
+getNativePrecisions(std::string impl)
 {
-    ImplMap impls = getImplementationDetails();
-    std::set<std::string> toReturn;
-    for (ImplMap::const_iterator i = impls.begin(); i != impls.end(); ++i) {
-        toReturn.insert(i->first);
+    if (impl == "fftw") {
+#ifdef FFTW_SINGLE_ONLY
+        return FFT::SinglePrecision;
+#else
+#ifdef FFTW_DOUBLE_ONLY
+        return FFT::DoublePrecision;
+#else
+        return FFT::SinglePrecision | FFT::DoublePrecision;
+#endif
+#endif
     }
-    return toReturn;
+    if (impl == "builtin" || impl == "dft") {
+        return FFT::DoublePrecision;
+    }
+    return FFT::SinglePrecision | FFT::DoublePrecision;
 }
 
-std::string
-FFT::getDefaultImplementation()
+static bool
+isUsableForSize(SizeConstraint constraint, int size)
 {
-    return defaultImplementation;
-}
+    bool isPowerOfTwo = !(size & (size-1));
+    bool isEven = !(size & 1);
 
-void
-FFT::setDefaultImplementation(std::string i)
-{
-    if (i == "") {
-        defaultImplementation = i;
-        return;
-    } 
-    ImplMap impls = getImplementationDetails();
-    ImplMap::const_iterator itr = impls.find(i);
-    if (itr == impls.end()) {
-        std::cerr << "WARNING: bqfft: setDefaultImplementation: "
-                  << "requested implementation \"" << i
-                  << "\" is not compiled in" << std::endl;
-    } else {
-        defaultImplementation = i;
+    if ((constraint & SizeConstraintPowerOfTwo) &&
+        // out of an abundance of caution we don't attempt to use
+        // power-of-two implementations with size 2 either, as they
+        // may involve a half-half complex-complex underneath (which
+        // would end up with size 0)
+        (!isPowerOfTwo || size < 4)) {
+        return false;
+    }
+    if ((constraint & SizeConstraintEven) && !isEven) {
+        return false;
     }
+    return true;
 }
 
-FFT::FFT(int size, int debugLevel) :
-    d(0)
+static FFTImpl *
+createImplementation(std::string impl, int size)
 {
-    std::string impl = pickImplementation(size);
-
-    if (debugLevel > 0) {
-        std::cerr << "FFT::FFT(" << size << "): using implementation: "
-                  << impl << std::endl;
-    }
-
+    FFTImpl *d = 0;
+    
     if (impl == "ipp") {
 #ifdef HAVE_IPP
         d = new FFTs::D_IPP(size);
@@ -2731,464 +5018,3129 @@ FFT::FFT(int size, int debugLevel) :
         d = new FFTs::D_DFT(size);
     }
 
-    if (!d) {
-        std::cerr << "FFT::FFT(" << size << "): ERROR: implementation "
-                  << impl << " is not compiled in" << std::endl;
-#ifndef NO_EXCEPTIONS
-        throw InvalidImplementation;
-#else
-        abort();
-#endif
-    }
+    return d;
 }
 
-FFT::~FFT()
+// The sixteen transform methods, in the order used by the tuning
+// file and the measurement code. The names are those written to the
+// tuning file, so they must not change without bumping
+// tuningFileVersion.
+
+enum MethodType {
+    ForwardDouble,
+    ForwardInterleavedDouble,
+    ForwardPolarDouble,
+    ForwardMagnitudeDouble,
+    ForwardFloat,
+    ForwardInterleavedFloat,
+    ForwardPolarFloat,
+    ForwardMagnitudeFloat,
+    InverseDouble,
+    InverseInterleavedDouble,
+    InversePolarDouble,
+    InverseCepstralDouble,
+    InverseFloat,
+    InverseInterleavedFloat,
+    InversePolarFloat,
+    InverseCepstralFloat,
+    MethodTypeCount
+};
+
+static const char *const methodTypeNames[MethodTypeCount] = {
+    "forwardDouble",
+    "forwardInterleavedDouble",
+    "forwardPolarDouble",
+    "forwardMagnitudeDouble",
+    "forwardFloat",
+    "forwardInterleavedFloat",
+    "forwardPolarFloat",
+    "forwardMagnitudeFloat",
+    "inverseDouble",
+    "inverseInterleavedDouble",
+    "inversePolarDouble",
+    "inverseCepstralDouble",
+    "inverseFloat",
+    "inverseInterleavedFloat",
+    "inversePolarFloat",
+    "inverseCepstralFloat"
+};
+
+static int
+getMethodType(std::string name)
 {
-    delete d;
+    for (int i = 0; i < MethodTypeCount; ++i) {
+        if (name == methodTypeNames[i]) return i;
+    }
+    return -1;
 }
 
-#ifndef NO_EXCEPTIONS
-#define CHECK_NOT_NULL(x) \
-    if (!(x)) { \
-        std::cerr << "FFT: ERROR: Null argument " #x << std::endl;  \
-        throw NullArgument; \
-    }
+// Monotonic clock for measurement, in nanoseconds from an arbitrary
+// origin
+static double
+getMonotonicTimeNs()
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return double(counter.QuadPart) * 1.0e9 / double(frequency.QuadPart);
 #else
-#define CHECK_NOT_NULL(x) \
-    if (!(x)) { \
-        std::cerr << "FFT: ERROR: Null argument " #x << std::endl;  \
-        std::cerr << "FFT: Would be throwing NullArgument here, if exceptions were not disabled" << std::endl;  \
-        return; \
-    }
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return double(ts.tv_sec) * 1.0e9 + double(ts.tv_nsec);
 #endif
+}
 
-void
-FFT::forward(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut)
+// Input and output buffers for running any of the method types at a
+// given size. Inputs are filled with deterministic pseudo-random
+// values; magnitudes are kept positive so that the cepstral methods
+// are timed on finite data.
+
+struct MeasurementBuffers
 {
-    CHECK_NOT_NULL(realIn);
-    CHECK_NOT_NULL(realOut);
-    CHECK_NOT_NULL(imagOut);
-    d->forward(realIn, realOut, imagOut);
+    MeasurementBuffers(int size) :
+        dtime(allocate<double>(size)),
+        dre(allocate<double>(size/2 + 1)),
+        dim(allocate<double>(size/2 + 1)),
+        dmag(allocate<double>(size/2 + 1)),
+        dcplx(allocate<double>(size + 2)),
+        douta(allocate<double>(size + 2)),
+        doutb(allocate<double>(size + 2)),
+        ftime(allocate<float>(size)),
+        fre(allocate<float>(size/2 + 1)),
+        fim(allocate<float>(size/2 + 1)),
+        fmag(allocate<float>(size/2 + 1)),
+        fcplx(allocate<float>(size + 2)),
+        fouta(allocate<float>(size + 2)),
+        foutb(allocate<float>(size + 2)) {
+        unsigned int seed = 1;
+        for (int i = 0; i < size; ++i) {
+            dtime[i] = next(seed);
+        }
+        for (int i = 0; i <= size/2; ++i) {
+            dre[i] = next(seed);
+            dim[i] = next(seed);
+            dmag[i] = fabs(next(seed)) + 0.1;
+            dcplx[i*2] = dre[i];
+            dcplx[i*2+1] = dim[i];
+        }
+        v_convert(ftime, dtime, size);
+        v_convert(fre, dre, size/2 + 1);
+        v_convert(fim, dim, size/2 + 1);
+        v_convert(fmag, dmag, size/2 + 1);
+        v_convert(fcplx, dcplx, size + 2);
+    }
+    ~MeasurementBuffers() {
+        deallocate(dtime);
+        deallocate(dre);
+        deallocate(dim);
+        deallocate(dmag);
+        deallocate(dcplx);
+        deallocate(douta);
+        deallocate(doutb);
+        deallocate(ftime);
+        deallocate(fre);
+        deallocate(fim);
+        deallocate(fmag);
+        deallocate(fcplx);
+        deallocate(fouta);
+        deallocate(foutb);
+    }
+
+    double *dtime, *dre, *dim, *dmag, *dcplx, *douta, *doutb;
+    float *ftime, *fre, *fim, *fmag, *fcplx, *fouta, *foutb;
+
+private:
+    static double next(unsigned int &seed) {
+        seed = seed * 1103515245u + 12345u;
+        return double((seed >> 8) & 0xffff) / 32768.0 - 1.0;
+    }
+    MeasurementBuffers(const MeasurementBuffers &); // not provided
+    MeasurementBuffers &operator=(const MeasurementBuffers &); // not provided
+};
+
+static void
+runMethod(FFTImpl *d, int type, MeasurementBuffers &b)
+{
+    switch (type) {
+    case ForwardDouble:
+        d->forward(b.dtime, b.douta, b.doutb); break;
+    case ForwardInterleavedDouble:
+        d->forwardInterleaved(b.dtime, b.douta); break;
+    case ForwardPolarDouble:
+        d->forwardPolar(b.dtime, b.douta, b.doutb); break;
+    case ForwardMagnitudeDouble:
+        d->forwardMagnitude(b.dtime, b.douta); break;
+    case ForwardFloat:
+        d->forward(b.ftime, b.fouta, b.foutb); break;
+    case ForwardInterleavedFloat:
+        d->forwardInterleaved(b.ftime, b.fouta); break;
+    case ForwardPolarFloat:
+        d->forwardPolar(b.ftime, b.fouta, b.foutb); break;
+    case ForwardMagnitudeFloat:
+        d->forwardMagnitude(b.ftime, b.fouta); break;
+    case InverseDouble:
+        d->inverse(b.dre, b.dim, b.douta); break;
+    case InverseInterleavedDouble:
+        d->inverseInterleaved(b.dcplx, b.douta); break;
+    case InversePolarDouble:
+        d->inversePolar(b.dmag, b.dim, b.douta); break;
+    case InverseCepstralDouble:
+        d->inverseCepstral(b.dmag, b.douta); break;
+    case InverseFloat:
+        d->inverse(b.fre, b.fim, b.fouta); break;
+    case InverseInterleavedFloat:
+        d->inverseInterleaved(b.fcplx, b.fouta); break;
+    case InversePolarFloat:
+        d->inversePolar(b.fmag, b.fim, b.fouta); break;
+    case InverseCepstralFloat:
+        d->inverseCepstral(b.fmag, b.fouta); break;
+    }
 }
 
-void
-FFT::forwardInterleaved(const double *BQ_R__ realIn, double *BQ_R__ complexOut)
+// Timing of one method, in ns per call, over a number of batches
+struct MethodTiming
 {
-    CHECK_NOT_NULL(realIn);
-    CHECK_NOT_NULL(complexOut);
-    d->forwardInterleaved(realIn, complexOut);
+    double mean;
+    double min;
+    double p10;
+    double p50;
+    double p90;
+    double max;
+    int iterations; // per batch
+    int batches;
+};
+
+static double
+runBatch(FFTImpl *d, int type, MeasurementBuffers &b, int iterations)
+{
+    double start = getMonotonicTimeNs();
+    for (int i = 0; i < iterations; ++i) {
+        runMethod(d, type, b);
+    }
+    return (getMonotonicTimeNs() - start) / iterations;
 }
 
-void
-FFT::forwardPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut)
+// Time the given method. The first calls are discarded (they may
+// include lazy initialisation) and the iteration count is doubled
+// until a batch takes at least minBatchNs, so that the clock
+// resolution is insignificant; then the requested number of batches
+// is run and summarised.
+static MethodTiming
+measureMethod(FFTImpl *d, int type, MeasurementBuffers &b,
+              int batches, double minBatchNs)
+{
+    runMethod(d, type, b);
+    runMethod(d, type, b);
+
+    int iterations = 1;
+    while (iterations < (1 << 20) &&
+           runBatch(d, type, b, iterations) * iterations < minBatchNs) {
+        iterations *= 2;
+    }
+
+    std::vector<double> times;
+    double total = 0.0;
+    for (int i = 0; i < batches; ++i) {
+        double t = runBatch(d, type, b, iterations);
+        times.push_back(t);
+        total += t;
+    }
+    std::sort(times.begin(), times.end());
+
+    MethodTiming timing;
+    timing.mean = total / batches;
+    timing.min = times[0];
+    timing.p10 = times[int(0.1 * (batches - 1) + 0.5)];
+    timing.p50 = times[int(0.5 * (batches - 1) + 0.5)];
+    timing.p90 = times[int(0.9 * (batches - 1) + 0.5)];
+    timing.max = times[batches - 1];
+    timing.iterations = iterations;
+    timing.batches = batches;
+    return timing;
+}
+
+// Identify the host CPU, so that a tuning file written on one machine
+// is not applied on another (e.g. with a shared home directory)
+static std::string
+getCPUModel()
+{
+    std::string model;
+    
+#if defined(__APPLE__)
+    char buf[256];
+    size_t len = sizeof(buf);
+    if (sysctlbyname("machdep.cpu.brand_string", buf, &len, 0, 0) == 0) {
+        model = std::string(buf, strnlen(buf, len));
+    } else {
+        len = sizeof(buf);
+        if (sysctlbyname("hw.model", buf, &len, 0, 0) == 0) {
+            model = std::string(buf, strnlen(buf, len));
+        }
+    }
+#elif defined(_WIN32)
+    const char *id = getenv("PROCESSOR_IDENTIFIER");
+    if (id) model = id;
+#else
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line, implementer, part;
+    while (model == "" && std::getline(cpuinfo, line)) {
+        std::string::size_type colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        std::string key = line.substr(0, line.find_last_not_of(" \t", colon - 1) + 1);
+        std::string value = line.substr(colon + 1);
+        std::string::size_type start = value.find_first_not_of(" \t");
+        value = (start == std::string::npos ? "" : value.substr(start));
+        if (key == "model name" || key == "Hardware") {
+            model = value;
+        } else if (key == "CPU implementer" && implementer == "") {
+            implementer = value;
+        } else if (key == "CPU part" && part == "") {
+            part = value;
+        }
+    }
+    if (model == "" && implementer != "") {
+        model = "implementer " + implementer + " part " + part;
+    }
+#endif
+
+    if (model == "") model = "unknown";
+    return model;
+}
+
+// Tuning table: size -> method type -> implementation -> ns per call
+
+typedef std::map<std::string, double> ImplTimings;
+typedef std::map<int, ImplTimings> MethodTimings;
+typedef std::map<int, MethodTimings> TuningTable;
+
+static const int tuningFileVersion = 1;
+
+static std::string tuningFile;
+static bool tuningFileSet = false;
+static bool tuningLoaded = false;
+static TuningTable tuningTable;
+
+#ifndef NO_THREADING
+#ifdef _WIN32
+static HANDLE tuningMutex = CreateMutex(NULL, FALSE, NULL);
+static void lockTuning() { WaitForSingleObject(tuningMutex, INFINITE); }
+static void unlockTuning() { ReleaseMutex(tuningMutex); }
+#else
+static pthread_mutex_t tuningMutex = PTHREAD_MUTEX_INITIALIZER;
+static void lockTuning() { pthread_mutex_lock(&tuningMutex); }
+static void unlockTuning() { pthread_mutex_unlock(&tuningMutex); }
+#endif
+#else
+static void lockTuning() { }
+static void unlockTuning() { }
+#endif
+
+// Call with tuning lock held
+static std::string
+getTuningFileName()
+{
+    if (tuningFileSet) {
+        return tuningFile;
+    }
+    const char *home = getenv("HOME");
+    if (!home) {
+        return "";
+    }
+    return std::string(home) + "/.bqfft.tuning";
+}
+
+static bool
+readTuningFile(std::string filename, TuningTable &table)
+{
+    std::ifstream in(filename.c_str());
+    if (!in) {
+        return false;
+    }
+
+    std::string line, tag;
+    int version = 0;
+    if (!std::getline(in, line)) {
+        return false;
+    }
+    std::istringstream header(line);
+    if (!(header >> tag >> version) ||
+        tag != "bqfft-tuning" || version != tuningFileVersion) {
+        std::cerr << "WARNING: bqfft: Ignoring tuning file \"" << filename
+                  << "\" with unknown format" << std::endl;
+        return false;
+    }
+
+    if (!std::getline(in, line) ||
+        line.substr(0, 4) != "cpu " ||
+        line.substr(4) != getCPUModel()) {
+        // Written on a different machine: not an error, just not
+        // applicable here
+        return false;
+    }
+
+    TuningTable read;
+    while (std::getline(in, line)) {
+        std::istringstream entry(line);
+        int size = 0;
+        std::string method, impl;
+        double ns = 0.0;
+        if (!(entry >> size >> method >> impl >> ns)) {
+            continue;
+        }
+        int type = getMethodType(method);
+        if (size <= 0 || type < 0 || ns <= 0.0) {
+            continue;
+        }
+        read[size][type][impl] = ns;
+    }
+
+    table = read;
+    return true;
+}
+
+static bool
+writeTuningFile(std::string filename, const TuningTable &table)
+{
+    std::ofstream out(filename.c_str());
+    if (!out) {
+        return false;
+    }
+    out << "bqfft-tuning " << tuningFileVersion << "\n";
+    out << "cpu " << getCPUModel() << "\n";
+    for (TuningTable::const_iterator si = table.begin();
+         si != table.end(); ++si) {
+        for (MethodTimings::const_iterator mi = si->second.begin();
+             mi != si->second.end(); ++mi) {
+            for (ImplTimings::const_iterator ii = mi->second.begin();
+                 ii != mi->second.end(); ++ii) {
+                out << si->first << " " << methodTypeNames[mi->first]
+                    << " " << ii->first << " " << ii->second << "\n";
+            }
+        }
+    }
+    return bool(out);
+}
+
+// The tuning table digested into the implementation to use at each
+// measured size, overall and for each method type, so that picking
+// implementations for a new FFT object takes one lookup. An empty
+// string means the table has nothing usable for that choice.
+
+struct TunedChoices
+{
+    std::string overall;
+    std::string methods[MethodTypeCount];
+};
+
+typedef std::map<int, TunedChoices> TunedIndex;
+
+static TunedIndex tunedIndex;
+
+// Return the compiled-in implementation recorded as fastest in these
+// timings for one size, for the given method type or (if type is
+// negative) in total across all measured methods, or an empty string
+// if there is none.
+static std::string
+findFastest(const MethodTimings &timings, const ImplMap &impls,
+            int size, int type)
+{
+    ImplTimings totals;
+    std::map<std::string, int> counts;
+    int methods = 0;
+
+    for (MethodTimings::const_iterator mi = timings.begin();
+         mi != timings.end(); ++mi) {
+        if (type >= 0 && mi->first != type) {
+            continue;
+        }
+        ++methods;
+        for (ImplTimings::const_iterator ii = mi->second.begin();
+             ii != mi->second.end(); ++ii) {
+            totals[ii->first] += ii->second;
+            counts[ii->first] += 1;
+        }
+    }
+
+    std::string best;
+    double bestTime = 0.0;
+    for (ImplTimings::const_iterator ii = totals.begin();
+         ii != totals.end(); ++ii) {
+        // Only consider implementations measured for every method,
+        // so that the totals are comparable
+        if (counts[ii->first] != methods) continue;
+        ImplMap::const_iterator itr = impls.find(ii->first);
+        if (itr == impls.end()) continue;
+        if (!isUsableForSize(itr->second, size)) continue;
+        if (best == "" || ii->second < bestTime) {
+            best = ii->first;
+            bestTime = ii->second;
+        }
+    }
+    return best;
+}
+
+// Call with tuning lock held
+static void
+indexTuningTable()
+{
+    ImplMap impls = getImplementationDetails();
+    tunedIndex.clear();
+    for (TuningTable::const_iterator si = tuningTable.begin();
+         si != tuningTable.end(); ++si) {
+        TunedChoices &choices = tunedIndex[si->first];
+        choices.overall = findFastest(si->second, impls, si->first, -1);
+        for (int type = 0; type < MethodTypeCount; ++type) {
+            choices.methods[type] =
+                findFastest(si->second, impls, si->first, type);
+        }
+    }
+}
+
+// Call with tuning lock held. The file is read only once, when the
+// first FFT object is constructed, and again only if setTuningFile
+// names another.
+static void
+ensureTuningLoaded()
+{
+    if (tuningLoaded) {
+        return;
+    }
+    tuningTable.clear();
+    std::string filename = getTuningFileName();
+    if (filename != "") {
+        readTuningFile(filename, tuningTable);
+    }
+    indexTuningTable();
+    tuningLoaded = true;
+}
+
+// Retrieve the tuned choices for this size, taking the tuning lock
+// once. Returns false, leaving choices empty, if the size has not
+// been measured.
+static bool
+getTunedChoices(int size, TunedChoices &choices)
+{
+    lockTuning();
+    ensureTuningLoaded();
+    TunedIndex::const_iterator itr = tunedIndex.find(size);
+    bool found = (itr != tunedIndex.end());
+    if (found) {
+        choices = itr->second;
+    }
+    unlockTuning();
+    return found;
+}
+
+static std::string
+pickImplementation(int size, const ImplMap &impls, const TunedChoices &tuned)
+{
+    bool isPowerOfTwo = !(size & (size-1));
+    bool isEven = !(size & 1);
+
+    if (defaultImplementation != "") {
+        ImplMap::const_iterator itr = impls.find(defaultImplementation);
+        if (itr != impls.end()) {
+            if (((itr->second & SizeConstraintPowerOfTwo) && !isPowerOfTwo) ||
+                ((itr->second & SizeConstraintEven) && !isEven)) {
+//                std::cerr << "NOTE: bqfft: Explicitly-set default "
+//                          << "implementation \"" << defaultImplementation
+//                          << "\" does not support size " << size
+//                          << ", trying other compiled-in implementations"
+//                          << std::endl;
+            } else {
+                return defaultImplementation;
+            }
+        } else {
+            std::cerr << "WARNING: bqfft: Default implementation \""
+                      << defaultImplementation << "\" is not compiled in"
+                      << std::endl;
+        }
+    } 
+
+    if (tuned.overall != "") {
+        return tuned.overall;
+    }
+    
+    for (int i = 0; i < implementationPreferenceCount; ++i) {
+        ImplMap::const_iterator itr = impls.find(implementationPreference[i]);
+        if (itr != impls.end()) {
+            if (!isUsableForSize(itr->second, size)) {
+                continue;
+            }
+            return implementationPreference[i];
+        }
+    }
+
+    std::cerr << "WARNING: bqfft: No compiled-in implementation supports size "
+              << size << ", falling back to slow DFT" << std::endl;
+    
+    return "dft";
+}
+
+static bool
+isFloatMethod(int type)
+{
+    return (type >= ForwardFloat && type <= ForwardMagnitudeFloat) ||
+        (type >= InverseFloat && type <= InverseCepstralFloat);
+}
+
+// Choose an implementation for each method type, for an FFT object
+// with no explicitly-set default implementation. Methods with a
+// tuned winner use that; otherwise each precision uses the overall
+// choice if it is native in that precision, or the first preferred
+// implementation that is. Returns true if the methods do not all end
+// up with the overall choice.
+static bool
+pickRoutes(int size, std::string overall, const ImplMap &impls,
+           const TunedChoices &tuned, std::string *routes)
+{
+    if (defaultImplementation != "") {
+        return false;
+    }
+    
+    bool mixed = false;
+    
+    for (int type = 0; type < MethodTypeCount; ++type) {
+
+        std::string route = tuned.methods[type];
+
+        if (route == "") {
+            FFT::Precisions wanted = isFloatMethod(type) ?
+                FFT::SinglePrecision : FFT::DoublePrecision;
+            route = overall;
+            if (!(getNativePrecisions(overall) & wanted)) {
+                for (int i = 0; i < implementationPreferenceCount; ++i) {
+                    ImplMap::const_iterator itr =
+                        impls.find(implementationPreference[i]);
+                    if (itr != impls.end() &&
+                        isUsableForSize(itr->second, size) &&
+                        (getNativePrecisions(itr->first) & wanted)) {
+                        route = itr->first;
+                        break;
+                    }
+                }
+            }
+        }
+
+        routes[type] = route;
+        if (route != overall) {
+            mixed = true;
+        }
+    }
+
+    return mixed;
+}
+
+namespace FFTs {
+
+// Passes each method through to its own implementation, as chosen by
+// pickRoutes. Each distinct implementation is constructed once, when
+// a method routed to it is first called or initFloat/initDouble (as
+// in RealTimeMode) or a query about alignment or precision needs it,
+// so that routes never taken cost nothing. As with any implementation
+// used directly, its plans and tables for each precision are then
+// initialised on first use or through initFloat/initDouble.
+
+class D_Routed : public FFTImpl
+{
+public:
+    D_Routed(int size, const std::string *routes) :
+        m_size(size),
+        m_shaping(NoShaping)
+    {
+        for (int type = 0; type < MethodTypeCount; ++type) {
+            int slot = 0;
+            while (slot < int(m_names.size()) &&
+                   m_names[slot] != routes[type]) {
+                ++slot;
+            }
+            if (slot == int(m_names.size())) {
+                m_names.push_back(routes[type]);
+                m_owned.push_back(0);
+            }
+            m_slots[type] = slot;
+            m_impls[type] = 0;
+        }
+    }
+
+    ~D_Routed() {
+        for (int i = 0; i < int(m_owned.size()); ++i) {
+            delete m_owned[i];
+        }
+    }
+
+    int getSize() const {
+        return m_size;
+    }
+
+    FFT::Precisions
+    getSupportedPrecisions() const {
+        FFT::Precisions precisions =
+            FFT::SinglePrecision | FFT::DoublePrecision;
+        for (int type = 0; type < MethodTypeCount; ++type) {
+            FFT::Precisions wanted = isFloatMethod(type) ?
+                FFT::SinglePrecision : FFT::DoublePrecision;
+            if (!(route(type)->getSupportedPrecisions() & wanted)) {
+                precisions &= ~wanted;
+            }
+        }
+        return precisions;
+    }
+
+    int getPreferredAlignment() const {
+        int alignment = 0;
+        for (int type = 0; type < MethodTypeCount; ++type) {
+            int a = route(type)->getPreferredAlignment();
+            if (a > alignment) alignment = a;
+        }
+        return alignment;
+    }
+
+    int getSlowPathCount() const {
+        int count = 0;
+        for (int i = 0; i < int(m_owned.size()); ++i) {
+            if (m_owned[i]) count += m_owned[i]->getSlowPathCount();
+        }
+        return count;
+    }
+
+    // Shaping is recorded here as well as passed on, so that it can
+    // be applied to an implementation created while it is in effect
+
+    void setShaping(const double *window, int rotation,
+                    bool accumulate, double gain) {
+        FFTImpl::setShaping(window, rotation, accumulate, gain);
+        m_shaping = FullShaping;
+        for (int i = 0; i < int(m_owned.size()); ++i) {
+            if (m_owned[i]) {
+                m_owned[i]->setShaping(window, rotation, accumulate, gain);
+            }
+        }
+    }
+
+    void setShaping(const float *window, int rotation,
+                    bool accumulate, double gain) {
+        FFTImpl::setShaping(window, rotation, accumulate, gain);
+        m_shaping = FullShaping;
+        for (int i = 0; i < int(m_owned.size()); ++i) {
+            if (m_owned[i]) {
+                m_owned[i]->setShaping(window, rotation, accumulate, gain);
+            }
+        }
+    }
+
+    void setOutputShaping(int rotation, int count) {
+        FFTImpl::setOutputShaping(rotation, count);
+        m_shaping = OutputShaping;
+        for (int i = 0; i < int(m_owned.size()); ++i) {
+            if (m_owned[i]) {
+                m_owned[i]->setOutputShaping(rotation, count);
+            }
+        }
+    }
+
+    void setInputShaping(int length) {
+        FFTImpl::setInputShaping(length);
+        m_shaping = InputShaping;
+        for (int i = 0; i < int(m_owned.size()); ++i) {
+            if (m_owned[i]) {
+                m_owned[i]->setInputShaping(length);
+            }
+        }
+    }
+
+    void clearShaping() {
+        FFTImpl::clearShaping();
+        m_shaping = NoShaping;
+        for (int i = 0; i < int(m_owned.size()); ++i) {
+            if (m_owned[i]) {
+                m_owned[i]->clearShaping();
+            }
+        }
+    }
+
+    void setFastPolar(bool fast) {
+        FFTImpl::setFastPolar(fast);
+        for (int i = 0; i < int(m_owned.size()); ++i) {
+            if (m_owned[i]) {
+                m_owned[i]->setFastPolar(fast);
+            }
+        }
+    }
+
+    void initFloat() {
+        for (int type = 0; type < MethodTypeCount; ++type) {
+            if (isFloatMethod(type)) route(type)->initFloat();
+        }
+    }
+
+    void initDouble() {
+        for (int type = 0; type < MethodTypeCount; ++type) {
+            if (!isFloatMethod(type)) route(type)->initDouble();
+        }
+    }
+
+    void forward(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        route(ForwardDouble)->forward(realIn, realOut, imagOut);
+    }
+
+    void forwardInterleaved(const double *BQ_R__ realIn, double *BQ_R__ complexOut) {
+        route(ForwardInterleavedDouble)->forwardInterleaved(realIn, complexOut);
+    }
+
+    void forwardPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut) {
+        route(ForwardPolarDouble)->forwardPolar(realIn, magOut, phaseOut);
+    }
+
+    void forwardMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut) {
+        route(ForwardMagnitudeDouble)->forwardMagnitude(realIn, magOut);
+    }
+
+    void forward(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        route(ForwardFloat)->forward(realIn, realOut, imagOut);
+    }
+
+    void forwardInterleaved(const float *BQ_R__ realIn, float *BQ_R__ complexOut) {
+        route(ForwardInterleavedFloat)->forwardInterleaved(realIn, complexOut);
+    }
+
+    void forwardPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut) {
+        route(ForwardPolarFloat)->forwardPolar(realIn, magOut, phaseOut);
+    }
+
+    void forwardMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut) {
+        route(ForwardMagnitudeFloat)->forwardMagnitude(realIn, magOut);
+    }
+
+    void inverse(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut) {
+        route(InverseDouble)->inverse(realIn, imagIn, realOut);
+    }
+
+    void inverseInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ realOut) {
+        route(InverseInterleavedDouble)->inverseInterleaved(complexIn, realOut);
+    }
+
+    void inversePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, double *BQ_R__ realOut) {
+        route(InversePolarDouble)->inversePolar(magIn, phaseIn, realOut);
+    }
+
+    void inverseCepstral(const double *BQ_R__ magIn, double *BQ_R__ cepOut) {
+        route(InverseCepstralDouble)->inverseCepstral(magIn, cepOut);
+    }
+
+    void inverse(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut) {
+        route(InverseFloat)->inverse(realIn, imagIn, realOut);
+    }
+
+    void inverseInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ realOut) {
+        route(InverseInterleavedFloat)->inverseInterleaved(complexIn, realOut);
+    }
+
+    void inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut) {
+        route(InversePolarFloat)->inversePolar(magIn, phaseIn, realOut);
+    }
+
+    void inverseCepstral(const float *BQ_R__ magIn, float *BQ_R__ cepOut) {
+        route(InverseCepstralFloat)->inverseCepstral(magIn, cepOut);
+    }
+
+    // The power and log power spectrum methods follow the routes for
+    // the nearest of the sixteen methods that routing is tuned for:
+    // the magnitude spectrum forward, and the cepstrum (whose input is
+    // also real-only) inverse
+
+    void forwardPower(const double *BQ_R__ realIn, double *BQ_R__ powerOut) {
+        route(ForwardMagnitudeDouble)->forwardPower(realIn, powerOut);
+    }
+
+    void inversePower(const double *BQ_R__ powerIn, double *BQ_R__ realOut) {
+        route(InverseCepstralDouble)->inversePower(powerIn, realOut);
+    }
+
+    void forwardPower(const float *BQ_R__ realIn, float *BQ_R__ powerOut) {
+        route(ForwardMagnitudeFloat)->forwardPower(realIn, powerOut);
+    }
+
+    void inversePower(const float *BQ_R__ powerIn, float *BQ_R__ realOut) {
+        route(InverseCepstralFloat)->inversePower(powerIn, realOut);
+    }
+
+    void forwardLogPower(const double *BQ_R__ realIn, double *BQ_R__ logOut, double floor, double scale) {
+        route(ForwardMagnitudeDouble)->forwardLogPower(realIn, logOut, floor, scale);
+    }
+
+    void forwardLogPower(const float *BQ_R__ realIn, float *BQ_R__ logOut, float floor, float scale) {
+        route(ForwardMagnitudeFloat)->forwardLogPower(realIn, logOut, floor, scale);
+    }
+
+    // The envelope is the cepstrum taken further, so it follows the
+    // route for inverseCepstral
+    void cepstralEnvelope(const double *BQ_R__ frame, int cutoff, double *BQ_R__ envOut) {
+        route(InverseCepstralDouble)->cepstralEnvelope(frame, cutoff, envOut);
+    }
+
+    void cepstralEnvelope(const float *BQ_R__ frame, int cutoff, float *BQ_R__ envOut) {
+        route(InverseCepstralFloat)->cepstralEnvelope(frame, cutoff, envOut);
+    }
+
+    void forwardBins(const double *BQ_R__ realIn, int first, int last, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        route(ForwardDouble)->forwardBins(realIn, first, last, realOut, imagOut);
+    }
+
+    void forwardBinsMagnitude(const double *BQ_R__ realIn, int first, int last, double *BQ_R__ magOut) {
+        route(ForwardMagnitudeDouble)->forwardBinsMagnitude(realIn, first, last, magOut);
+    }
+
+    void forwardBins(const float *BQ_R__ realIn, int first, int last, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        route(ForwardFloat)->forwardBins(realIn, first, last, realOut, imagOut);
+    }
+
+    void forwardBinsMagnitude(const float *BQ_R__ realIn, int first, int last, float *BQ_R__ magOut) {
+        route(ForwardMagnitudeFloat)->forwardBinsMagnitude(realIn, first, last, magOut);
+    }
+
+    // Correlation is mostly forward transforms, so it follows the
+    // route for forwardInterleaved
+
+    void correlate(const double *BQ_R__ a, const double *BQ_R__ b, double *BQ_R__ out, double scale) {
+        route(ForwardInterleavedDouble)->correlate(a, b, out, scale);
+    }
+
+    void autocorrelate(const double *BQ_R__ in, double *BQ_R__ out, double scale) {
+        route(ForwardInterleavedDouble)->autocorrelate(in, out, scale);
+    }
+
+    void correlate(const float *BQ_R__ a, const float *BQ_R__ b, float *BQ_R__ out, float scale) {
+        route(ForwardInterleavedFloat)->correlate(a, b, out, scale);
+    }
+
+    void autocorrelate(const float *BQ_R__ in, float *BQ_R__ out, float scale) {
+        route(ForwardInterleavedFloat)->autocorrelate(in, out, scale);
+    }
+
+private:
+    enum Shaping { NoShaping, FullShaping, OutputShaping, InputShaping };
+
+    const int m_size;
+    Shaping m_shaping;
+    std::vector<std::string> m_names;
+    int m_slots[MethodTypeCount];
+
+    // Created on demand, including from the const queries above
+    mutable FFTImpl *m_impls[MethodTypeCount];
+    mutable std::vector<FFTImpl *> m_owned;
+
+    FFTImpl *route(int type) const {
+        FFTImpl *d = m_impls[type];
+        if (!d) d = create(type);
+        return d;
+    }
+
+    FFTImpl *create(int type) const {
+        int slot = m_slots[type];
+        FFTImpl *d = m_owned[slot];
+        if (!d) {
+            d = createImplementation(m_names[slot], m_size);
+            if (!d) {
+                d = new D_DFT(m_size);
+            }
+            d->setFastPolar(isFastPolar());
+            switch (m_shaping) {
+            case NoShaping:
+                break;
+            case FullShaping:
+                if (m_fwindow) {
+                    d->setShaping(m_fwindow, m_rotation, m_accumulate, m_gain);
+                } else {
+                    d->setShaping(m_dwindow, m_rotation, m_accumulate, m_gain);
+                }
+                break;
+            case OutputShaping:
+                d->setOutputShaping(m_rotation, m_count);
+                break;
+            case InputShaping:
+                d->setInputShaping(m_length);
+                break;
+            }
+            m_owned[slot] = d;
+        }
+        for (int t = 0; t < MethodTypeCount; ++t) {
+            if (m_slots[t] == slot) m_impls[t] = d;
+        }
+        return d;
+    }
+};
+
+} /* end namespace FFTs */
+
+#ifdef FFT_STATISTICS
+
+static bool statisticsEnabled = false;
+static bool latencyHistogramEnabled = false;
+
+// Totals from instruments that no longer exist, plus the list of
+// live ones, for FFT::getProcessStatistics
+
+static FFT::Statistics retiredStatistics;
+
+#ifndef NO_THREADING
+#ifdef _WIN32
+static HANDLE statisticsMutex = CreateMutex(NULL, FALSE, NULL);
+static void lockStatistics() { WaitForSingleObject(statisticsMutex, INFINITE); }
+static void unlockStatistics() { ReleaseMutex(statisticsMutex); }
+#else
+static pthread_mutex_t statisticsMutex = PTHREAD_MUTEX_INITIALIZER;
+static void lockStatistics() { pthread_mutex_lock(&statisticsMutex); }
+static void unlockStatistics() { pthread_mutex_unlock(&statisticsMutex); }
+#endif
+#else
+static void lockStatistics() { }
+static void unlockStatistics() { }
+#endif
+
+static void
+clearStatistics(FFT::Statistics &s)
+{
+    for (int i = 0; i < FFT::Statistics::MethodCount; ++i) {
+        s.methods[i].calls = 0;
+        s.methods[i].totalNs = 0.0;
+        s.methods[i].minNs = 0.0;
+        s.methods[i].maxNs = 0.0;
+        s.methods[i].bytes = 0;
+        s.methods[i].slowPathEvents = 0;
+        s.methods[i].lazyInits = 0;
+    }
+}
+
+static void
+clearLatencyHistogram(FFT::LatencyHistogram &h)
+{
+    for (int i = 0; i < FFT::LatencyHistogram::BucketCount; ++i) {
+        h.buckets[i] = 0;
+    }
+    h.count = 0;
+    h.maxNs = 0.0;
+}
+
+// Full memory barrier, ordering the latency histogram's sequence
+// count against the histogram itself
+
+static void
+histogramBarrier()
+{
+#ifndef NO_THREADING
+#ifdef _WIN32
+    MemoryBarrier();
+#else
+    __sync_synchronize();
+#endif
+#endif
+}
+
+static void
+addStatistics(FFT::Statistics &to, const FFT::Statistics &from)
+{
+    for (int i = 0; i < FFT::Statistics::MethodCount; ++i) {
+        FFT::MethodStatistics &t = to.methods[i];
+        const FFT::MethodStatistics &f = from.methods[i];
+        if (f.calls == 0) continue;
+        if (t.calls == 0 || f.minNs < t.minNs) t.minNs = f.minNs;
+        if (f.maxNs > t.maxNs) t.maxNs = f.maxNs;
+        t.calls += f.calls;
+        t.totalNs += f.totalNs;
+        t.bytes += f.bytes;
+        t.slowPathEvents += f.slowPathEvents;
+        t.lazyInits += f.lazyInits;
+    }
+}
+
+namespace FFTs {
+
+// Wraps another implementation, recording per-method call counts,
+// times, bytes and slow-path events while statistics are enabled.
+// Only compiled in with FFT_STATISTICS, so that there is no cost at
+// all otherwise.
+
+class D_Instrumented : public FFTImpl
+{
+public:
+    D_Instrumented(FFTImpl *d) :
+        m_d(d), m_size(d->getSize()),
+        m_floatInitialised(false), m_doubleInitialised(false),
+        m_histogramSeq(0)
+    {
+        clearStatistics(m_statistics);
+        clearLatencyHistogram(m_histogram);
+        lockStatistics();
+        m_live.insert(this);
+        unlockStatistics();
+    }
+
+    ~D_Instrumented() {
+        lockStatistics();
+        m_live.erase(this);
+        addStatistics(retiredStatistics, m_statistics);
+        unlockStatistics();
+        delete m_d;
+    }
+
+    const FFT::Statistics &getStatistics() const {
+        return m_statistics;
+    }
+
+    // The histogram is written only by the thread calling the
+    // transforms, which makes m_histogramSeq odd while it does so,
+    // and may be read from any other. A reader copies it and tries
+    // again if the sequence count was odd or changed meanwhile, so
+    // that it never sees a torn or half-updated histogram and the
+    // writer never waits.
+    FFT::LatencyHistogram getLatencyHistogram() const {
+        const volatile FFT::LatencyHistogram &from = m_histogram;
+        FFT::LatencyHistogram h;
+        while (true) {
+            const unsigned int seq = m_histogramSeq;
+            histogramBarrier();
+            if (!(seq & 1)) {
+                for (int i = 0; i < FFT::LatencyHistogram::BucketCount; ++i) {
+                    h.buckets[i] = from.buckets[i];
+                }
+                h.count = from.count;
+                h.maxNs = from.maxNs;
+                histogramBarrier();
+                if (m_histogramSeq == seq) return h;
+            }
+        }
+    }
+
+    void resetLatencyHistogram() {
+        beginHistogramWrite();
+        clearLatencyHistogram(m_histogram);
+        endHistogramWrite();
+    }
+
+    void resetStatistics() {
+        clearStatistics(m_statistics);
+    }
+
+    static FFT::Statistics getProcessStatistics() {
+        FFT::Statistics s;
+        clearStatistics(s);
+        lockStatistics();
+        addStatistics(s, retiredStatistics);
+        for (std::set<D_Instrumented *>::const_iterator i = m_live.begin();
+             i != m_live.end(); ++i) {
+            addStatistics(s, (*i)->m_statistics);
+        }
+        unlockStatistics();
+        return s;
+    }
+
+    static void resetProcessStatistics() {
+        lockStatistics();
+        clearStatistics(retiredStatistics);
+        for (std::set<D_Instrumented *>::const_iterator i = m_live.begin();
+             i != m_live.end(); ++i) {
+            clearStatistics((*i)->m_statistics);
+        }
+        unlockStatistics();
+    }
+
+    int getSize() const {
+        return m_size;
+    }
+
+    FFT::Precisions getSupportedPrecisions() const {
+        return m_d->getSupportedPrecisions();
+    }
+
+    int getPreferredAlignment() const {
+        return m_d->getPreferredAlignment();
+    }
+
+    int getSlowPathCount() const {
+        return m_d->getSlowPathCount();
+    }
+
+    void setShaping(const double *window, int rotation,
+                    bool accumulate, double gain) {
+        m_d->setShaping(window, rotation, accumulate, gain);
+    }
+
+    void setShaping(const float *window, int rotation,
+                    bool accumulate, double gain) {
+        m_d->setShaping(window, rotation, accumulate, gain);
+    }
+
+    void setOutputShaping(int rotation, int count) {
+        m_d->setOutputShaping(rotation, count);
+    }
+
+    void setInputShaping(int length) {
+        m_d->setInputShaping(length);
+    }
+
+    void clearShaping() {
+        m_d->clearShaping();
+    }
+
+    void setFastPolar(bool fast) {
+        FFTImpl::setFastPolar(fast);
+        m_d->setFastPolar(fast);
+    }
+
+    void initFloat() {
+        m_floatInitialised = true;
+        m_d->initFloat();
+    }
+
+    void initDouble() {
+        m_doubleInitialised = true;
+        m_d->initDouble();
+    }
+
+    void forward(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        Call call(this, ForwardDouble);
+        m_d->forward(realIn, realOut, imagOut);
+    }
+
+    void forwardInterleaved(const double *BQ_R__ realIn, double *BQ_R__ complexOut) {
+        Call call(this, ForwardInterleavedDouble);
+        m_d->forwardInterleaved(realIn, complexOut);
+    }
+
+    void forwardPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut) {
+        Call call(this, ForwardPolarDouble);
+        m_d->forwardPolar(realIn, magOut, phaseOut);
+    }
+
+    void forwardMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut) {
+        Call call(this, ForwardMagnitudeDouble);
+        m_d->forwardMagnitude(realIn, magOut);
+    }
+
+    void forward(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        Call call(this, ForwardFloat);
+        m_d->forward(realIn, realOut, imagOut);
+    }
+
+    void forwardInterleaved(const float *BQ_R__ realIn, float *BQ_R__ complexOut) {
+        Call call(this, ForwardInterleavedFloat);
+        m_d->forwardInterleaved(realIn, complexOut);
+    }
+
+    void forwardPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut) {
+        Call call(this, ForwardPolarFloat);
+        m_d->forwardPolar(realIn, magOut, phaseOut);
+    }
+
+    void forwardMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut) {
+        Call call(this, ForwardMagnitudeFloat);
+        m_d->forwardMagnitude(realIn, magOut);
+    }
+
+    void inverse(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut) {
+        Call call(this, InverseDouble);
+        m_d->inverse(realIn, imagIn, realOut);
+    }
+
+    void inverseInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ realOut) {
+        Call call(this, InverseInterleavedDouble);
+        m_d->inverseInterleaved(complexIn, realOut);
+    }
+
+    void inversePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, double *BQ_R__ realOut) {
+        Call call(this, InversePolarDouble);
+        m_d->inversePolar(magIn, phaseIn, realOut);
+    }
+
+    void inverseCepstral(const double *BQ_R__ magIn, double *BQ_R__ cepOut) {
+        Call call(this, InverseCepstralDouble);
+        m_d->inverseCepstral(magIn, cepOut);
+    }
+
+    void inverse(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut) {
+        Call call(this, InverseFloat);
+        m_d->inverse(realIn, imagIn, realOut);
+    }
+
+    void inverseInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ realOut) {
+        Call call(this, InverseInterleavedFloat);
+        m_d->inverseInterleaved(complexIn, realOut);
+    }
+
+    void inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut) {
+        Call call(this, InversePolarFloat);
+        m_d->inversePolar(magIn, phaseIn, realOut);
+    }
+
+    void inverseCepstral(const float *BQ_R__ magIn, float *BQ_R__ cepOut) {
+        Call call(this, InverseCepstralFloat);
+        m_d->inverseCepstral(magIn, cepOut);
+    }
+
+    // Not among the sixteen methods counted in FFT::Statistics.
+    // These count as the method that D_Routed sends them to
+
+    void forwardPower(const double *BQ_R__ realIn, double *BQ_R__ powerOut) {
+        Call call(this, ForwardMagnitudeDouble);
+        m_d->forwardPower(realIn, powerOut);
+    }
+
+    void inversePower(const double *BQ_R__ powerIn, double *BQ_R__ realOut) {
+        Call call(this, InverseCepstralDouble);
+        m_d->inversePower(powerIn, realOut);
+    }
+
+    void forwardPower(const float *BQ_R__ realIn, float *BQ_R__ powerOut) {
+        Call call(this, ForwardMagnitudeFloat);
+        m_d->forwardPower(realIn, powerOut);
+    }
+
+    void inversePower(const float *BQ_R__ powerIn, float *BQ_R__ realOut) {
+        Call call(this, InverseCepstralFloat);
+        m_d->inversePower(powerIn, realOut);
+    }
+
+    void forwardLogPower(const double *BQ_R__ realIn, double *BQ_R__ logOut, double floor, double scale) {
+        Call call(this, ForwardMagnitudeDouble);
+        m_d->forwardLogPower(realIn, logOut, floor, scale);
+    }
+
+    void forwardLogPower(const float *BQ_R__ realIn, float *BQ_R__ logOut, float floor, float scale) {
+        Call call(this, ForwardMagnitudeFloat);
+        m_d->forwardLogPower(realIn, logOut, floor, scale);
+    }
+
+    void cepstralEnvelope(const double *BQ_R__ frame, int cutoff, double *BQ_R__ envOut) {
+        Call call(this, InverseCepstralDouble);
+        m_d->cepstralEnvelope(frame, cutoff, envOut);
+    }
+
+    void cepstralEnvelope(const float *BQ_R__ frame, int cutoff, float *BQ_R__ envOut) {
+        Call call(this, InverseCepstralFloat);
+        m_d->cepstralEnvelope(frame, cutoff, envOut);
+    }
+
+    void forwardBins(const double *BQ_R__ realIn, int first, int last, double *BQ_R__ realOut, double *BQ_R__ imagOut) {
+        Call call(this, ForwardDouble);
+        m_d->forwardBins(realIn, first, last, realOut, imagOut);
+    }
+
+    void forwardBinsMagnitude(const double *BQ_R__ realIn, int first, int last, double *BQ_R__ magOut) {
+        Call call(this, ForwardMagnitudeDouble);
+        m_d->forwardBinsMagnitude(realIn, first, last, magOut);
+    }
+
+    void forwardBins(const float *BQ_R__ realIn, int first, int last, float *BQ_R__ realOut, float *BQ_R__ imagOut) {
+        Call call(this, ForwardFloat);
+        m_d->forwardBins(realIn, first, last, realOut, imagOut);
+    }
+
+    void forwardBinsMagnitude(const float *BQ_R__ realIn, int first, int last, float *BQ_R__ magOut) {
+        Call call(this, ForwardMagnitudeFloat);
+        m_d->forwardBinsMagnitude(realIn, first, last, magOut);
+    }
+
+    void forwardBinsGoertzel(const double *BQ_R__ realIn, int first, int last, double *BQ_R__ realOut, double *BQ_R__ imagOut, double *BQ_R__ magOut) {
+        Call call(this, magOut ? ForwardMagnitudeDouble : ForwardDouble, false);
+        m_d->forwardBinsGoertzel(realIn, first, last, realOut, imagOut, magOut);
+    }
+
+    void forwardBinsGoertzel(const float *BQ_R__ realIn, int first, int last, float *BQ_R__ realOut, float *BQ_R__ imagOut, float *BQ_R__ magOut) {
+        Call call(this, magOut ? ForwardMagnitudeFloat : ForwardFloat, false);
+        m_d->forwardBinsGoertzel(realIn, first, last, realOut, imagOut, magOut);
+    }
+
+    void correlate(const double *BQ_R__ a, const double *BQ_R__ b, double *BQ_R__ out, double scale) {
+        Call call(this, ForwardInterleavedDouble);
+        m_d->correlate(a, b, out, scale);
+    }
+
+    void autocorrelate(const double *BQ_R__ in, double *BQ_R__ out, double scale) {
+        Call call(this, ForwardInterleavedDouble);
+        m_d->autocorrelate(in, out, scale);
+    }
+
+    void correlate(const float *BQ_R__ a, const float *BQ_R__ b, float *BQ_R__ out, float scale) {
+        Call call(this, ForwardInterleavedFloat);
+        m_d->correlate(a, b, out, scale);
+    }
+
+    void autocorrelate(const float *BQ_R__ in, float *BQ_R__ out, float scale) {
+        Call call(this, ForwardInterleavedFloat);
+        m_d->autocorrelate(in, out, scale);
+    }
+
+private:
+    FFTImpl *m_d;
+    const int m_size;
+    bool m_floatInitialised;
+    bool m_doubleInitialised;
+    FFT::Statistics m_statistics;
+    FFT::LatencyHistogram m_histogram;
+    volatile unsigned int m_histogramSeq;
+    static std::set<D_Instrumented *> m_live;
+
+    // Records one method call from construction to destruction, if
+    // statistics are enabled when it starts
+    class Call
+    {
+    public:
+        // usesBackend is false for a call that does not touch the
+        // backend and so cannot initialise it
+        Call(D_Instrumented *instrument, int type, bool usesBackend = true) :
+            m_instrument(instrument), m_type(type),
+            m_statistics(statisticsEnabled),
+            m_latency(latencyHistogramEnabled),
+            m_lazyInit(usesBackend && instrument->noteUse(type)),
+            m_slowPathCount(0), m_start(0.0) {
+            if (m_statistics) {
+                m_slowPathCount = m_instrument->m_d->getSlowPathCount();
+            }
+            if (m_statistics || m_latency) {
+                m_start = getMonotonicTimeNs();
+            }
+        }
+        ~Call() {
+            if (m_statistics || m_latency) {
+                double elapsed = getMonotonicTimeNs() - m_start;
+                if (m_latency) {
+                    m_instrument->recordLatency(elapsed);
+                }
+                if (m_statistics) {
+                    m_instrument->record
+                        (m_type, elapsed, m_lazyInit,
+                         m_instrument->m_d->getSlowPathCount() - m_slowPathCount);
+                }
+            }
+        }
+    private:
+        D_Instrumented *m_instrument;
+        int m_type;
+        bool m_statistics;
+        bool m_latency;
+        bool m_lazyInit;
+        int m_slowPathCount;
+        double m_start;
+    };
+
+    // Return true if this is the first use of the method's precision
+    // without a prior initFloat/initDouble, i.e. if the backend will
+    // initialise within this call
+    bool noteUse(int type) {
+        bool &initialised =
+            (isFloatMethod(type) ? m_floatInitialised : m_doubleInitialised);
+        if (initialised) return false;
+        initialised = true;
+        return true;
+    }
+
+    // Called on the thread using this FFT, the only writer of the
+    // histogram (see getLatencyHistogram)
+    void recordLatency(double ns) {
+        int bucket = 0;
+        if (ns >= 1.0) {
+            uint64_t v = uint64_t(ns);
+#ifdef __GNUC__
+            bucket = 63 - __builtin_clzll((unsigned long long)v);
+#else
+            while (v >>= 1) ++bucket;
+#endif
+            if (bucket >= FFT::LatencyHistogram::BucketCount) {
+                bucket = FFT::LatencyHistogram::BucketCount - 1;
+            }
+        }
+        beginHistogramWrite();
+        m_histogram.buckets[bucket] += 1;
+        m_histogram.count += 1;
+        if (ns > m_histogram.maxNs) m_histogram.maxNs = ns;
+        endHistogramWrite();
+    }
+
+    void beginHistogramWrite() {
+        m_histogramSeq = m_histogramSeq + 1;
+        histogramBarrier();
+    }
+
+    void endHistogramWrite() {
+        histogramBarrier();
+        m_histogramSeq = m_histogramSeq + 1;
+    }
+
+    void record(int type, double ns, bool lazyInit, int slowPathEvents) {
+        FFT::MethodStatistics &s = m_statistics.methods[type];
+        if (s.calls == 0 || ns < s.minNs) s.minNs = ns;
+        if (ns > s.maxNs) s.maxNs = ns;
+        s.calls += 1;
+        s.totalNs += ns;
+        s.bytes += getBytesPerCall(type);
+        s.slowPathEvents += slowPathEvents;
+        if (lazyInit) s.lazyInits += 1;
+    }
+
+    // Bytes read plus bytes written by one call
+    uint64_t getBytesPerCall(int type) const {
+        uint64_t time = m_size;
+        uint64_t bins = m_size/2 + 1;
+        uint64_t values = 0;
+        switch (type % 8) {
+        case 0: case 1: case 2: values = time + bins * 2; break; // forward
+        case 3: values = time + bins; break; // forwardMagnitude
+        case 4: case 5: case 6: values = bins * 2 + time; break; // inverse
+        case 7: values = bins + time; break; // inverseCepstral
+        }
+        return values * (isFloatMethod(type) ? sizeof(float) : sizeof(double));
+    }
+};
+
+std::set<D_Instrumented *>
+D_Instrumented::m_live;
+
+} /* end namespace FFTs */
+
+#endif
+
+std::set<std::string>
+FFT::getImplementations()
+{
+    ImplMap impls = getImplementationDetails();
+    std::set<std::string> toReturn;
+    for (ImplMap::const_iterator i = impls.begin(); i != impls.end(); ++i) {
+        toReturn.insert(i->first);
+    }
+    return toReturn;
+}
+
+std::string
+FFT::getDefaultImplementation()
+{
+    return defaultImplementation;
+}
+
+void
+FFT::setDefaultImplementation(std::string i)
+{
+    if (i == "") {
+        defaultImplementation = i;
+        return;
+    } 
+    ImplMap impls = getImplementationDetails();
+    ImplMap::const_iterator itr = impls.find(i);
+    if (itr == impls.end()) {
+        std::cerr << "WARNING: bqfft: setDefaultImplementation: "
+                  << "requested implementation \"" << i
+                  << "\" is not compiled in" << std::endl;
+    } else {
+        defaultImplementation = i;
+    }
+}
+
+std::string
+FFT::getTuningFile()
+{
+    lockTuning();
+    std::string filename = getTuningFileName();
+    unlockTuning();
+    return filename;
+}
+
+void
+FFT::setTuningFile(std::string filename)
+{
+    lockTuning();
+    tuningFile = filename;
+    tuningFileSet = true;
+    tuningLoaded = false;
+    tuningTable.clear();
+    tunedIndex.clear();
+    unlockTuning();
+}
+
+void
+FFT::calibrate(const std::vector<int> &sizes)
+{
+    ImplMap impls = getImplementationDetails();
+    TuningTable measured;
+
+    for (int i = 0; i < int(sizes.size()); ++i) {
+
+        int size = sizes[i];
+        if (size < 2) continue;
+
+        MeasurementBuffers buffers(size);
+
+        for (ImplMap::const_iterator itr = impls.begin();
+             itr != impls.end(); ++itr) {
+
+            // The DFT is only ever a fallback, never worth timing
+            if (itr->first == "dft") continue;
+            if (!isUsableForSize(itr->second, size)) continue;
+
+            FFTImpl *d = createImplementation(itr->first, size);
+            if (!d) continue;
+            d->initDouble();
+            d->initFloat();
+
+            for (int type = 0; type < MethodTypeCount; ++type) {
+                measured[size][type][itr->first] =
+                    measureMethod(d, type, buffers, 5, 5.0e5).p50;
+            }
+
+            delete d;
+        }
+    }
+
+    lockTuning();
+    ensureTuningLoaded();
+    for (TuningTable::const_iterator si = measured.begin();
+         si != measured.end(); ++si) {
+        tuningTable[si->first] = si->second;
+    }
+    indexTuningTable();
+    std::string filename = getTuningFileName();
+    if (filename != "" && !writeTuningFile(filename, tuningTable)) {
+        std::cerr << "WARNING: bqfft: Failed to write tuning file \""
+                  << filename << "\"" << std::endl;
+    }
+    unlockTuning();
+}
+
+FFT::FFT(int size, int debugLevel, Mode mode) :
+    d(0),
+    m_size(size)
+{
+    ImplMap impls = getImplementationDetails();
+    TunedChoices tuned;
+    getTunedChoices(size, tuned);
+
+    std::string impl = pickImplementation(size, impls, tuned);
+
+    std::string routes[MethodTypeCount];
+    if (pickRoutes(size, impl, impls, tuned, routes)) {
+        if (debugLevel > 0) {
+            std::cerr << "FFT::FFT(" << size << "): using implementations:";
+            for (int type = 0; type < MethodTypeCount; ++type) {
+                std::cerr << " " << methodTypeNames[type] << "="
+                          << routes[type];
+            }
+            std::cerr << std::endl;
+        }
+        d = new FFTs::D_Routed(size, routes);
+        for (int type = 0; type < MethodTypeCount; ++type) {
+            std::string name = routes[type];
+            if (m_implementation == "") {
+                m_implementation = name;
+            } else if (("+" + m_implementation + "+").find("+" + name + "+")
+                       == std::string::npos) {
+                m_implementation += "+" + name;
+            }
+        }
+    } else {
+        if (debugLevel > 0) {
+            std::cerr << "FFT::FFT(" << size << "): using implementation: "
+                      << impl << std::endl;
+        }
+        d = createImplementation(impl, size);
+        m_implementation = impl;
+    }
+
+    if (!d) {
+        std::cerr << "FFT::FFT(" << size << "): ERROR: implementation "
+                  << impl << " is not compiled in" << std::endl;
+#ifndef NO_EXCEPTIONS
+        throw InvalidImplementation;
+#else
+        abort();
+#endif
+    }
+
+    FFT_PROBE2(select, size, m_implementation.c_str());
+
+#ifdef FFT_STATISTICS
+    d = new FFTs::D_Instrumented(d);
+#endif
+
+    if (mode == RealTimeMode) {
+        // Every implementation allocates (and FFTW also locks) only
+        // in its constructor and init functions, so once both
+        // precisions are initialised no transform call does either
+        d->initFloat();
+        d->initDouble();
+    }
+}
+
+FFT::~FFT()
+{
+    delete d;
+}
+
+#ifndef NO_EXCEPTIONS
+#define CHECK_NOT_NULL(x) \
+    if (!(x)) { \
+        std::cerr << "FFT: ERROR: Null argument " #x << std::endl;  \
+        throw NullArgument; \
+    }
+#else
+#define CHECK_NOT_NULL(x) \
+    if (!(x)) { \
+        std::cerr << "FFT: ERROR: Null argument " #x << std::endl;  \
+        std::cerr << "FFT: Would be throwing NullArgument here, if exceptions were not disabled" << std::endl;  \
+        return; \
+    }
+#endif
+
+#define FFT_PROBE_TRANSFORM(name, type) \
+    do { \
+        if (FFT_PROBE_ENABLED(name)) { \
+            FFT_PROBE4(name, m_size, methodTypeNames[type], \
+                       (isFloatMethod(type) ? 32 : 64), \
+                       m_implementation.c_str()); \
+        } \
+    } while (0)
+
+void
+FFT::forward(const double *BQ_R__ realIn, double *BQ_R__ realOut, double *BQ_R__ imagOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(realOut);
+    CHECK_NOT_NULL(imagOut);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardDouble);
+    d->forward(realIn, realOut, imagOut);
+    FFT_PROBE_TRANSFORM(transform__return, ForwardDouble);
+}
+
+void
+FFT::forwardInterleaved(const double *BQ_R__ realIn, double *BQ_R__ complexOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(complexOut);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardInterleavedDouble);
+    d->forwardInterleaved(realIn, complexOut);
+    FFT_PROBE_TRANSFORM(transform__return, ForwardInterleavedDouble);
+}
+
+void
+FFT::forwardPolar(const double *BQ_R__ realIn, double *BQ_R__ magOut, double *BQ_R__ phaseOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(magOut);
+    CHECK_NOT_NULL(phaseOut);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardPolarDouble);
+    d->forwardPolar(realIn, magOut, phaseOut);
+    FFT_PROBE_TRANSFORM(transform__return, ForwardPolarDouble);
+}
+
+void
+FFT::forwardMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(magOut);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardMagnitudeDouble);
+    d->forwardMagnitude(realIn, magOut);
+    FFT_PROBE_TRANSFORM(transform__return, ForwardMagnitudeDouble);
+}
+
+void
+FFT::forward(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(realOut);
+    CHECK_NOT_NULL(imagOut);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardFloat);
+    d->forward(realIn, realOut, imagOut);
+    FFT_PROBE_TRANSFORM(transform__return, ForwardFloat);
+}
+
+void
+FFT::forwardInterleaved(const float *BQ_R__ realIn, float *BQ_R__ complexOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(complexOut);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardInterleavedFloat);
+    d->forwardInterleaved(realIn, complexOut);
+    FFT_PROBE_TRANSFORM(transform__return, ForwardInterleavedFloat);
+}
+
+void
+FFT::forwardPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(magOut);
+    CHECK_NOT_NULL(phaseOut);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardPolarFloat);
+    d->forwardPolar(realIn, magOut, phaseOut);
+    FFT_PROBE_TRANSFORM(transform__return, ForwardPolarFloat);
+}
+
+void
+FFT::forwardMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(magOut);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardMagnitudeFloat);
+    d->forwardMagnitude(realIn, magOut);
+    FFT_PROBE_TRANSFORM(transform__return, ForwardMagnitudeFloat);
+}
+
+void
+FFT::inverse(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(imagIn);
+    CHECK_NOT_NULL(realOut);
+    FFT_PROBE_TRANSFORM(transform__entry, InverseDouble);
+    d->inverse(realIn, imagIn, realOut);
+    FFT_PROBE_TRANSFORM(transform__return, InverseDouble);
+}
+
+void
+FFT::inverseInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(complexIn);
+    CHECK_NOT_NULL(realOut);
+    FFT_PROBE_TRANSFORM(transform__entry, InverseInterleavedDouble);
+    d->inverseInterleaved(complexIn, realOut);
+    FFT_PROBE_TRANSFORM(transform__return, InverseInterleavedDouble);
+}
+
+void
+FFT::inversePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, double *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(magIn);
+    CHECK_NOT_NULL(phaseIn);
+    CHECK_NOT_NULL(realOut);
+    FFT_PROBE_TRANSFORM(transform__entry, InversePolarDouble);
+    d->inversePolar(magIn, phaseIn, realOut);
+    FFT_PROBE_TRANSFORM(transform__return, InversePolarDouble);
+}
+
+void
+FFT::inverseCepstral(const double *BQ_R__ magIn, double *BQ_R__ cepOut)
+{
+    CHECK_NOT_NULL(magIn);
+    CHECK_NOT_NULL(cepOut);
+    FFT_PROBE_TRANSFORM(transform__entry, InverseCepstralDouble);
+    d->inverseCepstral(magIn, cepOut);
+    FFT_PROBE_TRANSFORM(transform__return, InverseCepstralDouble);
+}
+
+void
+FFT::inverse(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(imagIn);
+    CHECK_NOT_NULL(realOut);
+    FFT_PROBE_TRANSFORM(transform__entry, InverseFloat);
+    d->inverse(realIn, imagIn, realOut);
+    FFT_PROBE_TRANSFORM(transform__return, InverseFloat);
+}
+
+void
+FFT::inverseInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(complexIn);
+    CHECK_NOT_NULL(realOut);
+    FFT_PROBE_TRANSFORM(transform__entry, InverseInterleavedFloat);
+    d->inverseInterleaved(complexIn, realOut);
+    FFT_PROBE_TRANSFORM(transform__return, InverseInterleavedFloat);
+}
+
+void
+FFT::inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(magIn);
+    CHECK_NOT_NULL(phaseIn);
+    CHECK_NOT_NULL(realOut);
+    FFT_PROBE_TRANSFORM(transform__entry, InversePolarFloat);
+    d->inversePolar(magIn, phaseIn, realOut);
+    FFT_PROBE_TRANSFORM(transform__return, InversePolarFloat);
+}
+
+void
+FFT::inverseCepstral(const float *BQ_R__ magIn, float *BQ_R__ cepOut)
+{
+    CHECK_NOT_NULL(magIn);
+    CHECK_NOT_NULL(cepOut);
+    FFT_PROBE_TRANSFORM(transform__entry, InverseCepstralFloat);
+    d->inverseCepstral(magIn, cepOut);
+    FFT_PROBE_TRANSFORM(transform__return, InverseCepstralFloat);
+}
+
+// Rotations are accepted in either direction and modulo the size
+static int
+normaliseRotation(int rotation, int size)
+{
+    rotation %= size;
+    if (rotation < 0) rotation += size;
+    return rotation;
+}
+
+void
+FFT::forwardWindowed(const double *BQ_R__ realIn, const double *BQ_R__ window, int rotation, double *BQ_R__ realOut, double *BQ_R__ imagOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(realOut);
+    CHECK_NOT_NULL(imagOut);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardDouble);
+    d->setShaping(window, normaliseRotation(rotation, d->getSize()),
+                  false, 1.0);
+    d->forward(realIn, realOut, imagOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, ForwardDouble);
+}
+
+void
+FFT::forwardWindowedInterleaved(const double *BQ_R__ realIn, const double *BQ_R__ window, int rotation, double *BQ_R__ complexOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(complexOut);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardInterleavedDouble);
+    d->setShaping(window, normaliseRotation(rotation, d->getSize()),
+                  false, 1.0);
+    d->forwardInterleaved(realIn, complexOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, ForwardInterleavedDouble);
+}
+
+void
+FFT::forwardWindowedPolar(const double *BQ_R__ realIn, const double *BQ_R__ window, int rotation, double *BQ_R__ magOut, double *BQ_R__ phaseOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(magOut);
+    CHECK_NOT_NULL(phaseOut);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardPolarDouble);
+    d->setShaping(window, normaliseRotation(rotation, d->getSize()),
+                  false, 1.0);
+    d->forwardPolar(realIn, magOut, phaseOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, ForwardPolarDouble);
+}
+
+void
+FFT::forwardWindowedMagnitude(const double *BQ_R__ realIn, const double *BQ_R__ window, int rotation, double *BQ_R__ magOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(magOut);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardMagnitudeDouble);
+    d->setShaping(window, normaliseRotation(rotation, d->getSize()),
+                  false, 1.0);
+    d->forwardMagnitude(realIn, magOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, ForwardMagnitudeDouble);
+}
+
+void
+FFT::inverseWindowed(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, const double *BQ_R__ window, int rotation, double *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(imagIn);
+    CHECK_NOT_NULL(realOut);
+    FFT_PROBE_TRANSFORM(transform__entry, InverseDouble);
+    d->setShaping(window, normaliseRotation(rotation, d->getSize()),
+                  false, 1.0);
+    d->inverse(realIn, imagIn, realOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, InverseDouble);
+}
+
+void
+FFT::inverseWindowedInterleaved(const double *BQ_R__ complexIn, const double *BQ_R__ window, int rotation, double *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(complexIn);
+    CHECK_NOT_NULL(realOut);
+    FFT_PROBE_TRANSFORM(transform__entry, InverseInterleavedDouble);
+    d->setShaping(window, normaliseRotation(rotation, d->getSize()),
+                  false, 1.0);
+    d->inverseInterleaved(complexIn, realOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, InverseInterleavedDouble);
+}
+
+void
+FFT::inverseWindowedPolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, const double *BQ_R__ window, int rotation, double *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(magIn);
+    CHECK_NOT_NULL(phaseIn);
+    CHECK_NOT_NULL(realOut);
+    FFT_PROBE_TRANSFORM(transform__entry, InversePolarDouble);
+    d->setShaping(window, normaliseRotation(rotation, d->getSize()),
+                  false, 1.0);
+    d->inversePolar(magIn, phaseIn, realOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, InversePolarDouble);
+}
+
+void
+FFT::forwardWindowed(const float *BQ_R__ realIn, const float *BQ_R__ window, int rotation, float *BQ_R__ realOut, float *BQ_R__ imagOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(realOut);
+    CHECK_NOT_NULL(imagOut);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardFloat);
+    d->setShaping(window, normaliseRotation(rotation, d->getSize()),
+                  false, 1.0);
+    d->forward(realIn, realOut, imagOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, ForwardFloat);
+}
+
+void
+FFT::forwardWindowedInterleaved(const float *BQ_R__ realIn, const float *BQ_R__ window, int rotation, float *BQ_R__ complexOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(complexOut);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardInterleavedFloat);
+    d->setShaping(window, normaliseRotation(rotation, d->getSize()),
+                  false, 1.0);
+    d->forwardInterleaved(realIn, complexOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, ForwardInterleavedFloat);
+}
+
+void
+FFT::forwardWindowedPolar(const float *BQ_R__ realIn, const float *BQ_R__ window, int rotation, float *BQ_R__ magOut, float *BQ_R__ phaseOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(magOut);
+    CHECK_NOT_NULL(phaseOut);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardPolarFloat);
+    d->setShaping(window, normaliseRotation(rotation, d->getSize()),
+                  false, 1.0);
+    d->forwardPolar(realIn, magOut, phaseOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, ForwardPolarFloat);
+}
+
+void
+FFT::forwardWindowedMagnitude(const float *BQ_R__ realIn, const float *BQ_R__ window, int rotation, float *BQ_R__ magOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(magOut);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardMagnitudeFloat);
+    d->setShaping(window, normaliseRotation(rotation, d->getSize()),
+                  false, 1.0);
+    d->forwardMagnitude(realIn, magOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, ForwardMagnitudeFloat);
+}
+
+void
+FFT::inverseWindowed(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, const float *BQ_R__ window, int rotation, float *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(imagIn);
+    CHECK_NOT_NULL(realOut);
+    FFT_PROBE_TRANSFORM(transform__entry, InverseFloat);
+    d->setShaping(window, normaliseRotation(rotation, d->getSize()),
+                  false, 1.0);
+    d->inverse(realIn, imagIn, realOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, InverseFloat);
+}
+
+void
+FFT::inverseWindowedInterleaved(const float *BQ_R__ complexIn, const float *BQ_R__ window, int rotation, float *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(complexIn);
+    CHECK_NOT_NULL(realOut);
+    FFT_PROBE_TRANSFORM(transform__entry, InverseInterleavedFloat);
+    d->setShaping(window, normaliseRotation(rotation, d->getSize()),
+                  false, 1.0);
+    d->inverseInterleaved(complexIn, realOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, InverseInterleavedFloat);
+}
+
+void
+FFT::inverseWindowedPolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, const float *BQ_R__ window, int rotation, float *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(magIn);
+    CHECK_NOT_NULL(phaseIn);
+    CHECK_NOT_NULL(realOut);
+    FFT_PROBE_TRANSFORM(transform__entry, InversePolarFloat);
+    d->setShaping(window, normaliseRotation(rotation, d->getSize()),
+                  false, 1.0);
+    d->inversePolar(magIn, phaseIn, realOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, InversePolarFloat);
+}
+
+void
+FFT::inverseAccumulate(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, const double *BQ_R__ window, int rotation, double gain, double *BQ_R__ out)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(imagIn);
+    CHECK_NOT_NULL(out);
+    FFT_PROBE_TRANSFORM(transform__entry, InverseDouble);
+    d->setShaping(window, normaliseRotation(rotation, d->getSize()),
+                  true, gain);
+    d->inverse(realIn, imagIn, out);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, InverseDouble);
+}
+
+void
+FFT::inverseAccumulateInterleaved(const double *BQ_R__ complexIn, const double *BQ_R__ window, int rotation, double gain, double *BQ_R__ out)
+{
+    CHECK_NOT_NULL(complexIn);
+    CHECK_NOT_NULL(out);
+    FFT_PROBE_TRANSFORM(transform__entry, InverseInterleavedDouble);
+    d->setShaping(window, normaliseRotation(rotation, d->getSize()),
+                  true, gain);
+    d->inverseInterleaved(complexIn, out);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, InverseInterleavedDouble);
+}
+
+void
+FFT::inverseAccumulatePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, const double *BQ_R__ window, int rotation, double gain, double *BQ_R__ out)
+{
+    CHECK_NOT_NULL(magIn);
+    CHECK_NOT_NULL(phaseIn);
+    CHECK_NOT_NULL(out);
+    FFT_PROBE_TRANSFORM(transform__entry, InversePolarDouble);
+    d->setShaping(window, normaliseRotation(rotation, d->getSize()),
+                  true, gain);
+    d->inversePolar(magIn, phaseIn, out);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, InversePolarDouble);
+}
+
+void
+FFT::inverseAccumulate(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, const float *BQ_R__ window, int rotation, float gain, float *BQ_R__ out)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(imagIn);
+    CHECK_NOT_NULL(out);
+    FFT_PROBE_TRANSFORM(transform__entry, InverseFloat);
+    d->setShaping(window, normaliseRotation(rotation, d->getSize()),
+                  true, gain);
+    d->inverse(realIn, imagIn, out);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, InverseFloat);
+}
+
+void
+FFT::inverseAccumulateInterleaved(const float *BQ_R__ complexIn, const float *BQ_R__ window, int rotation, float gain, float *BQ_R__ out)
+{
+    CHECK_NOT_NULL(complexIn);
+    CHECK_NOT_NULL(out);
+    FFT_PROBE_TRANSFORM(transform__entry, InverseInterleavedFloat);
+    d->setShaping(window, normaliseRotation(rotation, d->getSize()),
+                  true, gain);
+    d->inverseInterleaved(complexIn, out);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, InverseInterleavedFloat);
+}
+
+void
+FFT::inverseAccumulatePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, const float *BQ_R__ window, int rotation, float gain, float *BQ_R__ out)
+{
+    CHECK_NOT_NULL(magIn);
+    CHECK_NOT_NULL(phaseIn);
+    CHECK_NOT_NULL(out);
+    FFT_PROBE_TRANSFORM(transform__entry, InversePolarFloat);
+    d->setShaping(window, normaliseRotation(rotation, d->getSize()),
+                  true, gain);
+    d->inversePolar(magIn, phaseIn, out);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, InversePolarFloat);
+}
+
+#ifndef NO_EXCEPTIONS
+#define CHECK_INPUT_LENGTH(length) \
+    if ((length) < 0 || (length) > d->getSize()) { \
+        std::cerr << "FFT: ERROR: Invalid input length " << (length) \
+                  << " for size " << d->getSize() << std::endl; \
+        throw InvalidSize; \
+    }
+#else
+#define CHECK_INPUT_LENGTH(length) \
+    if ((length) < 0 || (length) > d->getSize()) { \
+        std::cerr << "FFT: ERROR: Invalid input length " << (length) \
+                  << " for size " << d->getSize() << std::endl; \
+        std::cerr << "FFT: Would be throwing InvalidSize here, if exceptions were not disabled" << std::endl;  \
+        return; \
+    }
+#endif
+
+void
+FFT::forwardPadded(const double *BQ_R__ realIn, int inputLength, double *BQ_R__ realOut, double *BQ_R__ imagOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(realOut);
+    CHECK_NOT_NULL(imagOut);
+    CHECK_INPUT_LENGTH(inputLength);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardDouble);
+    d->setInputShaping(inputLength);
+    d->forward(realIn, realOut, imagOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, ForwardDouble);
+}
+
+void
+FFT::forwardPaddedInterleaved(const double *BQ_R__ realIn, int inputLength, double *BQ_R__ complexOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(complexOut);
+    CHECK_INPUT_LENGTH(inputLength);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardInterleavedDouble);
+    d->setInputShaping(inputLength);
+    d->forwardInterleaved(realIn, complexOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, ForwardInterleavedDouble);
+}
+
+void
+FFT::forwardPaddedPolar(const double *BQ_R__ realIn, int inputLength, double *BQ_R__ magOut, double *BQ_R__ phaseOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(magOut);
+    CHECK_NOT_NULL(phaseOut);
+    CHECK_INPUT_LENGTH(inputLength);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardPolarDouble);
+    d->setInputShaping(inputLength);
+    d->forwardPolar(realIn, magOut, phaseOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, ForwardPolarDouble);
+}
+
+void
+FFT::forwardPaddedMagnitude(const double *BQ_R__ realIn, int inputLength, double *BQ_R__ magOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(magOut);
+    CHECK_INPUT_LENGTH(inputLength);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardMagnitudeDouble);
+    d->setInputShaping(inputLength);
+    d->forwardMagnitude(realIn, magOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, ForwardMagnitudeDouble);
+}
+
+void
+FFT::forwardPadded(const float *BQ_R__ realIn, int inputLength, float *BQ_R__ realOut, float *BQ_R__ imagOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(realOut);
+    CHECK_NOT_NULL(imagOut);
+    CHECK_INPUT_LENGTH(inputLength);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardFloat);
+    d->setInputShaping(inputLength);
+    d->forward(realIn, realOut, imagOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, ForwardFloat);
+}
+
+void
+FFT::forwardPaddedInterleaved(const float *BQ_R__ realIn, int inputLength, float *BQ_R__ complexOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(complexOut);
+    CHECK_INPUT_LENGTH(inputLength);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardInterleavedFloat);
+    d->setInputShaping(inputLength);
+    d->forwardInterleaved(realIn, complexOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, ForwardInterleavedFloat);
+}
+
+void
+FFT::forwardPaddedPolar(const float *BQ_R__ realIn, int inputLength, float *BQ_R__ magOut, float *BQ_R__ phaseOut)
 {
     CHECK_NOT_NULL(realIn);
     CHECK_NOT_NULL(magOut);
     CHECK_NOT_NULL(phaseOut);
+    CHECK_INPUT_LENGTH(inputLength);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardPolarFloat);
+    d->setInputShaping(inputLength);
     d->forwardPolar(realIn, magOut, phaseOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, ForwardPolarFloat);
+}
+
+void
+FFT::forwardPaddedMagnitude(const float *BQ_R__ realIn, int inputLength, float *BQ_R__ magOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(magOut);
+    CHECK_INPUT_LENGTH(inputLength);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardMagnitudeFloat);
+    d->setInputShaping(inputLength);
+    d->forwardMagnitude(realIn, magOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, ForwardMagnitudeFloat);
+}
+
+#ifndef NO_EXCEPTIONS
+#define CHECK_BIN_RANGE(first, last) \
+    if ((first) < 0 || (first) > (last) || (last) > d->getSize()/2 + 1) { \
+        std::cerr << "FFT: ERROR: Invalid bin range " << (first) \
+                  << " to " << (last) << std::endl; \
+        throw InvalidSize; \
+    }
+#else
+#define CHECK_BIN_RANGE(first, last) \
+    if ((first) < 0 || (first) > (last) || (last) > d->getSize()/2 + 1) { \
+        std::cerr << "FFT: ERROR: Invalid bin range " << (first) \
+                  << " to " << (last) << std::endl; \
+        std::cerr << "FFT: Would be throwing InvalidSize here, if exceptions were not disabled" << std::endl;  \
+        return; \
+    }
+#endif
+
+// Bins first to last - 1 of the transform of the n samples of in,
+// by Goertzel's algorithm in Reinsch's form, which keeps the
+// rounding error small for bins near DC and Nyquist. The bins are
+// taken a block at a time, every sample being fed to each bin of
+// the block in turn, so that the inner loop runs across the bins
+// and vectorises. Either imOut or magOut is null.
+static const int goertzelBlock = 8;
+
+template <typename T>
+static void
+goertzel(const T *BQ_R__ in, int n, int first, int last,
+         T *BQ_R__ reOut, T *BQ_R__ imOut, T *BQ_R__ magOut)
+{
+    for (int b0 = first; b0 < last; b0 += goertzelBlock) {
+        double lambda[goertzelBlock], sigma[goertzelBlock];
+        double d[goertzelBlock], s[goertzelBlock];
+        for (int b = 0; b < goertzelBlock; ++b) {
+            const double w = (2.0 * M_PI * (b0 + b)) / n;
+            if (cos(w) > 0.0) {
+                const double h = sin(w / 2.0);
+                lambda[b] = -4.0 * h * h;
+                sigma[b] = 1.0;
+            } else {
+                const double h = cos(w / 2.0);
+                lambda[b] = 4.0 * h * h;
+                sigma[b] = -1.0;
+            }
+            d[b] = 0.0;
+            s[b] = 0.0;
+        }
+        for (int j = 0; j < n; ++j) {
+            const double x = in[j];
+            for (int b = 0; b < goertzelBlock; ++b) {
+                d[b] = lambda[b] * s[b] + sigma[b] * d[b] + x;
+                s[b] = d[b] + sigma[b] * s[b];
+            }
+        }
+        const int count = std::min(goertzelBlock, last - b0);
+        for (int b = 0; b < count; ++b) {
+            const double w = (2.0 * M_PI * (b0 + b)) / n;
+            const double re = sigma[b] * d[b] + 0.5 * lambda[b] * s[b];
+            const double im = s[b] * sin(w);
+            if (magOut) {
+                magOut[b0 - first + b] = T(sqrt(re * re + im * im));
+            } else {
+                reOut[b0 - first + b] = T(re);
+                imOut[b0 - first + b] = T(im);
+            }
+        }
+    }
+}
+
+void
+FFTImpl::forwardBinsGoertzel(const double *BQ_R__ realIn, int first, int last, double *BQ_R__ realOut, double *BQ_R__ imagOut, double *BQ_R__ magOut)
+{
+    goertzel(realIn, getSize(), first, last, realOut, imagOut, magOut);
+}
+
+void
+FFTImpl::forwardBinsGoertzel(const float *BQ_R__ realIn, int first, int last, float *BQ_R__ realOut, float *BQ_R__ imagOut, float *BQ_R__ magOut)
+{
+    goertzel(realIn, getSize(), first, last, realOut, imagOut, magOut);
+}
+
+// Whether Goertzel is cheaper than a whole transform for a range of
+// bins. A block of bins costs about as much as a transform of
+// 2^goertzelBlockCost points does per point (measured against the
+// built-in implementation, at sizes from 256 to 16384), so this
+// compares blocks * goertzelBlockCost with log2(n).
+static const int goertzelBlockCost = 7;
+
+static bool
+isGoertzelCheaper(int n, int bins)
+{
+    int log2n = 0;
+    while ((1 << log2n) < n) ++log2n;
+    int blocks = (bins + goertzelBlock - 1) / goertzelBlock;
+    return blocks * goertzelBlockCost <= log2n;
+}
+
+void
+FFT::forwardBins(const double *BQ_R__ realIn, int firstBin, int lastBin, double *BQ_R__ realOut, double *BQ_R__ imagOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(realOut);
+    CHECK_NOT_NULL(imagOut);
+    CHECK_BIN_RANGE(firstBin, lastBin);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardDouble);
+    if (isGoertzelCheaper(d->getSize(), lastBin - firstBin)) {
+        d->forwardBinsGoertzel(realIn, firstBin, lastBin,
+                               realOut, imagOut, (double *)0);
+    } else {
+        d->forwardBins(realIn, firstBin, lastBin, realOut, imagOut);
+    }
+    FFT_PROBE_TRANSFORM(transform__return, ForwardDouble);
+}
+
+void
+FFT::forwardBinsMagnitude(const double *BQ_R__ realIn, int firstBin, int lastBin, double *BQ_R__ magOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(magOut);
+    CHECK_BIN_RANGE(firstBin, lastBin);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardMagnitudeDouble);
+    if (isGoertzelCheaper(d->getSize(), lastBin - firstBin)) {
+        d->forwardBinsGoertzel(realIn, firstBin, lastBin,
+                               (double *)0, (double *)0, magOut);
+    } else {
+        d->forwardBinsMagnitude(realIn, firstBin, lastBin, magOut);
+    }
+    FFT_PROBE_TRANSFORM(transform__return, ForwardMagnitudeDouble);
+}
+
+void
+FFT::forwardBins(const float *BQ_R__ realIn, int firstBin, int lastBin, float *BQ_R__ realOut, float *BQ_R__ imagOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(realOut);
+    CHECK_NOT_NULL(imagOut);
+    CHECK_BIN_RANGE(firstBin, lastBin);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardFloat);
+    if (isGoertzelCheaper(d->getSize(), lastBin - firstBin)) {
+        d->forwardBinsGoertzel(realIn, firstBin, lastBin,
+                               realOut, imagOut, (float *)0);
+    } else {
+        d->forwardBins(realIn, firstBin, lastBin, realOut, imagOut);
+    }
+    FFT_PROBE_TRANSFORM(transform__return, ForwardFloat);
+}
+
+void
+FFT::forwardBinsMagnitude(const float *BQ_R__ realIn, int firstBin, int lastBin, float *BQ_R__ magOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(magOut);
+    CHECK_BIN_RANGE(firstBin, lastBin);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardMagnitudeFloat);
+    if (isGoertzelCheaper(d->getSize(), lastBin - firstBin)) {
+        d->forwardBinsGoertzel(realIn, firstBin, lastBin,
+                               (float *)0, (float *)0, magOut);
+    } else {
+        d->forwardBinsMagnitude(realIn, firstBin, lastBin, magOut);
+    }
+    FFT_PROBE_TRANSFORM(transform__return, ForwardMagnitudeFloat);
+}
+
+#ifndef NO_EXCEPTIONS
+#define CHECK_SAMPLE_RANGE(first, last) \
+    if ((first) < 0 || (first) > (last) || (last) > d->getSize()) { \
+        std::cerr << "FFT: ERROR: Invalid sample range " << (first) \
+                  << " to " << (last) << std::endl; \
+        throw InvalidSize; \
+    }
+#else
+#define CHECK_SAMPLE_RANGE(first, last) \
+    if ((first) < 0 || (first) > (last) || (last) > d->getSize()) { \
+        std::cerr << "FFT: ERROR: Invalid sample range " << (first) \
+                  << " to " << (last) << std::endl; \
+        std::cerr << "FFT: Would be throwing InvalidSize here, if exceptions were not disabled" << std::endl;  \
+        return; \
+    }
+#endif
+
+// The output shaping that leaves samples first to last - 1 of an
+// inverse transform at the start of the output: rotating by -first
+// brings sample first to index 0, and the count stops it there
+#define SET_SAMPLE_RANGE_SHAPING(first, last) \
+    d->setOutputShaping(normaliseRotation(-(first), d->getSize()), \
+                        (last) - (first))
+
+void
+FFT::inverseSamples(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, int firstSample, int lastSample, double *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(imagIn);
+    CHECK_NOT_NULL(realOut);
+    CHECK_SAMPLE_RANGE(firstSample, lastSample);
+    FFT_PROBE_TRANSFORM(transform__entry, InverseDouble);
+    SET_SAMPLE_RANGE_SHAPING(firstSample, lastSample);
+    d->inverse(realIn, imagIn, realOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, InverseDouble);
+}
+
+void
+FFT::inverseInterleavedSamples(const double *BQ_R__ complexIn, int firstSample, int lastSample, double *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(complexIn);
+    CHECK_NOT_NULL(realOut);
+    CHECK_SAMPLE_RANGE(firstSample, lastSample);
+    FFT_PROBE_TRANSFORM(transform__entry, InverseInterleavedDouble);
+    SET_SAMPLE_RANGE_SHAPING(firstSample, lastSample);
+    d->inverseInterleaved(complexIn, realOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, InverseInterleavedDouble);
+}
+
+void
+FFT::inverseSamples(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, int firstSample, int lastSample, float *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(imagIn);
+    CHECK_NOT_NULL(realOut);
+    CHECK_SAMPLE_RANGE(firstSample, lastSample);
+    FFT_PROBE_TRANSFORM(transform__entry, InverseFloat);
+    SET_SAMPLE_RANGE_SHAPING(firstSample, lastSample);
+    d->inverse(realIn, imagIn, realOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, InverseFloat);
+}
+
+void
+FFT::inverseInterleavedSamples(const float *BQ_R__ complexIn, int firstSample, int lastSample, float *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(complexIn);
+    CHECK_NOT_NULL(realOut);
+    CHECK_SAMPLE_RANGE(firstSample, lastSample);
+    FFT_PROBE_TRANSFORM(transform__entry, InverseInterleavedFloat);
+    SET_SAMPLE_RANGE_SHAPING(firstSample, lastSample);
+    d->inverseInterleaved(complexIn, realOut);
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, InverseInterleavedFloat);
+}
+
+void
+FFT::forwardPower(const double *BQ_R__ realIn, double *BQ_R__ powerOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(powerOut);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardMagnitudeDouble);
+    d->forwardPower(realIn, powerOut);
+    FFT_PROBE_TRANSFORM(transform__return, ForwardMagnitudeDouble);
+}
+
+void
+FFT::inversePower(const double *BQ_R__ powerIn, double *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(powerIn);
+    CHECK_NOT_NULL(realOut);
+    FFT_PROBE_TRANSFORM(transform__entry, InverseCepstralDouble);
+    d->inversePower(powerIn, realOut);
+    FFT_PROBE_TRANSFORM(transform__return, InverseCepstralDouble);
+}
+
+void
+FFT::forwardPower(const float *BQ_R__ realIn, float *BQ_R__ powerOut)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(powerOut);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardMagnitudeFloat);
+    d->forwardPower(realIn, powerOut);
+    FFT_PROBE_TRANSFORM(transform__return, ForwardMagnitudeFloat);
+}
+
+void
+FFT::inversePower(const float *BQ_R__ powerIn, float *BQ_R__ realOut)
+{
+    CHECK_NOT_NULL(powerIn);
+    CHECK_NOT_NULL(realOut);
+    FFT_PROBE_TRANSFORM(transform__entry, InverseCepstralFloat);
+    d->inversePower(powerIn, realOut);
+    FFT_PROBE_TRANSFORM(transform__return, InverseCepstralFloat);
+}
+
+// Power floor to pass to FFTImpl::forwardLogPower, which must be
+// positive and normal for the log approximation to hold
+static double
+logPowerFloor(double floorPower, double least)
+{
+    return floorPower > least ? floorPower : least;
+}
+
+void
+FFT::forwardLogMagnitude(const double *BQ_R__ realIn, double *BQ_R__ logMagOut, double floor)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(logMagOut);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardMagnitudeDouble);
+    d->forwardLogPower(realIn, logMagOut,
+                       logPowerFloor(floor * floor, DBL_MIN), 0.5);
+    FFT_PROBE_TRANSFORM(transform__return, ForwardMagnitudeDouble);
+}
+
+void
+FFT::forwardDecibels(const double *BQ_R__ realIn, double *BQ_R__ dbOut, double floorDb)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(dbOut);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardMagnitudeDouble);
+    d->forwardLogPower(realIn, dbOut,
+                       logPowerFloor(pow(10.0, floorDb / 10.0), DBL_MIN),
+                       10.0 / log(10.0));
+    FFT_PROBE_TRANSFORM(transform__return, ForwardMagnitudeDouble);
+}
+
+void
+FFT::forwardLogMagnitude(const float *BQ_R__ realIn, float *BQ_R__ logMagOut, float floor)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(logMagOut);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardMagnitudeFloat);
+    d->forwardLogPower(realIn, logMagOut,
+                       float(logPowerFloor(double(floor) * floor, FLT_MIN)),
+                       0.5f);
+    FFT_PROBE_TRANSFORM(transform__return, ForwardMagnitudeFloat);
+}
+
+void
+FFT::forwardDecibels(const float *BQ_R__ realIn, float *BQ_R__ dbOut, float floorDb)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(dbOut);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardMagnitudeFloat);
+    d->forwardLogPower(realIn, dbOut,
+                       float(logPowerFloor(pow(10.0, floorDb / 10.0), FLT_MIN)),
+                       float(10.0 / log(10.0)));
+    FFT_PROBE_TRANSFORM(transform__return, ForwardMagnitudeFloat);
+}
+
+#ifndef NO_EXCEPTIONS
+#define CHECK_LAG_RANGE(minLag, maxLag) \
+    if (!isValidLagRange(minLag, maxLag, d->getSize())) { \
+        std::cerr << "FFT: ERROR: Invalid lag range " << (minLag) \
+                  << " to " << (maxLag) << std::endl; \
+        throw InvalidSize; \
+    }
+#else
+#define CHECK_LAG_RANGE(minLag, maxLag) \
+    if (!isValidLagRange(minLag, maxLag, d->getSize())) { \
+        std::cerr << "FFT: ERROR: Invalid lag range " << (minLag) \
+                  << " to " << (maxLag) << std::endl; \
+        std::cerr << "FFT: Would be throwing InvalidSize here, if exceptions were not disabled" << std::endl;  \
+        return; \
+    }
+#endif
+
+static bool
+isValidLagRange(int minLag, int maxLag, int size)
+{
+    return minLag <= maxLag && minLag > -size && maxLag < size &&
+        maxLag - minLag < size;
+}
+
+// Factor to pass to FFTImpl::correlate: the implementations return
+// unnormalised inverses, so this includes 1/size as well as the
+// requested normalisation. The coefficient normalisation needs the
+// input energies, which are taken in the time domain.
+template <typename T>
+static double
+correlationScale(FFT::Normalisation normalisation, int size,
+                 const T *BQ_R__ a, const T *BQ_R__ b)
+{
+    double scale = 1.0 / size;
+    switch (normalisation) {
+    case FFT::NoNormalisation:
+        break;
+    case FFT::BiasedNormalisation:
+        scale /= size;
+        break;
+    case FFT::CoefficientNormalisation: {
+        double ea = 0.0, eb = 0.0;
+        for (int i = 0; i < size; ++i) ea += double(a[i]) * double(a[i]);
+        if (b == a) {
+            eb = ea;
+        } else {
+            for (int i = 0; i < size; ++i) eb += double(b[i]) * double(b[i]);
+        }
+        if (ea > 0.0 && eb > 0.0) scale /= sqrt(ea * eb);
+        break;
+    }
+    }
+    return scale;
+}
+
+void
+FFT::correlate(const double *BQ_R__ a, const double *BQ_R__ b, double *BQ_R__ out)
+{
+    CHECK_NOT_NULL(a);
+    CHECK_NOT_NULL(b);
+    CHECK_NOT_NULL(out);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardInterleavedDouble);
+    d->correlate(a, b, out, 1.0 / d->getSize());
+    FFT_PROBE_TRANSFORM(transform__return, ForwardInterleavedDouble);
+}
+
+void
+FFT::correlate(const double *BQ_R__ a, const double *BQ_R__ b, double *BQ_R__ out, int minLag, int maxLag, Normalisation normalisation)
+{
+    CHECK_NOT_NULL(a);
+    CHECK_NOT_NULL(b);
+    CHECK_NOT_NULL(out);
+    CHECK_LAG_RANGE(minLag, maxLag);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardInterleavedDouble);
+    const int size = d->getSize();
+    d->setOutputShaping(normaliseRotation(-minLag, size), maxLag - minLag + 1);
+    d->correlate(a, b, out, correlationScale(normalisation, size, a, b));
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, ForwardInterleavedDouble);
+}
+
+void
+FFT::correlate(const float *BQ_R__ a, const float *BQ_R__ b, float *BQ_R__ out)
+{
+    CHECK_NOT_NULL(a);
+    CHECK_NOT_NULL(b);
+    CHECK_NOT_NULL(out);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardInterleavedFloat);
+    d->correlate(a, b, out, 1.f / d->getSize());
+    FFT_PROBE_TRANSFORM(transform__return, ForwardInterleavedFloat);
+}
+
+void
+FFT::correlate(const float *BQ_R__ a, const float *BQ_R__ b, float *BQ_R__ out, int minLag, int maxLag, Normalisation normalisation)
+{
+    CHECK_NOT_NULL(a);
+    CHECK_NOT_NULL(b);
+    CHECK_NOT_NULL(out);
+    CHECK_LAG_RANGE(minLag, maxLag);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardInterleavedFloat);
+    const int size = d->getSize();
+    d->setOutputShaping(normaliseRotation(-minLag, size), maxLag - minLag + 1);
+    d->correlate(a, b, out, float(correlationScale(normalisation, size, a, b)));
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, ForwardInterleavedFloat);
+}
+
+void
+FFT::autocorrelate(const double *BQ_R__ in, double *BQ_R__ out)
+{
+    CHECK_NOT_NULL(in);
+    CHECK_NOT_NULL(out);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardInterleavedDouble);
+    d->autocorrelate(in, out, 1.0 / d->getSize());
+    FFT_PROBE_TRANSFORM(transform__return, ForwardInterleavedDouble);
+}
+
+void
+FFT::autocorrelate(const double *BQ_R__ in, double *BQ_R__ out, int maxLag, Normalisation normalisation)
+{
+    CHECK_NOT_NULL(in);
+    CHECK_NOT_NULL(out);
+    CHECK_LAG_RANGE(0, maxLag);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardInterleavedDouble);
+    const int size = d->getSize();
+    d->setOutputShaping(0, maxLag + 1);
+    d->autocorrelate(in, out, correlationScale(normalisation, size, in, in));
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, ForwardInterleavedDouble);
+}
+
+void
+FFT::autocorrelate(const float *BQ_R__ in, float *BQ_R__ out)
+{
+    CHECK_NOT_NULL(in);
+    CHECK_NOT_NULL(out);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardInterleavedFloat);
+    d->autocorrelate(in, out, 1.f / d->getSize());
+    FFT_PROBE_TRANSFORM(transform__return, ForwardInterleavedFloat);
+}
+
+void
+FFT::autocorrelate(const float *BQ_R__ in, float *BQ_R__ out, int maxLag, Normalisation normalisation)
+{
+    CHECK_NOT_NULL(in);
+    CHECK_NOT_NULL(out);
+    CHECK_LAG_RANGE(0, maxLag);
+    FFT_PROBE_TRANSFORM(transform__entry, ForwardInterleavedFloat);
+    const int size = d->getSize();
+    d->setOutputShaping(0, maxLag + 1);
+    d->autocorrelate(in, out, float(correlationScale(normalisation, size, in, in)));
+    d->clearShaping();
+    FFT_PROBE_TRANSFORM(transform__return, ForwardInterleavedFloat);
+}
+
+#ifndef NO_EXCEPTIONS
+#define CHECK_LIFTER_CUTOFF(cutoff) \
+    if ((cutoff) < 0) { \
+        std::cerr << "FFT: ERROR: Invalid lifter cutoff " << (cutoff) \
+                  << std::endl; \
+        throw InvalidSize; \
+    }
+#else
+#define CHECK_LIFTER_CUTOFF(cutoff) \
+    if ((cutoff) < 0) { \
+        std::cerr << "FFT: ERROR: Invalid lifter cutoff " << (cutoff) \
+                  << std::endl; \
+        std::cerr << "FFT: Would be throwing InvalidSize here, if exceptions were not disabled" << std::endl;  \
+        return; \
+    }
+#endif
+
+void
+FFT::cepstralEnvelope(const double *BQ_R__ frame, int lifterCutoff, double *BQ_R__ envOut)
+{
+    CHECK_NOT_NULL(frame);
+    CHECK_NOT_NULL(envOut);
+    CHECK_LIFTER_CUTOFF(lifterCutoff);
+    FFT_PROBE_TRANSFORM(transform__entry, InverseCepstralDouble);
+    d->cepstralEnvelope(frame, lifterCutoff, envOut);
+    FFT_PROBE_TRANSFORM(transform__return, InverseCepstralDouble);
 }
 
 void
-FFT::forwardMagnitude(const double *BQ_R__ realIn, double *BQ_R__ magOut)
+FFT::cepstralEnvelope(const float *BQ_R__ frame, int lifterCutoff, float *BQ_R__ envOut)
 {
-    CHECK_NOT_NULL(realIn);
-    CHECK_NOT_NULL(magOut);
-    d->forwardMagnitude(realIn, magOut);
+    CHECK_NOT_NULL(frame);
+    CHECK_NOT_NULL(envOut);
+    CHECK_LIFTER_CUTOFF(lifterCutoff);
+    FFT_PROBE_TRANSFORM(transform__entry, InverseCepstralFloat);
+    d->cepstralEnvelope(frame, lifterCutoff, envOut);
+    FFT_PROBE_TRANSFORM(transform__return, InverseCepstralFloat);
 }
 
 void
-FFT::forward(const float *BQ_R__ realIn, float *BQ_R__ realOut, float *BQ_R__ imagOut)
+FFT::initFloat() 
 {
-    CHECK_NOT_NULL(realIn);
-    CHECK_NOT_NULL(realOut);
-    CHECK_NOT_NULL(imagOut);
-    d->forward(realIn, realOut, imagOut);
+    d->initFloat();
 }
 
 void
-FFT::forwardInterleaved(const float *BQ_R__ realIn, float *BQ_R__ complexOut)
+FFT::initDouble() 
 {
-    CHECK_NOT_NULL(realIn);
-    CHECK_NOT_NULL(complexOut);
-    d->forwardInterleaved(realIn, complexOut);
+    d->initDouble();
 }
 
-void
-FFT::forwardPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut)
+int
+FFT::getSize() const
 {
-    CHECK_NOT_NULL(realIn);
-    CHECK_NOT_NULL(magOut);
-    CHECK_NOT_NULL(phaseOut);
-    d->forwardPolar(realIn, magOut, phaseOut);
+    return m_size;
 }
 
-void
-FFT::forwardMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut)
+std::string
+FFT::getImplementation() const
 {
-    CHECK_NOT_NULL(realIn);
-    CHECK_NOT_NULL(magOut);
-    d->forwardMagnitude(realIn, magOut);
+    return m_implementation;
 }
 
-void
-FFT::inverse(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut)
+#ifdef FFT_STATISTICS
+
+const char *
+FFT::getMethodName(int method)
 {
-    CHECK_NOT_NULL(realIn);
-    CHECK_NOT_NULL(imagIn);
-    CHECK_NOT_NULL(realOut);
-    d->inverse(realIn, imagIn, realOut);
+    if (method < 0 || method >= MethodTypeCount) return "";
+    return methodTypeNames[method];
 }
 
-void
-FFT::inverseInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ realOut)
+FFT::Statistics
+FFT::getStatistics() const
 {
-    CHECK_NOT_NULL(complexIn);
-    CHECK_NOT_NULL(realOut);
-    d->inverseInterleaved(complexIn, realOut);
+    return static_cast<const FFTs::D_Instrumented *>(d)->getStatistics();
 }
 
 void
-FFT::inversePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, double *BQ_R__ realOut)
+FFT::resetStatistics()
 {
-    CHECK_NOT_NULL(magIn);
-    CHECK_NOT_NULL(phaseIn);
-    CHECK_NOT_NULL(realOut);
-    d->inversePolar(magIn, phaseIn, realOut);
+    static_cast<FFTs::D_Instrumented *>(d)->resetStatistics();
 }
 
-void
-FFT::inverseCepstral(const double *BQ_R__ magIn, double *BQ_R__ cepOut)
+FFT::Statistics
+FFT::getProcessStatistics()
 {
-    CHECK_NOT_NULL(magIn);
-    CHECK_NOT_NULL(cepOut);
-    d->inverseCepstral(magIn, cepOut);
+    return FFTs::D_Instrumented::getProcessStatistics();
 }
 
 void
-FFT::inverse(const float *BQ_R__ realIn, const float *BQ_R__ imagIn, float *BQ_R__ realOut)
+FFT::resetProcessStatistics()
 {
-    CHECK_NOT_NULL(realIn);
-    CHECK_NOT_NULL(imagIn);
-    CHECK_NOT_NULL(realOut);
-    d->inverse(realIn, imagIn, realOut);
+    FFTs::D_Instrumented::resetProcessStatistics();
 }
 
 void
-FFT::inverseInterleaved(const float *BQ_R__ complexIn, float *BQ_R__ realOut)
+FFT::setStatisticsEnabled(bool enabled)
 {
-    CHECK_NOT_NULL(complexIn);
-    CHECK_NOT_NULL(realOut);
-    d->inverseInterleaved(complexIn, realOut);
+    statisticsEnabled = enabled;
 }
 
-void
-FFT::inversePolar(const float *BQ_R__ magIn, const float *BQ_R__ phaseIn, float *BQ_R__ realOut)
+bool
+FFT::isStatisticsEnabled()
 {
-    CHECK_NOT_NULL(magIn);
-    CHECK_NOT_NULL(phaseIn);
-    CHECK_NOT_NULL(realOut);
-    d->inversePolar(magIn, phaseIn, realOut);
+    return statisticsEnabled;
 }
 
-void
-FFT::inverseCepstral(const float *BQ_R__ magIn, float *BQ_R__ cepOut)
+double
+FFT::LatencyHistogram::getPercentile(double percentile) const
 {
-    CHECK_NOT_NULL(magIn);
-    CHECK_NOT_NULL(cepOut);
-    d->inverseCepstral(magIn, cepOut);
+    if (count == 0) return 0.0;
+    uint64_t target = uint64_t(ceil(double(count) * percentile / 100.0));
+    if (target < 1) target = 1;
+    uint64_t cumulative = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        cumulative += buckets[i];
+        if (cumulative >= target) {
+            double upper = ldexp(1.0, i + 1);
+            return (upper < maxNs ? upper : maxNs);
+        }
+    }
+    return maxNs;
 }
 
-void
-FFT::initFloat() 
+FFT::LatencyHistogram
+FFT::getLatencyHistogram() const
 {
-    d->initFloat();
+    return static_cast<const FFTs::D_Instrumented *>(d)->getLatencyHistogram();
 }
 
 void
-FFT::initDouble() 
+FFT::resetLatencyHistogram()
 {
-    d->initDouble();
+    static_cast<FFTs::D_Instrumented *>(d)->resetLatencyHistogram();
 }
 
-int
-FFT::getSize() const
+std::string
+FFT::getLatencySummary() const
+{
+    LatencyHistogram h = getLatencyHistogram();
+    std::ostringstream os;
+    os << "count " << h.count
+       << ", p50 " << h.getPercentile(50.0) << " ns"
+       << ", p99 " << h.getPercentile(99.0) << " ns"
+       << ", p99.9 " << h.getPercentile(99.9) << " ns"
+       << ", max " << h.maxNs << " ns";
+    return os.str();
+}
+
+void
+FFT::setLatencyHistogramEnabled(bool enabled)
 {
-    return d->getSize();
+    latencyHistogramEnabled = enabled;
 }
 
+#endif
+
 FFT::Precisions
 FFT::getSupportedPrecisions() const
 {
     return d->getSupportedPrecisions();
 }
 
-#ifdef FFT_MEASUREMENT
+int
+FFT::getPreferredAlignment() const
+{
+    return d->getPreferredAlignment();
+}
 
-#ifdef FFT_MEASUREMENT_RETURN_RESULT_TEXT
-std::string
-#else
-void
-#endif
-FFT::tune()
+int
+FFT::getBufferLength(BufferType type) const
 {
-#ifdef FFT_MEASUREMENT_RETURN_RESULT_TEXT
-    std::ostringstream os;
+    const int size = d->getSize();
+    switch (type) {
+    case TimeDomainBuffer: return size;
+    case SplitSpectrumBuffer: return size/2 + 1;
+    case InterleavedSpectrumBuffer: return size + 2;
+    }
+    return size + 2;
+}
+
+void *
+FFT::allocateAligned(size_t bytes) const
+{
+    // Over-allocate so that we can align within the block and stash
+    // the original pointer just before the aligned one
+    const size_t alignment = d->getPreferredAlignment();
+    const size_t padded = ((bytes + alignment - 1) / alignment) * alignment;
+    char *base = (char *)malloc(padded + alignment + sizeof(void *));
+    if (!base) {
+        std::cerr << "FFT: ERROR: Failed to allocate " << padded
+                  << " bytes" << std::endl;
+#ifndef NO_EXCEPTIONS
+        throw std::bad_alloc();
 #else
-#define os std::cerr
+        abort();
 #endif
-    os << "FFT::tune()..." << std::endl;
-
-    std::vector<int> sizes;
-    std::map<std::string, FFTImpl *> candidates;
-    std::map<std::string, int> wins;
-
-    sizes.push_back(512);
-    sizes.push_back(1024);
-    sizes.push_back(2048);
-    sizes.push_back(4096);
-    
-    for (unsigned int si = 0; si < sizes.size(); ++si) {
+    }
+    char *aligned = base + sizeof(void *);
+    aligned += (alignment - ((uintptr_t)aligned & (alignment - 1)))
+        & (alignment - 1);
+    ((void **)aligned)[-1] = base;
+    memset(aligned, 0, padded);
+    return aligned;
+}
 
-        int size = sizes[si];
+void
+FFT::deallocateBuffer(void *buffer)
+{
+    if (!buffer) return;
+    free(((void **)buffer)[-1]);
+}
 
-        while (!candidates.empty()) {
-            delete candidates.begin()->second;
-            candidates.erase(candidates.begin());
-        }
+int
+FFT::getSlowPathCount() const
+{
+    return d->getSlowPathCount();
+}
 
-        FFTImpl *d;
-        
-#ifdef HAVE_IPP
-        os << "Constructing new IPP FFT object for size " << size << "..." << std::endl;
-        d = new FFTs::D_IPP(size);
-        d->initFloat();
-        d->initDouble();
-        candidates["ipp"] = d;
-#endif
-        
-#ifdef HAVE_FFTW3
-        os << "Constructing new FFTW3 FFT object for size " << size << "..." << std::endl;
-        d = new FFTs::D_FFTW(size);
-        d->initFloat();
-        d->initDouble();
-        candidates["fftw"] = d;
-#endif
-        
-#ifdef HAVE_SLEEF
-        os << "Constructing new SLEEF FFT object for size " << size << "..." << std::endl;
-        d = new FFTs::D_SLEEF(size);
-        d->initFloat();
-        d->initDouble();
-        candidates["sleef"] = d;
-#endif
+void
+FFT::setPolarAccuracy(PolarAccuracy accuracy)
+{
+    d->setFastPolar(accuracy == FastPolar);
+}
 
-#ifdef HAVE_KISSFFT
-        os << "Constructing new KISSFFT object for size " << size << "..." << std::endl;
-        d = new FFTs::D_KISSFFT(size);
-        d->initFloat();
-        d->initDouble();
-        candidates["kissfft"] = d;
-#endif        
+FFT::PolarAccuracy
+FFT::getPolarAccuracy() const
+{
+    return d->isFastPolar() ? FastPolar : ExactPolar;
+}
 
-#ifdef USE_BUILTIN_FFT
-        os << "Constructing new Builtin FFT object for size " << size << "..." << std::endl;
-        d = new FFTs::D_Builtin(size);
-        d->initFloat();
-        d->initDouble();
-        candidates["builtin"] = d;
-#endif
-        
-#ifdef HAVE_VDSP
-        os << "Constructing new vDSP FFT object for size " << size << "..." << std::endl;
-        d = new FFTs::D_VDSP(size);
-        d->initFloat();
-        d->initDouble();
-        candidates["vdsp"] = d;
-#endif
+#ifdef FFT_MEASUREMENT
 
-        os << "Constructing new DFT object for size " << size << "..." << std::endl;
-        d = new FFTs::D_DFT(size);
-        d->initFloat();
-        d->initDouble();
-        candidates["dft"] = d;
+// Approximate flop count for a real transform of the given size, by
+// the usual 2.5 N log2 N convention, so that MFLOPS figures are
+// comparable across sizes and with other published benchmarks
+static double
+estimateFlops(int size)
+{
+    return 2.5 * size * (log(double(size)) / log(2.0));
+}
 
-        os << "CLOCKS_PER_SEC = " << CLOCKS_PER_SEC << std::endl;
-        float divisor = float(CLOCKS_PER_SEC) / 1000.f;
-        
-        os << "Timing order is: ";
-        for (std::map<std::string, FFTImpl *>::iterator ci = candidates.begin();
-             ci != candidates.end(); ++ci) {
-            os << ci->first << " ";
+static std::string
+jsonEscape(std::string s)
+{
+    std::string escaped;
+    for (std::string::size_type i = 0; i < s.length(); ++i) {
+        if (s[i] == '"' || s[i] == '\\') {
+            escaped += '\\';
         }
-        os << std::endl;
-
-        int iterations = 500;
-        os << "Iterations: " << iterations << std::endl;
+        if ((unsigned char)s[i] >= 0x20) {
+            escaped += s[i];
+        }
+    }
+    return escaped;
+}
 
-        double *da = allocate_and_zero<double>(size);
-        double *db = allocate_and_zero<double>(size);
-        double *dc = allocate_and_zero<double>(size);
-        double *dd = allocate_and_zero<double>(size);
+static std::string
+csvEscape(std::string s)
+{
+    if (s.find_first_of(",\"") == std::string::npos) {
+        return s;
+    }
+    std::string escaped = "\"";
+    for (std::string::size_type i = 0; i < s.length(); ++i) {
+        if (s[i] == '"') {
+            escaped += '"';
+        }
+        escaped += s[i];
+    }
+    return escaped + "\"";
+}
 
-        double *di = allocate_and_zero<double>(size + 2);
-        double *dj = allocate_and_zero<double>(size + 2);
+static void
+runTune(std::ostream &os, FFT::TuneFormat format, const std::vector<int> &sizes)
+{
+    ImplMap impls = getImplementationDetails();
+    std::map<std::string, int> wins;
+    std::string cpu = getCPUModel();
+    bool first = true;
+    
+    if (format == FFT::TuneText) {
+        os << "FFT::tune()..." << std::endl;
+        os << "CPU: " << cpu << std::endl;
+        os << "Timings are median ns per transform, with MFLOPS "
+           << "(2.5 N log2 N) and 10th-90th percentile range" << std::endl;
+    } else if (format == FFT::TuneJSON) {
+        os << "{\n  \"cpu\": \"" << jsonEscape(cpu) << "\",\n"
+           << "  \"results\": [";
+    } else {
+        os << "cpu,size,method,implementation,ns,mflops,"
+           << "min,p10,p50,p90,max,mean,iterations,batches" << std::endl;
+    }
 
-        float *fa = allocate_and_zero<float>(size);
-        float *fb = allocate_and_zero<float>(size);
-        float *fc = allocate_and_zero<float>(size);
-        float *fd = allocate_and_zero<float>(size);
+    for (int si = 0; si < int(sizes.size()); ++si) {
 
-        float *fi = allocate_and_zero<float>(size + 2);
-        float *fj = allocate_and_zero<float>(size + 2);
+        int size = sizes[si];
+        if (size < 2) continue;
+
+        std::map<std::string, FFTImpl *> candidates;
+        for (ImplMap::const_iterator itr = impls.begin();
+             itr != impls.end(); ++itr) {
+            if (!isUsableForSize(itr->second, size)) continue;
+            FFTImpl *d = createImplementation(itr->first, size);
+            if (!d) continue;
+            d->initFloat();
+            d->initDouble();
+            candidates[itr->first] = d;
+        }
 
-        for (int type = 0; type < 16; ++type) {
-    
-            //!!!
-            if ((type > 3 && type < 8) ||
-                (type > 11)) {
-                continue;
-            }
+        MeasurementBuffers buffers(size);
+        double flops = estimateFlops(size);
 
-            if (type > 7) {
-                // inverse transform: bigger inputs, to simulate the
-                // fact that the forward transform is unscaled
-                for (int i = 0; i < size; ++i) {
-                    da[i] = drand48() * size;
-                    fa[i] = da[i];
-                    db[i] = drand48() * size;
-                    fb[i] = db[i];
-                }
-            } else {    
-                for (int i = 0; i < size; ++i) {
-                    da[i] = drand48();
-                    fa[i] = da[i];
-                    db[i] = drand48();
-                    fb[i] = db[i];
-                }
-            }
-                
-            for (int i = 0; i < size + 2; ++i) {
-                di[i] = drand48();
-                fi[i] = di[i];
-            }
+        for (int type = 0; type < MethodTypeCount; ++type) {
 
             std::string low;
-            clock_t lowscore = 0;
-
-            const char *names[] = {
-
-                "Forward Cartesian Double",
-                "Forward Interleaved Double",
-                "Forward Polar Double",
-                "Forward Magnitude Double",
-                "Forward Cartesian Float",
-                "Forward Interleaved Float",
-                "Forward Polar Float",
-                "Forward Magnitude Float",
-
-                "Inverse Cartesian Double",
-                "Inverse Interleaved Double",
-                "Inverse Polar Double",
-                "Inverse Cepstral Double",
-                "Inverse Cartesian Float",
-                "Inverse Interleaved Float",
-                "Inverse Polar Float",
-                "Inverse Cepstral Float"
-            };
-            os << names[type] << " :: ";
-
-            for (std::map<std::string, FFTImpl *>::iterator ci = candidates.begin();
-                 ci != candidates.end(); ++ci) {
-
-                FFTImpl *d = ci->second;
-
-                double mean = 0;
-
-                clock_t start = clock();
-                
-                for (int i = 0; i < iterations; ++i) {
-
-                    if (i == 0) {
-                        for (int j = 0; j < size; ++j) {
-                            dc[j] = 0;
-                            dd[j] = 0;
-                            fc[j] = 0;
-                            fd[j] = 0;
-                            fj[j] = 0;
-                            dj[j] = 0;
-                        }
-                    }
-
-                    switch (type) {
-                    case 0: d->forward(da, dc, dd); break;
-                    case 1: d->forwardInterleaved(da, dj); break;
-                    case 2: d->forwardPolar(da, dc, dd); break;
-                    case 3: d->forwardMagnitude(da, dc); break;
-                    case 4: d->forward(fa, fc, fd); break;
-                    case 5: d->forwardInterleaved(fa, fj); break;
-                    case 6: d->forwardPolar(fa, fc, fd); break;
-                    case 7: d->forwardMagnitude(fa, fc); break;
-                    case 8: d->inverse(da, db, dc); break;
-                    case 9: d->inverseInterleaved(di, dc); break;
-                    case 10: d->inversePolar(da, db, dc); break;
-                    case 11: d->inverseCepstral(da, dc); break;
-                    case 12: d->inverse(fa, fb, fc); break;
-                    case 13: d->inverseInterleaved(fi, fc); break;
-                    case 14: d->inversePolar(fa, fb, fc); break;
-                    case 15: d->inverseCepstral(fa, fc); break;
-                    }
+            double lowscore = 0.0;
 
-                    if (i == 0) {
-                        mean = 0;
-                        for (int j = 0; j < size; ++j) {
-                            mean += dc[j];
-                            mean += dd[j];
-                            mean += fc[j];
-                            mean += fd[j];
-                            mean += fj[j];
-                            mean += dj[j];
-                        }
-                        mean /= size * 6;
-                    }
+            if (format == FFT::TuneText) {
+                os << "size " << size << ", " << methodTypeNames[type]
+                   << ":" << std::endl;
+            }
+            
+            for (std::map<std::string, FFTImpl *>::iterator ci =
+                     candidates.begin(); ci != candidates.end(); ++ci) {
+
+                MethodTiming t = measureMethod(ci->second, type, buffers,
+                                               21, 1.0e6);
+                double mflops = flops * 1.0e3 / t.p50;
+
+                if (format == FFT::TuneText) {
+                    os << "  " << ci->first << ": " << t.p50 << " ns, "
+                       << mflops << " MFLOPS (" << t.p10 << " - "
+                       << t.p90 << ")" << std::endl;
+                } else if (format == FFT::TuneJSON) {
+                    os << (first ? "\n" : ",\n")
+                       << "    { \"size\": " << size
+                       << ", \"method\": \"" << methodTypeNames[type] << "\""
+                       << ", \"implementation\": \"" << ci->first << "\""
+                       << ", \"ns\": " << t.p50
+                       << ", \"mflops\": " << mflops
+                       << ", \"min\": " << t.min
+                       << ", \"p10\": " << t.p10
+                       << ", \"p50\": " << t.p50
+                       << ", \"p90\": " << t.p90
+                       << ", \"max\": " << t.max
+                       << ", \"mean\": " << t.mean
+                       << ", \"iterations\": " << t.iterations
+                       << ", \"batches\": " << t.batches << " }";
+                } else {
+                    os << csvEscape(cpu) << "," << size << ","
+                       << methodTypeNames[type] << "," << ci->first << ","
+                       << t.p50 << "," << mflops << "," << t.min << ","
+                       << t.p10 << "," << t.p50 << "," << t.p90 << ","
+                       << t.max << "," << t.mean << "," << t.iterations
+                       << "," << t.batches << std::endl;
                 }
+                first = false;
 
-                clock_t end = clock();
-
-                os << float(end - start)/divisor << " (" << mean << ") ";
-
-                if (low == "" || (end - start) < lowscore) {
+                if (low == "" || t.p50 < lowscore) {
                     low = ci->first;
-                    lowscore = end - start;
+                    lowscore = t.p50;
                 }
             }
 
-            os << std::endl;
-
-            os << "  size " << size << ", type " << type << ": fastest is " << low << " (time " << float(lowscore)/divisor << ")" << std::endl;
-
+            if (format == FFT::TuneText) {
+                os << "  fastest is " << low << std::endl;
+            }
+            
             wins[low]++;
         }
 
-        deallocate(da);
-        deallocate(db);
-        deallocate(dc);
-        deallocate(dd);
-
-        deallocate(di);
-        deallocate(dj);
-        
-        deallocate(fa);
-        deallocate(fb);
-        deallocate(fc);
-        deallocate(fd);
-
-        deallocate(fi);
-        deallocate(fj);
-    }
-
-    while (!candidates.empty()) {
-        delete candidates.begin()->second;
-        candidates.erase(candidates.begin());
+        while (!candidates.empty()) {
+            delete candidates.begin()->second;
+            candidates.erase(candidates.begin());
+        }
     }
 
     int bestscore = 0;
@@ -3201,10 +8153,50 @@ FFT::tune()
         }
     }
 
-    os << "overall winner is " << best << " with " << bestscore << " wins" << std::endl;
+    if (format == FFT::TuneText) {
+        os << "overall winner is " << best << " with " << bestscore
+           << " wins" << std::endl;
+    } else if (format == FFT::TuneJSON) {
+        os << "\n  ],\n  \"winner\": \"" << best << "\"\n}" << std::endl;
+    }
+}
+
+#ifdef FFT_MEASUREMENT_RETURN_RESULT_TEXT
+std::string
+#else
+void
+#endif
+FFT::tune()
+{
+    std::vector<int> sizes;
+    sizes.push_back(512);
+    sizes.push_back(1024);
+    sizes.push_back(2048);
+    sizes.push_back(4096);
+#ifdef FFT_MEASUREMENT_RETURN_RESULT_TEXT
+    return tune(TuneText, sizes);
+#else
+    tune(TuneText, sizes);
+#endif
+}
 
 #ifdef FFT_MEASUREMENT_RETURN_RESULT_TEXT
+std::string
+#else
+void
+#endif
+FFT::tune(TuneFormat format, const std::vector<int> &sizes)
+{
+#ifdef FFT_MEASUREMENT_RETURN_RESULT_TEXT
+    std::ostringstream os;
+    runTune(os, format, sizes);
     return os.str();
+#else
+    if (format == TuneText) {
+        runTune(std::cerr, format, sizes);
+    } else {
+        runTune(std::cout, format, sizes);
+    }
 #endif
 }
 
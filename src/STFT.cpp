@@ -0,0 +1,315 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    bqfft
+
+    A small library wrapping various FFT implementations for some
+    common audio processing use cases.
+
+    Copyright 2007-2021 Particular Programs Ltd.
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of Chris Cannam and
+    Particular Programs Ltd shall not be used in advertising or
+    otherwise to promote the sale, use or other dealings in this
+    Software without prior written authorization.
+*/
+
+#include "bqfft/STFT.h"
+
+#include <bqvec/Allocators.h>
+#include <bqvec/VectorOps.h>
+
+#include <iostream>
+#include <cstdlib>
+
+namespace breakfastquay {
+
+static int
+checkSTFTSizes(int frameSize, int hop, int capacity)
+{
+    if (frameSize < 2 || hop < 1 || hop > frameSize ||
+        (capacity != 0 && capacity < frameSize)) {
+        std::cerr << "STFT: ERROR: Invalid frame size " << frameSize
+                  << ", hop " << hop << " or capacity " << capacity
+                  << std::endl;
+#ifndef NO_EXCEPTIONS
+        throw FFT::InvalidSize;
+#else
+        abort();
+#endif
+    }
+    return frameSize;
+}
+
+template <typename T>
+STFTAnalyser<T>::STFTAnalyser(int frameSize, int hop, Format format,
+                              const T *window, bool zeroPhase,
+                              int capacity, FFT::Mode mode) :
+    m_frameSize(checkSTFTSizes(frameSize, hop, capacity)),
+    m_hop(hop),
+    m_format(format),
+    m_rotation(zeroPhase ? frameSize/2 : 0),
+    m_capacity(capacity > 0 ? capacity : frameSize * 4),
+    m_window(0),
+    m_buffer(0),
+    m_readPos(0),
+    m_fill(0),
+    m_fft(frameSize, 0, mode)
+{
+    if (window) {
+        m_window = allocate<T>(m_frameSize);
+        v_copy(m_window, window, m_frameSize);
+    }
+    m_buffer = allocate_and_zero<T>(m_capacity + m_frameSize - 1);
+}
+
+template <typename T>
+STFTAnalyser<T>::~STFTAnalyser()
+{
+    deallocate(m_buffer);
+    deallocate(m_window);
+}
+
+template <typename T>
+void
+STFTAnalyser<T>::write(const T *BQ_R__ samples, int pos, int count)
+{
+    // The first m_frameSize - 1 samples of the ring are mirrored past
+    // its end, so that a frame starting anywhere in the ring can be
+    // read contiguously
+    v_copy(m_buffer + pos, samples, count);
+    if (pos < m_frameSize - 1) {
+        int mirrored = m_frameSize - 1 - pos;
+        if (mirrored > count) mirrored = count;
+        v_copy(m_buffer + m_capacity + pos, samples, mirrored);
+    }
+}
+
+template <typename T>
+int
+STFTAnalyser<T>::push(const T *BQ_R__ samples, int count)
+{
+    int space = m_capacity - m_fill;
+    if (count > space) count = space;
+    if (count <= 0) return 0;
+    int pos = m_readPos + m_fill;
+    if (pos >= m_capacity) pos -= m_capacity;
+    int first = m_capacity - pos;
+    if (first > count) first = count;
+    write(samples, pos, first);
+    if (first < count) {
+        write(samples + first, 0, count - first);
+    }
+    m_fill += count;
+    return count;
+}
+
+template <typename T>
+int
+STFTAnalyser<T>::getAvailableFrames() const
+{
+    if (m_fill < m_frameSize) return 0;
+    return (m_fill - m_frameSize) / m_hop + 1;
+}
+
+template <typename T>
+void
+STFTAnalyser<T>::analyse(T *BQ_R__ a, T *BQ_R__ b)
+{
+    const T *frame = m_buffer + m_readPos;
+    switch (m_format) {
+    case Cartesian:
+        m_fft.forwardWindowed(frame, m_window, m_rotation, a, b);
+        break;
+    case Polar:
+        m_fft.forwardWindowedPolar(frame, m_window, m_rotation, a, b);
+        break;
+    case Magnitude:
+        m_fft.forwardWindowedMagnitude(frame, m_window, m_rotation, a);
+        break;
+    }
+    m_readPos += m_hop;
+    if (m_readPos >= m_capacity) m_readPos -= m_capacity;
+    m_fill -= m_hop;
+}
+
+template <typename T>
+bool
+STFTAnalyser<T>::pull(T *BQ_R__ a, T *BQ_R__ b)
+{
+    if (getAvailableFrames() == 0) return false;
+    analyse(a, b);
+    return true;
+}
+
+template <typename T>
+int
+STFTAnalyser<T>::pull(T *const *a, T *const *b, int n)
+{
+    int available = getAvailableFrames();
+    if (n > available) n = available;
+    for (int i = 0; i < n; ++i) {
+        analyse(a[i], b ? b[i] : 0);
+    }
+    return n;
+}
+
+template <typename T>
+void
+STFTAnalyser<T>::reset()
+{
+    m_readPos = 0;
+    m_fill = 0;
+}
+
+template <typename T>
+ISTFTSynthesiser<T>::ISTFTSynthesiser(int frameSize, int hop, Format format,
+                                      const T *window, bool zeroPhase,
+                                      int capacity, FFT::Mode mode) :
+    m_frameSize(checkSTFTSizes(frameSize, hop, capacity)),
+    m_hop(hop),
+    m_format(format),
+    m_rotation(zeroPhase ? frameSize/2 : 0),
+    m_capacity(capacity > 0 ? capacity : frameSize * 4),
+    m_gain(1),
+    m_window(0),
+    m_buffer(0),
+    m_readPos(0),
+    m_writePos(0),
+    m_endPos(0),
+    m_fft(frameSize, 0, mode)
+{
+    // Each output sample is the sum, over the frameSize/hop frames
+    // overlapping it, of window^2 (analysis and synthesis) times
+    // frameSize (the unnormalised inverse transform). Divide by the
+    // average of that sum across a hop.
+    double sumOfSquares = m_frameSize;
+    if (window) {
+        m_window = allocate<T>(m_frameSize);
+        v_copy(m_window, window, m_frameSize);
+        sumOfSquares = 0.0;
+        for (int i = 0; i < m_frameSize; ++i) {
+            sumOfSquares += double(window[i]) * double(window[i]);
+        }
+    }
+    if (sumOfSquares > 0.0) {
+        m_gain = T(double(m_hop) / (double(m_frameSize) * sumOfSquares));
+    }
+    m_buffer = allocate_and_zero<T>(m_capacity + m_frameSize);
+}
+
+template <typename T>
+ISTFTSynthesiser<T>::~ISTFTSynthesiser()
+{
+    deallocate(m_buffer);
+    deallocate(m_window);
+}
+
+template <typename T>
+int
+ISTFTSynthesiser<T>::getWriteSpace() const
+{
+    int space = m_capacity - (m_writePos - m_readPos);
+    if (space < m_hop) return 0;
+    return space / m_hop;
+}
+
+template <typename T>
+void
+ISTFTSynthesiser<T>::compact()
+{
+    // Move the unread samples back to the start of the buffer, and
+    // zero what they leave behind so that everything from the end of
+    // the last frame onwards stays ready to accumulate into
+    int n = m_endPos - m_readPos;
+    v_move(m_buffer, m_buffer + m_readPos, n);
+    v_zero(m_buffer + n, m_readPos);
+    m_writePos -= m_readPos;
+    m_endPos -= m_readPos;
+    m_readPos = 0;
+}
+
+template <typename T>
+bool
+ISTFTSynthesiser<T>::push(const T *BQ_R__ a, const T *BQ_R__ b)
+{
+    if (getWriteSpace() == 0) return false;
+    if (m_writePos > m_capacity) compact();
+    T *frame = m_buffer + m_writePos;
+    switch (m_format) {
+    case Cartesian:
+        m_fft.inverseAccumulate(a, b, m_window, m_rotation, m_gain, frame);
+        break;
+    case Polar:
+        m_fft.inverseAccumulatePolar(a, b, m_window, m_rotation, m_gain, frame);
+        break;
+    }
+    m_endPos = m_writePos + m_frameSize;
+    m_writePos += m_hop;
+    return true;
+}
+
+template <typename T>
+int
+ISTFTSynthesiser<T>::push(const T *const *a, const T *const *b, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        if (!push(a[i], b[i])) return i;
+    }
+    return n;
+}
+
+template <typename T>
+int
+ISTFTSynthesiser<T>::pull(T *BQ_R__ samples, int count)
+{
+    int available = m_writePos - m_readPos;
+    if (count > available) count = available;
+    if (count <= 0) return 0;
+    v_copy(samples, m_buffer + m_readPos, count);
+    m_readPos += count;
+    return count;
+}
+
+template <typename T>
+void
+ISTFTSynthesiser<T>::flush()
+{
+    m_writePos = m_endPos;
+}
+
+template <typename T>
+void
+ISTFTSynthesiser<T>::reset()
+{
+    v_zero(m_buffer, m_capacity + m_frameSize);
+    m_readPos = 0;
+    m_writePos = 0;
+    m_endPos = 0;
+}
+
+template class STFTAnalyser<float>;
+template class STFTAnalyser<double>;
+template class ISTFTSynthesiser<float>;
+template class ISTFTSynthesiser<double>;
+
+}
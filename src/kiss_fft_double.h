@@ -0,0 +1,93 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    bqfft
+
+    A small library wrapping various FFT implementations for some
+    common audio processing use cases.
+
+    Copyright 2007-2021 Particular Programs Ltd.
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of Chris Cannam and
+    Particular Programs Ltd shall not be used in advertising or
+    otherwise to promote the sale, use or other dealings in this
+    Software without prior written authorization.
+*/
+
+#ifndef BQFFT_KISS_FFT_DOUBLE_H
+#define BQFFT_KISS_FFT_DOUBLE_H
+
+/*
+ * KissFFT has a single scalar type, fixed when it is compiled, and
+ * bqfft uses it as normally built, with float. kiss_fft_double.c and
+ * kiss_fftr_double.c compile the KissFFT sources a second time with
+ * double as the scalar type and a _d in each public function name,
+ * so that the library has both. This header declares the renamed
+ * real-input functions, with types of their own, to be used
+ * alongside kiss_fftr.h. With BQFFT_KISS_FFT_DOUBLE_BUILD defined it
+ * instead sets up the renaming, for those two source files.
+ */
+
+#ifdef BQFFT_KISS_FFT_DOUBLE_BUILD
+
+#define kiss_fft_scalar double
+
+#define kiss_fft_alloc kiss_fft_d_alloc
+#define kiss_fft kiss_fft_d
+#define kiss_fft_stride kiss_fft_d_stride
+#define kiss_fft_cleanup kiss_fft_d_cleanup
+#define kiss_fft_next_fast_size kiss_fft_d_next_fast_size
+
+#define kiss_fftr_alloc kiss_fftr_d_alloc
+#define kiss_fftr kiss_fftr_d
+#define kiss_fftri kiss_fftri_d
+
+#else
+
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct { double r; double i; } kiss_fft_d_cpx;
+
+typedef struct kiss_fftr_d_state *kiss_fftr_d_cfg;
+
+kiss_fftr_d_cfg kiss_fftr_d_alloc(int nfft, int inverse_fft,
+                                  void *mem, size_t *lenmem);
+
+void kiss_fftr_d(kiss_fftr_d_cfg cfg, const double *timedata,
+                 kiss_fft_d_cpx *freqdata);
+
+void kiss_fftri_d(kiss_fftr_d_cfg cfg, const kiss_fft_d_cpx *freqdata,
+                  double *timedata);
+
+#define kiss_fftr_d_free free
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+#endif
@@ -34,6 +34,8 @@
 */
 
 #include "bqfft/FFT.h"
+#include "bqfft/STFT.h"
+#include "bqfft/Convolver.h"
 
 #define BOOST_TEST_DYN_LINK
 #define BOOST_TEST_MAIN
@@ -41,9 +43,20 @@
 #include <boost/test/unit_test.hpp>
 
 #include <iostream>
+#include <vector>
 
+#include <algorithm>
 #include <cstdio>
+#include <cfloat>
 #include <cmath>
+#include <ctime>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
 using namespace breakfastquay;
 
@@ -766,6 +779,33 @@ ALL_IMPL_AUTO_TEST_CASE(sineCosine_7)
     COMPARE_SCALED(back, in, 7);
 }
 
+ALL_IMPL_AUTO_TEST_CASE(roundTrip_999)
+{
+    // Long enough that a DFT with full N*N tables would be costly
+    const int n = 999;
+    double *in = new double[n];
+    double *cplx = new double[n + 1];
+    double *back = new double[n];
+    srand48(0);
+    for (int i = 0; i < n; ++i) {
+        in[i] = drand48() * 4.0 - 2.0;
+    }
+    USING_FFT(n);
+    if (eps < 1e-11) {
+        eps = 1e-11;
+    }
+    fft.forwardInterleaved(in, cplx);
+    double sum = 0.0;
+    for (int i = 0; i < n; ++i) sum += in[i];
+    COMPARE(cplx[0], sum);
+    COMPARE_ZERO(cplx[1]);
+    fft.inverseInterleaved(cplx, back);
+    COMPARE_SCALED_N(back, in, n, n);
+    delete[] back;
+    delete[] cplx;
+    delete[] in;
+}
+
 
 /*
  * 6. Slightly longer transforms of pseudorandom data.
@@ -839,4 +879,1424 @@ ALL_IMPL_AUTO_TEST_CASE(random)
     delete[] in;
 }
 
+/*
+ * 7. Aligned buffer allocation
+ */
+
+ALL_IMPL_AUTO_TEST_CASE(alignedBuffers)
+{
+    const int n = 64;
+    USING_FFT(n);
+    if (eps < 1e-11) {
+        eps = 1e-11;
+    }
+    int align = fft.getPreferredAlignment();
+    BOOST_CHECK(align >= int(sizeof(double)));
+    BOOST_CHECK_EQUAL(align & (align - 1), 0);
+    BOOST_CHECK_EQUAL(fft.getBufferLength(FFT::TimeDomainBuffer), n);
+    BOOST_CHECK_EQUAL(fft.getBufferLength(FFT::SplitSpectrumBuffer), n/2 + 1);
+    BOOST_CHECK_EQUAL(fft.getBufferLength(FFT::InterleavedSpectrumBuffer), n + 2);
+    double *in = fft.allocateBuffer<double>(FFT::TimeDomainBuffer);
+    double *re = fft.allocateBuffer<double>(FFT::SplitSpectrumBuffer);
+    double *im = fft.allocateBuffer<double>(FFT::SplitSpectrumBuffer);
+    double *cplx = fft.allocateBuffer<double>(FFT::InterleavedSpectrumBuffer);
+    double *back = fft.allocateBuffer<double>(FFT::TimeDomainBuffer);
+    BOOST_CHECK_EQUAL((size_t)in % align, 0u);
+    BOOST_CHECK_EQUAL((size_t)re % align, 0u);
+    BOOST_CHECK_EQUAL((size_t)cplx % align, 0u);
+    for (int i = 0; i < n; ++i) {
+        COMPARE_ZERO(in[i]);
+        in[i] = sin(i * 0.3) + 0.5;
+    }
+    fft.forward(in, re, im);
+    fft.forwardInterleaved(in, cplx);
+    for (int i = 0; i <= n/2; ++i) {
+        COMPARE(cplx[i*2], re[i]);
+        COMPARE(cplx[i*2+1], im[i]);
+    }
+    fft.inverseInterleaved(cplx, back);
+    COMPARE_SCALED_N(back, in, n, n);
+    BOOST_CHECK_EQUAL(fft.getSlowPathCount(), 0);
+    FFT::deallocateBuffer(back);
+    FFT::deallocateBuffer(cplx);
+    FFT::deallocateBuffer(im);
+    FFT::deallocateBuffer(re);
+    FFT::deallocateBuffer(in);
+}
+
+/*
+ * 8. Calibration and tuning file
+ */
+
+BOOST_AUTO_TEST_CASE(calibrate)
+{
+    const char *filename = "test-fft-tuning.tmp";
+    FFT::setDefaultImplementation("");
+    FFT::setTuningFile(filename);
+    BOOST_CHECK_EQUAL(FFT::getTuningFile(), std::string(filename));
+    std::vector<int> sizes;
+    sizes.push_back(64);
+    FFT::calibrate(sizes);
+    FILE *f = fopen(filename, "r");
+    BOOST_REQUIRE(f);
+    char line[1024];
+    BOOST_REQUIRE(fgets(line, sizeof(line), f));
+    BOOST_CHECK_EQUAL(std::string(line), std::string("bqfft-tuning 1\n"));
+    BOOST_REQUIRE(fgets(line, sizeof(line), f));
+    BOOST_CHECK_EQUAL(std::string(line).substr(0, 4), std::string("cpu "));
+    // one entry per method type for each implementation except dft
+    int entries = 0;
+    while (fgets(line, sizeof(line), f)) {
+        BOOST_CHECK_EQUAL(std::string(line).substr(0, 3), std::string("64 "));
+        ++entries;
+    }
+    fclose(f);
+    int expected = 16 * (int(FFT::getImplementations().size()) - 1);
+    BOOST_CHECK_EQUAL(entries, expected);
+    // a tuned instance must still give correct results
+    double in[64], re[33], im[33], back[64];
+    for (int i = 0; i < 64; ++i) {
+        in[i] = cos(i * 0.2);
+    }
+    FFT fft(64);
+    DEFINE_EPS(fft);
+    if (eps < 1e-11) {
+        eps = 1e-11;
+    }
+    fft.forward(in, re, im);
+    fft.inverse(re, im, back);
+    COMPARE_SCALED_N(back, in, 64, 64);
+    FFT::setTuningFile("");
+    BOOST_CHECK_EQUAL(FFT::getTuningFile(), std::string(""));
+    remove(filename);
+}
+
+/*
+ * 9. Routing by precision
+ */
+
+BOOST_AUTO_TEST_CASE(routing)
+{
+    // With no explicit default, an FFT object should compute in
+    // every precision that some compiled-in implementation (other
+    // than the fallback DFT) supports natively
+    FFT::setTuningFile("");
+    FFT::Precisions available = 0;
+    std::set<std::string> impls = FFT::getImplementations();
+    for (std::set<std::string>::const_iterator i = impls.begin();
+         i != impls.end(); ++i) {
+        if (*i == "dft") continue;
+        FFT::setDefaultImplementation(*i);
+        FFT f(64);
+        available |= f.getSupportedPrecisions();
+    }
+    FFT::setDefaultImplementation("");
+    FFT fft(64);
+    BOOST_CHECK_EQUAL(fft.getSupportedPrecisions(), available);
+    DEFINE_EPS(fft);
+    if (eps < 1e-11) {
+        eps = 1e-11;
+    }
+    double in[64], re[33], im[33], back[64];
+    float inf[64], ref[33], imf[33], backf[64];
+    for (int i = 0; i < 64; ++i) {
+        in[i] = sin(i * 0.7) + 0.25;
+        inf[i] = float(in[i]);
+    }
+    fft.forward(in, re, im);
+    fft.forward(inf, ref, imf);
+    for (int i = 0; i <= 32; ++i) {
+        BOOST_CHECK_SMALL(ref[i] - float(re[i]), 1e-4f);
+        BOOST_CHECK_SMALL(imf[i] - float(im[i]), 1e-4f);
+    }
+    fft.inverse(re, im, back);
+    fft.inverse(ref, imf, backf);
+    COMPARE_SCALED_N(back, in, 64, 64);
+    for (int i = 0; i < 64; ++i) {
+        BOOST_CHECK_SMALL(backf[i] / 64.f - inf[i], 1e-5f);
+    }
+    // Routed implementations are created on first use, here while
+    // the window is in effect, and must still apply it
+    double window[64], windowed[64], wre[33], wim[33];
+    float windowf[64], wref[33], wimf[33];
+    for (int i = 0; i < 64; ++i) {
+        window[i] = 0.5 - 0.5 * cos(2.0 * M_PI * i / 64);
+        windowf[i] = float(window[i]);
+        windowed[i] = in[i] * window[i];
+    }
+    FFT lazy(64);
+    lazy.forwardWindowed(in, window, 0, wre, wim);
+    lazy.forwardWindowed(inf, windowf, 0, wref, wimf);
+    fft.forward(windowed, re, im);
+    for (int i = 0; i <= 32; ++i) {
+        BOOST_CHECK_SMALL(wre[i] - re[i], 1e-9);
+        BOOST_CHECK_SMALL(wim[i] - im[i], 1e-9);
+        BOOST_CHECK_SMALL(wref[i] - float(re[i]), 1e-4f);
+        BOOST_CHECK_SMALL(wimf[i] - float(im[i]), 1e-4f);
+    }
+}
+
+#ifdef FFT_STATISTICS
+
+/*
+ * 10. Statistics
+ */
+
+BOOST_AUTO_TEST_CASE(statistics)
+{
+    FFT::setDefaultImplementation("");
+    FFT::resetProcessStatistics();
+    double in[64], re[33], im[33];
+    float inf[64], mag[33];
+    for (int i = 0; i < 64; ++i) {
+        in[i] = sin(i * 0.5);
+        inf[i] = float(in[i]);
+    }
+    {
+        FFT fft(64);
+        FFT::setStatisticsEnabled(false);
+        fft.forward(in, re, im);
+        FFT::Statistics s = fft.getStatistics();
+        BOOST_CHECK_EQUAL(s.methods[0].calls, 0u);
+        FFT::setStatisticsEnabled(true);
+        fft.initFloat();
+        fft.forward(in, re, im);
+        fft.forward(in, re, im);
+        fft.forwardMagnitude(inf, mag);
+        FFT::setStatisticsEnabled(false);
+        s = fft.getStatistics();
+        BOOST_CHECK_EQUAL(std::string(FFT::getMethodName(0)),
+                          std::string("forwardDouble"));
+        BOOST_CHECK_EQUAL(s.methods[0].calls, 2u);
+        BOOST_CHECK(s.methods[0].totalNs > 0.0);
+        BOOST_CHECK(s.methods[0].minNs <= s.methods[0].maxNs);
+        BOOST_CHECK_EQUAL(s.methods[0].bytes, 2u * (64 + 33 * 2) * sizeof(double));
+        // the double precision was first used before recording
+        // started, so its lazy init was not counted
+        BOOST_CHECK_EQUAL(s.methods[0].lazyInits, 0u);
+        BOOST_CHECK_EQUAL(std::string(FFT::getMethodName(7)),
+                          std::string("forwardMagnitudeFloat"));
+        BOOST_CHECK_EQUAL(s.methods[7].calls, 1u);
+        BOOST_CHECK_EQUAL(s.methods[7].lazyInits, 0u);
+        BOOST_CHECK_EQUAL(s.methods[1].calls, 0u);
+        fft.resetStatistics();
+        BOOST_CHECK_EQUAL(fft.getStatistics().methods[0].calls, 0u);
+        FFT::setStatisticsEnabled(true);
+        fft.forward(in, re, im);
+        FFT::setStatisticsEnabled(false);
+    }
+    {
+        FFT fft(64);
+        FFT::setStatisticsEnabled(true);
+        fft.inverse(re, im, in);
+        FFT::setStatisticsEnabled(false);
+        BOOST_CHECK_EQUAL(fft.getStatistics().methods[8].lazyInits, 1u);
+        FFT::Statistics p = FFT::getProcessStatistics();
+        BOOST_CHECK_EQUAL(p.methods[0].calls, 1u);
+        BOOST_CHECK_EQUAL(p.methods[8].calls, 1u);
+    }
+    {
+        // Methods outside the sixteen count as the one whose
+        // implementation they use
+        FFT fft(64);
+        double out[64];
+        FFT::setStatisticsEnabled(true);
+        FFT::setLatencyHistogramEnabled(true);
+        fft.correlate(in, in, out);
+        fft.autocorrelate(in, out, 8, FFT::NoNormalisation);
+        fft.forwardPower(in, out);
+        fft.forwardDecibels(in, out, -120.0);
+        fft.inversePower(out, in);
+        fft.cepstralEnvelope(in, 8, out);
+        fft.forwardBinsMagnitude(in, 0, 33, out);
+        FFT::setStatisticsEnabled(false);
+        FFT::setLatencyHistogramEnabled(false);
+        FFT::Statistics s = fft.getStatistics();
+        BOOST_CHECK_EQUAL(s.methods[1].calls, 2u);
+        BOOST_CHECK_EQUAL(s.methods[3].calls, 3u);
+        BOOST_CHECK_EQUAL(s.methods[11].calls, 2u);
+        BOOST_CHECK_EQUAL(fft.getLatencyHistogram().count, 7u);
+    }
+    {
+        // forwardBins counts as forward whether it uses Goertzel or
+        // a transform, but only the transform initialises
+        const int n = 256;
+        double bin[n], re[n/2 + 1], im[n/2 + 1];
+        for (int i = 0; i < n; ++i) bin[i] = i % 7;
+        FFT fft(n);
+        FFT::setStatisticsEnabled(true);
+        fft.forwardBins(bin, 3, 4, re, im);
+        BOOST_CHECK_EQUAL(fft.getStatistics().methods[0].calls, 1u);
+        BOOST_CHECK_EQUAL(fft.getStatistics().methods[0].lazyInits, 0u);
+        fft.forwardBins(bin, 0, n/2 + 1, re, im);
+        FFT::setStatisticsEnabled(false);
+        BOOST_CHECK_EQUAL(fft.getStatistics().methods[0].calls, 2u);
+        BOOST_CHECK_EQUAL(fft.getStatistics().methods[0].lazyInits, 1u);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(latencyHistogram)
+{
+    FFT::setDefaultImplementation("");
+    double in[64], re[33], im[33];
+    for (int i = 0; i < 64; ++i) {
+        in[i] = cos(i * 0.25);
+    }
+    FFT fft(64);
+    fft.initDouble();
+    fft.forward(in, re, im);
+    BOOST_CHECK_EQUAL(fft.getLatencyHistogram().count, 0u);
+    FFT::setLatencyHistogramEnabled(true);
+    for (int i = 0; i < 100; ++i) {
+        fft.forward(in, re, im);
+    }
+    FFT::setLatencyHistogramEnabled(false);
+    FFT::LatencyHistogram h = fft.getLatencyHistogram();
+    BOOST_CHECK_EQUAL(h.count, 100u);
+    uint64_t total = 0;
+    for (int i = 0; i < FFT::LatencyHistogram::BucketCount; ++i) {
+        total += h.buckets[i];
+    }
+    BOOST_CHECK_EQUAL(total, 100u);
+    BOOST_CHECK(h.maxNs > 0.0);
+    double p50 = h.getPercentile(50.0);
+    double p99 = h.getPercentile(99.0);
+    BOOST_CHECK(p50 > 0.0);
+    BOOST_CHECK(p50 <= p99);
+    BOOST_CHECK(p99 <= h.maxNs);
+    BOOST_CHECK(fft.getLatencySummary().find("p99.9") != std::string::npos);
+    fft.resetLatencyHistogram();
+    BOOST_CHECK_EQUAL(fft.getLatencyHistogram().count, 0u);
+}
+
+#ifndef NO_THREADING
+
+struct HistogramWriter
+{
+    FFT *fft;
+    int calls;
+    volatile bool done;
+};
+
+#ifdef _WIN32
+static DWORD WINAPI
+runHistogramWriter(LPVOID arg)
+#else
+static void *
+runHistogramWriter(void *arg)
+#endif
+{
+    HistogramWriter *w = static_cast<HistogramWriter *>(arg);
+    double in[64], re[33], im[33];
+    for (int i = 0; i < 64; ++i) {
+        in[i] = cos(i * 0.25);
+    }
+    for (int i = 0; i < w->calls; ++i) {
+        w->fft->forward(in, re, im);
+    }
+    w->done = true;
+    return 0;
+}
+
+BOOST_AUTO_TEST_CASE(latencyHistogramSnapshots)
+{
+    // Snapshots taken while another thread runs transforms must each
+    // be consistent, and must never go backwards
+    FFT::setDefaultImplementation("");
+    FFT fft(64);
+    fft.initDouble();
+    HistogramWriter w;
+    w.fft = &fft;
+    w.calls = 200000;
+    w.done = false;
+    FFT::setLatencyHistogramEnabled(true);
+#ifdef _WIN32
+    HANDLE thread = CreateThread(NULL, 0, runHistogramWriter, &w, 0, NULL);
+    BOOST_REQUIRE(thread != 0);
+#else
+    pthread_t thread;
+    BOOST_REQUIRE_EQUAL(pthread_create(&thread, 0, runHistogramWriter, &w), 0);
+#endif
+    uint64_t last = 0;
+    int snapshots = 0, inconsistent = 0, backwards = 0;
+    while (!w.done) {
+        FFT::LatencyHistogram h = fft.getLatencyHistogram();
+        uint64_t total = 0;
+        for (int i = 0; i < FFT::LatencyHistogram::BucketCount; ++i) {
+            total += h.buckets[i];
+        }
+        if (total != h.count) ++inconsistent;
+        if (h.count < last) ++backwards;
+        last = h.count;
+        ++snapshots;
+    }
+#ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, 0);
+#endif
+    FFT::setLatencyHistogramEnabled(false);
+    BOOST_CHECK(snapshots > 0);
+    BOOST_CHECK_EQUAL(inconsistent, 0);
+    BOOST_CHECK_EQUAL(backwards, 0);
+    BOOST_CHECK_EQUAL(fft.getLatencyHistogram().count, uint64_t(w.calls));
+}
+
+#endif
+
+#endif
+
+/*
+ * 11. Windowed and rotated transforms
+ */
+
+ALL_IMPL_AUTO_TEST_CASE(windowed)
+{
+    const int n = 16;
+    const int hs1 = n/2 + 1;
+    const int rotations[] = { 0, 5, n/2, -3 };
+    double in[n], win[n], shaped[n], expected[n], back[n];
+    double re[hs1], im[hs1], re2[hs1], im2[hs1], mag[hs1], phase[hs1];
+    double cplx[hs1 * 2];
+    float fin[n], fwin[n], fshaped[n], fback[n];
+    float fre[hs1], fim[hs1], fre2[hs1], fim2[hs1];
+    for (int i = 0; i < n; ++i) {
+        in[i] = sin(i * 0.7) + 0.25 * cos(i * 1.9);
+        win[i] = 0.5 - 0.5 * cos(2.0 * M_PI * i / n);
+        fin[i] = float(in[i]);
+        fwin[i] = float(win[i]);
+    }
+    USING_FFT(n);
+    if (eps < 1e-11) {
+        eps = 1e-11;
+    }
+    for (int k = 0; k < int(sizeof(rotations)/sizeof(rotations[0])); ++k) {
+        int rotation = rotations[k];
+        int r = ((rotation % n) + n) % n;
+        for (int j = 0; j < n; ++j) {
+            shaped[(j - r + n) % n] = in[j] * win[j];
+            fshaped[(j - r + n) % n] = fin[j] * fwin[j];
+            expected[j] = in[j] * win[j] * win[j];
+        }
+        fft.forward(shaped, re2, im2);
+        fft.forwardWindowed(in, win, rotation, re, im);
+        COMPARE_ARR(re, re2, hs1);
+        COMPARE_ARR(im, im2, hs1);
+        fft.forwardWindowedInterleaved(in, win, rotation, cplx);
+        for (int i = 0; i < hs1; ++i) {
+            COMPARE(cplx[i*2], re2[i]);
+            COMPARE(cplx[i*2+1], im2[i]);
+        }
+        fft.forwardWindowedMagnitude(in, win, rotation, mag);
+        for (int i = 0; i < hs1; ++i) {
+            COMPARE(mag[i], sqrt(re2[i] * re2[i] + im2[i] * im2[i]));
+        }
+        fft.forwardWindowedPolar(in, win, rotation, mag, phase);
+        for (int i = 0; i < hs1; ++i) {
+            COMPARE(mag[i] * cos(phase[i]), re2[i]);
+            COMPARE(mag[i] * sin(phase[i]), im2[i]);
+        }
+        fft.inverseWindowed(re2, im2, win, rotation, back);
+        COMPARE_SCALED_N(back, expected, n, n);
+        fft.inverseWindowedInterleaved(cplx, win, rotation, back);
+        COMPARE_SCALED_N(back, expected, n, n);
+        fft.inverseWindowedPolar(mag, phase, win, rotation, back);
+        COMPARE_SCALED_N(back, expected, n, n);
+
+        // Rotation only
+        fft.forwardWindowed(in, (const double *)0, rotation, re, im);
+        fft.inverse(re, im, back);
+        for (int j = 0; j < n; ++j) {
+            COMPARE(back[(j - r + n) % n] / n, in[j]);
+        }
+        fft.inverseWindowed(re, im, (const double *)0, rotation, back);
+        COMPARE_SCALED_N(back, in, n, n);
+
+        fft.forward(fshaped, fre2, fim2);
+        fft.forwardWindowed(fin, fwin, rotation, fre, fim);
+        for (int i = 0; i < hs1; ++i) {
+            COMPARE_F(fre[i], fre2[i]);
+            COMPARE_F(fim[i], fim2[i]);
+        }
+        fft.inverseWindowed(fre2, fim2, fwin, rotation, fback);
+        for (int j = 0; j < n; ++j) {
+            COMPARE_F(fback[j] / n, float(expected[j]));
+        }
+    }
+}
+
+ALL_IMPL_AUTO_TEST_CASE(padded)
+{
+    // Against the plain transforms of explicitly padded frames. The
+    // samples of the input beyond its length are set to a large
+    // value, which must not be read.
+    const int n = 64;
+    const int hs1 = n/2 + 1;
+    const int lengths[] = { 0, 1, 2, 5, 16, 17, 32, 33, 63, 64 };
+    double in[n], padded[n], re[hs1], im[hs1], re2[hs1], im2[hs1];
+    double mag[hs1], phase[hs1], cplx[hs1 * 2];
+    float fin[n], fpadded[n], fre[hs1], fim[hs1], fre2[hs1], fim2[hs1];
+    USING_FFT(n);
+    if (eps < 1e-11) {
+        eps = 1e-11;
+    }
+    for (int k = 0; k < int(sizeof(lengths)/sizeof(lengths[0])); ++k) {
+        const int length = lengths[k];
+        for (int i = 0; i < n; ++i) {
+            padded[i] = (i < length) ? sin(i * 0.7) + 0.25 * cos(i * 1.9) : 0.0;
+            in[i] = (i < length) ? padded[i] : 1e6;
+            fpadded[i] = float(padded[i]);
+            fin[i] = float(in[i]);
+        }
+        fft.forward(padded, re2, im2);
+        fft.forwardPadded(in, length, re, im);
+        COMPARE_ARR(re, re2, hs1);
+        COMPARE_ARR(im, im2, hs1);
+        fft.forwardPaddedInterleaved(in, length, cplx);
+        for (int i = 0; i < hs1; ++i) {
+            COMPARE(cplx[i*2], re2[i]);
+            COMPARE(cplx[i*2+1], im2[i]);
+        }
+        fft.forwardPaddedMagnitude(in, length, mag);
+        for (int i = 0; i < hs1; ++i) {
+            COMPARE(mag[i], sqrt(re2[i] * re2[i] + im2[i] * im2[i]));
+        }
+        fft.forwardPaddedPolar(in, length, mag, phase);
+        for (int i = 0; i < hs1; ++i) {
+            COMPARE(mag[i] * cos(phase[i]), re2[i]);
+            COMPARE(mag[i] * sin(phase[i]), im2[i]);
+        }
+        fft.forward(fpadded, fre2, fim2);
+        fft.forwardPadded(fin, length, fre, fim);
+        for (int i = 0; i < hs1; ++i) {
+            COMPARE_F(fre[i], fre2[i]);
+            COMPARE_F(fim[i], fim2[i]);
+        }
+        // And the padding is not left behind for a plain transform
+        fft.forward(padded, re, im);
+        COMPARE_ARR(re, re2, hs1);
+    }
+    BOOST_CHECK_THROW(fft.forwardPadded(in, n + 1, re, im), FFT::Exception);
+    BOOST_CHECK_THROW(fft.forwardPadded(in, -1, re, im), FFT::Exception);
+}
+
+ALL_IMPL_AUTO_TEST_CASE(bins)
+{
+    // Against the full transform. At this size the narrow ranges
+    // are computed by Goertzel and the wide ones by a transform
+    const int n = 256;
+    const int hs1 = n/2 + 1;
+    const int ranges[][2] = {
+        { 0, 0 }, { 0, 1 }, { 3, 7 }, { 40, 48 }, { 121, 129 },
+        { 40, 80 }, { 100, 129 }, { 0, 129 }
+    };
+    double in[n], re[hs1], im[hs1], re2[hs1], im2[hs1], mag[hs1];
+    float fin[n], fre[hs1], fim[hs1], fre2[hs1], fim2[hs1], fmag[hs1];
+    for (int i = 0; i < n; ++i) {
+        in[i] = sin(i * 0.7) + 0.25 * cos(i * 1.9) + 0.1;
+        fin[i] = float(in[i]);
+    }
+    USING_FFT(n);
+    // The spectrum here is large, and Goertzel's results are compared
+    // with a single-precision transform's where there is no double
+    epsf = 1e-4f;
+    if (eps < 1e-11) {
+        eps = 1e-11;
+    } else {
+        eps = epsf;
+    }
+    fft.forward(in, re2, im2);
+    fft.forward(fin, fre2, fim2);
+    for (int k = 0; k < int(sizeof(ranges)/sizeof(ranges[0])); ++k) {
+        const int first = ranges[k][0], last = ranges[k][1];
+        fft.forwardBins(in, first, last, re, im);
+        fft.forwardBinsMagnitude(in, first, last, mag);
+        for (int i = first; i < last; ++i) {
+            COMPARE(re[i - first], re2[i]);
+            COMPARE(im[i - first], im2[i]);
+            COMPARE(mag[i - first], sqrt(re2[i] * re2[i] + im2[i] * im2[i]));
+        }
+        fft.forwardBins(fin, first, last, fre, fim);
+        fft.forwardBinsMagnitude(fin, first, last, fmag);
+        for (int i = first; i < last; ++i) {
+            COMPARE_F(fre[i - first], fre2[i]);
+            COMPARE_F(fim[i - first], fim2[i]);
+            COMPARE_F(fmag[i - first],
+                      sqrtf(fre2[i] * fre2[i] + fim2[i] * fim2[i]));
+        }
+    }
+    BOOST_CHECK_THROW(fft.forwardBins(in, -1, 4, re, im), FFT::Exception);
+    BOOST_CHECK_THROW(fft.forwardBins(in, 5, 4, re, im), FFT::Exception);
+    BOOST_CHECK_THROW(fft.forwardBinsMagnitude(in, 0, hs1 + 1, mag),
+                      FFT::Exception);
+}
+
+ALL_IMPL_AUTO_TEST_CASE(samples)
+{
+    // Against the full inverse. The output beyond the range must not
+    // be written
+    const int n = 64;
+    const int hs1 = n/2 + 1;
+    const int ranges[][2] = {
+        { 0, 0 }, { 0, 64 }, { 0, 10 }, { 32, 64 }, { 63, 64 }, { 5, 6 },
+        { 17, 40 }
+    };
+    double in[n], re[hs1], im[hs1], cplx[hs1 * 2], full[n], out[n];
+    float fre[hs1], fim[hs1], fcplx[hs1 * 2], ffull[n], fout[n];
+    for (int i = 0; i < n; ++i) {
+        in[i] = sin(i * 0.7) + 0.25 * cos(i * 1.9);
+    }
+    USING_FFT(n);
+    if (eps < 1e-11) {
+        eps = 1e-11;
+    }
+    fft.forward(in, re, im);
+    fft.inverse(re, im, full);
+    for (int i = 0; i < hs1; ++i) {
+        cplx[i*2] = re[i];
+        cplx[i*2+1] = im[i];
+        fre[i] = float(re[i]);
+        fim[i] = float(im[i]);
+        fcplx[i*2] = fre[i];
+        fcplx[i*2+1] = fim[i];
+    }
+    fft.inverse(fre, fim, ffull);
+    for (int k = 0; k < int(sizeof(ranges)/sizeof(ranges[0])); ++k) {
+        const int first = ranges[k][0], last = ranges[k][1];
+        for (int i = 0; i < n; ++i) out[i] = 1e6;
+        fft.inverseSamples(re, im, first, last, out);
+        for (int i = 0; i < last - first; ++i) {
+            COMPARE(out[i], full[first + i]);
+        }
+        for (int i = last - first; i < n; ++i) {
+            BOOST_CHECK_EQUAL(out[i], 1e6);
+        }
+        for (int i = 0; i < n; ++i) out[i] = 1e6;
+        fft.inverseInterleavedSamples(cplx, first, last, out);
+        for (int i = 0; i < last - first; ++i) {
+            COMPARE(out[i], full[first + i]);
+        }
+        for (int i = last - first; i < n; ++i) {
+            BOOST_CHECK_EQUAL(out[i], 1e6);
+        }
+        fft.inverseSamples(fre, fim, first, last, fout);
+        for (int i = 0; i < last - first; ++i) {
+            COMPARE_F(fout[i] / n, ffull[first + i] / n);
+        }
+        fft.inverseInterleavedSamples(fcplx, first, last, fout);
+        for (int i = 0; i < last - first; ++i) {
+            COMPARE_F(fout[i] / n, ffull[first + i] / n);
+        }
+    }
+    // And the range is not left behind for a plain inverse
+    fft.inverse(re, im, out);
+    COMPARE_ARR(out, full, n);
+    BOOST_CHECK_THROW(fft.inverseSamples(re, im, -1, 4, out), FFT::Exception);
+    BOOST_CHECK_THROW(fft.inverseSamples(re, im, 5, 4, out), FFT::Exception);
+    BOOST_CHECK_THROW(fft.inverseInterleavedSamples(cplx, 0, n + 1, out),
+                      FFT::Exception);
+}
+
+ALL_IMPL_AUTO_TEST_CASE(inverseAccumulate)
+{
+    const int n = 16;
+    const int hs1 = n/2 + 1;
+    const int rotations[] = { 0, 5, n/2 };
+    double in[n], win[n], base[n], acc[n], expected[n];
+    double re[hs1], im[hs1], mag[hs1], phase[hs1], cplx[hs1 * 2];
+    float fwin[n], fre[hs1], fim[hs1], facc[n];
+    for (int i = 0; i < n; ++i) {
+        in[i] = sin(i * 0.7) + 0.25 * cos(i * 1.9);
+        win[i] = 0.5 - 0.5 * cos(2.0 * M_PI * i / n);
+        base[i] = i * 0.1 - 0.5;
+        fwin[i] = float(win[i]);
+    }
+    USING_FFT(n);
+    if (eps < 1e-11) {
+        eps = 1e-11;
+    }
+    const double gain = 0.5 / n;
+    for (int k = 0; k < int(sizeof(rotations)/sizeof(rotations[0])); ++k) {
+        int rotation = rotations[k];
+        fft.forwardWindowed(in, win, rotation, re, im);
+        for (int j = 0; j < n; ++j) {
+            expected[j] = base[j] + 0.5 * in[j] * win[j] * win[j];
+        }
+        for (int j = 0; j < n; ++j) acc[j] = base[j];
+        fft.inverseAccumulate(re, im, win, rotation, gain, acc);
+        COMPARE_ARR(acc, expected, n);
+        for (int i = 0; i < hs1; ++i) {
+            cplx[i*2] = re[i];
+            cplx[i*2+1] = im[i];
+            mag[i] = sqrt(re[i] * re[i] + im[i] * im[i]);
+            phase[i] = atan2(im[i], re[i]);
+            fre[i] = float(re[i]);
+            fim[i] = float(im[i]);
+        }
+        for (int j = 0; j < n; ++j) acc[j] = base[j];
+        fft.inverseAccumulateInterleaved(cplx, win, rotation, gain, acc);
+        COMPARE_ARR(acc, expected, n);
+        for (int j = 0; j < n; ++j) acc[j] = base[j];
+        fft.inverseAccumulatePolar(mag, phase, win, rotation, gain, acc);
+        COMPARE_ARR(acc, expected, n);
+        for (int j = 0; j < n; ++j) facc[j] = float(base[j]);
+        fft.inverseAccumulate(fre, fim, fwin, rotation, float(gain), facc);
+        for (int j = 0; j < n; ++j) {
+            COMPARE_F(facc[j], float(expected[j]));
+        }
+
+        // No window, accumulating twice
+        for (int j = 0; j < n; ++j) acc[j] = base[j];
+        fft.inverseAccumulate(re, im, (const double *)0, rotation, gain, acc);
+        fft.inverseAccumulate(re, im, (const double *)0, rotation, gain, acc);
+        for (int j = 0; j < n; ++j) {
+            COMPARE(acc[j], (base[j] + in[j] * win[j]));
+        }
+    }
+
+    // Plain inverse afterwards is unaffected
+    fft.forward(in, re, im);
+    fft.inverse(re, im, acc);
+    COMPARE_SCALED_N(acc, in, n, n);
+}
+
+/*
+ * 12. Streaming STFT analysis and synthesis
+ */
+
+BOOST_AUTO_TEST_CASE(stftAnalyser)
+{
+    const int n = 16, hop = 4, hs1 = n/2 + 1, total = 101;
+    double signal[total], win[n];
+    for (int i = 0; i < total; ++i) {
+        signal[i] = sin(i * 0.37) + 0.5 * cos(i * 1.3);
+    }
+    for (int i = 0; i < n; ++i) {
+        win[i] = 0.5 - 0.5 * cos(2.0 * M_PI * i / n);
+    }
+
+    STFTAnalyser<double> stft(n, hop, STFTAnalyser<double>::Polar,
+                              win, true, 3 * n);
+    BOOST_CHECK_EQUAL(stft.getBinCount(), hs1);
+    FFT fft(n);
+    DEFINE_EPS(fft);
+    if (eps < 1e-11) {
+        eps = 1e-11;
+    }
+
+    double mag[4][hs1], phase[4][hs1], expmag[hs1], expphase[hs1];
+    double *mags[4] = { mag[0], mag[1], mag[2], mag[3] };
+    double *phases[4] = { phase[0], phase[1], phase[2], phase[3] };
+
+    // Push in irregular blocks, pulling singly or in batches as we
+    // go, and check every frame against a direct transform of the
+    // same stretch of signal
+    const int blocks[] = { 7, 13, 1, 30, 5, 20, 25 };
+    int pushed = 0, frames = 0;
+    for (int b = 0; b < int(sizeof(blocks)/sizeof(blocks[0])); ++b) {
+        BOOST_CHECK_EQUAL(stft.push(signal + pushed, blocks[b]), blocks[b]);
+        pushed += blocks[b];
+        int expected = (pushed < n ? 0 : (pushed - n) / hop + 1) - frames;
+        BOOST_CHECK_EQUAL(stft.getAvailableFrames(), expected);
+        while (stft.getAvailableFrames() > 0) {
+            int got;
+            if (b % 2) {
+                got = stft.pull(mags, phases, 4);
+            } else {
+                got = stft.pull(mag[0], phase[0]) ? 1 : 0;
+            }
+            BOOST_CHECK(got > 0);
+            for (int f = 0; f < got; ++f) {
+                fft.forwardWindowedPolar(signal + (frames + f) * hop,
+                                         win, n/2, expmag, expphase);
+                for (int i = 0; i < hs1; ++i) {
+                    COMPARE(mag[f][i] * cos(phase[f][i]),
+                            expmag[i] * cos(expphase[i]));
+                    COMPARE(mag[f][i] * sin(phase[f][i]),
+                            expmag[i] * sin(expphase[i]));
+                }
+            }
+            frames += got;
+        }
+    }
+    BOOST_CHECK_EQUAL(frames, (total - n) / hop + 1);
+    BOOST_CHECK(!stft.pull(mag[0], phase[0]));
+
+    // The ring holds at most its capacity
+    stft.reset();
+    BOOST_CHECK_EQUAL(stft.getWriteSpace(), 3 * n);
+    BOOST_CHECK_EQUAL(stft.push(signal, total), 3 * n);
+    BOOST_CHECK_EQUAL(stft.getWriteSpace(), 0);
+    BOOST_CHECK_EQUAL(stft.getAvailableFrames(), (3 * n - n) / hop + 1);
+}
+
+BOOST_AUTO_TEST_CASE(stftAnalyserFloatMagnitude)
+{
+    const int n = 8, hop = 8, hs1 = n/2 + 1;
+    float signal[3 * n], mag[hs1], expected[hs1];
+    for (int i = 0; i < 3 * n; ++i) {
+        signal[i] = float(i % 5) - 2.f;
+    }
+    STFTAnalyser<float> stft(n, hop, STFTAnalyser<float>::Magnitude);
+    FFT fft(n);
+    float epsf = 1e-4f;
+    BOOST_CHECK_EQUAL(stft.push(signal, 3 * n), 3 * n);
+    for (int f = 0; f < 3; ++f) {
+        BOOST_CHECK(stft.pull(mag, 0));
+        fft.forwardMagnitude(signal + f * n, expected);
+        for (int i = 0; i < hs1; ++i) {
+            COMPARE_F(mag[i], expected[i]);
+        }
+    }
+    BOOST_CHECK_EQUAL(stft.getAvailableFrames(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(stftAnalyserInvalid)
+{
+    BOOST_CHECK_THROW(STFTAnalyser<double>
+                      (16, 17, STFTAnalyser<double>::Cartesian),
+                      FFT::Exception);
+    BOOST_CHECK_THROW(STFTAnalyser<double>
+                      (16, 4, STFTAnalyser<double>::Cartesian, 0, false, 8),
+                      FFT::Exception);
+}
+
+BOOST_AUTO_TEST_CASE(istftRoundTrip)
+{
+    const int n = 16, hop = 4, hs1 = n/2 + 1, total = 160;
+    double signal[total], out[total], win[n], re[hs1], im[hs1];
+    for (int i = 0; i < total; ++i) {
+        signal[i] = sin(i * 0.37) + 0.5 * cos(i * 1.3);
+    }
+    for (int i = 0; i < n; ++i) {
+        win[i] = 0.5 - 0.5 * cos(2.0 * M_PI * i / n);
+    }
+    STFTAnalyser<double> stft(n, hop, STFTAnalyser<double>::Cartesian,
+                              win, true);
+    ISTFTSynthesiser<double> istft(n, hop, ISTFTSynthesiser<double>::Cartesian,
+                                   win, true, 2 * n);
+    BOOST_CHECK_EQUAL(istft.getBinCount(), hs1);
+    BOOST_CHECK_EQUAL(istft.getWriteSpace(), 2 * n / hop);
+    DEFINE_EPS(istft.getFFT());
+    if (eps < 1e-11) {
+        eps = 1e-11;
+    }
+
+    // Analyse and resynthesise in small irregular blocks, so that
+    // the output buffer fills and is compacted many times over
+    int pushed = 0, pulled = 0, block = 0;
+    while (pulled < total) {
+        if (pushed < total) {
+            int count = 3 + (block++ % 7);
+            if (count > total - pushed) count = total - pushed;
+            pushed += stft.push(signal + pushed, count);
+        }
+        while (stft.getAvailableFrames() > 0 && istft.getWriteSpace() > 0) {
+            BOOST_CHECK(stft.pull(re, im));
+            BOOST_CHECK(istft.push(re, im));
+        }
+        if (pushed == total && stft.getAvailableFrames() == 0) {
+            istft.flush();
+        }
+        int got = istft.pull(out + pulled, 5);
+        BOOST_CHECK(got <= 5);
+        pulled += got;
+    }
+    BOOST_CHECK_EQUAL(pulled, total);
+    for (int i = n - hop; i < total - n + hop; ++i) {
+        COMPARE(out[i], signal[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(istftFloatPolar)
+{
+    // Rectangular frames with no overlap just reproduce the input
+    const int n = 8, hs1 = n/2 + 1;
+    float signal[3 * n], out[3 * n], mag[hs1], phase[hs1];
+    for (int i = 0; i < 3 * n; ++i) {
+        signal[i] = float(i % 5) - 2.f;
+    }
+    ISTFTSynthesiser<float> istft(n, n, ISTFTSynthesiser<float>::Polar);
+    FFT fft(n);
+    float epsf = 1e-4f;
+    BOOST_CHECK_EQUAL(istft.getAvailableSamples(), 0);
+    for (int f = 0; f < 3; ++f) {
+        fft.forwardPolar(signal + f * n, mag, phase);
+        BOOST_CHECK(istft.push(mag, phase));
+        BOOST_CHECK_EQUAL(istft.getAvailableSamples(), (f + 1) * n);
+    }
+    BOOST_CHECK_EQUAL(istft.pull(out, 4 * n), 3 * n);
+    for (int i = 0; i < 3 * n; ++i) {
+        COMPARE_F(out[i], signal[i]);
+    }
+
+    // A full output buffer refuses further frames until pulled
+    istft.reset();
+    int frames = 0;
+    while (istft.push(mag, phase)) ++frames;
+    BOOST_CHECK_EQUAL(frames, 4);
+    BOOST_CHECK_EQUAL(istft.getWriteSpace(), 0);
+    BOOST_CHECK_EQUAL(istft.pull(out, n), n);
+    BOOST_CHECK_EQUAL(istft.getWriteSpace(), 1);
+}
+
+/*
+ * 13. Partitioned convolution
+ */
+
+BOOST_AUTO_TEST_CASE(convolver)
+{
+    // An impulse response that is not a whole number of blocks,
+    // against direct-form convolution
+    const int block = 16, length = 100, total = 256;
+    double ir[length], in[total], out[total];
+    for (int i = 0; i < length; ++i) {
+        ir[i] = cos(i * 0.3) * exp(-i * 0.02);
+    }
+    for (int i = 0; i < total; ++i) {
+        in[i] = sin(i * 0.37) + 0.5 * cos(i * 1.3);
+    }
+    Convolver<double> conv(block, ir, length);
+    BOOST_CHECK_EQUAL(conv.getPartitionCount(), 7);
+    DEFINE_EPS(conv.getFFT());
+    if (eps < 1e-11) {
+        eps = 1e-11;
+    }
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < total; i += block) {
+            conv.process(in + i, out + i);
+        }
+        for (int i = 0; i < total; ++i) {
+            double expected = 0.0;
+            for (int j = 0; j < length && j <= i; ++j) {
+                expected += ir[j] * in[i - j];
+            }
+            COMPARE(out[i], expected);
+        }
+        conv.reset();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(convolverFloatShort)
+{
+    // A single partition, and an impulse response shorter than it
+    const int block = 8;
+    float ir[3] = { 1.f, -0.5f, 0.25f };
+    float in[block * 2], out[block * 2];
+    for (int i = 0; i < block * 2; ++i) {
+        in[i] = (i == 2 || i == 9) ? 1.f : 0.f;
+    }
+    Convolver<float> conv(block, ir, 3);
+    BOOST_CHECK_EQUAL(conv.getPartitionCount(), 1);
+    float epsf = 1e-5f;
+    conv.process(in, out);
+    conv.process(in + block, out + block);
+    for (int i = 0; i < block * 2; ++i) {
+        float expected = 0.f;
+        if (i >= 2 && i < 5) expected += ir[i - 2];
+        if (i >= 9 && i < 12) expected += ir[i - 9];
+        COMPARE_F(out[i], expected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(convolverInvalid)
+{
+    double ir[1] = { 1.0 };
+    BOOST_CHECK_THROW(Convolver<double>(0, ir, 1), FFT::Exception);
+    BOOST_CHECK_THROW(Convolver<double>(16, ir, 0), FFT::Exception);
+}
+
+// Give a NonUniformConvolver's background thread time to keep up, as
+// a real-time caller would by waiting for its next block
+static void
+waitForNextBlock(double seconds)
+{
+#ifdef _WIN32
+    Sleep(DWORD(seconds * 1000.0) + 1);
+#else
+    usleep(useconds_t(seconds * 1e6));
+#endif
+}
+
+BOOST_AUTO_TEST_CASE(nonUniformConvolver)
+{
+    const int block = 16, length = 1000, total = 2048;
+    std::vector<double> ir(length), in(total), out(total);
+    for (int i = 0; i < length; ++i) {
+        ir[i] = cos(i * 0.3) * exp(-i * 0.004);
+    }
+    for (int i = 0; i < total; ++i) {
+        in[i] = sin(i * 0.37) + 0.5 * cos(i * 1.3);
+    }
+    // Threaded blocks are paced generously, at four times the
+    // average cost of a block without the thread and at least a
+    // millisecond, so that the thread is never legitimately late
+    double pace = 0.001;
+    for (int threaded = 0; threaded < 2; ++threaded) {
+        NonUniformConvolver<double> conv(block, &ir[0], length, 128,
+                                         threaded != 0);
+        BOOST_CHECK_EQUAL(conv.getStageCount(), 3);
+        BOOST_CHECK_EQUAL(conv.getStageBlockSize(0), 32);
+        BOOST_CHECK_EQUAL(conv.getStageBlockSize(2), 128);
+        double eps = 1e-9;
+        for (int pass = 0; pass < 2; ++pass) {
+            const std::clock_t start = std::clock();
+            for (int i = 0; i < total; i += block) {
+                conv.process(&in[i], &out[i]);
+                if (threaded) waitForNextBlock(pace);
+            }
+            if (!threaded) {
+                const double perBlock = double(std::clock() - start) /
+                    CLOCKS_PER_SEC / (total / block);
+                if (pace < perBlock * 4.0) pace = perBlock * 4.0;
+            }
+            BOOST_CHECK_EQUAL(conv.getSkipCount(), 0);
+            for (int i = 0; i < total; ++i) {
+                double expected = 0.0;
+                for (int j = 0; j < length && j <= i; ++j) {
+                    expected += ir[j] * in[i - j];
+                }
+                COMPARE(out[i], expected);
+            }
+            conv.reset();
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(nonUniformConvolverFloat)
+{
+    // Short enough for the head alone, and with the default maximum
+    const int block = 32;
+    float ir[100], in[block * 8], out[block * 8];
+    for (int i = 0; i < 100; ++i) ir[i] = float(i % 4) - 1.5f;
+    for (int i = 0; i < block * 8; ++i) in[i] = float(i % 9) - 4.f;
+    NonUniformConvolver<float> conv(block, ir, 100);
+    BOOST_CHECK_EQUAL(conv.getStageCount(), 0);
+    float epsf = 1e-3f;
+    for (int i = 0; i < block * 8; i += block) {
+        conv.process(in + i, out + i);
+    }
+    for (int i = 0; i < block * 8; ++i) {
+        float expected = 0.f;
+        for (int j = 0; j < 100 && j <= i; ++j) {
+            expected += ir[j] * in[i - j];
+        }
+        COMPARE_F(out[i], expected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(nonUniformConvolverInvalid)
+{
+    double ir[1] = { 1.0 };
+    BOOST_CHECK_THROW(NonUniformConvolver<double>(0, ir, 1), FFT::Exception);
+    BOOST_CHECK_THROW(NonUniformConvolver<double>(64, ir, 1, 32),
+                      FFT::Exception);
+}
+
+/*
+ * 14. Correlation and power spectra
+ */
+
+ALL_IMPL_AUTO_TEST_CASE(correlate)
+{
+    // Against direct circular sums, for the full result and for lag
+    // ranges either side of zero with each normalisation
+    const int n = 16;
+    double a[n], b[n], out[n], expected[n];
+    float fa[n], fb[n], fout[n];
+    double ea = 0.0, eb = 0.0;
+    for (int i = 0; i < n; ++i) {
+        a[i] = sin(i * 0.7) + 0.25 * cos(i * 1.9);
+        b[i] = cos(i * 0.4) - 0.5 * sin(i * 2.3);
+        fa[i] = float(a[i]);
+        fb[i] = float(b[i]);
+        ea += a[i] * a[i];
+        eb += b[i] * b[i];
+    }
+    for (int k = 0; k < n; ++k) {
+        expected[k] = 0.0;
+        for (int j = 0; j < n; ++j) {
+            expected[k] += a[(j + k) % n] * b[j];
+        }
+    }
+    USING_FFT(n);
+    if (eps < 1e-11) {
+        eps = 1e-11;
+    }
+    // Tolerances relative to the size of the sums
+    eps *= sqrt(ea * eb);
+    const float ftol = 1e-5f * float(sqrt(ea * eb));
+    fft.correlate(a, b, out);
+    COMPARE_ARR(out, expected, n);
+    fft.correlate(fa, fb, fout);
+    for (int k = 0; k < n; ++k) {
+        BOOST_CHECK_SMALL(fout[k] - float(expected[k]), ftol);
+    }
+
+    const int ranges[][2] = { { -3, 4 }, { 2, 6 }, { -n + 1, 0 }, { 0, n - 1 } };
+    const FFT::Normalisation norms[] = {
+        FFT::NoNormalisation, FFT::BiasedNormalisation,
+        FFT::CoefficientNormalisation
+    };
+    const double scales[] = { 1.0, 1.0 / n, 1.0 / sqrt(ea * eb) };
+    for (int r = 0; r < 4; ++r) {
+        const int minLag = ranges[r][0], maxLag = ranges[r][1];
+        const int count = maxLag - minLag + 1;
+        for (int m = 0; m < 3; ++m) {
+            // Guard values after the range must be left alone
+            for (int k = 0; k < n; ++k) out[k] = 99.0;
+            fft.correlate(a, b, out, minLag, maxLag, norms[m]);
+            for (int k = 0; k < count; ++k) {
+                COMPARE(out[k], (expected[(minLag + k + n) % n] * scales[m]));
+            }
+            for (int k = count; k < n; ++k) {
+                BOOST_CHECK_EQUAL(out[k], 99.0);
+            }
+        }
+        for (int k = 0; k < n; ++k) fout[k] = 99.f;
+        fft.correlate(fa, fb, fout, minLag, maxLag);
+        for (int k = 0; k < count; ++k) {
+            BOOST_CHECK_SMALL(fout[k] - float(expected[(minLag + k + n) % n]),
+                              ftol);
+        }
+        for (int k = count; k < n; ++k) {
+            BOOST_CHECK_EQUAL(fout[k], 99.f);
+        }
+    }
+
+    BOOST_CHECK_THROW(fft.correlate(a, b, out, 2, 1), FFT::Exception);
+    BOOST_CHECK_THROW(fft.correlate(a, b, out, -n, 0), FFT::Exception);
+    BOOST_CHECK_THROW(fft.correlate(a, b, out, -8, 8), FFT::Exception);
+
+    // Plain inverse afterwards is unaffected
+    double re[n/2 + 1], im[n/2 + 1];
+    fft.forward(a, re, im);
+    fft.inverse(re, im, out);
+    COMPARE_SCALED_N(out, a, n, n);
+}
+
+ALL_IMPL_AUTO_TEST_CASE(autocorrelate)
+{
+    const int n = 32;
+    const int maxLag = 9;
+    double in[n], out[n], expected[n];
+    float fin[n], fout[n];
+    for (int i = 0; i < n; ++i) {
+        // A periodic signal, zero-padded to half the frame so that
+        // the circular result is the linear one
+        in[i] = (i < n/2) ? sin(2.0 * M_PI * i / 5.0) + 0.1 * i : 0.0;
+        fin[i] = float(in[i]);
+    }
+    for (int k = 0; k < n; ++k) {
+        expected[k] = 0.0;
+        for (int j = 0; j < n; ++j) {
+            expected[k] += in[(j + k) % n] * in[j];
+        }
+    }
+    USING_FFT(n);
+    if (eps < 1e-11) {
+        eps = 1e-11;
+    }
+    // Tolerances relative to the size of the sums
+    eps *= expected[0];
+    fft.autocorrelate(in, out);
+    COMPARE_ARR(out, expected, n);
+    for (int k = 1; k < n; ++k) {
+        COMPARE(out[k], out[n - k]);
+    }
+    for (int k = 0; k < n; ++k) out[k] = 99.0;
+    fft.autocorrelate(in, out, maxLag, FFT::CoefficientNormalisation);
+    COMPARE(out[0], 1.0);
+    for (int k = 0; k <= maxLag; ++k) {
+        COMPARE(out[k], (expected[k] / expected[0]));
+    }
+    for (int k = maxLag + 1; k < n; ++k) {
+        BOOST_CHECK_EQUAL(out[k], 99.0);
+    }
+    fft.autocorrelate(in, out, maxLag, FFT::BiasedNormalisation);
+    for (int k = 0; k <= maxLag; ++k) {
+        COMPARE(out[k], (expected[k] / n));
+    }
+    fft.autocorrelate(fin, fout);
+    for (int k = 0; k < n; ++k) {
+        BOOST_CHECK_SMALL(fout[k] - float(expected[k]), 1e-5f * float(expected[0]));
+    }
+    BOOST_CHECK_THROW(fft.autocorrelate(in, out, n), FFT::Exception);
+    BOOST_CHECK_THROW(fft.autocorrelate(in, out, -1), FFT::Exception);
+}
+
+ALL_IMPL_AUTO_TEST_CASE(power)
+{
+    const int n = 32;
+    const int hs1 = n/2 + 1;
+    double in[n], out[n], expected[n], re[hs1], im[hs1], power[hs1];
+    float fin[n], fout[n], fpower[hs1];
+    for (int i = 0; i < n; ++i) {
+        in[i] = sin(i * 0.7) + 0.25 * cos(i * 1.9) + 0.1;
+        fin[i] = float(in[i]);
+    }
+    USING_FFT(n);
+    if (eps < 1e-11) {
+        eps = 1e-11;
+    }
+    fft.forward(in, re, im);
+    fft.forwardPower(in, power);
+    double maxPower = 0.0;
+    for (int i = 0; i < hs1; ++i) {
+        if (power[i] > maxPower) maxPower = power[i];
+    }
+    // Tolerances relative to the largest bin
+    eps *= maxPower;
+    for (int i = 0; i < hs1; ++i) {
+        COMPARE(power[i], (re[i] * re[i] + im[i] * im[i]));
+    }
+    fft.forwardPower(fin, fpower);
+    for (int i = 0; i < hs1; ++i) {
+        BOOST_CHECK_SMALL(fpower[i] - float(power[i]), 1e-5f * float(maxPower));
+    }
+
+    // Inverse of the power spectrum is size times the autocorrelation
+    fft.autocorrelate(in, expected);
+    fft.inversePower(power, out);
+    COMPARE_SCALED_N(out, expected, n, n);
+    fft.inversePower(fpower, fout);
+    for (int i = 0; i < n; ++i) {
+        BOOST_CHECK_SMALL(fout[i] / n - float(expected[i]),
+                          1e-5f * float(maxPower));
+    }
+}
+
+ALL_IMPL_AUTO_TEST_CASE(logMagnitude)
+{
+    // Against the log of forwardMagnitude, for an input most of
+    // whose bins fall below the floor
+    const int n = 32;
+    const int hs1 = n/2 + 1;
+    const double floor = 0.05, floorDb = 20.0 * log10(floor);
+    double in[n], mag[hs1], logMag[hs1], db[hs1];
+    float fin[n], flogMag[hs1], fdb[hs1];
+    for (int i = 0; i < n; ++i) {
+        in[i] = 2.0 * cos(2.0 * M_PI * 3.0 * i / n) + 0.5 +
+            0.02 * sin(i * 0.7);
+        fin[i] = float(in[i]);
+    }
+    USING_FFT(n);
+    if (eps < 1e-11) {
+        eps = 1e-11;
+    }
+    // The error in the log is the relative error in the magnitude,
+    // which is largest at the floor
+    eps *= 32.0 / floor;
+    fft.forwardMagnitude(in, mag);
+    fft.forwardLogMagnitude(in, logMag, floor);
+    fft.forwardDecibels(in, db, floorDb);
+    int floored = 0;
+    for (int i = 0; i < hs1; ++i) {
+        if (mag[i] < floor) ++floored;
+        const double expected = log(std::max(mag[i], floor));
+        COMPARE(logMag[i], expected);
+        BOOST_CHECK_SMALL(db[i] - (20.0 / log(10.0)) * expected,
+                          eps * 10.0);
+    }
+    BOOST_CHECK(floored > 0 && floored < hs1);
+    fft.forwardLogMagnitude(fin, flogMag, float(floor));
+    fft.forwardDecibels(fin, fdb, float(floorDb));
+    for (int i = 0; i < hs1; ++i) {
+        const double expected = log(std::max(mag[i], floor));
+        BOOST_CHECK_SMALL(flogMag[i] - float(expected), 2e-4f);
+        BOOST_CHECK_SMALL(fdb[i] - float((20.0 / log(10.0)) * expected),
+                          2e-3f);
+    }
+}
+
+ALL_IMPL_AUTO_TEST_CASE(logMagnitudeAccuracy)
+{
+    // Every bin of the transform of an impulse has the magnitude of
+    // the impulse exactly, so the only error is that of the log
+    // approximation, which should be within the documented bounds
+    // over a wide range. A zero floor is replaced by the smallest
+    // normal number.
+    const int n = 8;
+    const int hs1 = n/2 + 1;
+    double in[n], logMag[hs1];
+    float fin[n], flogMag[hs1];
+    USING_FFT(n);
+    bool exact = (eps < 1e-11);
+    for (int i = 0; i < n; ++i) {
+        in[i] = 0.0;
+        fin[i] = 0.f;
+    }
+    for (int e = -300; e <= 300; ++e) {
+        in[0] = pow(10.0, e * 0.1 + 0.037);
+        const double expected = log(in[0]);
+        fft.forwardLogMagnitude(in, logMag, 0.0);
+        for (int i = 0; i < hs1; ++i) {
+            const double err = fabs(logMag[i] - expected);
+            if (exact) {
+                BOOST_CHECK(err <= 5e-15 + 2e-15 * fabs(expected));
+            } else {
+                BOOST_CHECK(err <= 1e-7 + 4e-7 * fabs(expected));
+            }
+        }
+    }
+    for (int e = -150; e <= 150; ++e) {
+        fin[0] = float(pow(10.0, e * 0.1 + 0.037));
+        const double expected = log(double(fin[0]));
+        fft.forwardLogMagnitude(fin, flogMag, 0.f);
+        for (int i = 0; i < hs1; ++i) {
+            const double err = fabs(flogMag[i] - expected);
+            BOOST_CHECK(err <= 1e-7 + 4e-7 * fabs(expected));
+        }
+    }
+    in[0] = 0.0;
+    fft.forwardLogMagnitude(in, logMag, 0.0);
+    BOOST_CHECK_SMALL(logMag[0] - 0.5 * log(DBL_MIN), 1e-12);
+    // A power that overflows float is clamped to the largest value,
+    // if the implementation works in float at all
+    fin[0] = 1e30f;
+    fft.forwardLogMagnitude(fin, flogMag, 0.f);
+    for (int i = 0; i < hs1; ++i) {
+        BOOST_CHECK(flogMag[i] >= 0.5 * log(FLT_MAX) - 1e-4);
+        BOOST_CHECK(flogMag[i] <= log(1e30) + 1e-4);
+    }
+}
+
+ALL_IMPL_AUTO_TEST_CASE(fastPolar)
+{
+    // FastPolar against ExactPolar on the same transforms, so the
+    // only differences are those of the approximations, which should
+    // be within the documented bounds
+    const int n = 64;
+    const int hs1 = n/2 + 1;
+    double in[n], mag[hs1], phase[hs1], fmag[hs1], fphase[hs1];
+    double out[n], fastOut[n];
+    float fin[n], smag[hs1], sphase[hs1], sfmag[hs1], sfphase[hs1];
+    float sout[n], sfastOut[n];
+    USING_FFT(n);
+    if (eps < 1e-11) {
+        eps = 1e-11;
+    }
+    BOOST_CHECK_EQUAL(fft.getPolarAccuracy(), FFT::ExactPolar);
+    srand(17);
+    for (int frame = 0; frame < 20; ++frame) {
+        for (int i = 0; i < n; ++i) {
+            in[i] = double(rand()) / RAND_MAX - 0.5;
+            fin[i] = float(in[i]);
+        }
+        fft.setPolarAccuracy(FFT::ExactPolar);
+        fft.forwardPolar(in, mag, phase);
+        fft.forwardPolar(fin, smag, sphase);
+        fft.setPolarAccuracy(FFT::FastPolar);
+        fft.forwardPolar(in, fmag, fphase);
+        fft.forwardPolar(fin, sfmag, sfphase);
+        BOOST_CHECK_EQUAL(fft.getPolarAccuracy(), FFT::FastPolar);
+        double sum = 0.0;
+        for (int i = 0; i < hs1; ++i) {
+            sum += mag[i];
+            BOOST_CHECK_SMALL(fmag[i] - mag[i], eps);
+            BOOST_CHECK_SMALL(sfmag[i] - smag[i], 1e-6f);
+            // Either of pi and -pi is correct for a zero imaginary part
+            double d = fabs(fphase[i] - phase[i]);
+            BOOST_CHECK(d < 2e-8 || fabs(d - 2.0 * M_PI) < 2e-8);
+            d = fabs(double(sfphase[i]) - double(sphase[i]));
+            BOOST_CHECK(d < 4e-7 || fabs(d - 2.0 * M_PI) < 4e-7);
+        }
+        // Phases well outside [-pi, pi], as accumulated by a phase
+        // vocoder, for the inverse
+        for (int i = 0; i < hs1; ++i) {
+            phase[i] += (frame - 10) * 100.0 * i;
+            sphase[i] = float(phase[i]);
+        }
+        fft.setPolarAccuracy(FFT::ExactPolar);
+        fft.inversePolar(mag, phase, out);
+        fft.inversePolar(smag, sphase, sout);
+        fft.setPolarAccuracy(FFT::FastPolar);
+        fft.inversePolar(mag, phase, fastOut);
+        fft.inversePolar(smag, sphase, sfastOut);
+        for (int i = 0; i < n; ++i) {
+            BOOST_CHECK_SMALL(fastOut[i] - out[i], (2e-9 + eps) * 2.0 * sum);
+            BOOST_CHECK_SMALL(sfastOut[i] - sout[i],
+                              float((2e-7 + 1e-6) * 2.0 * sum));
+        }
+    }
+    // Phases beyond the range of an int, where the error bound grows
+    // with the phase, and far beyond, where only the magnitude of
+    // the output is bounded
+    double sum = 0.0;
+    for (int i = 0; i < hs1; ++i) {
+        sum += mag[i];
+        phase[i] = 1e10 + 12345.678 * i;
+        sphase[i] = float(phase[i]);
+    }
+    fft.setPolarAccuracy(FFT::ExactPolar);
+    fft.inversePolar(mag, phase, out);
+    fft.inversePolar(smag, sphase, sout);
+    fft.setPolarAccuracy(FFT::FastPolar);
+    fft.inversePolar(mag, phase, fastOut);
+    fft.inversePolar(smag, sphase, sfastOut);
+    for (int i = 0; i < n; ++i) {
+        BOOST_CHECK_SMALL(fastOut[i] - out[i],
+                          (2e-9 + 2e-16 * 1e10 + eps) * 2.0 * sum);
+        BOOST_CHECK_SMALL(sfastOut[i] - sout[i],
+                          float((2e-7 + 2e-16 * 1e10 + 1e-6) * 2.0 * sum));
+    }
+    for (int i = 0; i < hs1; ++i) {
+        phase[i] = (i % 2 ? -1e30 : 1e30) * (i + 1);
+        sphase[i] = float(phase[i]);
+    }
+    fft.inversePolar(mag, phase, fastOut);
+    fft.inversePolar(smag, sphase, sfastOut);
+    for (int i = 0; i < n; ++i) {
+        BOOST_CHECK(fabs(fastOut[i]) <= 2.0 * sum + eps);
+        BOOST_CHECK(fabs(sfastOut[i]) <= 2.0 * sum + 1e-3);
+    }
+}
+
+ALL_IMPL_AUTO_TEST_CASE(cepstralEnvelope)
+{
+    // Against the same pipeline composed from the separate calls,
+    // compared as logs, for cutoffs from none to beyond size/2
+    const int n = 64;
+    const int hs1 = n/2 + 1;
+    const int cutoffs[] = { 0, 1, 7, n/2 - 1, n/2, n };
+    double in[n], mag[hs1], cep[n], re[hs1], im[hs1], env[hs1];
+    float fin[n], fenv[hs1];
+    srand(23);
+    for (int i = 0; i < n; ++i) {
+        in[i] = sin(i * 0.9) + 0.5 * cos(i * 0.3) +
+            double(rand()) / RAND_MAX - 0.5;
+        fin[i] = float(in[i]);
+    }
+    USING_FFT(n);
+    if (eps < 1e-11) {
+        eps = 1e-11;
+    }
+    // The log amplifies the error in the smaller bins
+    eps *= 10.0;
+    fft.forwardMagnitude(in, mag);
+    fft.inverseCepstral(mag, cep);
+    for (int c = 0; c < int(sizeof(cutoffs) / sizeof(cutoffs[0])); ++c) {
+        const int cutoff = cutoffs[c];
+        double liftered[n];
+        for (int i = 0; i < n; ++i) {
+            const int q = std::min(i, n - i);
+            liftered[i] = (q <= cutoff) ? cep[i] / n : 0.0;
+        }
+        fft.forward(liftered, re, im);
+        fft.cepstralEnvelope(in, cutoff, env);
+        fft.cepstralEnvelope(fin, cutoff, fenv);
+        for (int i = 0; i < hs1; ++i) {
+            COMPARE(log(env[i]), re[i]);
+            BOOST_CHECK_SMALL(float(log(fenv[i]) - re[i]), 1e-4f);
+        }
+        if (cutoff >= n/2) {
+            for (int i = 0; i < hs1; ++i) {
+                COMPARE(env[i], (mag[i] + 1e-6));
+            }
+        }
+    }
+    BOOST_CHECK_THROW(fft.cepstralEnvelope(in, -1, env), FFT::Exception);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
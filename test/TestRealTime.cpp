@@ -0,0 +1,399 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    bqfft
+
+    A small library wrapping various FFT implementations for some
+    common audio processing use cases.
+
+    Copyright 2007-2021 Particular Programs Ltd.
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of Chris Cannam and
+    Particular Programs Ltd shall not be used in advertising or
+    otherwise to promote the sale, use or other dealings in this
+    Software without prior written authorization.
+*/
+
+#include "bqfft/FFT.h"
+#include "bqfft/STFT.h"
+#include "bqfft/Convolver.h"
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+
+#include <iostream>
+#include <string>
+#include <set>
+
+using namespace breakfastquay;
+
+/*
+ * An FFT constructed in RealTimeMode must not allocate memory or
+ * lock a mutex in any transform call. We check this by interposing
+ * the allocator and pthread_mutex_lock and counting calls made
+ * while a transform is running, on the thread running it. This only
+ * works where we know how to reach the real functions underneath,
+ * i.e. with glibc.
+ */
+
+#if defined(__GLIBC__) && !defined(NO_THREADING)
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#define INTERPOSING 1
+
+extern "C" {
+
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+extern void *__libc_memalign(size_t, size_t);
+extern void __libc_free(void *);
+
+// Per thread, so that a background thread of the object under test
+// is not counted against the thread calling it
+static __thread bool armed = false;
+static volatile int allocations = 0;
+static volatile int locks = 0;
+
+typedef int (*MutexLockFn)(pthread_mutex_t *);
+
+static MutexLockFn realMutexLock = 0;
+
+void *malloc(size_t n)
+{
+    if (armed) ++allocations;
+    return __libc_malloc(n);
+}
+
+void *calloc(size_t n, size_t sz)
+{
+    if (armed) ++allocations;
+    return __libc_calloc(n, sz);
+}
+
+void *realloc(void *p, size_t n)
+{
+    if (armed) ++allocations;
+    return __libc_realloc(p, n);
+}
+
+void *memalign(size_t alignment, size_t n)
+{
+    if (armed) ++allocations;
+    return __libc_memalign(alignment, n);
+}
+
+int posix_memalign(void **p, size_t alignment, size_t n)
+{
+    if (armed) ++allocations;
+    *p = __libc_memalign(alignment, n);
+    return *p ? 0 : ENOMEM;
+}
+
+void free(void *p)
+{
+    if (armed && p) ++allocations;
+    __libc_free(p);
+}
+
+int pthread_mutex_lock(pthread_mutex_t *m)
+{
+    if (armed) ++locks;
+    if (!realMutexLock) {
+        realMutexLock = (MutexLockFn)dlsym(RTLD_NEXT, "pthread_mutex_lock");
+    }
+    return realMutexLock(m);
+}
+
+}
+
+static void arm()
+{
+    // Resolve the real lock function now, as dlsym may itself allocate
+    if (!realMutexLock) {
+        realMutexLock = (MutexLockFn)dlsym(RTLD_NEXT, "pthread_mutex_lock");
+    }
+    allocations = 0;
+    locks = 0;
+    armed = true;
+}
+
+static void disarm()
+{
+    armed = false;
+}
+
+#else
+
+static int allocations = 0;
+static int locks = 0;
+
+static void arm() { }
+static void disarm() { }
+
+#endif
+
+BOOST_AUTO_TEST_SUITE(TestRealTime)
+
+std::string all_implementations[] = {
+    "ipp", "vdsp", "fftw", "sleef", "kissfft", "builtin", "dft"
+};
+
+static const int size = 64;
+
+static void runAll(FFT &fft,
+                   double *dtime, double *dre, double *dim, double *dcplx,
+                   float *ftime, float *fre, float *fim, float *fcplx)
+{
+    fft.forward(dtime, dre, dim);
+    fft.forwardInterleaved(dtime, dcplx);
+    fft.forwardPolar(dtime, dre, dim);
+    fft.forwardMagnitude(dtime, dre);
+    fft.inverse(dre, dim, dtime);
+    fft.inverseInterleaved(dcplx, dtime);
+    fft.inversePolar(dre, dim, dtime);
+    fft.inverseCepstral(dre, dtime);
+
+    fft.forward(ftime, fre, fim);
+    fft.forwardInterleaved(ftime, fcplx);
+    fft.forwardPolar(ftime, fre, fim);
+    fft.forwardMagnitude(ftime, fre);
+    fft.inverse(fre, fim, ftime);
+    fft.inverseInterleaved(fcplx, ftime);
+    fft.inversePolar(fre, fim, ftime);
+    fft.inverseCepstral(fre, ftime);
+
+    fft.forwardWindowedPolar(dtime, dcplx, size/2, dre, dim);
+    fft.inverseWindowedPolar(dre, dim, dcplx, size/2, dtime);
+    fft.forwardWindowedPolar(ftime, fcplx, size/2, fre, fim);
+    fft.inverseWindowedPolar(fre, fim, fcplx, size/2, ftime);
+    fft.inverseAccumulate(dre, dim, dcplx, size/2, 0.5, dtime);
+    fft.inverseAccumulate(fre, fim, fcplx, size/2, 0.5f, ftime);
+
+    fft.forwardPadded(dtime, size/3, dre, dim);
+    fft.forwardPaddedInterleaved(dtime, size/3, dcplx);
+    fft.forwardPaddedPolar(ftime, size/3, fre, fim);
+    fft.forwardPaddedMagnitude(ftime, size/3, fre);
+
+    fft.forwardBins(dtime, 2, 6, dre, dim);
+    fft.forwardBinsMagnitude(dtime, 0, size/2 + 1, dre);
+    fft.forwardBins(ftime, 0, size/2 + 1, fre, fim);
+    fft.forwardBinsMagnitude(ftime, 2, 6, fre);
+
+    fft.inverseSamples(dre, dim, size/2, size, dtime);
+    fft.inverseInterleavedSamples(dcplx, 0, size/4, dtime);
+    fft.inverseSamples(fre, fim, size/4, size/2, ftime);
+    fft.inverseInterleavedSamples(fcplx, size/2, size, ftime);
+
+    fft.forwardPower(dtime, dre);
+    fft.inversePower(dre, dtime);
+    fft.forwardPower(ftime, fre);
+    fft.inversePower(fre, ftime);
+
+    fft.forwardLogMagnitude(dtime, dre, 1e-6);
+    fft.forwardDecibels(dtime, dre, -120.0);
+    fft.forwardLogMagnitude(ftime, fre, 1e-6f);
+    fft.forwardDecibels(ftime, fre, -120.f);
+
+    fft.setPolarAccuracy(FFT::FastPolar);
+    fft.forwardPolar(dtime, dre, dim);
+    fft.inversePolar(dre, dim, dtime);
+    fft.forwardPolar(ftime, fre, fim);
+    fft.inversePolar(fre, fim, ftime);
+    fft.setPolarAccuracy(FFT::ExactPolar);
+
+    fft.cepstralEnvelope(dtime, size/8, dre);
+    fft.cepstralEnvelope(ftime, size/8, fre);
+
+    fft.correlate(dtime, dtime, dcplx);
+    fft.autocorrelate(dtime, dcplx, size/4, FFT::CoefficientNormalisation);
+    fft.correlate(ftime, ftime, fcplx, -4, 4, FFT::BiasedNormalisation);
+    fft.autocorrelate(ftime, fcplx);
+}
+
+static void checkRealTime(std::string impl)
+{
+    FFT::setDefaultImplementation(impl);
+
+    FFT fft(size, 0, FFT::RealTimeMode);
+
+    double *dtime = fft.allocateBuffer<double>(FFT::TimeDomainBuffer);
+    double *dre = fft.allocateBuffer<double>(FFT::SplitSpectrumBuffer);
+    double *dim = fft.allocateBuffer<double>(FFT::SplitSpectrumBuffer);
+    double *dcplx = fft.allocateBuffer<double>(FFT::InterleavedSpectrumBuffer);
+    float *ftime = fft.allocateBuffer<float>(FFT::TimeDomainBuffer);
+    float *fre = fft.allocateBuffer<float>(FFT::SplitSpectrumBuffer);
+    float *fim = fft.allocateBuffer<float>(FFT::SplitSpectrumBuffer);
+    float *fcplx = fft.allocateBuffer<float>(FFT::InterleavedSpectrumBuffer);
+
+    for (int i = 0; i < size; ++i) {
+        dtime[i] = ftime[i] = float(i % 7) - 3.f;
+    }
+
+    arm();
+    runAll(fft, dtime, dre, dim, dcplx, ftime, fre, fim, fcplx);
+    disarm();
+
+    BOOST_TEST_MESSAGE(fft.getImplementation() << ": " << allocations
+                       << " allocation(s), " << locks << " lock(s)");
+    BOOST_CHECK_EQUAL(allocations, 0);
+    BOOST_CHECK_EQUAL(locks, 0);
+
+    FFT::deallocateBuffer(fcplx);
+    FFT::deallocateBuffer(fim);
+    FFT::deallocateBuffer(fre);
+    FFT::deallocateBuffer(ftime);
+    FFT::deallocateBuffer(dcplx);
+    FFT::deallocateBuffer(dim);
+    FFT::deallocateBuffer(dre);
+    FFT::deallocateBuffer(dtime);
+
+    FFT::setDefaultImplementation("");
+}
+
+BOOST_AUTO_TEST_CASE(eachImplementation)
+{
+    std::set<std::string> impls = FFT::getImplementations();
+    for (int i = 0; i < int(sizeof(all_implementations)/sizeof(all_implementations[0])); ++i) {
+        if (impls.find(all_implementations[i]) == impls.end()) continue;
+        checkRealTime(all_implementations[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(defaultSelection)
+{
+    // No explicit default, so possibly routed across implementations
+    checkRealTime("");
+}
+
+BOOST_AUTO_TEST_CASE(stftAnalyser)
+{
+    const int n = 64, hop = 16;
+    float signal[n * 3], out[n * 3], win[n];
+    float mag[4][n/2 + 1], phase[4][n/2 + 1];
+    float *mags[4] = { mag[0], mag[1], mag[2], mag[3] };
+    float *phases[4] = { phase[0], phase[1], phase[2], phase[3] };
+    for (int i = 0; i < n * 3; ++i) signal[i] = float(i % 7) - 3.f;
+    for (int i = 0; i < n; ++i) win[i] = 1.f;
+    STFTAnalyser<float> stft(n, hop, STFTAnalyser<float>::Polar,
+                             win, true, 0, FFT::RealTimeMode);
+    ISTFTSynthesiser<float> istft(n, hop, ISTFTSynthesiser<float>::Polar,
+                                  win, true, 0, FFT::RealTimeMode);
+
+    arm();
+    int frames = 0, samples = 0;
+    for (int i = 0; i < n * 3; i += 24) {
+        stft.push(signal + i, 24);
+        int got = stft.pull(mags, phases, 4);
+        istft.push(mags, phases, got);
+        samples += istft.pull(out + samples, n * 3 - samples);
+        frames += got;
+    }
+    disarm();
+
+    BOOST_CHECK(frames > 0);
+    BOOST_CHECK(samples > 0);
+    BOOST_CHECK_EQUAL(allocations, 0);
+    BOOST_CHECK_EQUAL(locks, 0);
+}
+
+BOOST_AUTO_TEST_CASE(convolver)
+{
+    const int block = 64, length = 1000;
+    float ir[length], in[block], out[block];
+    for (int i = 0; i < length; ++i) ir[i] = float(i % 3) - 1.f;
+    for (int i = 0; i < block; ++i) in[i] = float(i % 7) - 3.f;
+    Convolver<float> conv(block, ir, length, FFT::RealTimeMode);
+
+    arm();
+    for (int i = 0; i < 20; ++i) {
+        conv.process(in, out);
+    }
+    disarm();
+
+    BOOST_CHECK_EQUAL(allocations, 0);
+    BOOST_CHECK_EQUAL(locks, 0);
+}
+
+BOOST_AUTO_TEST_CASE(nonUniformConvolver)
+{
+    // With and without the background thread. Without it, every
+    // stage runs in process(); with it, process() hands stages to
+    // the thread and may run late ones itself, and must not take a
+    // lock to do either
+    const int block = 64, length = 4000;
+    float ir[length], in[block], out[block];
+    for (int i = 0; i < length; ++i) ir[i] = float(i % 3) - 1.f;
+    for (int i = 0; i < block; ++i) in[i] = float(i % 7) - 3.f;
+    for (int threaded = 0; threaded < 2; ++threaded) {
+        NonUniformConvolver<float> conv(block, ir, length, 1024,
+                                        threaded != 0, FFT::RealTimeMode);
+
+        arm();
+        for (int i = 0; i < 40; ++i) {
+            conv.process(in, out);
+        }
+        disarm();
+
+        BOOST_CHECK_EQUAL(allocations, 0);
+        BOOST_CHECK_EQUAL(locks, 0);
+    }
+}
+
+#ifdef INTERPOSING
+
+BOOST_AUTO_TEST_CASE(interpositionWorks)
+{
+    // A DefaultMode object initialises lazily in its first transform
+    // call, which must show up in the counts, or the tests above
+    // prove nothing
+    FFT::setDefaultImplementation("dft");
+    FFT fft(size);
+    double *dtime = fft.allocateBuffer<double>(FFT::TimeDomainBuffer);
+    double *dcplx = fft.allocateBuffer<double>(FFT::InterleavedSpectrumBuffer);
+    arm();
+    fft.forwardInterleaved(dtime, dcplx);
+    disarm();
+    BOOST_CHECK(allocations > 0);
+    FFT::deallocateBuffer(dcplx);
+    FFT::deallocateBuffer(dtime);
+    FFT::setDefaultImplementation("");
+}
+
+#else
+
+BOOST_AUTO_TEST_CASE(interpositionUnavailable)
+{
+    BOOST_TEST_MESSAGE("Allocator interposition is not supported on this "
+                       "platform: real-time mode was exercised but not verified");
+}
+
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
+
@@ -0,0 +1,822 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    bqfft
+
+    A small library wrapping various FFT implementations for some
+    common audio processing use cases.
+
+    Copyright 2007-2021 Particular Programs Ltd.
+
+    Permission is hereby granted, free of charge, to any person
+    obtaining a copy of this software and associated documentation
+    files (the "Software"), to deal in the Software without
+    restriction, including without limitation the rights to use, copy,
+    modify, merge, publish, distribute, sublicense, and/or sell copies
+    of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+    ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+    CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+    Except as contained in this notice, the names of Chris Cannam and
+    Particular Programs Ltd shall not be used in advertising or
+    otherwise to promote the sale, use or other dealings in this
+    Software without prior written authorization.
+*/
+
+/*
+ * Benchmark of the library as built, using only the public API.
+ *
+ * Usage: bench-fft [-s size]... [-i implementation]... [-c] [-a] [-e budget]
+ *                  [-v length]
+ *
+ *   -s  Size to measure (repeatable; default a range from 64 to 8192,
+ *       including some non-power-of-two sizes)
+ *   -i  Implementation to measure (repeatable; default all compiled-in
+ *       implementations except the DFT fallback)
+ *   -c  Write CSV instead of a table
+ *   -a  Measure accuracy against a long double reference DFT, as well
+ *       as speed, and mark the Pareto-optimal implementations
+ *   -e  As -a, also marking the fastest implementation whose worst
+ *       RMS error is within the given budget
+ *   -v  Instead of transforms, time the uniformly and non-uniformly
+ *       partitioned convolvers with an impulse response of the given
+ *       length against direct-form convolution, at each size as block
+ *       size (default 64 to 1024)
+ *
+ * Each implementation is selected with FFT::setDefaultImplementation;
+ * sizes it cannot handle (where the FFT falls back to another
+ * implementation) are skipped. Every forward and inverse method is
+ * timed in both precisions as the median of a number of batches, and
+ * a result is flagged as noisy if its 10th-90th percentile spread
+ * exceeds 10% of the median.
+ *
+ * In accuracy mode, forward, inverse and round-trip errors are
+ * reported for each implementation, size and precision, as RMS and
+ * maximum error relative to the reference.
+ *
+ * In convolution mode, the median time to process one block is
+ * reported for each implementation, block size and precision, for
+ * both convolvers and for the direct form, with the speedup of the
+ * uniform convolver over the direct form.
+ */
+
+#include "bqfft/FFT.h"
+#include "bqfft/Convolver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+using namespace breakfastquay;
+
+static const char *const methodNames[] = {
+    "forward", "forwardInterleaved", "forwardPolar", "forwardMagnitude",
+    "inverse", "inverseInterleaved", "inversePolar", "inverseCepstral"
+};
+
+static const int methodCount = 8;
+
+static const int batches = 11;
+static const double minBatchNs = 5.0e5;
+static const double noiseThreshold = 0.1;
+
+static double
+now()
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return double(counter.QuadPart) * 1.0e9 / double(frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return double(ts.tv_sec) * 1.0e9 + double(ts.tv_nsec);
+#endif
+}
+
+// Keep the process on one CPU, so that migrations don't show up as
+// noise. Only implemented on Linux; elsewhere we rely on the noise
+// flag to show up any disturbance.
+static void
+pinToCurrentCPU()
+{
+#ifdef __linux__
+    int cpu = sched_getcpu();
+    if (cpu < 0) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) == 0) {
+        std::cerr << "Pinned to CPU " << cpu << std::endl;
+    }
+#endif
+}
+
+template <typename T>
+struct Buffers
+{
+    Buffers(const FFT &fft) {
+        int n = fft.getSize();
+        time = fft.allocateBuffer<T>(FFT::TimeDomainBuffer);
+        re = fft.allocateBuffer<T>(FFT::SplitSpectrumBuffer);
+        im = fft.allocateBuffer<T>(FFT::SplitSpectrumBuffer);
+        mag = fft.allocateBuffer<T>(FFT::SplitSpectrumBuffer);
+        cplx = fft.allocateBuffer<T>(FFT::InterleavedSpectrumBuffer);
+        outa = fft.allocateBuffer<T>(FFT::InterleavedSpectrumBuffer);
+        outb = fft.allocateBuffer<T>(FFT::InterleavedSpectrumBuffer);
+        srand(1);
+        for (int i = 0; i < n; ++i) {
+            time[i] = T(double(rand()) / RAND_MAX * 2.0 - 1.0);
+        }
+        for (int i = 0; i <= n/2; ++i) {
+            re[i] = T(double(rand()) / RAND_MAX * 2.0 - 1.0);
+            im[i] = T(double(rand()) / RAND_MAX * 2.0 - 1.0);
+            mag[i] = T(double(rand()) / RAND_MAX + 0.1);
+            cplx[i*2] = re[i];
+            cplx[i*2+1] = im[i];
+        }
+    }
+    ~Buffers() {
+        FFT::deallocateBuffer(time);
+        FFT::deallocateBuffer(re);
+        FFT::deallocateBuffer(im);
+        FFT::deallocateBuffer(mag);
+        FFT::deallocateBuffer(cplx);
+        FFT::deallocateBuffer(outa);
+        FFT::deallocateBuffer(outb);
+    }
+    T *time, *re, *im, *mag, *cplx, *outa, *outb;
+};
+
+template <typename T>
+static void
+run(FFT &fft, int method, Buffers<T> &b)
+{
+    switch (method) {
+    case 0: fft.forward(b.time, b.outa, b.outb); break;
+    case 1: fft.forwardInterleaved(b.time, b.outa); break;
+    case 2: fft.forwardPolar(b.time, b.outa, b.outb); break;
+    case 3: fft.forwardMagnitude(b.time, b.outa); break;
+    case 4: fft.inverse(b.re, b.im, b.outa); break;
+    case 5: fft.inverseInterleaved(b.cplx, b.outa); break;
+    case 6: fft.inversePolar(b.mag, b.im, b.outa); break;
+    case 7: fft.inverseCepstral(b.mag, b.outa); break;
+    }
+}
+
+template <typename T>
+struct TransformRunner
+{
+    TransformRunner(FFT &f, int m, Buffers<T> &bufs) :
+        fft(f), method(m), b(bufs) { }
+    void operator()() { run(fft, method, b); }
+    FFT &fft;
+    int method;
+    Buffers<T> &b;
+};
+
+template <typename R>
+static double
+runBatch(R &runner, int iterations)
+{
+    double start = now();
+    for (int i = 0; i < iterations; ++i) {
+        runner();
+    }
+    return (now() - start) / iterations;
+}
+
+struct Result
+{
+    double p10;
+    double p50;
+    double p90;
+    bool noisy;
+};
+
+template <typename R>
+static Result
+measure(R &runner)
+{
+    runner();
+    runner();
+
+    int iterations = 1;
+    while (iterations < (1 << 20) &&
+           runBatch(runner, iterations) * iterations < minBatchNs) {
+        iterations *= 2;
+    }
+
+    std::vector<double> times;
+    for (int i = 0; i < batches; ++i) {
+        times.push_back(runBatch(runner, iterations));
+    }
+    std::sort(times.begin(), times.end());
+
+    Result r;
+    r.p10 = times[(batches - 1) / 10];
+    r.p50 = times[(batches - 1) / 2];
+    r.p90 = times[batches - 1 - (batches - 1) / 10];
+    r.noisy = ((r.p90 - r.p10) > noiseThreshold * r.p50);
+    return r;
+}
+
+template <typename T>
+static Result
+measure(FFT &fft, int method, Buffers<T> &b)
+{
+    TransformRunner<T> runner(fft, method, b);
+    return measure(runner);
+}
+
+static void
+report(bool csv, std::string impl, int size, std::string precision,
+       bool native, int method, const Result &r)
+{
+    double mflops = 2.5 * size * (log(double(size)) / log(2.0)) * 1.0e3 / r.p50;
+    if (csv) {
+        std::cout << impl << "," << size << "," << precision << ","
+                  << (native ? "native" : "converted") << ","
+                  << methodNames[method] << "," << r.p50 << ","
+                  << mflops << "," << r.p10 << "," << r.p90 << ","
+                  << (r.noisy ? "noisy" : "") << std::endl;
+    } else {
+        char line[200];
+        snprintf(line, sizeof(line),
+                 "%-10s %6d %-6s%c %-20s %12.1f %10.1f %12.1f %12.1f %s",
+                 impl.c_str(), size, precision.c_str(), native ? ' ' : '*',
+                 methodNames[method], r.p50, mflops, r.p10, r.p90,
+                 r.noisy ? "NOISY" : "");
+        std::cout << line << std::endl;
+    }
+}
+
+// Accuracy mode. Reference transforms are naive DFTs in long double,
+// with the twiddles taken from one table indexed modulo the size so
+// that the reference itself accumulates no phase error.
+
+struct Reference
+{
+    Reference(int n) : size(n) {
+        const long double pi = 3.14159265358979323846264338327950288L;
+        for (int i = 0; i < n; ++i) {
+            cosTable.push_back(cosl(2.0L * pi * i / n));
+            sinTable.push_back(sinl(2.0L * pi * i / n));
+        }
+    }
+
+    // Forward real-to-complex, first n/2+1 bins
+    void forward(const std::vector<long double> &in,
+                 std::vector<long double> &re,
+                 std::vector<long double> &im) const {
+        re.assign(size/2 + 1, 0.0L);
+        im.assign(size/2 + 1, 0.0L);
+        for (int k = 0; k <= size/2; ++k) {
+            long double sr = 0.0L, si = 0.0L;
+            for (int j = 0; j < size; ++j) {
+                int ix = int((long long)k * j % size);
+                sr += in[j] * cosTable[ix];
+                si -= in[j] * sinTable[ix];
+            }
+            re[k] = sr;
+            im[k] = si;
+        }
+    }
+
+    // Unscaled inverse of a Hermitian spectrum given as n/2+1 bins
+    void inverse(const std::vector<long double> &re,
+                 const std::vector<long double> &im,
+                 std::vector<long double> &out) const {
+        out.assign(size, 0.0L);
+        for (int j = 0; j < size; ++j) {
+            long double s = 0.0L;
+            for (int k = 0; k < size; ++k) {
+                long double r, i;
+                if (k <= size/2) {
+                    r = re[k]; i = im[k];
+                } else {
+                    r = re[size - k]; i = -im[size - k];
+                }
+                int ix = int((long long)k * j % size);
+                s += r * cosTable[ix] - i * sinTable[ix];
+            }
+            out[j] = s;
+        }
+    }
+
+    int size;
+    std::vector<long double> cosTable;
+    std::vector<long double> sinTable;
+};
+
+// Errors relative to the RMS and peak magnitude of the reference, so
+// that figures are comparable across sizes
+struct Error
+{
+    double rms;
+    double max;
+};
+
+template <typename T>
+static Error
+compare(const T *a, const T *b, const std::vector<long double> &refa,
+        const std::vector<long double> &refb, long double scale)
+{
+    long double sumErr = 0.0L, sumRef = 0.0L, maxErr = 0.0L, maxRef = 0.0L;
+    for (int i = 0; i < int(refa.size()); ++i) {
+        long double ra = refa[i], rb = (b ? refb[i] : 0.0L);
+        long double ea = a[i] / scale - ra;
+        long double eb = (b ? b[i] / scale - rb : 0.0L);
+        long double e = sqrtl(ea * ea + eb * eb);
+        long double m = sqrtl(ra * ra + rb * rb);
+        sumErr += e * e;
+        sumRef += m * m;
+        if (e > maxErr) maxErr = e;
+        if (m > maxRef) maxRef = m;
+    }
+    Error err;
+    err.rms = (sumRef > 0.0L ? double(sqrtl(sumErr / sumRef)) : 0.0);
+    err.max = (maxRef > 0.0L ? double(maxErr / maxRef) : 0.0);
+    return err;
+}
+
+struct AccuracyResult
+{
+    std::string impl;
+    std::string precision;
+    bool native;
+    Error forward;
+    Error inverse;
+    Error roundTrip;
+    double ns;
+    double worst;
+    bool pareto;
+};
+
+// Measure one implementation in one precision against the reference
+// transforms of the given inputs. The time reported is that of a
+// forward plus an inverse transform.
+template <typename T>
+static AccuracyResult
+measureAccuracy(FFT &fft, const Reference &ref,
+                const std::vector<long double> &in,
+                const std::vector<long double> &re,
+                const std::vector<long double> &im)
+{
+    int n = fft.getSize();
+    Buffers<T> b(fft);
+
+    // Inputs at the precision under test, and references computed
+    // from exactly those (rounded) values
+    std::vector<long double> tin(n), tre(n/2 + 1), tim(n/2 + 1);
+    for (int i = 0; i < n; ++i) {
+        b.time[i] = T(in[i]);
+        tin[i] = b.time[i];
+    }
+    for (int i = 0; i <= n/2; ++i) {
+        b.re[i] = T(re[i]);
+        b.im[i] = T(im[i]);
+        tre[i] = b.re[i];
+        tim[i] = b.im[i];
+    }
+    std::vector<long double> fre, fim, iout;
+    ref.forward(tin, fre, fim);
+    ref.inverse(tre, tim, iout);
+    
+    AccuracyResult r;
+
+    fft.forward(b.time, b.outa, b.outb);
+    r.forward = compare(b.outa, b.outb, fre, fim, 1.0L);
+
+    fft.inverse(b.re, b.im, b.outa);
+    r.inverse = compare(b.outa, (const T *)0, iout, iout, 1.0L);
+
+    fft.forward(b.time, b.re, b.im);
+    fft.inverse(b.re, b.im, b.outa);
+    r.roundTrip = compare(b.outa, (const T *)0, tin, tin, (long double)n);
+
+    r.ns = measure(fft, 0, b).p50 + measure(fft, 4, b).p50;
+    r.worst = std::max(r.forward.rms, std::max(r.inverse.rms, r.roundTrip.rms));
+    r.pareto = false;
+    return r;
+}
+
+// Mark the results that are Pareto-optimal in time and worst RMS
+// error, i.e. no other result is at least as good in both and better
+// in one
+static void
+markPareto(std::vector<AccuracyResult> &results)
+{
+    for (int i = 0; i < int(results.size()); ++i) {
+        results[i].pareto = true;
+        for (int j = 0; j < int(results.size()); ++j) {
+            if (i == j) continue;
+            if (results[j].ns <= results[i].ns &&
+                results[j].worst <= results[i].worst &&
+                (results[j].ns < results[i].ns ||
+                 results[j].worst < results[i].worst)) {
+                results[i].pareto = false;
+                break;
+            }
+        }
+    }
+}
+
+static void
+reportAccuracy(bool csv, int size, const AccuracyResult &r, bool chosen)
+{
+    if (csv) {
+        std::cout << r.impl << "," << size << "," << r.precision << ","
+                  << (r.native ? "native" : "converted") << ","
+                  << r.forward.rms << "," << r.forward.max << ","
+                  << r.inverse.rms << "," << r.inverse.max << ","
+                  << r.roundTrip.rms << "," << r.roundTrip.max << ","
+                  << r.ns << "," << (r.pareto ? "pareto" : "") << ","
+                  << (chosen ? "chosen" : "") << std::endl;
+    } else {
+        char line[200];
+        snprintf(line, sizeof(line),
+                 "%-10s %6d %-6s%c %9.2e %9.2e %9.2e %9.2e %9.2e %9.2e %12.1f %s%s",
+                 r.impl.c_str(), size, r.precision.c_str(),
+                 r.native ? ' ' : '*',
+                 r.forward.rms, r.forward.max, r.inverse.rms, r.inverse.max,
+                 r.roundTrip.rms, r.roundTrip.max, r.ns,
+                 r.pareto ? "P" : " ", chosen ? " <" : "");
+        std::cout << line << std::endl;
+    }
+}
+
+static void
+runAccuracy(bool csv, const std::vector<int> &sizes,
+            const std::vector<std::string> &impls, double budget)
+{
+    if (csv) {
+        std::cout << "implementation,size,precision,native,"
+                  << "forward_rms,forward_max,inverse_rms,inverse_max,"
+                  << "roundtrip_rms,roundtrip_max,ns,pareto,chosen"
+                  << std::endl;
+    } else {
+        std::cout << "Errors relative to a long double reference DFT: "
+                  << "RMS and max, relative to the reference" << std::endl
+                  << "ns = median forward + inverse time; "
+                  << "P = Pareto-optimal in time and worst RMS error"
+                  << std::endl;
+        if (budget > 0.0) {
+            std::cout << "< = fastest within error budget " << budget
+                      << std::endl;
+        }
+        std::cout << "* = precision not native to the implementation"
+                  << std::endl << std::endl;
+        char line[200];
+        snprintf(line, sizeof(line),
+                 "%-10s %6s %-7s %9s %9s %9s %9s %9s %9s %12s",
+                 "impl", "size", "prec", "fwd rms", "fwd max",
+                 "inv rms", "inv max", "rt rms", "rt max", "ns");
+        std::cout << line << std::endl;
+    }
+
+    for (int si = 0; si < int(sizes.size()); ++si) {
+
+        int size = sizes[si];
+        if (size < 2) continue;
+
+        Reference ref(size);
+        std::vector<long double> in(size), re(size/2 + 1), im(size/2 + 1);
+        srand(2);
+        for (int i = 0; i < size; ++i) {
+            in[i] = double(rand()) / RAND_MAX * 2.0 - 1.0;
+        }
+        for (int i = 0; i <= size/2; ++i) {
+            re[i] = double(rand()) / RAND_MAX * 2.0 - 1.0;
+            im[i] = double(rand()) / RAND_MAX * 2.0 - 1.0;
+        }
+        im[0] = 0.0L;
+        if (size % 2 == 0) im[size/2] = 0.0L;
+
+        for (int p = 0; p < 2; ++p) {
+
+            std::vector<AccuracyResult> results;
+            
+            for (int ii = 0; ii < int(impls.size()); ++ii) {
+
+                FFT::setDefaultImplementation(impls[ii]);
+                if (FFT::getDefaultImplementation() != impls[ii]) {
+                    continue;
+                }
+                FFT fft(size);
+                if (fft.getImplementation() != impls[ii]) {
+                    continue;
+                }
+                FFT::Precisions precisions = fft.getSupportedPrecisions();
+
+                AccuracyResult r;
+                if (p == 0) {
+                    r = measureAccuracy<double>(fft, ref, in, re, im);
+                    r.precision = "double";
+                    r.native = (precisions & FFT::DoublePrecision) != 0;
+                } else {
+                    r = measureAccuracy<float>(fft, ref, in, re, im);
+                    r.precision = "float";
+                    r.native = (precisions & FFT::SinglePrecision) != 0;
+                }
+                r.impl = impls[ii];
+                results.push_back(r);
+            }
+
+            markPareto(results);
+
+            int chosen = -1;
+            for (int i = 0; i < int(results.size()); ++i) {
+                if (budget > 0.0 && results[i].worst <= budget &&
+                    (chosen < 0 || results[i].ns < results[chosen].ns)) {
+                    chosen = i;
+                }
+            }
+
+            for (int i = 0; i < int(results.size()); ++i) {
+                reportAccuracy(csv, size, results[i], i == chosen);
+            }
+        }
+    }
+
+    FFT::setDefaultImplementation("");
+}
+
+// Convolution mode. The direct form keeps the last length - 1 input
+// samples ahead of each block, so that every output sample is a
+// single dot product.
+
+template <typename T>
+struct DirectConvolver
+{
+    DirectConvolver(int blockSize, const std::vector<T> &ir) :
+        block(blockSize), h(ir), x(ir.size() - 1 + blockSize, T(0)) { }
+    void process(const T *in, T *out) {
+        const int n = int(h.size());
+        for (int i = 0; i < block; ++i) x[n - 1 + i] = in[i];
+        for (int i = 0; i < block; ++i) {
+            const T *xi = &x[n - 1 + i];
+            T sum = T(0);
+            for (int j = 0; j < n; ++j) sum += h[j] * xi[-j];
+            out[i] = sum;
+        }
+        for (int i = 0; i < n - 1; ++i) x[i] = x[i + block];
+    }
+    int block;
+    std::vector<T> h;
+    std::vector<T> x;
+};
+
+template <typename C, typename T>
+struct ConvolutionRunner
+{
+    ConvolutionRunner(C &c, const std::vector<T> &input) :
+        conv(c), in(input), out(input.size()) { }
+    void operator()() { conv.process(&in[0], &out[0]); }
+    C &conv;
+    std::vector<T> in;
+    std::vector<T> out;
+};
+
+template <typename T>
+static void
+runConvolution(bool csv, int blockSize, int length,
+               const std::vector<std::string> &impls, std::string precision)
+{
+    std::vector<T> ir(length), in(blockSize);
+    srand(3);
+    for (int i = 0; i < length; ++i) {
+        ir[i] = T((double(rand()) / RAND_MAX * 2.0 - 1.0) *
+                  exp(-4.0 * i / length));
+    }
+    for (int i = 0; i < blockSize; ++i) {
+        in[i] = T(double(rand()) / RAND_MAX * 2.0 - 1.0);
+    }
+
+    DirectConvolver<T> direct(blockSize, ir);
+    ConvolutionRunner<DirectConvolver<T>, T> directRunner(direct, in);
+    Result d = measure(directRunner);
+
+    for (int ii = 0; ii < int(impls.size()); ++ii) {
+
+        FFT::setDefaultImplementation(impls[ii]);
+        if (FFT::getDefaultImplementation() != impls[ii]) {
+            continue;
+        }
+        Convolver<T> conv(blockSize, &ir[0], length, FFT::RealTimeMode);
+        if (conv.getFFT().getImplementation() != impls[ii]) {
+            continue;
+        }
+        ConvolutionRunner<Convolver<T>, T> runner(conv, in);
+        Result r = measure(runner);
+
+        // All stages in the calling thread, so as to time the total
+        // work, which the median over batches spreads across blocks
+        NonUniformConvolver<T> nonUniform(blockSize, &ir[0], length, 0,
+                                          false, FFT::RealTimeMode);
+        ConvolutionRunner<NonUniformConvolver<T>, T> nuRunner(nonUniform, in);
+        Result nu = measure(nuRunner);
+
+        bool noisy = r.noisy || d.noisy || nu.noisy;
+
+        if (csv) {
+            std::cout << impls[ii] << "," << blockSize << "," << length
+                      << "," << precision << "," << conv.getPartitionCount()
+                      << "," << r.p50 << "," << nu.p50 << "," << d.p50
+                      << "," << d.p50 / r.p50 << ","
+                      << (noisy ? "noisy" : "") << std::endl;
+        } else {
+            char line[200];
+            snprintf(line, sizeof(line),
+                     "%-10s %6d %8d %-7s %6d %12.1f %12.1f %12.1f %9.2f %s",
+                     impls[ii].c_str(), blockSize, length, precision.c_str(),
+                     conv.getPartitionCount(), r.p50, nu.p50, d.p50,
+                     d.p50 / r.p50, noisy ? "NOISY" : "");
+            std::cout << line << std::endl;
+        }
+    }
+
+    FFT::setDefaultImplementation("");
+}
+
+static void
+runConvolution(bool csv, const std::vector<int> &blockSizes, int length,
+               const std::vector<std::string> &impls)
+{
+    if (csv) {
+        std::cout << "implementation,block,length,precision,partitions,"
+                  << "ns,nonuniform_ns,direct_ns,speedup,noisy" << std::endl;
+    } else {
+        std::cout << "Median ns per block: uniformly partitioned, "
+                  << "non-uniformly partitioned (all stages in one thread) "
+                  << "and direct form convolution, and speedup of "
+                  << "uniform over direct" << std::endl
+                  << std::endl;
+        char line[200];
+        snprintf(line, sizeof(line),
+                 "%-10s %6s %8s %-7s %6s %12s %12s %12s %9s",
+                 "impl", "block", "length", "prec", "parts",
+                 "ns", "nonuni ns", "direct ns", "speedup");
+        std::cout << line << std::endl;
+    }
+
+    for (int bi = 0; bi < int(blockSizes.size()); ++bi) {
+        if (blockSizes[bi] < 1) continue;
+        runConvolution<double>(csv, blockSizes[bi], length, impls, "double");
+        runConvolution<float>(csv, blockSizes[bi], length, impls, "float");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<int> sizes;
+    std::vector<std::string> impls;
+    bool csv = false;
+    bool accuracy = false;
+    double budget = 0.0;
+    int convolutionLength = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg == "-s" && i + 1 < argc) {
+            sizes.push_back(atoi(argv[++i]));
+        } else if (arg == "-i" && i + 1 < argc) {
+            impls.push_back(argv[++i]);
+        } else if (arg == "-c") {
+            csv = true;
+        } else if (arg == "-a") {
+            accuracy = true;
+        } else if (arg == "-e" && i + 1 < argc) {
+            accuracy = true;
+            budget = atof(argv[++i]);
+        } else if (arg == "-v" && i + 1 < argc) {
+            convolutionLength = atoi(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [-s size]... [-i implementation]... [-c]"
+                      << " [-a] [-e budget] [-v length]" << std::endl;
+            return 2;
+        }
+    }
+
+    if (sizes.empty() && convolutionLength > 0) {
+        int defaultSizes[] = { 64, 128, 256, 512, 1024 };
+        sizes = std::vector<int>
+            (defaultSizes, defaultSizes + sizeof(defaultSizes)/sizeof(defaultSizes[0]));
+    }
+
+    if (sizes.empty()) {
+        int defaultSizes[] = { 64, 128, 256, 480, 512, 1000, 1024, 2048, 4096, 8192 };
+        sizes = std::vector<int>
+            (defaultSizes, defaultSizes + sizeof(defaultSizes)/sizeof(defaultSizes[0]));
+    }
+
+    if (impls.empty()) {
+        std::set<std::string> available = FFT::getImplementations();
+        for (std::set<std::string>::const_iterator i = available.begin();
+             i != available.end(); ++i) {
+            if (*i != "dft") impls.push_back(*i);
+        }
+    }
+
+    pinToCurrentCPU();
+
+    if (accuracy) {
+        runAccuracy(csv, sizes, impls, budget);
+        return 0;
+    }
+
+    if (convolutionLength > 0) {
+        runConvolution(csv, sizes, convolutionLength, impls);
+        return 0;
+    }
+
+    if (csv) {
+        std::cout << "implementation,size,precision,native,method,ns,"
+                  << "mflops,p10,p90,noisy" << std::endl;
+    } else {
+        std::cout << "Median ns per transform, MFLOPS (2.5 N log2 N), "
+                  << "10th and 90th percentiles" << std::endl
+                  << "* = precision not native to the implementation"
+                  << std::endl << std::endl;
+        char line[200];
+        snprintf(line, sizeof(line),
+                 "%-10s %6s %-7s %-20s %12s %10s %12s %12s",
+                 "impl", "size", "prec", "method",
+                 "ns", "MFLOPS", "p10", "p90");
+        std::cout << line << std::endl;
+    }
+
+    int noisy = 0;
+
+    for (int ii = 0; ii < int(impls.size()); ++ii) {
+
+        FFT::setDefaultImplementation(impls[ii]);
+        if (FFT::getDefaultImplementation() != impls[ii]) {
+            continue; // not compiled in, already warned
+        }
+
+        for (int si = 0; si < int(sizes.size()); ++si) {
+
+            int size = sizes[si];
+            if (size < 2) continue;
+
+            FFT fft(size);
+            if (fft.getImplementation() != impls[ii]) {
+                continue; // size not supported by this implementation
+            }
+            fft.initDouble();
+            fft.initFloat();
+
+            FFT::Precisions precisions = fft.getSupportedPrecisions();
+
+            Buffers<double> db(fft);
+            for (int m = 0; m < methodCount; ++m) {
+                Result r = measure(fft, m, db);
+                if (r.noisy) ++noisy;
+                report(csv, impls[ii], size, "double",
+                       (precisions & FFT::DoublePrecision) != 0, m, r);
+            }
+
+            Buffers<float> fb(fft);
+            for (int m = 0; m < methodCount; ++m) {
+                Result r = measure(fft, m, fb);
+                if (r.noisy) ++noisy;
+                report(csv, impls[ii], size, "float",
+                       (precisions & FFT::SinglePrecision) != 0, m, r);
+            }
+        }
+    }
+
+    if (noisy > 0) {
+        std::cerr << noisy << " result(s) flagged as noisy: "
+                  << "consider rerunning on a quieter machine" << std::endl;
+    }
+
+    return 0;
+}
@@ -5,7 +5,38 @@
 
 #include <iostream>
 
-int main(int, char **)
+// Usage: timings [text|json|csv] [size ...]
+
+int main(int argc, char **argv)
 {
-    breakfastquay::FFT::tune();
+    if (argc < 2) {
+        breakfastquay::FFT::tune();
+        return 0;
+    }
+
+    breakfastquay::FFT::TuneFormat format = breakfastquay::FFT::TuneText;
+    std::string f(argv[1]);
+    if (f == "json") {
+        format = breakfastquay::FFT::TuneJSON;
+    } else if (f == "csv") {
+        format = breakfastquay::FFT::TuneCSV;
+    } else if (f != "text") {
+        std::cerr << "Usage: " << argv[0] << " [text|json|csv] [size ...]"
+                  << std::endl;
+        return 2;
+    }
+
+    std::vector<int> sizes;
+    for (int i = 2; i < argc; ++i) {
+        sizes.push_back(atoi(argv[i]));
+    }
+    if (sizes.empty()) {
+        sizes.push_back(512);
+        sizes.push_back(1024);
+        sizes.push_back(2048);
+        sizes.push_back(4096);
+    }
+    
+    breakfastquay::FFT::tune(format, sizes);
+    return 0;
 }